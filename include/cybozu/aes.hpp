@@ -1,7 +1,7 @@
 #pragma once
 /**
 	@file
-	@brief AES-CBC/CTR/ECB cipher
+	@brief AES-CBC/CTR/ECB cipher and AES-GCM authenticated encryption
 	@author MITSUNARI Shigeo(@herumi)
 */
 
@@ -15,10 +15,26 @@
 #ifdef CYBOZU_AES_NI
 	#include <wmmintrin.h>
 	#include <string.h> // memcpy
+	#include <cybozu/endian.hpp>
+	#include <cybozu/parallel.hpp>
+	#include <tmmintrin.h> // _mm_shuffle_epi8
 	#ifdef __GNUC__
 		#define CYBOZU_AES_NI_TARGET __attribute__((target("aes,sse2")))
+		#define CYBOZU_AES_NI_CLMUL_TARGET __attribute__((target("aes,pclmul,ssse3")))
 	#else
 		#define CYBOZU_AES_NI_TARGET
+		#define CYBOZU_AES_NI_CLMUL_TARGET
+	#endif
+	/*
+		process 16 blocks at a time by VAES(and VPCLMULQDQ for GCM) and AVX-512 if the CPU supports them
+		define CYBOZU_AES_DONT_USE_VAES to disable it
+	*/
+	#if !defined(CYBOZU_AES_DONT_USE_VAES) && defined(__x86_64__) && !defined(__APPLE__) \
+		&& ((defined(__clang__) && __clang_major__ >= 8) || (!defined(__clang__) && __GNUC__ >= 8))
+		#define CYBOZU_AES_VAES
+		#include <immintrin.h>
+		#include <cpuid.h>
+		#define CYBOZU_AES_VAES_TARGET __attribute__((target("aes,pclmul,vaes,vpclmulqdq,avx512f,avx512bw")))
 	#endif
 #endif
 
@@ -65,16 +81,57 @@ namespace crypto {
 #ifdef CYBOZU_AES_NI
 namespace local {
 
+#ifdef CYBOZU_AES_VAES
+/*
+	return ecx of cpuid(eax = 7, ecx = 0) if AVX512F and AVX512BW are available else 0
+*/
+inline uint32_t getAvx512Feature()
+{
+	unsigned int a, b, c, d;
+	if (__get_cpuid_max(0, 0) < 7) return 0;
+	__cpuid(1, a, b, c, d);
+	if ((c & (1u << 27)) == 0) return 0; // OSXSAVE
+	uint32_t xcr0, xcr0H;
+	__asm__ volatile("xgetbv" : "=a"(xcr0), "=d"(xcr0H) : "c"(0));
+	if ((xcr0 & 0xe6) != 0xe6) return 0; // OS saves xmm, ymm, opmask and zmm
+	__cpuid_count(7, 0, a, b, c, d);
+	if ((b & (1u << 16)) == 0 || (b & (1u << 30)) == 0) return 0;
+	return c;
+}
+#endif
+
+inline bool hasVaes()
+{
+#ifdef CYBOZU_AES_VAES
+	static const bool b = (getAvx512Feature() & (1u << 9)) != 0;
+	return b;
+#else
+	return false;
+#endif
+}
+
+inline bool hasVpclmulqdq()
+{
+#ifdef CYBOZU_AES_VAES
+	static const bool b = (getAvx512Feature() & (1u << 10)) != 0;
+	return b;
+#else
+	return false;
+#endif
+}
+
 /*
-	AES-CBC/CTR/ECB by AES-NI intrinsics
+	AES-CBC/CTR/ECB/GCM by AES-NI intrinsics
 	update/finalize have the same semantics as EVP_CipherUpdate/EVP_CipherFinal_ex without padding
+	CTR, ECB, CBC-decrypt and GCM process 8 blocks at a time (16 blocks if VAES is available)
 */
 class AesNi {
 public:
 	enum Mode {
 		M_CBC,
 		M_CTR,
-		M_ECB
+		M_ECB,
+		M_GCM
 	};
 private:
 	static const int maxRoundNum = 14;
@@ -82,14 +139,26 @@ private:
 	__m128i key_[maxRoundNum + 1];
 	__m128i iv_; // for CBC
 	uint8_t buf_[blockSize]; // partial block for CBC/ECB
-	uint8_t ctr_[blockSize]; // big endian counter for CTR
-	uint8_t ks_[blockSize]; // keystream for CTR
+	uint64_t ctrHi_, ctrLo_; // 128-bit big endian counter for CTR
+	uint8_t ks_[blockSize]; // keystream for CTR/GCM
+	// for GCM ; GHASH values are byte reflected
+	static const int ghashTblN = 16;
+	__m128i hTbl_[ghashTblN]; // hTbl_[i] = H^(ghashTblN - i)
+	__m128i ghash_;
+	__m128i ctrGcm_; // the lowest 32 bits are the counter
+	__m128i ekJ0_; // E(K, J0)
+	uint8_t gBuf_[blockSize]; // partial block of AAD or ciphertext for GHASH
+	size_t gPos_;
+	uint64_t aadSize_;
+	uint64_t msgSize_;
+	bool aadDone_;
 	size_t bufSize_;
 	size_t ksPos_;
 	size_t keySize_;
 	int roundNum_;
 	Mode mode_;
 	bool encMode_;
+	bool useVaes_;
 	CYBOZU_AES_NI_TARGET
 	static inline __m128i nextKey(__m128i key, __m128i t)
 	{
@@ -199,87 +268,600 @@ private:
 		}
 		return _mm_aesdeclast_si128(m, key_[roundNum_]);
 	}
+	/*
+		process 8 independent blocks in parallel to hide the latency of aesenc/aesdec
+	*/
+#define CYBOZU_CRYPTO_AES_X8(op, k) \
+		m[0] = op(m[0], k); m[1] = op(m[1], k); m[2] = op(m[2], k); m[3] = op(m[3], k); \
+		m[4] = op(m[4], k); m[5] = op(m[5], k); m[6] = op(m[6], k); m[7] = op(m[7], k)
 	CYBOZU_AES_NI_TARGET
-	void processBlocks(uint8_t *out, const uint8_t *in, size_t blockNum)
+	void encrypt8(__m128i m[8]) const
+	{
+		CYBOZU_CRYPTO_AES_X8(_mm_xor_si128, key_[0]);
+		for (int i = 1; i < roundNum_; i++) {
+			const __m128i k = key_[i];
+			CYBOZU_CRYPTO_AES_X8(_mm_aesenc_si128, k);
+		}
+		CYBOZU_CRYPTO_AES_X8(_mm_aesenclast_si128, key_[roundNum_]);
+	}
+	CYBOZU_AES_NI_TARGET
+	void decrypt8(__m128i m[8]) const
+	{
+		CYBOZU_CRYPTO_AES_X8(_mm_xor_si128, key_[0]);
+		for (int i = 1; i < roundNum_; i++) {
+			const __m128i k = key_[i];
+			CYBOZU_CRYPTO_AES_X8(_mm_aesdec_si128, k);
+		}
+		CYBOZU_CRYPTO_AES_X8(_mm_aesdeclast_si128, key_[roundNum_]);
+	}
+#undef CYBOZU_CRYPTO_AES_X8
+	// return the counter block of (hi, lo) and increment it
+	CYBOZU_AES_NI_TARGET
+	static inline __m128i nextCtrBlock(uint64_t& hi, uint64_t& lo)
+	{
+		const __m128i c = _mm_set_epi64x(int64_t(cybozu::byteSwap(lo)), int64_t(cybozu::byteSwap(hi)));
+		if (++lo == 0) hi++;
+		return c;
+	}
+#ifdef CYBOZU_AES_VAES
+#if defined(__GNUC__) && !defined(__clang__)
+	// avoid a false positive of _mm512_undefined_epi32 in GCC 12
+	#pragma GCC diagnostic push
+	#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+	#pragma GCC diagnostic ignored "-Wuninitialized"
+#endif
+	/*
+		process 16 blocks (4 x 4 blocks) by VAES
+	*/
+#define CYBOZU_CRYPTO_AES_X4(op, k) \
+		m[0] = op(m[0], k); m[1] = op(m[1], k); m[2] = op(m[2], k); m[3] = op(m[3], k)
+	CYBOZU_AES_VAES_TARGET
+	void encrypt16(__m512i m[4]) const
 	{
+		CYBOZU_CRYPTO_AES_X4(_mm512_xor_si512, _mm512_broadcast_i32x4(key_[0]));
+		for (int i = 1; i < roundNum_; i++) {
+			const __m512i k = _mm512_broadcast_i32x4(key_[i]);
+			CYBOZU_CRYPTO_AES_X4(_mm512_aesenc_epi128, k);
+		}
+		CYBOZU_CRYPTO_AES_X4(_mm512_aesenclast_epi128, _mm512_broadcast_i32x4(key_[roundNum_]));
+	}
+	CYBOZU_AES_VAES_TARGET
+	void decrypt16(__m512i m[4]) const
+	{
+		CYBOZU_CRYPTO_AES_X4(_mm512_xor_si512, _mm512_broadcast_i32x4(key_[0]));
+		for (int i = 1; i < roundNum_; i++) {
+			const __m512i k = _mm512_broadcast_i32x4(key_[i]);
+			CYBOZU_CRYPTO_AES_X4(_mm512_aesdec_epi128, k);
+		}
+		CYBOZU_CRYPTO_AES_X4(_mm512_aesdeclast_epi128, _mm512_broadcast_i32x4(key_[roundNum_]));
+	}
+#undef CYBOZU_CRYPTO_AES_X4
+	/*
+		process blocks of CTR by 16 blocks
+		@return the number of processed blocks (a multiple of 16)
+	*/
+	CYBOZU_AES_VAES_TARGET
+	size_t processCtrBlocksVaes(uint8_t *out, const uint8_t *in, size_t blockNum, uint64_t& hi, uint64_t& lo) const
+	{
+		const size_t n = blockNum & ~size_t(15);
+		const __m512i *src = cybozu::cast<const __m512i*>(in);
+		__m512i *dst = cybozu::cast<__m512i*>(out);
+		__m512i m[4];
+		for (size_t i = 0; i < n; i += 16) {
+			for (int j = 0; j < 4; j++) {
+				m[j] = _mm512_castsi128_si512(nextCtrBlock(hi, lo));
+				m[j] = _mm512_inserti32x4(m[j], nextCtrBlock(hi, lo), 1);
+				m[j] = _mm512_inserti32x4(m[j], nextCtrBlock(hi, lo), 2);
+				m[j] = _mm512_inserti32x4(m[j], nextCtrBlock(hi, lo), 3);
+			}
+			encrypt16(m);
+			for (int j = 0; j < 4; j++) {
+				_mm512_storeu_si512(dst + j, _mm512_xor_si512(m[j], _mm512_loadu_si512(src + j)));
+			}
+			src += 4;
+			dst += 4;
+		}
+		return n;
+	}
+	/*
+		process blocks of ECB and CBC-decrypt by 16 blocks
+		@return the number of processed blocks (a multiple of 16)
+	*/
+	CYBOZU_AES_VAES_TARGET
+	size_t processBlocksVaes(uint8_t *out, const uint8_t *in, size_t blockNum)
+	{
+		const size_t n = blockNum & ~size_t(15);
+		const __m512i *src = cybozu::cast<const __m512i*>(in);
+		__m512i *dst = cybozu::cast<__m512i*>(out);
+		__m512i m[4];
 		if (mode_ == M_ECB) {
-			for (size_t i = 0; i < blockNum; i++) {
-				__m128i m = _mm_loadu_si128(cybozu::cast<const __m128i*>(in) + i);
-				m = encMode_ ? encryptBlock(m) : decryptBlock(m);
-				_mm_storeu_si128(cybozu::cast<__m128i*>(out) + i, m);
+			for (size_t i = 0; i < n; i += 16) {
+				for (int j = 0; j < 4; j++) m[j] = _mm512_loadu_si512(src + j);
+				if (encMode_) {
+					encrypt16(m);
+				} else {
+					decrypt16(m);
+				}
+				for (int j = 0; j < 4; j++) _mm512_storeu_si512(dst + j, m[j]);
+				src += 4;
+				dst += 4;
+			}
+		} else {
+			// CBC-decrypt ; the highest 128-bit lane of prev has the previous ciphertext
+			__m512i prev = _mm512_broadcast_i32x4(iv_);
+			for (size_t i = 0; i < n; i += 16) {
+				__m512i c[4];
+				for (int j = 0; j < 4; j++) m[j] = c[j] = _mm512_loadu_si512(src + j);
+				decrypt16(m);
+				for (int j = 0; j < 4; j++) {
+					// (prev[3], c[j][0], c[j][1], c[j][2])
+					_mm512_storeu_si512(dst + j, _mm512_xor_si512(m[j], _mm512_alignr_epi64(c[j], prev, 6)));
+					prev = c[j];
+				}
+				src += 4;
+				dst += 4;
 			}
+			iv_ = _mm512_extracti32x4_epi32(prev, 3);
+		}
+		return n;
+	}
+#if defined(__GNUC__) && !defined(__clang__)
+	#pragma GCC diagnostic pop
+#endif
+#endif
+	/*
+		process blockNum blocks of CTR from the counter (ctrHi, ctrLo) and advance it
+		@note it does not modify the members, so threads may call it for different ranges
+	*/
+	CYBOZU_AES_NI_TARGET
+	void processCtrBlocks(uint8_t *out, const uint8_t *in, size_t blockNum, uint64_t& ctrHi, uint64_t& ctrLo) const
+	{
+		// use local variables because out may alias ctrHi and ctrLo
+		uint64_t hi = ctrHi, lo = ctrLo;
+#ifdef CYBOZU_AES_VAES
+		if (useVaes_ && blockNum >= 16) {
+			const size_t n = processCtrBlocksVaes(out, in, blockNum, hi, lo);
+			out += n * blockSize;
+			in += n * blockSize;
+			blockNum -= n;
+		}
+#endif
+		const __m128i *src = cybozu::cast<const __m128i*>(in);
+		__m128i *dst = cybozu::cast<__m128i*>(out);
+		size_t i = 0;
+		__m128i m[8];
+		for (; i + 8 <= blockNum; i += 8) {
+			for (int j = 0; j < 8; j++) m[j] = nextCtrBlock(hi, lo);
+			encrypt8(m);
+			for (int j = 0; j < 8; j++) {
+				_mm_storeu_si128(dst + i + j, _mm_xor_si128(m[j], _mm_loadu_si128(src + i + j)));
+			}
+		}
+		for (; i < blockNum; i++) {
+			_mm_storeu_si128(dst + i, _mm_xor_si128(encryptBlock(nextCtrBlock(hi, lo)), _mm_loadu_si128(src + i)));
+		}
+		ctrHi = hi;
+		ctrLo = lo;
+	}
+	// add n to the 128-bit counter (hi, lo)
+	static inline void addCtr(uint64_t& hi, uint64_t& lo, uint64_t n)
+	{
+		lo += n;
+		if (lo < n) hi++;
+	}
+	struct CtrTask {
+		const AesNi *self;
+		uint8_t *out;
+		const uint8_t *in;
+		size_t blockNum;
+		size_t chunkNum; // number of blocks of a thread
+		uint64_t hi, lo;
+		bool operator()(size_t i, size_t)
+		{
+			const size_t begin = i * chunkNum;
+			if (begin >= blockNum) return true;
+			const size_t n = blockNum - begin < chunkNum ? blockNum - begin : chunkNum;
+			// the counter of each chunk is computed directly
+			uint64_t h = hi, l = lo;
+			addCtr(h, l, begin);
+			self->processCtrBlocks(out + begin * blockSize, in + begin * blockSize, n, h, l);
+			return true;
+		}
+	};
+	CYBOZU_AES_NI_TARGET
+	void processBlocks(uint8_t *out, const uint8_t *in, size_t blockNum)
+	{
+		if (mode_ == M_CTR) {
+			processCtrBlocks(out, in, blockNum, ctrHi_, ctrLo_);
 			return;
 		}
-		__m128i iv = iv_;
-		if (encMode_) {
+		// CBC-encrypt is sequential
+		if (mode_ == M_CBC && encMode_) {
+			__m128i iv = iv_;
 			for (size_t i = 0; i < blockNum; i++) {
 				iv = encryptBlock(_mm_xor_si128(_mm_loadu_si128(cybozu::cast<const __m128i*>(in) + i), iv));
 				_mm_storeu_si128(cybozu::cast<__m128i*>(out) + i, iv);
 			}
+			iv_ = iv;
+			return;
+		}
+#ifdef CYBOZU_AES_VAES
+		if (useVaes_ && blockNum >= 16) {
+			const size_t n = processBlocksVaes(out, in, blockNum);
+			out += n * blockSize;
+			in += n * blockSize;
+			blockNum -= n;
+		}
+#endif
+		const __m128i *src = cybozu::cast<const __m128i*>(in);
+		__m128i *dst = cybozu::cast<__m128i*>(out);
+		size_t i = 0;
+		__m128i m[8];
+		if (mode_ == M_ECB) {
+			for (; i + 8 <= blockNum; i += 8) {
+				for (int j = 0; j < 8; j++) m[j] = _mm_loadu_si128(src + i + j);
+				if (encMode_) {
+					encrypt8(m);
+				} else {
+					decrypt8(m);
+				}
+				for (int j = 0; j < 8; j++) _mm_storeu_si128(dst + i + j, m[j]);
+			}
+			for (; i < blockNum; i++) {
+				const __m128i c = _mm_loadu_si128(src + i);
+				_mm_storeu_si128(dst + i, encMode_ ? encryptBlock(c) : decryptBlock(c));
+			}
 		} else {
-			for (size_t i = 0; i < blockNum; i++) {
-				__m128i c = _mm_loadu_si128(cybozu::cast<const __m128i*>(in) + i);
-				_mm_storeu_si128(cybozu::cast<__m128i*>(out) + i, _mm_xor_si128(decryptBlock(c), iv));
+			// CBC-decrypt ; load all blocks before storing because out may be equal to in
+			__m128i iv = iv_;
+			for (; i + 8 <= blockNum; i += 8) {
+				__m128i c[8];
+				for (int j = 0; j < 8; j++) m[j] = c[j] = _mm_loadu_si128(src + i + j);
+				decrypt8(m);
+				_mm_storeu_si128(dst + i, _mm_xor_si128(m[0], iv));
+				for (int j = 1; j < 8; j++) _mm_storeu_si128(dst + i + j, _mm_xor_si128(m[j], c[j - 1]));
+				iv = c[7];
+			}
+			for (; i < blockNum; i++) {
+				const __m128i c = _mm_loadu_si128(src + i);
+				_mm_storeu_si128(dst + i, _mm_xor_si128(decryptBlock(c), iv));
 				iv = c;
 			}
-		}
-		iv_ = iv;
-	}
-	void incCtr()
-	{
-		for (int i = (int)blockSize - 1; i >= 0; i--) {
-			if (++ctr_[i] != 0) break;
+			iv_ = iv;
 		}
 	}
 	CYBOZU_AES_NI_TARGET
 	void generateKeyStream()
 	{
-		const __m128i ks = encryptBlock(_mm_loadu_si128(cybozu::cast<const __m128i*>(ctr_)));
-		_mm_storeu_si128(cybozu::cast<__m128i*>(ks_), ks);
-		incCtr();
+		_mm_storeu_si128(cybozu::cast<__m128i*>(ks_), encryptBlock(nextCtrBlock(ctrHi_, ctrLo_)));
 	}
-	CYBOZU_AES_NI_TARGET
-	void processCtrBlocks(uint8_t *out, const uint8_t *in, size_t blockNum)
+	int updateCtr(uint8_t *out, const uint8_t *in, size_t inSize)
+	{
+		updateCtrParallel(out, in, inSize, 1);
+		return (int)inSize;
+	}
+	/*
+		GHASH for GCM
+		blocks are byte reflected so that the bit order of GF(2^128) matches pclmulqdq
+	*/
+	CYBOZU_AES_NI_CLMUL_TARGET
+	static inline __m128i bswap128(__m128i x)
+	{
+		return _mm_shuffle_epi8(x, _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15));
+	}
+	// (hi, mid, lo) ^= a * b without reduction
+	CYBOZU_AES_NI_CLMUL_TARGET
+	static inline void mulAcc(__m128i& lo, __m128i& mid, __m128i& hi, __m128i a, __m128i b)
 	{
+		lo = _mm_xor_si128(lo, _mm_clmulepi64_si128(a, b, 0x00));
+		hi = _mm_xor_si128(hi, _mm_clmulepi64_si128(a, b, 0x11));
+		mid = _mm_xor_si128(mid, _mm_clmulepi64_si128(a, b, 0x01));
+		mid = _mm_xor_si128(mid, _mm_clmulepi64_si128(a, b, 0x10));
+	}
+	// reduce (hi, mid, lo) modulo x^128 + x^7 + x^2 + x + 1
+	CYBOZU_AES_NI_CLMUL_TARGET
+	static inline __m128i reduce(__m128i lo, __m128i mid, __m128i hi)
+	{
+		lo = _mm_xor_si128(lo, _mm_slli_si128(mid, 8));
+		hi = _mm_xor_si128(hi, _mm_srli_si128(mid, 8));
+		// shift (hi, lo) left by 1 because of the bit reflection
+		__m128i t1 = _mm_srli_epi32(lo, 31);
+		__m128i t2 = _mm_srli_epi32(hi, 31);
+		lo = _mm_slli_epi32(lo, 1);
+		hi = _mm_slli_epi32(hi, 1);
+		hi = _mm_or_si128(hi, _mm_srli_si128(t1, 12));
+		hi = _mm_or_si128(hi, _mm_slli_si128(t2, 4));
+		lo = _mm_or_si128(lo, _mm_slli_si128(t1, 4));
+		t1 = _mm_xor_si128(_mm_slli_epi32(lo, 31), _mm_xor_si128(_mm_slli_epi32(lo, 30), _mm_slli_epi32(lo, 25)));
+		t2 = _mm_srli_si128(t1, 4);
+		lo = _mm_xor_si128(lo, _mm_slli_si128(t1, 12));
+		t1 = _mm_xor_si128(_mm_srli_epi32(lo, 1), _mm_xor_si128(_mm_srli_epi32(lo, 2), _mm_srli_epi32(lo, 7)));
+		lo = _mm_xor_si128(lo, _mm_xor_si128(t1, t2));
+		return _mm_xor_si128(hi, lo);
+	}
+	CYBOZU_AES_NI_CLMUL_TARGET
+	static inline __m128i gfmul(__m128i a, __m128i b)
+	{
+		const __m128i zero = _mm_setzero_si128();
+		__m128i lo = zero, mid = zero, hi = zero;
+		mulAcc(lo, mid, hi, a, b);
+		return reduce(lo, mid, hi);
+	}
+	// ghash_ = (ghash_ + c) * H for byte reflected c
+	CYBOZU_AES_NI_CLMUL_TARGET
+	void ghashBlock(__m128i c)
+	{
+		ghash_ = gfmul(_mm_xor_si128(ghash_, c), hTbl_[ghashTblN - 1]);
+	}
+	CYBOZU_AES_NI_CLMUL_TARGET
+	void ghashBlocks(const uint8_t *p, size_t blockNum)
+	{
+		const __m128i *src = cybozu::cast<const __m128i*>(p);
 		for (size_t i = 0; i < blockNum; i++) {
-			const __m128i ks = encryptBlock(_mm_loadu_si128(cybozu::cast<const __m128i*>(ctr_)));
-			incCtr();
-			_mm_storeu_si128(cybozu::cast<__m128i*>(out) + i, _mm_xor_si128(_mm_loadu_si128(cybozu::cast<const __m128i*>(in) + i), ks));
+			ghashBlock(bswap128(_mm_loadu_si128(src + i)));
 		}
 	}
-	int updateCtr(uint8_t *out, const uint8_t *in, size_t inSize)
+	// absorb the partial block of AAD or message padded with zeros
+	CYBOZU_AES_NI_CLMUL_TARGET
+	void flushGhash()
+	{
+		if (gPos_ == 0) return;
+		memset(gBuf_ + gPos_, 0, blockSize - gPos_);
+		ghashBlock(bswap128(_mm_loadu_si128(cybozu::cast<const __m128i*>(gBuf_))));
+		gPos_ = 0;
+	}
+	/*
+		encrypt the counter blocks m[8] and ghash the blocks g[8] (if g != 0) at the same time
+	*/
+#define CYBOZU_CRYPTO_AES_X8(op, k) \
+		m[0] = op(m[0], k); m[1] = op(m[1], k); m[2] = op(m[2], k); m[3] = op(m[3], k); \
+		m[4] = op(m[4], k); m[5] = op(m[5], k); m[6] = op(m[6], k); m[7] = op(m[7], k)
+	CYBOZU_AES_NI_CLMUL_TARGET
+	void encryptGhash8(__m128i m[8], const __m128i *g)
+	{
+		const __m128i zero = _mm_setzero_si128();
+		__m128i lo = zero, mid = zero, hi = zero;
+		CYBOZU_CRYPTO_AES_X8(_mm_xor_si128, key_[0]);
+		// roundNum_ >= 10
+		for (int i = 1; i <= 8; i++) {
+			const __m128i k = key_[i];
+			CYBOZU_CRYPTO_AES_X8(_mm_aesenc_si128, k);
+			if (g) {
+				__m128i x = bswap128(_mm_loadu_si128(g + i - 1));
+				if (i == 1) x = _mm_xor_si128(x, ghash_);
+				mulAcc(lo, mid, hi, x, hTbl_[ghashTblN - 9 + i]);
+			}
+		}
+		for (int i = 9; i < roundNum_; i++) {
+			const __m128i k = key_[i];
+			CYBOZU_CRYPTO_AES_X8(_mm_aesenc_si128, k);
+		}
+		CYBOZU_CRYPTO_AES_X8(_mm_aesenclast_si128, key_[roundNum_]);
+		if (g) ghash_ = reduce(lo, mid, hi);
+	}
+#undef CYBOZU_CRYPTO_AES_X8
+	// return the counter block and increment the lowest 32 bits
+	CYBOZU_AES_NI_CLMUL_TARGET
+	static inline __m128i nextGcmCtrBlock(__m128i& ctr)
 	{
+		const __m128i c = bswap128(ctr);
+		ctr = _mm_add_epi32(ctr, _mm_set_epi32(0, 0, 0, 1));
+		return c;
+	}
+#ifdef CYBOZU_AES_VAES
+#if defined(__GNUC__) && !defined(__clang__)
+	// avoid a false positive of _mm512_undefined_epi32 in GCC 12
+	#pragma GCC diagnostic push
+	#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+	#pragma GCC diagnostic ignored "-Wuninitialized"
+#endif
+	/*
+		encrypt 16 counter blocks m[4] and ghash 16 blocks g (if g != 0) by VAES and VPCLMULQDQ
+	*/
+#define CYBOZU_CRYPTO_AES_X4(op, k) \
+		m[0] = op(m[0], k); m[1] = op(m[1], k); m[2] = op(m[2], k); m[3] = op(m[3], k)
+	CYBOZU_AES_VAES_TARGET
+	void encryptGhash16(__m512i m[4], const __m512i *g)
+	{
+		const __m512i mask = _mm512_broadcast_i32x4(_mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15));
+		const __m512i *hTbl = cybozu::cast<const __m512i*>(hTbl_);
+		__m512i lo = _mm512_setzero_si512(), mid = lo, hi = lo;
+		CYBOZU_CRYPTO_AES_X4(_mm512_xor_si512, _mm512_broadcast_i32x4(key_[0]));
+		for (int i = 1; i <= 4; i++) {
+			const __m512i k = _mm512_broadcast_i32x4(key_[i]);
+			CYBOZU_CRYPTO_AES_X4(_mm512_aesenc_epi128, k);
+			if (g) {
+				__m512i x = _mm512_shuffle_epi8(_mm512_loadu_si512(g + i - 1), mask);
+				if (i == 1) x = _mm512_xor_si512(x, _mm512_inserti32x4(_mm512_setzero_si512(), ghash_, 0));
+				const __m512i h = _mm512_loadu_si512(hTbl + i - 1);
+				lo = _mm512_xor_si512(lo, _mm512_clmulepi64_epi128(x, h, 0x00));
+				hi = _mm512_xor_si512(hi, _mm512_clmulepi64_epi128(x, h, 0x11));
+				mid = _mm512_xor_si512(mid, _mm512_clmulepi64_epi128(x, h, 0x01));
+				mid = _mm512_xor_si512(mid, _mm512_clmulepi64_epi128(x, h, 0x10));
+			}
+		}
+		for (int i = 5; i < roundNum_; i++) {
+			const __m512i k = _mm512_broadcast_i32x4(key_[i]);
+			CYBOZU_CRYPTO_AES_X4(_mm512_aesenc_epi128, k);
+		}
+		CYBOZU_CRYPTO_AES_X4(_mm512_aesenclast_epi128, _mm512_broadcast_i32x4(key_[roundNum_]));
+		if (g) ghash_ = reduce(sumLane(lo), sumLane(mid), sumLane(hi));
+	}
+#undef CYBOZU_CRYPTO_AES_X4
+	// xor of four 128-bit lanes
+	CYBOZU_AES_VAES_TARGET
+	static inline __m128i sumLane(__m512i x)
+	{
+		const __m256i t = _mm256_xor_si256(_mm512_castsi512_si256(x), _mm512_extracti64x4_epi64(x, 1));
+		return _mm_xor_si128(_mm256_castsi256_si128(t), _mm256_extracti128_si256(t, 1));
+	}
+	/*
+		process GCM blocks by 16 blocks
+		@return the number of processed blocks (a multiple of 16)
+	*/
+	CYBOZU_AES_VAES_TARGET
+	size_t processGcmBlocksVaes(uint8_t *out, const uint8_t *in, size_t blockNum)
+	{
+		const size_t n = blockNum & ~size_t(15);
+		if (n == 0) return 0;
+		const __m512i mask = _mm512_broadcast_i32x4(_mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15));
+		const __m512i four = _mm512_broadcast_i32x4(_mm_set_epi32(0, 0, 0, 4));
+		__m512i ctr = _mm512_add_epi32(_mm512_broadcast_i32x4(ctrGcm_), _mm512_set_epi32(0, 0, 0, 3, 0, 0, 0, 2, 0, 0, 0, 1, 0, 0, 0, 0));
+		const __m512i *src = cybozu::cast<const __m512i*>(in);
+		__m512i *dst = cybozu::cast<__m512i*>(out);
+		const __m512i *prev = 0; // ciphertext to be hashed
+		__m512i m[4];
+		for (size_t i = 0; i < n; i += 16) {
+			for (int j = 0; j < 4; j++) {
+				m[j] = _mm512_shuffle_epi8(ctr, mask);
+				ctr = _mm512_add_epi32(ctr, four);
+			}
+			// hash the previous ciphertext for encryption and the current one for decryption
+			encryptGhash16(m, encMode_ ? prev : src);
+			for (int j = 0; j < 4; j++) {
+				_mm512_storeu_si512(dst + j, _mm512_xor_si512(m[j], _mm512_loadu_si512(src + j)));
+			}
+			prev = dst;
+			src += 4;
+			dst += 4;
+		}
+		if (encMode_) ghashBlocks(cybozu::cast<const uint8_t*>(prev), 16);
+		ctrGcm_ = _mm512_castsi512_si128(ctr);
+		return n;
+	}
+#if defined(__GNUC__) && !defined(__clang__)
+	#pragma GCC diagnostic pop
+#endif
+#endif
+	CYBOZU_AES_NI_CLMUL_TARGET
+	void processGcmBlocks(uint8_t *out, const uint8_t *in, size_t blockNum)
+	{
+#ifdef CYBOZU_AES_VAES
+		if (useVaes_ && hasVpclmulqdq() && blockNum >= 16) {
+			const size_t n = processGcmBlocksVaes(out, in, blockNum);
+			out += n * blockSize;
+			in += n * blockSize;
+			blockNum -= n;
+		}
+#endif
+		const __m128i *src = cybozu::cast<const __m128i*>(in);
+		__m128i *dst = cybozu::cast<__m128i*>(out);
+		__m128i ctr = ctrGcm_;
+		__m128i m[8];
+		size_t i = 0;
+		if (blockNum >= 8) {
+			const __m128i *prev = 0; // ciphertext to be hashed
+			for (; i + 8 <= blockNum; i += 8) {
+				for (int j = 0; j < 8; j++) m[j] = nextGcmCtrBlock(ctr);
+				// hash the previous ciphertext for encryption and the current one for decryption
+				encryptGhash8(m, encMode_ ? prev : src + i);
+				for (int j = 0; j < 8; j++) {
+					_mm_storeu_si128(dst + i + j, _mm_xor_si128(m[j], _mm_loadu_si128(src + i + j)));
+				}
+				prev = dst + i;
+			}
+			if (encMode_) ghashBlocks(cybozu::cast<const uint8_t*>(prev), 8);
+		}
+		for (; i < blockNum; i++) {
+			const __m128i x = _mm_loadu_si128(src + i);
+			const __m128i y = _mm_xor_si128(encryptBlock(nextGcmCtrBlock(ctr)), x);
+			_mm_storeu_si128(dst + i, y);
+			ghashBlock(bswap128(encMode_ ? y : x));
+		}
+		ctrGcm_ = ctr;
+	}
+	CYBOZU_AES_NI_CLMUL_TARGET
+	void setupGcm(const std::string& iv)
+	{
+		hTbl_[ghashTblN - 1] = bswap128(encryptBlock(_mm_setzero_si128()));
+		for (int i = ghashTblN - 2; i >= 0; i--) {
+			hTbl_[i] = gfmul(hTbl_[i + 1], hTbl_[ghashTblN - 1]);
+		}
+		ghash_ = _mm_setzero_si128();
+		__m128i j0;
+		if (iv.size() == 12) {
+			uint8_t buf[blockSize] = {};
+			memcpy(buf, iv.data(), 12);
+			buf[15] = 1;
+			j0 = bswap128(_mm_loadu_si128(cybozu::cast<const __m128i*>(buf)));
+		} else {
+			// J0 = GHASH(IV || 0^s || 0^64 || [len(IV)]_64)
+			const size_t n = iv.size() / blockSize;
+			ghashBlocks(cybozu::cast<const uint8_t*>(iv.data()), n);
+			gPos_ = iv.size() - n * blockSize;
+			memcpy(gBuf_, iv.data() + n * blockSize, gPos_);
+			flushGhash();
+			ghashBlock(_mm_set_epi64x(0, int64_t(iv.size() * 8)));
+			j0 = ghash_;
+			ghash_ = _mm_setzero_si128();
+		}
+		ekJ0_ = encryptBlock(bswap128(j0));
+		ctrGcm_ = _mm_add_epi32(j0, _mm_set_epi32(0, 0, 0, 1));
+		gPos_ = 0;
+		aadSize_ = 0;
+		msgSize_ = 0;
+		aadDone_ = false;
+	}
+	int updateGcm(uint8_t *out, const uint8_t *in, size_t inSize)
+	{
+		// at most 2^32 - 2 blocks
+		const uint64_t maxMsgSize = ((uint64_t(1) << 32) - 2) * blockSize;
+		if (inSize > maxMsgSize - msgSize_) return -1;
+		if (!aadDone_) {
+			flushGhash();
+			aadDone_ = true;
+		}
+		msgSize_ += inSize;
 		size_t remain = inSize;
 		// use the rest of the previous keystream
-		while (remain > 0 && ksPos_ < blockSize) {
-			*out++ = *in++ ^ ks_[ksPos_++];
+		while (remain > 0 && gPos_ > 0) {
+			const uint8_t c = *in ^ ks_[gPos_];
+			gBuf_[gPos_++] = encMode_ ? c : *in;
+			*out++ = c;
+			in++;
 			remain--;
+			if (gPos_ == blockSize) {
+				gPos_ = 0;
+				ghashBlocks(gBuf_, 1);
+			}
 		}
 		const size_t blockNum = remain / blockSize;
 		if (blockNum > 0) {
-			processCtrBlocks(out, in, blockNum);
+			processGcmBlocks(out, in, blockNum);
 			out += blockNum * blockSize;
 			in += blockNum * blockSize;
 			remain -= blockNum * blockSize;
 		}
 		if (remain > 0) {
-			generateKeyStream();
-			ksPos_ = 0;
+			generateGcmKeyStream();
 			while (remain > 0) {
-				*out++ = *in++ ^ ks_[ksPos_++];
+				const uint8_t c = *in ^ ks_[gPos_];
+				gBuf_[gPos_++] = encMode_ ? c : *in;
+				*out++ = c;
+				in++;
 				remain--;
 			}
 		}
 		return (int)inSize;
 	}
+	CYBOZU_AES_NI_CLMUL_TARGET
+	void generateGcmKeyStream()
+	{
+		_mm_storeu_si128(cybozu::cast<__m128i*>(ks_), encryptBlock(nextGcmCtrBlock(ctrGcm_)));
+	}
 public:
 	AesNi()
-		: bufSize_(0)
+		: gPos_(0)
+		, aadSize_(0)
+		, msgSize_(0)
+		, aadDone_(false)
+		, bufSize_(0)
 		, ksPos_(0)
 		, keySize_(0)
 		, roundNum_(0)
 		, mode_(M_CBC)
 		, encMode_(false)
+		, useVaes_(hasVaes())
 	{
 	}
 	void init(size_t keySize, Mode mode)
@@ -287,14 +869,18 @@ public:
 		keySize_ = keySize;
 		mode_ = mode;
 	}
+	/*
+		use VAES if useVaes is true and the CPU supports it (for test)
+	*/
+	void setUseVaes(bool useVaes) { useVaes_ = useVaes && hasVaes(); }
 	CYBOZU_AES_NI_TARGET
 	void setup(bool encMode, const std::string& key, const std::string& iv)
 	{
 		if (key.size() != keySize_) {
 			throw cybozu::Exception("crypto:AesNi:setup:keyLen") << key.size() << keySize_;
 		}
-		if (mode_ != M_ECB && iv.size() < blockSize) {
-			throw cybozu::Exception("crypto:AesNi:setup:ivLen") << iv.size() << ">=" << (int)blockSize;
+		if (mode_ == M_GCM ? iv.empty() : (mode_ != M_ECB && iv.size() < blockSize)) {
+			throw cybozu::Exception("crypto:AesNi:setup:ivLen") << iv.size();
 		}
 		encMode_ = encMode;
 		bufSize_ = 0;
@@ -313,17 +899,101 @@ public:
 			if (!encMode_) convertDecKey();
 			break;
 		case M_CTR:
-			memcpy(ctr_, iv.data(), blockSize);
+			ctrHi_ = cybozu::Get64bitAsBE(iv.data());
+			ctrLo_ = cybozu::Get64bitAsBE(iv.data() + 8);
 			break;
 		case M_ECB:
 			if (!encMode_) convertDecKey();
 			break;
+		case M_GCM:
+			setupGcm(iv);
+			break;
+		}
+	}
+	/*
+		add additional authenticated data for GCM before update
+	*/
+	void updateAad(const uint8_t *aad, size_t aadSize)
+	{
+		if (aadDone_) throw cybozu::Exception("crypto:AesNi:updateAad:call before update");
+		aadSize_ += aadSize;
+		while (aadSize > 0 && gPos_ > 0) {
+			gBuf_[gPos_++] = *aad++;
+			aadSize--;
+			if (gPos_ == blockSize) {
+				gPos_ = 0;
+				ghashBlocks(gBuf_, 1);
+			}
+		}
+		const size_t blockNum = aadSize / blockSize;
+		ghashBlocks(aad, blockNum);
+		aad += blockNum * blockSize;
+		aadSize -= blockNum * blockSize;
+		if (aadSize > 0) {
+			memcpy(gBuf_, aad, aadSize);
+			gPos_ = aadSize;
+		}
+	}
+	/*
+		get the authentication tag of GCM for the data given so far
+	*/
+	CYBOZU_AES_NI_CLMUL_TARGET
+	void getTag(uint8_t tag[blockSize]) const
+	{
+		const __m128i h = hTbl_[ghashTblN - 1];
+		__m128i x = ghash_;
+		if (gPos_ > 0) {
+			uint8_t buf[blockSize] = {};
+			memcpy(buf, gBuf_, gPos_);
+			x = gfmul(_mm_xor_si128(x, bswap128(_mm_loadu_si128(cybozu::cast<const __m128i*>(buf)))), h);
+		}
+		x = gfmul(_mm_xor_si128(x, _mm_set_epi64x(int64_t(aadSize_ * 8), int64_t(msgSize_ * 8))), h);
+		_mm_storeu_si128(cybozu::cast<__m128i*>(tag), _mm_xor_si128(bswap128(x), ekJ0_));
+	}
+	/*
+		CTR of inSize bytes by threadNum threads
+		each thread processes a range of blocks from its own counter,
+		so the output is the same as update(out, in, inSize) and it may be larger than 2GiB
+	*/
+	void updateCtrParallel(uint8_t *out, const uint8_t *in, size_t inSize, size_t threadNum)
+	{
+		if (mode_ != M_CTR) throw cybozu::Exception("crypto:AesNi:updateCtrParallel:not CTR") << (int)mode_;
+		size_t remain = inSize;
+		// use the rest of the previous keystream
+		while (remain > 0 && ksPos_ < blockSize) {
+			*out++ = *in++ ^ ks_[ksPos_++];
+			remain--;
+		}
+		const size_t blockNum = remain / blockSize;
+		// a thread processes 256KiB at least to hide the cost of starting it
+		const size_t minChunkNum = 16 * 1024;
+		if (threadNum > blockNum / minChunkNum) threadNum = blockNum / minChunkNum;
+		if (threadNum <= 1) {
+			if (blockNum > 0) processCtrBlocks(out, in, blockNum, ctrHi_, ctrLo_);
+		} else {
+			// keep chunks a multiple of 16 blocks for VAES
+			const size_t chunkNum = ((blockNum + threadNum - 1) / threadNum + 15) & ~size_t(15);
+			CtrTask task = { this, out, in, blockNum, chunkNum, ctrHi_, ctrLo_ };
+			cybozu::parallel_for(task, threadNum, threadNum);
+			addCtr(ctrHi_, ctrLo_, blockNum);
+		}
+		out += blockNum * blockSize;
+		in += blockNum * blockSize;
+		remain -= blockNum * blockSize;
+		if (remain > 0) {
+			generateKeyStream();
+			ksPos_ = 0;
+			while (remain > 0) {
+				*out++ = *in++ ^ ks_[ksPos_++];
+				remain--;
+			}
 		}
 	}
 	int update(uint8_t *out, const uint8_t *in, int inSize)
 	{
 		if (inSize < 0) return -1;
 		if (mode_ == M_CTR) return updateCtr(out, in, (size_t)inSize);
+		if (mode_ == M_GCM) return updateGcm(out, in, (size_t)inSize);
 		int outSize = 0;
 		size_t remain = (size_t)inSize;
 		if (bufSize_ > 0) {
@@ -354,7 +1024,7 @@ public:
 	}
 	int finalize() const
 	{
-		if (mode_ == M_CTR) return 0;
+		if (mode_ == M_CTR || mode_ == M_GCM) return 0;
 		return bufSize_ == 0 ? 0 : -1;
 	}
 };
@@ -813,6 +1483,27 @@ public:
 		return outLen;
 	#endif
 	}
+	/*
+		CTR of a large buffer by threadNum threads
+		the output is the same as update(outBuf, inBuf, inBufSize) and inBufSize may be larger than 2GiB
+		@note only AES-NI uses threads ; the other backends process it by update() sequentially
+	*/
+	void updateParallel(char *outBuf, const char *inBuf, size_t inBufSize, size_t threadNum)
+	{
+	#ifdef CYBOZU_AES_NI
+		aes_.updateCtrParallel(cybozu::cast<uint8_t*>(outBuf), cybozu::cast<const uint8_t*>(inBuf), inBufSize, threadNum);
+	#else
+		(void)threadNum;
+		const size_t maxSize = size_t(1) << 30;
+		while (inBufSize > 0) {
+			const size_t n = inBufSize < maxSize ? inBufSize : maxSize;
+			if (update(outBuf, inBuf, (int)n) != (int)n) throw cybozu::Exception("crypto:Cipher:updateParallel:not CTR") << n;
+			outBuf += n;
+			inBuf += n;
+			inBufSize -= n;
+		}
+	#endif
+	}
 	/*
 		return -1 if padding
 		@note don't use
@@ -837,6 +1528,144 @@ public:
 	}
 };
 
+#if defined(CYBOZU_AES_NI) || (CYBOZU_USE_WIN_BCRYPT != 1 && CYBOZU_USE_APPLE_COMMONCRYPTO != 1)
+#define CYBOZU_AES_GCM
+/*
+	AES-GCM authenticated encryption
+	AES-128/192/256 is selected by the size of the key
+	setup -> updateAad(optional) -> update -> finalize(Encoding) or verify(Decoding)
+	@note the tag of decrypted data must be verified before using it
+*/
+class AesGcm {
+#ifdef CYBOZU_AES_NI
+	local::AesNi aes_;
+#else
+	EVP_CIPHER_CTX *ctx_;
+#endif
+	AesGcm(const AesGcm&);
+	void operator=(const AesGcm&);
+public:
+	static const size_t tagSize = 16;
+	AesGcm()
+	#ifndef CYBOZU_AES_NI
+		: ctx_(EVP_CIPHER_CTX_new())
+	#endif
+	{
+	#ifndef CYBOZU_AES_NI
+		if (ctx_ == 0) throw cybozu::Exception("crypto:AesGcm:EVP_CIPHER_CTX_new");
+	#endif
+	}
+	~AesGcm()
+	{
+	#ifndef CYBOZU_AES_NI
+		EVP_CIPHER_CTX_free(ctx_);
+	#endif
+	}
+	/*
+		@param key [in] 16, 24 or 32 bytes
+		@param iv [in] 12 bytes is recommended ; never reuse it with the same key
+	*/
+	void setup(Cipher::Mode mode, const std::string& key, const std::string& iv)
+	{
+		if (iv.empty()) throw cybozu::Exception("crypto:AesGcm:setup:ivLen") << iv.size();
+	#ifdef CYBOZU_AES_NI
+		aes_.init(key.size(), local::AesNi::M_GCM);
+		aes_.setup(mode == Cipher::Encoding, key, iv);
+	#else
+		const EVP_CIPHER *cipher;
+		switch (key.size()) {
+		case 16: cipher = EVP_aes_128_gcm(); break;
+		case 24: cipher = EVP_aes_192_gcm(); break;
+		case 32: cipher = EVP_aes_256_gcm(); break;
+		default:
+			throw cybozu::Exception("crypto:AesGcm:setup:keyLen") << key.size();
+		}
+		const int enc = mode == Cipher::Encoding ? 1 : 0;
+		if (EVP_CipherInit_ex(ctx_, cipher, NULL, NULL, NULL, enc) != 1
+			|| EVP_CIPHER_CTX_ctrl(ctx_, EVP_CTRL_GCM_SET_IVLEN, static_cast<int>(iv.size()), NULL) != 1
+			|| EVP_CipherInit_ex(ctx_, NULL, NULL, cybozu::cast<const uint8_t*>(key.data()), cybozu::cast<const uint8_t*>(iv.data()), enc) != 1) {
+			throw cybozu::Exception("crypto:AesGcm:setup:EVP_CipherInit_ex");
+		}
+	#endif
+	}
+	/*
+		add additional authenticated data
+		@note call it before update
+	*/
+	void updateAad(const void *aad, size_t aadSize)
+	{
+	#ifdef CYBOZU_AES_NI
+		aes_.updateAad(static_cast<const uint8_t*>(aad), aadSize);
+	#else
+		int outLen = 0;
+		if (aadSize > 0 && EVP_CipherUpdate(ctx_, NULL, &outLen, static_cast<const uint8_t*>(aad), static_cast<int>(aadSize)) != 1) {
+			throw cybozu::Exception("crypto:AesGcm:updateAad:EVP_CipherUpdate") << aadSize;
+		}
+	#endif
+	}
+	/*
+		encrypt or decrypt inBuf to outBuf
+		@retval inBufSize
+		@retval -1 : error
+	*/
+	int update(char *outBuf, const char *inBuf, int inBufSize)
+	{
+	#ifdef CYBOZU_AES_NI
+		return aes_.update(cybozu::cast<uint8_t*>(outBuf), cybozu::cast<const uint8_t*>(inBuf), inBufSize);
+	#else
+		if (inBufSize < 0) return -1;
+		int outLen = 0;
+		if (EVP_CipherUpdate(ctx_, cybozu::cast<uint8_t*>(outBuf), &outLen, cybozu::cast<const uint8_t*>(inBuf), inBufSize) != 1) return -1;
+		return outLen;
+	#endif
+	}
+	/*
+		get the tag of encrypted data
+		@param tag [out] the first tagLen bytes of the tag
+		@param tagLen [in] 4 <= tagLen <= 16
+	*/
+	void finalize(char *tag, size_t tagLen = tagSize)
+	{
+		if (tagLen < 4 || tagLen > tagSize) throw cybozu::Exception("crypto:AesGcm:finalize:tagLen") << tagLen;
+		uint8_t t[tagSize];
+	#ifdef CYBOZU_AES_NI
+		aes_.getTag(t);
+	#else
+		int outLen = 0;
+		if (EVP_CipherFinal_ex(ctx_, t, &outLen) != 1
+			|| EVP_CIPHER_CTX_ctrl(ctx_, EVP_CTRL_GCM_GET_TAG, static_cast<int>(tagSize), t) != 1) {
+			throw cybozu::Exception("crypto:AesGcm:finalize:EVP_CipherFinal_ex");
+		}
+	#endif
+		memcpy(tag, t, tagLen);
+	}
+	/*
+		verify the tag of decrypted data in constant time
+		@param tag [in] the first tagLen bytes of the tag
+		@param tagLen [in] 4 <= tagLen <= 16
+	*/
+	bool verify(const char *tag, size_t tagLen = tagSize)
+	{
+		if (tagLen < 4 || tagLen > tagSize) throw cybozu::Exception("crypto:AesGcm:verify:tagLen") << tagLen;
+	#ifdef CYBOZU_AES_NI
+		uint8_t t[tagSize];
+		aes_.getTag(t);
+		uint8_t diff = 0;
+		for (size_t i = 0; i < tagLen; i++) {
+			diff |= t[i] ^ uint8_t(tag[i]);
+		}
+		return diff == 0;
+	#else
+		uint8_t t[tagSize];
+		memcpy(t, tag, tagLen);
+		if (EVP_CIPHER_CTX_ctrl(ctx_, EVP_CTRL_GCM_SET_TAG, static_cast<int>(tagLen), t) != 1) return false;
+		int outLen = 0;
+		return EVP_CipherFinal_ex(ctx_, t, &outLen) == 1;
+	#endif
+	}
+};
+#endif
+
 } }	// cybozu::crypto
 
 #ifdef __APPLE__
@@ -0,0 +1,220 @@
+#pragma once
+/**
+	@file
+	@brief bump allocator
+
+	@author MITSUNARI Shigeo(@herumi)
+*/
+#include <new>
+#include <utility>
+#include <stdlib.h>
+#include <stddef.h>
+#include <memory.h>
+#include <cybozu/inttype.hpp>
+
+namespace cybozu {
+
+namespace arena_local {
+
+template<class T>
+struct AlignOf {
+	struct S { char c; T t; };
+	static const size_t value = sizeof(S) - sizeof(T);
+};
+
+} // arena_local
+
+/**
+	allocate memory from large blocks by incrementing a pointer
+	all memory is released at once by clear() or the destructor
+	@note the destructors of objects in Arena are not called
+*/
+class Arena {
+	struct Block {
+		Block *next;
+		size_t size;
+	};
+	static const size_t headerSize = (sizeof(Block) + 15) & ~size_t(15);
+	Block *top_;
+	char *cur_;
+	char *end_;
+	size_t blockSize_;
+	size_t allocSize_;
+	Arena(const Arena&);
+	void operator=(const Arena&);
+	Block *allocBlock(size_t size)
+	{
+		Block *b = static_cast<Block*>(malloc(size));
+		if (b == 0) throw std::bad_alloc();
+		b->size = size;
+		allocSize_ += size;
+		return b;
+	}
+	static char *alignUp(char *p, size_t align)
+	{
+		return reinterpret_cast<char*>((size_t(p) + align - 1) & ~(align - 1));
+	}
+	void *allocSlow(size_t size, size_t align)
+	{
+		const size_t n = headerSize + size + align;
+		if (top_ && n > blockSize_ / 4) {
+			/*
+				a large request gets its own block
+				put it under top_ to keep the rest of the current block
+			*/
+			Block *b = allocBlock(n);
+			b->next = top_->next;
+			top_->next = b;
+			return alignUp(reinterpret_cast<char*>(b) + headerSize, align);
+		}
+		Block *b = allocBlock(n > blockSize_ ? n : blockSize_);
+		b->next = top_;
+		top_ = b;
+		cur_ = reinterpret_cast<char*>(b) + headerSize;
+		end_ = reinterpret_cast<char*>(b) + b->size;
+		char *p = alignUp(cur_, align);
+		cur_ = p + size;
+		return p;
+	}
+public:
+	/**
+		@param blockSize [in] size of a block allocated by malloc
+	*/
+	explicit Arena(size_t blockSize = 64 * 1024)
+		: top_(0)
+		, cur_(0)
+		, end_(0)
+		, blockSize_(blockSize < 1024 ? 1024 : blockSize)
+		, allocSize_(0)
+	{
+	}
+	~Arena()
+	{
+		clear();
+	}
+	/**
+		allocate size bytes aligned to align
+		@note align must be a power of two
+	*/
+	void *alloc(size_t size, size_t align = sizeof(void*))
+	{
+		char *p = alignUp(cur_, align);
+		if (cur_ == 0 || size > size_t(end_ - cur_) || size_t(p - cur_) > size_t(end_ - cur_) - size) {
+			return allocSlow(size, align);
+		}
+		cur_ = p + size;
+		return p;
+	}
+	/**
+		allocate uninitialized memory for n objects of T
+	*/
+	template<class T>
+	T *alloc(size_t n = 1)
+	{
+		return static_cast<T*>(alloc(sizeof(T) * n, arena_local::AlignOf<T>::value));
+	}
+	/**
+		copy [p, p + size) into Arena
+	*/
+	char *dup(const void *p, size_t size)
+	{
+		char *q = static_cast<char*>(alloc(size, 1));
+		memcpy(q, p, size);
+		return q;
+	}
+	/**
+		give back [p, p + size) if it is the last allocation so that the next alloc reuses it
+		@return false (and do nothing) if it is not the last one
+	*/
+	bool freeLast(const void *p, size_t size)
+	{
+		const char *q = static_cast<const char*>(p);
+		if (q == 0 || q + size != cur_) return false;
+		cur_ = const_cast<char*>(q);
+		return true;
+	}
+	/**
+		release all memory
+	*/
+	void clear()
+	{
+		Block *b = top_;
+		while (b) {
+			Block *next = b->next;
+			free(b);
+			b = next;
+		}
+		top_ = 0;
+		cur_ = 0;
+		end_ = 0;
+		allocSize_ = 0;
+	}
+	void swap(Arena& rhs) CYBOZU_NOEXCEPT
+	{
+		std::swap(top_, rhs.top_);
+		std::swap(cur_, rhs.cur_);
+		std::swap(end_, rhs.end_);
+		std::swap(blockSize_, rhs.blockSize_);
+		std::swap(allocSize_, rhs.allocSize_);
+	}
+	/**
+		total size of blocks obtained by malloc
+	*/
+	size_t getAllocatedSize() const { return allocSize_; }
+};
+
+/**
+	STL allocator using Arena
+	memory is released when Arena is cleared ; deallocate() gives back only the last allocation
+	a default constructed allocator uses operator new and delete
+	@note Arena must live longer than containers using it
+	@note a growing container such as vector and basic_string allocates a new buffer before it frees the old one,
+	so the old buffers stay in Arena until clear() ; they are less than the final capacity in total
+	by the geometric growth ; call reserve() first to avoid them
+*/
+template<class T>
+class ArenaAllocator {
+	template<class U> friend class ArenaAllocator;
+	Arena *arena_;
+public:
+	typedef T value_type;
+	typedef T *pointer;
+	typedef const T *const_pointer;
+	typedef T& reference;
+	typedef const T& const_reference;
+	typedef size_t size_type;
+	typedef ptrdiff_t difference_type;
+	template<class U>
+	struct rebind { typedef ArenaAllocator<U> other; };
+
+	ArenaAllocator() CYBOZU_NOEXCEPT : arena_(0) {}
+	ArenaAllocator(Arena& arena) CYBOZU_NOEXCEPT : arena_(&arena) {}
+	template<class U>
+	ArenaAllocator(const ArenaAllocator<U>& rhs) CYBOZU_NOEXCEPT : arena_(rhs.arena_) {}
+	Arena *getArena() const { return arena_; }
+	pointer address(reference x) const { return &x; }
+	const_pointer address(const_reference x) const { return &x; }
+	pointer allocate(size_type n, const void* = 0)
+	{
+		if (n > max_size()) throw std::bad_alloc();
+		if (arena_) return arena_->alloc<T>(n);
+		return static_cast<pointer>(::operator new(n * sizeof(T)));
+	}
+	void deallocate(pointer p, size_type n)
+	{
+		if (arena_) {
+			arena_->freeLast(p, n * sizeof(T));
+		} else {
+			::operator delete(p);
+		}
+	}
+	size_type max_size() const CYBOZU_NOEXCEPT { return size_t(-1) / sizeof(T); }
+	void construct(pointer p, const T& x) { new(p) T(x); }
+	void destroy(pointer p) { p->~T(); }
+	template<class U>
+	bool operator==(const ArenaAllocator<U>& rhs) const { return arena_ == rhs.arena_; }
+	template<class U>
+	bool operator!=(const ArenaAllocator<U>& rhs) const { return arena_ != rhs.arena_; }
+};
+
+} // cybozu
@@ -7,13 +7,183 @@
 */
 
 #include <memory.h>
+#include <string.h>
 #include <limits>
 #include <cybozu/exception.hpp>
+#include <cybozu/endian.hpp>
+#include <cybozu/bit_operation.hpp>
+
+/*
+	SSSE3 kernel of parsing digits is selected at runtime
+	define CYBOZU_ATOI_DONT_USE_SIMD to disable it
+*/
+#if !defined(CYBOZU_ATOI_DONT_USE_SIMD) && CYBOZU_HOST == CYBOZU_HOST_INTEL && !defined(_MSC_VER) \
+	&& ((defined(__clang__) && __clang_major__ >= 8) || (!defined(__clang__) && __GNUC__ >= 5))
+	#define CYBOZU_ATOI_USE_SIMD
+	#include <immintrin.h>
+	#include <cpuid.h>
+#endif
 
 namespace cybozu {
 
 namespace atoi_local {
 
+inline uint32_t getPow10(size_t n)
+{
+	static const uint32_t tbl[] = { 1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000 };
+	return tbl[n];
+}
+
+/*
+	number of leading decimal digits in 8 chars v(loaded as little endian)
+*/
+inline size_t countDigit8(uint64_t v)
+{
+	const uint64_t hi = (v & 0xf0f0f0f0f0f0f0f0ULL) ^ 0x3030303030303030ULL; // upper nibble != 3
+	const uint64_t lo = ((v & 0x0f0f0f0f0f0f0f0fULL) + 0x0606060606060606ULL) & 0xf0f0f0f0f0f0f0f0ULL; // lower nibble > 9
+	const uint64_t bad = (((hi | lo) >> 4) + 0x0f0f0f0f0f0f0f0fULL) & 0x1010101010101010ULL;
+	if (bad == 0) return 8;
+	return cybozu::bsf(bad) / 8;
+}
+
+/*
+	convert the first k(1 <= k <= 8) digits in v to an integer
+*/
+inline uint32_t digit8ToInt(uint64_t v, size_t k)
+{
+	v &= 0x0f0f0f0f0f0f0f0fULL;
+	if (k < 8) v <<= (8 - k) * 8; // pad with leading zeros
+	v = (v * 10 + (v >> 8)) & 0x00ff00ff00ff00ffULL;
+	v = (v * 100 + (v >> 16)) & 0x0000ffff0000ffffULL;
+	return uint32_t((v * 10000 + (v >> 32)));
+}
+
+/*
+	parse at most maxN leading digits of p[0, size) 8 chars at a time
+	@param x [out] value of the digits
+	@return number of parsed digits(the rest is left to the caller)
+*/
+inline size_t parseDigitSwar(uint64_t *x, const char *p, size_t size, size_t maxN)
+{
+	uint64_t v = 0;
+	size_t n = 0;
+	while (size - n >= 8 && n < maxN) {
+		const uint64_t w = cybozu::Get64bitAsLE(p + n);
+		size_t k = countDigit8(w);
+		if (k > maxN - n) k = maxN - n;
+		if (k == 0) break;
+		v = v * getPow10(k) + digit8ToInt(w, k);
+		n += k;
+		if (k < 8) break;
+	}
+	*x = v;
+	return n;
+}
+
+enum {
+	atoiSsse3 = 1
+};
+
+#ifdef CYBOZU_ATOI_USE_SIMD
+inline int detectAtoiFeature()
+{
+	unsigned int a, b, c, d;
+	if (__get_cpuid_max(0, 0) < 1) return 0;
+	__cpuid(1, a, b, c, d);
+	return (c & (1u << 9)) ? atoiSsse3 : 0;
+}
+
+inline int& getAtoiFeatureRef()
+{
+	static int f = detectAtoiFeature();
+	return f;
+}
+#endif
+
+inline int getAtoiFeature()
+{
+#ifdef CYBOZU_ATOI_USE_SIMD
+	return getAtoiFeatureRef();
+#else
+	return 0;
+#endif
+}
+
+/*
+	use only the kernels in mask (for test)
+*/
+inline void limitAtoiFeature(int mask)
+{
+#ifdef CYBOZU_ATOI_USE_SIMD
+	getAtoiFeatureRef() = detectAtoiFeature() & mask;
+#else
+	(void)mask;
+#endif
+}
+
+#ifdef CYBOZU_ATOI_USE_SIMD
+/*
+	parse at most maxN leading digits of p[0, 16) by SSSE3
+	the digits are moved to the end of a register and folded by pmaddubsw and pmaddwd
+	@param x [out] value of the digits
+	@return number of parsed digits(<= 16)
+*/
+__attribute__((target("ssse3")))
+inline size_t parseDigit16Ssse3(uint64_t *x, const char *p, size_t maxN)
+{
+	// [16, 32) are the indices of pshufb to move k digits at the top to the end
+	static const signed char shiftTbl[] = {
+		-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+		0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15,
+	};
+	__m128i v = _mm_sub_epi8(_mm_loadu_si128(cybozu::cast<const __m128i*>(p)), _mm_set1_epi8('0'));
+	const int digit = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_min_epu8(v, _mm_set1_epi8(9)), v));
+	size_t k = cybozu::bsf(uint32_t(~digit));
+	if (k > maxN) k = maxN;
+	if (k == 0) return 0;
+	v = _mm_shuffle_epi8(v, _mm_loadu_si128(cybozu::cast<const __m128i*>(shiftTbl + k)));
+	v = _mm_maddubs_epi16(v, _mm_setr_epi8(10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1));
+	v = _mm_madd_epi16(v, _mm_setr_epi16(100, 1, 100, 1, 100, 1, 100, 1));
+	v = _mm_packs_epi32(v, v);
+	v = _mm_madd_epi16(v, _mm_setr_epi16(10000, 1, 10000, 1, 10000, 1, 10000, 1));
+	// v = [upper 8 digits, lower 8 digits, ...]
+	*x = uint64_t(uint32_t(_mm_cvtsi128_si32(v))) * 100000000 + uint32_t(_mm_cvtsi128_si32(_mm_srli_si128(v, 4)));
+	return k;
+}
+#endif
+
+/*
+	parse digits by SWAR(or SSSE3 if available) while the value surely fits in T
+	size may be larger than the string terminated by '\0'
+*/
+template<typename T>
+size_t parseDigitFast(T *x, const char *p, size_t size)
+{
+	const size_t maxN = std::numeric_limits<T>::digits10;
+	if (maxN < 8) return 0;
+	// 8 chars are read at p + n for n < maxN, so the exact length is required up to maxN + 7
+	size = strnlen(p, size < maxN + 7 ? size : maxN + 7);
+	uint64_t v;
+#ifdef CYBOZU_ATOI_USE_SIMD
+	if (size >= 16 && (getAtoiFeature() & atoiSsse3)) {
+		const size_t n = parseDigit16Ssse3(&v, p, maxN);
+		*x = T(v);
+		return n;
+	}
+#endif
+	const size_t n = parseDigitSwar(&v, p, size, maxN);
+	*x = T(v);
+	return n;
+}
+
+/*
+	size may be larger than the string terminated by '\0'
+*/
+inline std::string makeErrString(const char *p, size_t size)
+{
+	return cybozu::exception::makeString(p, strnlen(p, size < 16 ? size : 16));
+}
+
 template<typename T, size_t n>
 T convertToInt(bool *b, const char *p, size_t size, const char (&max)[n], T min, T overflow1, char overflow2)
 {
@@ -28,11 +198,12 @@ T convertToInt(bool *b, const char *p, size_t size, const char (&max)[n], T min,
 			// skip leading zero
 			while (i < size && p[i] == '0') i++;
 			// check minimum
-			if (isMinus && size - i >= n - 1 && memcmp(max, &p[i], n - 1) == 0) {
+			if (isMinus && size - i >= n - 1 && strncmp(max, &p[i], n - 1) == 0) {
 				if (b) *b = true;
 				return min;
 			}
 			T x = 0;
+			i += parseDigitFast(&x, p + i, size - i);
 			for (;;) {
 				unsigned char c;
 				if (i == size || (c = static_cast<unsigned char>(p[i])) == '\0') {
@@ -52,7 +223,7 @@ T convertToInt(bool *b, const char *p, size_t size, const char (&max)[n], T min,
 		*b = false;
 		return 0;
 	} else {
-		throw cybozu::Exception("atoi::convertToInt") << cybozu::exception::makeString(p, size);
+		throw cybozu::Exception("atoi::convertToInt") << makeErrString(p, size);
 	}
 }
 
@@ -64,6 +235,7 @@ T convertToUint(bool *b, const char *p, size_t size, T overflow1, char overflow2
 		// skip leading zero
 		while (i < size && p[i] == '0') i++;
 		T x = 0;
+		i += parseDigitFast(&x, p + i, size - i);
 		for (;;) {
 			unsigned char c;
 			if (i == size || (c = static_cast<unsigned char>(p[i])) == '\0') {
@@ -82,7 +254,7 @@ T convertToUint(bool *b, const char *p, size_t size, T overflow1, char overflow2
 		*b = false;
 		return 0;
 	} else {
-		throw cybozu::Exception("atoi::convertToUint") << cybozu::exception::makeString(p, size);
+		throw cybozu::Exception("atoi::convertToUint") << makeErrString(p, size);
 	}
 }
 
@@ -117,7 +289,7 @@ T convertHexToInt(bool *b, const char *p, size_t size)
 		*b = false;
 		return 0;
 	} else {
-		throw cybozu::Exception("atoi::convertHexToInt") << cybozu::exception::makeString(p, size);
+		throw cybozu::Exception("atoi::convertHexToInt") << makeErrString(p, size);
 	}
 }
 
@@ -235,4 +407,32 @@ public:
 	operator long long() const { return atoi_local::convertHexToInt<long long>(b_, p_, size_); }
 };
 
+/**
+	parse integers separated by sep such as "12,-3,45"
+	@param begin [in] begin of text
+	@param end [in] end of text
+	@param sep [in] separator
+	@param out [out] parsed values(must have room for (number of sep in text) + 1 elements)
+	@return number of parsed values(0 if begin == end)
+	@note throw cybozu::Exception if a field is not an integer or out of range of T
+*/
+template<typename T>
+size_t parseInts(const char *begin, const char *end, char sep, T *out)
+{
+	size_t n = 0;
+	if (begin == end) return 0;
+	for (;;) {
+		const char *q = static_cast<const char*>(memchr(begin, sep, end - begin));
+		const char *fieldEnd = q ? q : end;
+		bool b;
+		const T x = cybozu::atoi(&b, begin, fieldEnd - begin);
+		if (!b) {
+			throw cybozu::Exception("atoi:parseInts:bad value") << n << cybozu::exception::makeString(begin, fieldEnd - begin);
+		}
+		out[n++] = x;
+		if (q == 0) return n;
+		begin = q + 1;
+	}
+}
+
 } // cybozu
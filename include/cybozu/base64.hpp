@@ -7,10 +7,17 @@
 */
 
 #include <iostream>
+#include <algorithm>
 #include <assert.h>
+#include <string.h>
 #include <cybozu/stream.hpp>
 #include <cybozu/line_stream.hpp>
 
+#if defined(__SSSE3__) || defined(__AVX__)
+	#define CYBOZU_BASE64_USE_SSSE3
+	#include <tmmintrin.h>
+#endif
+
 namespace cybozu {
 
 namespace base64 {
@@ -30,8 +37,285 @@ static inline void addEndLine(char *outBuf, size_t& outBufSize, int mode)
 	outBuf[outBufSize++] = cybozu::line_stream::LF;
 }
 
+inline size_t getEndLineSize(int mode)
+{
+	return mode == base64::useCRLF ? 2 : mode == base64::useLF ? 1 : 0;
+}
+
+const unsigned int S = 255; /* skip character */
+
+inline const unsigned char *getDecodeTbl()
+{
+	static const unsigned char tbl[256] = {
+		S, S, S, S, S, S, S, S, S, S, S, S, S, S, S, S,
+		S, S, S, S, S, S, S, S, S, S, S, S, S, S, S, S,
+		S, S, S, S, S, S, S, S, S, S, S, 62, S, S, S, 63,
+		52, 53, 54, 55, 56, 57, 58, 59, 60, 61, S, S, S, S, S, S,
+		S, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14,
+		15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, S, S, S, S, S,
+		S, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40,
+		41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51, S, S, S, S, S,
+		S, S, S, S, S, S, S, S, S, S, S, S, S, S, S, S,
+		S, S, S, S, S, S, S, S, S, S, S, S, S, S, S, S,
+		S, S, S, S, S, S, S, S, S, S, S, S, S, S, S, S,
+		S, S, S, S, S, S, S, S, S, S, S, S, S, S, S, S,
+		S, S, S, S, S, S, S, S, S, S, S, S, S, S, S, S,
+		S, S, S, S, S, S, S, S, S, S, S, S, S, S, S, S,
+		S, S, S, S, S, S, S, S, S, S, S, S, S, S, S, S,
+		S, S, S, S, S, S, S, S, S, S, S, S, S, S, S, S,
+	};
+	return tbl;
+}
+
+#ifdef CYBOZU_BASE64_USE_SSSE3
+/*
+	encode 12 bytes of in[0, 16) to 16 chars
+	W. Mula and D. Lemire, Faster Base64 Encoding and Decoding Using AVX2 Instructions
+*/
+inline void encode12(char *out, const unsigned char *in)
+{
+	__m128i v = _mm_loadu_si128((const __m128i*)in);
+	v = _mm_shuffle_epi8(v, _mm_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10));
+	// split each 24 bits into four 6-bit indices
+	const __m128i t0 = _mm_mulhi_epu16(_mm_and_si128(v, _mm_set1_epi32(0x0fc0fc00)), _mm_set1_epi32(0x04000040));
+	const __m128i t1 = _mm_mullo_epi16(_mm_and_si128(v, _mm_set1_epi32(0x003f03f0)), _mm_set1_epi32(0x01000010));
+	const __m128i idx = _mm_or_si128(t0, t1);
+	// 0..25 -> 13, 26..51 -> 0, 52..61 -> 1..10, 62 -> 11, 63 -> 12
+	__m128i r = _mm_subs_epu8(idx, _mm_set1_epi8(51));
+	r = _mm_or_si128(r, _mm_and_si128(_mm_cmpgt_epi8(_mm_set1_epi8(26), idx), _mm_set1_epi8(13)));
+	const __m128i shiftTbl = _mm_setr_epi8(
+		'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+		'0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+	r = _mm_add_epi8(_mm_shuffle_epi8(shiftTbl, r), idx);
+	_mm_storeu_si128((__m128i*)out, r);
+}
+
+/*
+	decode 16 chars to 12 bytes
+	@return false if in has a char out of the alphabet
+*/
+inline bool decode16(char *out, const char *in)
+{
+	const __m128i v = _mm_loadu_si128((const __m128i*)in);
+	const __m128i mask2F = _mm_set1_epi8(0x2f);
+	const __m128i hi = _mm_and_si128(_mm_srli_epi32(v, 4), mask2F);
+	const __m128i lo = _mm_and_si128(v, mask2F);
+	const __m128i loTbl = _mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a);
+	const __m128i hiTbl = _mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+	const __m128i bad = _mm_and_si128(_mm_shuffle_epi8(loTbl, lo), _mm_shuffle_epi8(hiTbl, hi));
+	if (_mm_movemask_epi8(_mm_cmpeq_epi8(bad, _mm_setzero_si128())) != 0xffff) return false;
+	const __m128i rollTbl = _mm_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+	const __m128i roll = _mm_shuffle_epi8(rollTbl, _mm_add_epi8(_mm_cmpeq_epi8(v, mask2F), hi));
+	__m128i t = _mm_add_epi8(v, roll);
+	// pack four 6-bit values into 24 bits
+	t = _mm_maddubs_epi16(t, _mm_set1_epi32(0x01400140));
+	t = _mm_madd_epi16(t, _mm_set1_epi32(0x00011000));
+	t = _mm_shuffle_epi8(t, _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+	_mm_storel_epi64((__m128i*)out, t);
+	const uint32_t last = uint32_t(_mm_cvtsi128_si32(_mm_srli_si128(t, 8)));
+	memcpy(out + 8, &last, 4);
+	return true;
+}
+#endif
+
+/*
+	encode in[0, n) without line break
+	@note out must have (n + 2) / 3 * 4 bytes
+	@return written size
+*/
+inline size_t encodeLine(char *out, const unsigned char *in, size_t n)
+{
+	static const char tbl[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+	char *const top = out;
+	size_t i = 0;
+#ifdef CYBOZU_BASE64_USE_SSSE3
+	// encode12 reads 16 bytes
+	while (n - i >= 16) {
+		encode12(out, in + i);
+		i += 12;
+		out += 16;
+	}
+#endif
+	while (n - i >= 3) {
+		const unsigned int v = (in[i] << 16) | (in[i + 1] << 8) | in[i + 2];
+		out[0] = tbl[v >> 18];
+		out[1] = tbl[(v >> 12) & 63];
+		out[2] = tbl[(v >> 6) & 63];
+		out[3] = tbl[v & 63];
+		i += 3;
+		out += 4;
+	}
+	if (i < n) {
+		const unsigned int v = (in[i] << 16) | (i + 1 < n ? in[i + 1] << 8 : 0);
+		out[0] = tbl[v >> 18];
+		out[1] = tbl[(v >> 12) & 63];
+		out[2] = i + 1 < n ? tbl[(v >> 6) & 63] : '=';
+		out[3] = '=';
+		out += 4;
+	}
+	return out - top;
+}
+
+/*
+	encode in[0, n) and put an end of line after every maxLineSize chars and the last line
+*/
+inline size_t encodeLines(char *out, const unsigned char *in, size_t n, size_t maxLineSize, int mode)
+{
+	if (maxLineSize == 0) return encodeLine(out, in, n);
+	const size_t lineBytes = maxLineSize / 4 * 3;
+	size_t outSize = 0;
+	for (size_t i = 0; i < n; i += lineBytes) {
+		const size_t len = (std::min)(lineBytes, n - i);
+		outSize += encodeLine(out + outSize, in + i, len);
+		addEndLine(out, outSize, mode);
+	}
+	return outSize;
+}
+
+/*
+	decode in[0, n) while all chars are in the alphabet
+	@return number of consumed chars(multiple of 4), which are decoded to (ret / 4) * 3 bytes
+*/
+inline size_t decodeFast(char *out, const char *in, size_t n)
+{
+	const unsigned char *tbl = getDecodeTbl();
+	size_t i = 0;
+#ifdef CYBOZU_BASE64_USE_SSSE3
+	while (n - i >= 16 && decode16(out, in + i)) {
+		i += 16;
+		out += 12;
+	}
+#endif
+	while (n - i >= 4) {
+		const unsigned int a = tbl[static_cast<unsigned char>(in[i])];
+		const unsigned int b = tbl[static_cast<unsigned char>(in[i + 1])];
+		const unsigned int c = tbl[static_cast<unsigned char>(in[i + 2])];
+		const unsigned int d = tbl[static_cast<unsigned char>(in[i + 3])];
+		if ((a | b | c | d) == S) break;
+		const unsigned int v = (a << 18) | (b << 12) | (c << 6) | d;
+		out[0] = static_cast<char>(v >> 16);
+		out[1] = static_cast<char>(v >> 8);
+		out[2] = static_cast<char>(v);
+		i += 4;
+		out += 3;
+	}
+	return i;
+}
+
+/*
+	decoder state of chars out of 4-char groups
+*/
+struct DecodeState {
+	size_t idx;
+	unsigned int cur;
+	DecodeState() : idx(0), cur(0) {}
+	/*
+		decode in[0, n) and skip chars out of the alphabet
+		@note out must have n / 4 * 3 + n % 4 bytes
+		@return written size
+	*/
+	size_t decode(char *out, const char *in, size_t n)
+	{
+		const unsigned char *tbl = getDecodeTbl();
+		char *const top = out;
+		size_t i = 0;
+		while (i < n) {
+			if (idx == 0) {
+				const size_t m = decodeFast(out, in + i, n - i);
+				i += m;
+				out += m / 4 * 3;
+				if (i == n) break;
+			}
+			const unsigned int t = tbl[static_cast<unsigned char>(in[i++])];
+			if (t == S) continue;
+			if (idx == 0) {
+				cur = t << 2;
+				idx = 1;
+			} else if (idx == 1) {
+				*out++ = static_cast<char>(cur | (t >> 4));
+				cur = (t & 0xf) << 4;
+				idx = 2;
+			} else if (idx == 2) {
+				*out++ = static_cast<char>(cur | (t >> 2));
+				cur = (t & 3) << 6;
+				idx = 3;
+			} else {
+				*out++ = static_cast<char>(cur | t);
+				idx = 0;
+			}
+		}
+		return out - top;
+	}
+};
+
 } // base64_local
 
+namespace base64 {
+
+/**
+	get the size of encoded string
+	@param n [in] size of data
+	@param maxLineSize [in] max line size(multiply of 4 or zero(means infinite line))
+	@param mode [in] useLF, useCRLF or noEndLine
+*/
+inline size_t getEncodedSize(size_t n, size_t maxLineSize = 76, int mode = useCRLF)
+{
+	const size_t size = (n + 2) / 3 * 4;
+	if (maxLineSize == 0 || n == 0) return size;
+	return size + (size + maxLineSize - 1) / maxLineSize * base64_local::getEndLineSize(mode);
+}
+
+/**
+	get the max size of decoded data
+	@param n [in] size of base64 string
+*/
+inline size_t getDecodedMaxSize(size_t n)
+{
+	return n / 4 * 3 + n % 4;
+}
+
+/**
+	base64 encode buffer to buffer
+	@param out [out] output buffer
+	@param outSize [in] size of out(getEncodedSize() bytes are enough)
+	@param in [in] data
+	@param inSize [in] size of data
+	@param maxLineSize [in] max line size(multiply of 4 or zero(means infinite line))
+	@param mode [in] useLF, useCRLF or noEndLine
+	@return written size
+	@note same output as EncodeToBase64
+*/
+inline size_t encode(char *out, size_t outSize, const void *in, size_t inSize, size_t maxLineSize = 76, int mode = useCRLF)
+{
+	if ((maxLineSize % 4) != 0) {
+		throw cybozu::Exception("base64:encode:bad line size") << maxLineSize;
+	}
+	if (outSize < getEncodedSize(inSize, maxLineSize, mode)) {
+		throw cybozu::Exception("base64:encode:small outSize") << outSize << inSize;
+	}
+	return base64_local::encodeLines(out, static_cast<const unsigned char*>(in), inSize, maxLineSize, mode);
+}
+
+/**
+	base64 decode buffer to buffer
+	@param out [out] output buffer
+	@param outSize [in] size of out(getDecodedMaxSize() bytes are enough)
+	@param in [in] base64 string
+	@param inSize [in] size of base64 string
+	@return written size
+	@note chars out of the alphabet are skipped as DecodeFromBase64
+*/
+inline size_t decode(char *out, size_t outSize, const char *in, size_t inSize)
+{
+	if (outSize < getDecodedMaxSize(inSize)) {
+		throw cybozu::Exception("base64:decode:small outSize") << outSize << inSize;
+	}
+	base64_local::DecodeState state;
+	return state.decode(out, in, inSize);
+}
+
+} // base64
+
 /**
 	base64 encode
 	@param os [in] output stream
@@ -46,62 +330,23 @@ void EncodeToBase64(OutputStream& os, InputStream& is, size_t maxLineSize = 76,
 	if (maxLineSize > innerMaxLineSize || ((maxLineSize % 4) != 0)) {
 		throw cybozu::Exception("base64::EncodeToBase64:bad line size") << maxLineSize;
 	}
-
-	const char *tbl = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
-
-	unsigned int remain = 0;
-	size_t idx = 0; /* 0, 1, 2 */
-	size_t pos = 0; /* line position */
-
-	char inBuf[1024];
-	char outBuf[4096];
-	assert(sizeof(outBuf) > (sizeof(inBuf) * 4) / 3 +(sizeof(inBuf) * 2) /* max # of CRLF */ + 16 /* margin */);
-	size_t outBufSize = 0;
+	// read whole lines at once so that a line does not cross chunks
+	const size_t chunkSize = 3072;
+	const size_t lineBytes = maxLineSize / 4 * 3;
+	const size_t inSize = maxLineSize ? chunkSize / lineBytes * lineBytes : chunkSize;
+	unsigned char inBuf[chunkSize];
+	char outBuf[chunkSize / 3 * 4 + (chunkSize / 3) * 2 /* max # of CRLF */];
 	for (;;) {
-		size_t readSize = cybozu::readSome(inBuf, sizeof(inBuf), is);
-		if (readSize == 0) break;
-		for (size_t i = 0; i < readSize; i++) {
-			unsigned int c = static_cast<unsigned char>(inBuf[i]);
-			if (idx == 0) {
-				remain = (c & 3) << 4;
-				outBuf[outBufSize++] = tbl[c >> 2];
-				pos++;
-				idx = 1;
-			} else if (idx == 1) {
-				unsigned int tmp = remain | (c >> 4);
-				remain = (c & 0xf) << 2;
-				outBuf[outBufSize++] = tbl[tmp];
-				pos++;
-				idx = 2;
-			} else {
-				outBuf[outBufSize++] = tbl[remain | (c >> 6)];
-				outBuf[outBufSize++] = tbl[c & 0x3f];
-				pos += 2;
-				idx = 0;
-			}
-			if (maxLineSize && pos == maxLineSize) {
-				base64_local::addEndLine(outBuf, outBufSize, mode);
-				pos = 0;
-			}
-			assert(outBufSize <= sizeof(outBuf));
-		}
-		cybozu::write(os, outBuf, outBufSize);
-		outBufSize = 0;
-	}
-	if (idx > 0) {
-		outBuf[outBufSize++] = tbl[remain];
-		outBuf[outBufSize++] = '=';
-		pos += 2;
-		if (idx == 1) {
-			outBuf[outBufSize++] = '=';
-			pos++;
+		size_t readSize = 0;
+		while (readSize < inSize) {
+			const size_t n = cybozu::readSome(inBuf + readSize, inSize - readSize, is);
+			if (n == 0) break;
+			readSize += n;
 		}
-	}
-	if (maxLineSize && pos > 0) {
-		base64_local::addEndLine(outBuf, outBufSize, mode);
-	}
-	if (outBufSize > 0) {
-		cybozu::write(os, outBuf, outBufSize);
+		if (readSize == 0) break;
+		const size_t outSize = base64_local::encodeLines(outBuf, inBuf, readSize, maxLineSize, mode);
+		cybozu::write(os, outBuf, outSize);
+		if (readSize < inSize) break;
 	}
 }
 
@@ -112,18 +357,15 @@ void EncodeToBase64(OutputStream& os, InputStream& is, size_t maxLineSize = 76,
 template<class OutputStream>
 class Base64Decoder {
 	OutputStream& os_;
-	char outBuf_[1024];
+	char outBuf_[4096];
 	size_t outBufSize_;
-	size_t idx_;
-	unsigned int cur_;
+	base64_local::DecodeState state_;
 	Base64Decoder(const Base64Decoder&);
 	void operator=(const Base64Decoder&);
 public:
 	Base64Decoder(OutputStream& os)
 		: os_(os)
 		, outBufSize_(0)
-		, idx_(0)
-		, cur_(0)
 	{
 	}
 	/*
@@ -133,47 +375,17 @@ public:
 	*/
 	ssize_t write(const char *buf, size_t size)
 	{
-		const unsigned int S = 255; /* skip character */
-		static const unsigned int tbl[256] = {
-			S, S, S, S, S, S, S, S, S, S, S, S, S, S, S, S,
-			S, S, S, S, S, S, S, S, S, S, S, S, S, S, S, S,
-			S, S, S, S, S, S, S, S, S, S, S, 62, S, S, S, 63,
-			52, 53, 54, 55, 56, 57, 58, 59, 60, 61, S, S, S, S, S, S,
-			S, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14,
-			15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, S, S, S, S, S,
-			S, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40,
-			41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51, S, S, S, S, S,
-			S, S, S, S, S, S, S, S, S, S, S, S, S, S, S, S,
-			S, S, S, S, S, S, S, S, S, S, S, S, S, S, S, S,
-			S, S, S, S, S, S, S, S, S, S, S, S, S, S, S, S,
-			S, S, S, S, S, S, S, S, S, S, S, S, S, S, S, S,
-			S, S, S, S, S, S, S, S, S, S, S, S, S, S, S, S,
-			S, S, S, S, S, S, S, S, S, S, S, S, S, S, S, S,
-			S, S, S, S, S, S, S, S, S, S, S, S, S, S, S, S,
-			S, S, S, S, S, S, S, S, S, S, S, S, S, S, S, S,
-		};
-		for (size_t i = 0; i < size; i++) {
-			unsigned int t = tbl[static_cast<unsigned char>(buf[i])];
-			if (t == S) continue;
-			if (idx_ == 0) {
-				cur_ = t << 2;
-				idx_ = 1;
-			} else if (idx_ == 1) {
-				outBuf_[outBufSize_++] = static_cast<char>(cur_ | (t >> 4));
-				cur_ = (t & 0xf) << 4;
-				idx_ = 2;
-			} else if (idx_ == 2) {
-				outBuf_[outBufSize_++] = static_cast<char>(cur_ | (t >> 2));
-				cur_ = (t & 3) << 6;
-				idx_ = 3;
-			} else {
-				outBuf_[outBufSize_++] = static_cast<char>(cur_ | t);
-				idx_ = 0;
-			}
-			if (outBufSize_ == sizeof(outBuf_)) {
-				cybozu::write(os_, outBuf_, outBufSize_);
-				outBufSize_ = 0;
+		size_t i = 0;
+		while (i < size) {
+			size_t room = sizeof(outBuf_) - outBufSize_;
+			if (room < 6) {
+				flush();
+				room = sizeof(outBuf_);
 			}
+			// the rest of outBuf_ can hold the result of n chars
+			const size_t n = (std::min)(size - i, (room - 3) / 3 * 4);
+			outBufSize_ += state_.decode(outBuf_ + outBufSize_, buf + i, n);
+			i += n;
 		}
 		return static_cast<ssize_t>(size);
 	}
@@ -199,7 +411,7 @@ void DecodeFromBase64(OutputStream& os, InputStream& is)
 {
 	cybozu::Base64Decoder<OutputStream> dec(os);
 	for (;;) {
-		char buf[1024];
+		char buf[4096];
 		size_t readSize = cybozu::readSome(buf, sizeof(buf), is);
 		if (readSize <= 0) break;
 		dec.write(buf, readSize);
@@ -5,6 +5,7 @@
 	@author MITSUNARI Shigeo(@herumi)
 */
 
+#include <new>
 #include <cybozu/exception.hpp>
 #include <cybozu/inttype.hpp>
 #include <cybozu/aes.hpp>
@@ -169,10 +170,57 @@ public:
 class Hmac {
 	Hash::Name name_;
 	size_t hashSize_;
+	bool hasKey_;
+	/*
+		the context of the key given by setKey ; Hmac1, Hmac256 or Hmac512 selected by name_
+		it is constructed by setKey and is trivially copyable, so the storage is copied as bytes
+	*/
+	union {
+		char buf[sizeof(cybozu::Hmac512)];
+		uint64_t align;
+	} ctx_;
+	template<class T>
+	void setKeyT(const void *key, size_t keySize)
+	{
+		if (!hasKey_) {
+			new (ctx_.buf) T(key, keySize);
+			hasKey_ = true;
+		} else {
+			cybozu::cast<T*>(ctx_.buf)->setKey(key, keySize);
+		}
+	}
+	/*
+		use a context of the empty key if setKey has not been called
+	*/
+	template<class T>
+	void evalT(void *out, const void *msg, size_t msgSize) const
+	{
+		if (hasKey_) {
+			cybozu::cast<const T*>(ctx_.buf)->compute(out, msg, msgSize);
+		} else {
+			T().compute(out, msg, msgSize);
+		}
+	}
+	template<class T>
+	void evalBatchT(void *out, const void *const *msgs, const size_t *sizes, size_t n) const
+	{
+		if (hasKey_) {
+			cybozu::cast<const T*>(ctx_.buf)->computeBatch(out, msgs, sizes, n);
+		} else {
+			T().computeBatch(out, msgs, sizes, n);
+		}
+	}
+	template<class T>
+	bool verifyT(const void *mac, const void *msg, size_t msgSize) const
+	{
+		if (hasKey_) return cybozu::cast<const T*>(ctx_.buf)->verify(mac, msg, msgSize);
+		return T().verify(mac, msg, msgSize);
+	}
 public:
 	explicit Hmac(Hash::Name name)
 		: name_(name)
 		, hashSize_(Hash::getSize(name))
+		, hasKey_(false)
 	{
 		Hash::verifyName(name_);
 	}
@@ -196,6 +244,62 @@ public:
 		eval(&out[0], key.c_str(), key.size(), data.c_str(), data.size());
 		return out;
 	}
+	/*
+		precompute the key for eval(out, msg, msgSize), evalBatch and verify
+		the key is empty by default
+	*/
+	void setKey(const void *key, size_t keySize)
+	{
+		switch (name_) {
+		case Hash::N_SHA1:   setKeyT<cybozu::Hmac1>(key, keySize); break;
+		case Hash::N_SHA256: setKeyT<cybozu::Hmac256>(key, keySize); break;
+		case Hash::N_SHA512: setKeyT<cybozu::Hmac512>(key, keySize); break;
+		default:
+			throw cybozu::Exception("crypto:Hmac:setKey") << name_;
+		}
+	}
+	void setKey(const std::string& key) { setKey(key.c_str(), key.size()); }
+	/*
+		MAC of msg by the key given by setKey
+		out must have getSize() byte
+	*/
+	void eval(void *out, const void *msg, size_t msgSize) const
+	{
+		switch (name_) {
+		case Hash::N_SHA1:   evalT<cybozu::Hmac1>(out, msg, msgSize); break;
+		case Hash::N_SHA256: evalT<cybozu::Hmac256>(out, msg, msgSize); break;
+		case Hash::N_SHA512: evalT<cybozu::Hmac512>(out, msg, msgSize); break;
+		default:
+			throw cybozu::Exception("crypto:Hmac:eval") << name_;
+		}
+	}
+	/*
+		MACs of n messages by the key given by setKey
+		out must have getSize() * n byte
+	*/
+	void evalBatch(void *out, const void *const *msgs, const size_t *sizes, size_t n) const
+	{
+		switch (name_) {
+		case Hash::N_SHA1:   evalBatchT<cybozu::Hmac1>(out, msgs, sizes, n); break;
+		case Hash::N_SHA256: evalBatchT<cybozu::Hmac256>(out, msgs, sizes, n); break;
+		case Hash::N_SHA512: evalBatchT<cybozu::Hmac512>(out, msgs, sizes, n); break;
+		default:
+			throw cybozu::Exception("crypto:Hmac:evalBatch") << name_;
+		}
+	}
+	/*
+		compare mac of getSize() byte with the MAC of msg in constant time
+	*/
+	bool verify(const void *mac, const void *msg, size_t msgSize) const
+	{
+		switch (name_) {
+		case Hash::N_SHA1:   return verifyT<cybozu::Hmac1>(mac, msg, msgSize);
+		case Hash::N_SHA256: return verifyT<cybozu::Hmac256>(mac, msg, msgSize);
+		case Hash::N_SHA512: return verifyT<cybozu::Hmac512>(mac, msg, msgSize);
+		default:
+			throw cybozu::Exception("crypto:Hmac:verify") << name_;
+		}
+	}
 };
 
 } }	// cybozu::crypto
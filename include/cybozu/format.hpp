@@ -9,6 +9,13 @@
 #include <stdarg.h>
 #include <stdlib.h>
 #include <cybozu/exception.hpp>
+#if CYBOZU_CPP_VERSION >= CYBOZU_CPP_VERSION_CPP11
+#include <string.h>
+#include <algorithm>
+#include <sstream>
+#include <type_traits>
+#include <cybozu/itoa.hpp>
+#endif
 
 #if defined(__clang__) || (defined(__GNUC__) && __GNUC__ >= 4 && __GNUC_MINOR__ >= 4)
 #define CYBOZU_FORMAT_DISABLE_WARNING
@@ -86,8 +93,215 @@ inline std::string format(CYBOZU_FORMAT_PRINTF const char *format, ...)
 	return str;
 }
 
+#if CYBOZU_CPP_VERSION >= CYBOZU_CPP_VERSION_CPP11
+
+namespace format_local {
+
+/*
+	number of "{}" in format("{{" and "}}" are escapes)
+	return size_t(-1) if format is broken
+*/
+#if CYBOZU_CPP_VERSION >= CYBOZU_CPP_VERSION_CPP14
+constexpr size_t countArg(const char *p)
+{
+	size_t n = 0;
+	while (*p) {
+		if (*p == '{') {
+			if (p[1] == '}') {
+				n++;
+			} else if (p[1] != '{') {
+				return size_t(-1);
+			}
+			p += 2;
+		} else if (*p == '}') {
+			if (p[1] != '}') return size_t(-1);
+			p += 2;
+		} else {
+			p++;
+		}
+	}
+	return n;
+}
+#else
+// the length of format is limited by the depth of constexpr recursion
+constexpr size_t countArg(const char *p, size_t n = 0)
+{
+	return *p == '\0' ? n
+		: *p == '{' ? (p[1] == '}' ? countArg(p + 2, n + 1) : p[1] == '{' ? countArg(p + 2, n) : size_t(-1))
+		: *p == '}' ? (p[1] == '}' ? countArg(p + 2, n) : size_t(-1))
+		: countArg(p + 1, n);
+}
+#endif
+
+template<class... Args>
+char (&argNum(const char *, const Args&...))[sizeof...(Args) + 1];
+
+template<size_t formatNum, size_t argNum>
+struct CheckArgNum {
+	static_assert(formatNum != size_t(-1), "cybozu::format:bad format");
+	static_assert(formatNum == size_t(-1) || formatNum == argNum, "cybozu::format:the number of {} is different from that of arguments");
+};
+
+/*
+	write to buf[0, bufSize) and count the whole size
+*/
+class BufWriter {
+	char *buf_;
+	size_t bufSize_;
+	size_t n_;
+public:
+	BufWriter(char *buf, size_t bufSize) : buf_(buf), bufSize_(bufSize), n_(0) {}
+	void append(const char *p, size_t len)
+	{
+		if (n_ < bufSize_) memcpy(buf_ + n_, p, (std::min)(len, bufSize_ - n_));
+		n_ += len;
+	}
+	size_t size() const { return n_; }
+};
+
+class StrWriter {
+	std::string& str_;
+public:
+	explicit StrWriter(std::string& str) : str_(str) {}
+	void append(const char *p, size_t len) { str_.append(p, len); }
+};
+
+template<class W>
+void putArg(W& w, const char *s)
+{
+	if (s == 0) s = "(null)";
+	w.append(s, strlen(s));
+}
+template<class W>
+void putArg(W& w, char *s) { putArg(w, static_cast<const char*>(s)); }
+template<class W>
+void putArg(W& w, const std::string& s) { w.append(s.c_str(), s.size()); }
+template<class W>
+void putArg(W& w, char c) { w.append(&c, 1); }
+template<class W>
+void putArg(W& w, bool b)
+{
+	if (b) {
+		w.append("true", 4);
+	} else {
+		w.append("false", 5);
+	}
+}
+template<class W, class T>
+typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value>::type putArg(W& w, T x)
+{
+	char buf[32];
+	w.append(buf, cybozu::itoa(buf, sizeof(buf), static_cast<long long>(x)));
+}
+template<class W, class T>
+typename std::enable_if<std::is_integral<T>::value && std::is_unsigned<T>::value>::type putArg(W& w, T x)
+{
+	char buf[32];
+	w.append(buf, cybozu::itoa(buf, sizeof(buf), static_cast<unsigned long long>(x)));
+}
+template<class W, class T>
+typename std::enable_if<std::is_floating_point<T>::value>::type putArg(W& w, T x)
+{
+	char buf[32];
+	w.append(buf, cybozu::dtoa(buf, sizeof(buf), static_cast<double>(x)));
+}
+// other types are written by operator<<
+template<class W, class T>
+typename std::enable_if<!std::is_arithmetic<T>::value>::type putArg(W& w, const T& x)
+{
+	std::ostringstream os;
+	os << x;
+	const std::string& s = os.str();
+	w.append(s.c_str(), s.size());
+}
+
+/*
+	write format until "{}"
+	@return the next of "{}" or NULL if no "{}"
+*/
+template<class W>
+const char *putUntilArg(W& w, const char *p)
+{
+	for (;;) {
+		const char *q = p;
+		while (*q && *q != '{' && *q != '}') q++;
+		w.append(p, q - p);
+		if (*q == '\0') return 0;
+		if (q[0] == '{' && q[1] == '}') return q + 2;
+		if (q[0] != q[1]) throw cybozu::Exception("format:bad format") << q;
+		w.append(q, 1);
+		p = q + 2;
+	}
+}
+
+template<class W>
+void formatLoop(W& w, const char *p)
+{
+	if (putUntilArg(w, p)) throw cybozu::Exception("format:too few arguments");
+}
+
+template<class W, class T, class... Args>
+void formatLoop(W& w, const char *p, const T& x, const Args&... args)
+{
+	p = putUntilArg(w, p);
+	if (p == 0) throw cybozu::Exception("format:too many arguments");
+	putArg(w, x);
+	formatLoop(w, p, args...);
+}
+
+} // format_local
+
+/**
+	type-safe format such as formatTo(buf, bufSize, "x={}, y={}", 3, "abc")
+	"{}" is replaced with the next argument, "{{" and "}}" mean '{' and '}'
+	integers and floating point numbers are converted by itoa and dtoa
+	other types are converted by operator<<
+	@param buf [out] not NUL terminated
+	@param bufSize [in] size of buf
+	@return size of the whole result(the result is truncated if it is larger than bufSize)
+	@note no memory allocation for arithmetic types and strings
+	@note throw cybozu::Exception if format does not match args(use CYBOZU_FORMAT_TO to check it at compile time)
+*/
+template<class... Args>
+size_t formatTo(char *buf, size_t bufSize, const char *format, const Args&... args)
+{
+	format_local::BufWriter w(buf, bufSize);
+	format_local::formatLoop(w, format, args...);
+	return w.size();
+}
+
+/**
+	type-safe format to str
+	@note str keeps its capacity, so reusing str avoids memory allocation
+*/
+template<class... Args>
+void formatTo(std::string& str, const char *format, const Args&... args)
+{
+	str.clear();
+	format_local::StrWriter w(str);
+	format_local::formatLoop(w, format, args...);
+}
+
+#endif
+
 } // cybozu
 
+#if CYBOZU_CPP_VERSION >= CYBOZU_CPP_VERSION_CPP11
+#define CYBOZU_FORMAT_FIRST(x, ...) x
+/*
+	check the number of "{}" in the format(string literal) and that of arguments at compile time
+	CYBOZU_FORMAT_CHECK(format, args...)
+*/
+#define CYBOZU_FORMAT_CHECK(...) ((void)cybozu::format_local::CheckArgNum<cybozu::format_local::countArg(CYBOZU_FORMAT_FIRST(__VA_ARGS__, 0)), sizeof(cybozu::format_local::argNum(__VA_ARGS__)) - 1>())
+/*
+	formatTo with the check at compile time
+	CYBOZU_FORMAT_TO(str, format, args...)
+	CYBOZU_FORMAT_TO_BUF(buf, bufSize, format, args...)
+*/
+#define CYBOZU_FORMAT_TO(str, ...) (CYBOZU_FORMAT_CHECK(__VA_ARGS__), cybozu::formatTo(str, __VA_ARGS__))
+#define CYBOZU_FORMAT_TO_BUF(buf, bufSize, ...) (CYBOZU_FORMAT_CHECK(__VA_ARGS__), cybozu::formatTo(buf, bufSize, __VA_ARGS__))
+#endif
+
 #ifdef CYBOZU_FORMAT_DISABLE_WARNING
 #pragma GCC diagnostic push
 #endif
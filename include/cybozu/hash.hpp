@@ -1,5 +1,9 @@
 #pragma once
 #include <cybozu/inttype.hpp>
+#include <string.h>
+#if defined(_MSC_VER) && defined(_M_X64)
+	#include <intrin.h>
+#endif
 
 namespace cybozu {
 
@@ -35,6 +39,108 @@ uint64_t hash64(const T *x, size_t n, uint64_t v = 0)
 	return hash64(x, x + n, v);
 }
 
+namespace hash_local {
+
+inline uint64_t read64(const uint8_t *p)
+{
+	uint64_t v;
+	memcpy(&v, p, sizeof(v));
+#if CYBOZU_ENDIAN == CYBOZU_ENDIAN_BIG
+	v = (v >> 56) | ((v >> 40) & 0xff00) | ((v >> 24) & 0xff0000) | ((v >> 8) & 0xff000000)
+		| ((v & 0xff000000) << 8) | ((v & 0xff0000) << 24) | ((v & 0xff00) << 40) | (v << 56);
+#endif
+	return v;
+}
+
+inline uint64_t read32(const uint8_t *p)
+{
+	return uint64_t(p[0]) | (uint64_t(p[1]) << 8) | (uint64_t(p[2]) << 16) | (uint64_t(p[3]) << 24);
+}
+
+/*
+	(lo, hi) = a * b
+*/
+inline void mul128(uint64_t& lo, uint64_t& hi, uint64_t a, uint64_t b)
+{
+#if defined(__SIZEOF_INT128__)
+	__extension__ typedef unsigned __int128 uint128_t;
+	const uint128_t t = uint128_t(a) * b;
+	lo = uint64_t(t);
+	hi = uint64_t(t >> 64);
+#elif defined(_MSC_VER) && defined(_M_X64)
+	lo = _umul128(a, b, &hi);
+#else
+	const uint64_t aL = uint32_t(a), aH = a >> 32;
+	const uint64_t bL = uint32_t(b), bH = b >> 32;
+	const uint64_t LL = aL * bL, LH = aL * bH, HL = aH * bL, HH = aH * bH;
+	const uint64_t mid = (LL >> 32) + uint32_t(LH) + uint32_t(HL);
+	hi = HH + (LH >> 32) + (HL >> 32) + (mid >> 32);
+	lo = (mid << 32) | uint32_t(LL);
+#endif
+}
+
+inline uint64_t mix(uint64_t a, uint64_t b)
+{
+	uint64_t lo, hi;
+	mul128(lo, hi, a, b);
+	return lo ^ hi;
+}
+
+} // cybozu::hash_local
+
+/*
+	fast non-cryptographic hash of [data, data + n) based on wyhash
+	it reads 48 bytes per step by three independent multiplications
+	keys up to 16 bytes are hashed by two multiplications without a loop
+	@note the value depends on nothing but bytes and seed (not on endianness)
+	@note use siphash24 if an attacker may choose keys to make collisions
+*/
+inline uint64_t fastHash64(const void *data, size_t n, uint64_t seed = 0)
+{
+	using namespace hash_local;
+	const uint64_t s0 = 0xa0761d6478bd642fULL;
+	const uint64_t s1 = 0xe7037ed1a0b428dbULL;
+	const uint64_t s2 = 0x8ebc6af09c88c6e3ULL;
+	const uint64_t s3 = 0x589965cc75374cc3ULL;
+	const uint8_t *p = static_cast<const uint8_t*>(data);
+	seed ^= mix(seed ^ s0, s1);
+	uint64_t a, b;
+	if (n <= 16) {
+		if (n >= 4) {
+			const size_t d = (n >> 3) << 2;
+			a = (read32(p) << 32) | read32(p + d);
+			b = (read32(p + n - 4) << 32) | read32(p + n - 4 - d);
+		} else if (n > 0) {
+			a = (uint64_t(p[0]) << 16) | (uint64_t(p[n >> 1]) << 8) | p[n - 1];
+			b = 0;
+		} else {
+			a = b = 0;
+		}
+	} else {
+		size_t i = n;
+		if (i > 48) {
+			uint64_t t1 = seed, t2 = seed;
+			do {
+				seed = mix(read64(p) ^ s1, read64(p + 8) ^ seed);
+				t1 = mix(read64(p + 16) ^ s2, read64(p + 24) ^ t1);
+				t2 = mix(read64(p + 32) ^ s3, read64(p + 40) ^ t2);
+				p += 48;
+				i -= 48;
+			} while (i > 48);
+			seed ^= t1 ^ t2;
+		}
+		while (i > 16) {
+			seed = mix(read64(p) ^ s1, read64(p + 8) ^ seed);
+			p += 16;
+			i -= 16;
+		}
+		a = read64(p + i - 16);
+		b = read64(p + i - 8);
+	}
+	mul128(a, b, a ^ s1, b ^ seed);
+	return mix(a ^ s0 ^ n, b ^ s1);
+}
+
 } // cybozu
 
 namespace boost {
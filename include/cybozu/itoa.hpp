@@ -9,11 +9,51 @@
 #include <string>
 #endif
 #include <memory.h>
+#include <string.h>
 #include <cybozu/inttype.hpp>
 #include <cybozu/bit_operation.hpp>
+#include <cybozu/endian.hpp>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#define CYBOZU_ITOA_USE_SSE2
+	#include <emmintrin.h>
+#endif
 
 namespace cybozu {
 
+namespace itoa_local {
+
+/*
+	write 16 hex chars of x
+*/
+inline void uint64ToHex16(char out[16], uint64_t x, bool upCase)
+{
+#ifdef CYBOZU_ITOA_USE_SSE2
+	char be[8];
+	cybozu::Set64bitAsBE(be, x);
+	const __m128i v = _mm_loadl_epi64(cybozu::cast<const __m128i*>(be));
+	const __m128i mask = _mm_set1_epi8(0x0f);
+	// split each byte into (upper nibble, lower nibble)
+	__m128i t = _mm_unpacklo_epi8(_mm_and_si128(_mm_srli_epi16(v, 4), mask), _mm_and_si128(v, mask));
+	const __m128i gt9 = _mm_cmpgt_epi8(t, _mm_set1_epi8(9));
+	t = _mm_add_epi8(t, _mm_set1_epi8('0'));
+	t = _mm_add_epi8(t, _mm_and_si128(gt9, _mm_set1_epi8(char((upCase ? 'A' : 'a') - '9' - 1))));
+	_mm_storeu_si128(cybozu::cast<__m128i*>(out), t);
+#else
+	static const char *hexTbl[] = {
+		"0123456789abcdef",
+		"0123456789ABCDEF"
+	};
+	const char *tbl = hexTbl[upCase];
+	for (int i = 0; i < 16; i++) {
+		out[15 - i] = tbl[x & 15];
+		x >>= 4;
+	}
+#endif
+}
+
+} // itoa_local
+
 template<class T>
 size_t getHexLength(T x)
 {
@@ -33,6 +73,12 @@ size_t getBinLength(T x)
 template<class T>
 void itohex(char *out, size_t len, T x, bool upCase = true)
 {
+	if (sizeof(T) <= 8 && len <= 16) {
+		char buf[16];
+		itoa_local::uint64ToHex16(buf, uint64_t(x), upCase);
+		memcpy(out, buf + 16 - len, len);
+		return;
+	}
 	static const char *hexTbl[] = {
 		"0123456789abcdef",
 		"0123456789ABCDEF"
@@ -59,6 +105,54 @@ void itobin(char *out, size_t len, T x)
 
 namespace itoa_local {
 
+/*
+	number of decimal digits of x
+*/
+inline size_t getDecLength(uint64_t x)
+{
+	static const uint64_t tbl[] = {
+		0, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000,
+		10000000000ULL, 100000000000ULL, 1000000000000ULL, 10000000000000ULL, 100000000000000ULL,
+		1000000000000000ULL, 10000000000000000ULL, 100000000000000000ULL, 1000000000000000000ULL,
+		10000000000000000000ULL,
+	};
+	// log10(2) ~ 1233 / 4096
+	const size_t t = (size_t(cybozu::bsr(x | 1)) + 1) * 1233 >> 12;
+	return t + (x >= tbl[t]);
+}
+
+/*
+	"00" "01" ... "99"
+*/
+inline const char *getDigit2Tbl()
+{
+	static const char tbl[] =
+		"00010203040506070809"
+		"10111213141516171819"
+		"20212223242526272829"
+		"30313233343536373839"
+		"40414243444546474849"
+		"50515253545556575859"
+		"60616263646566676869"
+		"70717273747576777879"
+		"80818283848586878889"
+		"90919293949596979899";
+	return tbl;
+}
+
+/*
+	write x < 10^8 as 8 digits to p[-8, 0)
+*/
+inline void writeDigit8(char *p, uint32_t x)
+{
+	const char *tbl = getDigit2Tbl();
+	for (int i = 0; i < 4; i++) {
+		p -= 2;
+		memcpy(p, tbl + (x % 100) * 2, 2);
+		x /= 100;
+	}
+}
+
 /*
 	convert x to dec
 	use buf[0, bufSize)
@@ -69,12 +163,30 @@ namespace itoa_local {
 template<class UT>
 size_t uintToDec(char *buf, size_t bufSize, UT x)
 {
-	for (size_t i = 0; i < bufSize; i++) {
-		buf[bufSize - 1 - i] = '0' + static_cast<int>(x % 10);
-		x /= 10;
-		if (x == 0) return i + 1;
+	const size_t n = getDecLength(uint64_t(x));
+	if (n > bufSize) return 0;
+	char *p = buf + bufSize;
+	uint64_t y = x;
+	// 32-bit division is faster than 64-bit one
+	while (y >= 100000000) {
+		writeDigit8(p, uint32_t(y % 100000000));
+		y /= 100000000;
+		p -= 8;
 	}
-	return 0;
+	uint32_t z = uint32_t(y);
+	const char *tbl = getDigit2Tbl();
+	while (z >= 100) {
+		p -= 2;
+		memcpy(p, tbl + (z % 100) * 2, 2);
+		z /= 100;
+	}
+	if (z >= 10) {
+		p -= 2;
+		memcpy(p, tbl + z * 2, 2);
+	} else {
+		*--p = char('0' + z);
+	}
+	return n;
 }
 
 /*
@@ -87,17 +199,10 @@ size_t uintToDec(char *buf, size_t bufSize, UT x)
 template<class UT>
 size_t uintToHex(char *buf, size_t bufSize, UT x, bool upCase = true)
 {
-	static const char *hexTbl[] = {
-		"0123456789abcdef",
-		"0123456789ABCDEF"
-	};
-	const char *tbl = hexTbl[upCase];
-	for (size_t i = 0; i < bufSize; i++) {
-		buf[bufSize - 1 - i] = tbl[x % 16];
-		x /= 16;
-		if (x == 0) return i + 1;
-	}
-	return 0;
+	const size_t n = getHexLength(x);
+	if (n > bufSize) return 0;
+	itohex(buf + bufSize - n, n, x, upCase);
+	return n;
 }
 
 /*
@@ -143,6 +248,399 @@ size_t intToDec(char *buf, size_t bufSize, T x)
 	return n;
 }
 
+/*
+	write x to the top of buf
+*/
+inline size_t uintToDecFront(char *buf, size_t bufSize, uint64_t x, bool neg)
+{
+	const size_t n = getDecLength(x) + neg;
+	if (n > bufSize) return 0;
+	if (neg) buf[0] = '-';
+	uintToDec(buf, n, x);
+	return n;
+}
+
+template<class T>
+size_t intToDecFront(char *buf, size_t bufSize, T x)
+{
+	const bool neg = x < 0;
+	// 0 - x avoids overflow of -LLONG_MIN
+	return uintToDecFront(buf, bufSize, neg ? 0 - uint64_t(x) : uint64_t(x), neg);
+}
+
+/*
+	shortest round-trip conversion of double by Ryu
+	Ulf Adams, Ryu: fast float-to-string conversion, PLDI 2018
+	tables of 5^i and 2^k/5^i with 125 bits are computed from every 26th entry
+	and the 2-bit corrections
+*/
+namespace ryu {
+
+/*
+	return low 64 bits of a * b and set high 64 bits to *pH
+*/
+inline uint64_t mulUnit(uint64_t *pH, uint64_t a, uint64_t b)
+{
+#if defined(__SIZEOF_INT128__)
+	__extension__ typedef unsigned __int128 uint128_t;
+	const uint128_t t = uint128_t(a) * b;
+	*pH = uint64_t(t >> 64);
+	return uint64_t(t);
+#elif defined(_MSC_VER) && defined(_M_X64)
+	return _umul128(a, b, pH);
+#else
+	const uint64_t aL = uint32_t(a), aH = a >> 32;
+	const uint64_t bL = uint32_t(b), bH = b >> 32;
+	const uint64_t LL = aL * bL, LH = aL * bH, HL = aH * bL, HH = aH * bH;
+	const uint64_t mid = (LL >> 32) + uint32_t(LH) + uint32_t(HL);
+	*pH = HH + (LH >> 32) + (HL >> 32) + (mid >> 32);
+	return (mid << 32) | uint32_t(LL);
+#endif
+}
+
+/*
+	return low 64 bits of (H:L) >> d for 0 < d < 64
+*/
+inline uint64_t shiftRight128(uint64_t L, uint64_t H, int d)
+{
+	return (H << (64 - d)) | (L >> d);
+}
+
+inline int pow5bits(int e)
+{
+	return int((uint32_t(e) * 1217359) >> 19) + 1;
+}
+
+inline int log10Pow2(int e)
+{
+	return int((uint32_t(e) * 78913) >> 18);
+}
+
+inline int log10Pow5(int e)
+{
+	return int((uint32_t(e) * 732923) >> 20);
+}
+
+inline bool multipleOfPowerOf5(uint64_t v, int p)
+{
+	int n = 0;
+	while (v % 5 == 0) {
+		v /= 5;
+		n++;
+	}
+	return n >= p;
+}
+
+inline bool multipleOfPowerOf2(uint64_t v, int p)
+{
+	return (v & ((uint64_t(1) << p) - 1)) == 0;
+}
+
+inline uint64_t getPow5(int i)
+{
+	static const uint64_t tbl[] = {
+		0x0000000000000001, 0x0000000000000005, 0x0000000000000019, 0x000000000000007d,
+		0x0000000000000271, 0x0000000000000c35, 0x0000000000003d09, 0x000000000001312d,
+		0x000000000005f5e1, 0x00000000001dcd65, 0x00000000009502f9, 0x0000000002e90edd,
+		0x000000000e8d4a51, 0x0000000048c27395, 0x000000016bcc41e9, 0x000000071afd498d,
+		0x0000002386f26fc1, 0x000000b1a2bc2ec5, 0x000003782dace9d9, 0x00001158e460913d,
+		0x000056bc75e2d631, 0x0001b1ae4d6e2ef5, 0x000878678326eac9, 0x002a5a058fc295ed,
+		0x00d3c21bcecceda1, 0x0422ca8b0a00a425,
+	};
+	return tbl[i];
+}
+
+/*
+	r = (m * mul) >> d + c for m < 2^64, mul < 2^128, 0 < d < 64
+*/
+inline void mulShiftAdd(uint64_t r[2], uint64_t m, const uint64_t mul[2], int d, uint64_t c)
+{
+	uint64_t H0, H1;
+	const uint64_t L0 = mulUnit(&H0, m, mul[0]);
+	const uint64_t L1 = mulUnit(&H1, m, mul[1]);
+	const uint64_t s1 = H0 + L1;
+	const uint64_t s2 = H1 + (s1 < H0);
+	r[0] = shiftRight128(L0, s1, d) + c;
+	r[1] = shiftRight128(s1, s2, d) + (r[0] < c);
+}
+
+/*
+	r = 5^i with 125 bits
+*/
+inline void computePow5(uint64_t r[2], int i)
+{
+	static const uint64_t tbl[][2] = {
+		{ 0x0000000000000000, 0x1000000000000000 },
+		{ 0x0000000000000000, 0x14adf4b7320334b9 },
+		{ 0x0e549208b31adb10, 0x1aba4714957d300d },
+		{ 0x6dc6ad264d8f0866, 0x1145b7e285bf98f5 },
+		{ 0xeb1dbd923d8596ca, 0x1652efdc6018a1fc },
+		{ 0xb4c1b80b22ae923c, 0x1cda62055b2d9d83 },
+		{ 0x5bb28b4e8f7e4c30, 0x12a5568b9f52f416 },
+		{ 0xf08aed437682d4fb, 0x1819651531f9e78f },
+		{ 0xb4ee134ad99bf150, 0x1f25c186a6f04c28 },
+		{ 0x16499ecb70c25f03, 0x1420eb449c8842e6 },
+		{ 0x85a56ead360865b0, 0x1a03fde214caf085 },
+		{ 0x093db1d57999890b, 0x10cfeb353a97dad8 },
+		{ 0xcf38bb735e3f36ac, 0x15baaf44fa52673e },
+	};
+	static const uint64_t corrTbl[] = {
+		0x0000000000000000, 0x0000000000000000, 0x5969599540000000, 0x5655551555545555,
+		0x4055541041150504, 0x4450454044555145, 0x4000400045555550, 0x5556556596440440,
+		0x4015415154454045, 0x5140555555559155, 0x0000000000000105,
+	};
+	const int base = i / 26;
+	const int base2 = base * 26;
+	const int offset = i - base2;
+	const uint64_t *mul = tbl[base];
+	if (offset == 0) {
+		r[0] = mul[0];
+		r[1] = mul[1];
+		return;
+	}
+	const uint64_t c = (corrTbl[i / 32] >> ((i % 32) * 2)) & 3;
+	mulShiftAdd(r, getPow5(offset), mul, pow5bits(i) - pow5bits(base2), c);
+}
+
+/*
+	r = floor(2^(pow5bits(i) - 1 + 125) / 5^i) + 1
+*/
+inline void computeInvPow5(uint64_t r[2], int i)
+{
+	static const uint64_t tbl[][2] = {
+		{ 0x0000000000000001, 0x2000000000000000 },
+		{ 0x52a6c95fc0655034, 0x18c240c4aecb13bb },
+		{ 0x7ca8d50071dfc806, 0x1327fc58da0f6ff5 },
+		{ 0x6520247d3556476e, 0x1da48ce468e7c702 },
+		{ 0x6139cdd76802e6e9, 0x16ef5b40c2fc7779 },
+		{ 0xf951a7ff43de8c79, 0x11bebdf578b2f391 },
+		{ 0x7be8bee8d6e957e8, 0x1b758d848fac54b0 },
+		{ 0x8bd3f9e999a423ea, 0x153eda614071a3b7 },
+		{ 0x0848f973cb3ee3ce, 0x10701bd527b4978c },
+		{ 0x153285ebb9efbfa2, 0x196fbb9bb44db44d },
+		{ 0xadeee7f86c07b696, 0x13ae3591f5b4d936 },
+		{ 0x4d686a4eaf182222, 0x1e74404f3daada91 },
+		{ 0x98c0a106e09ebd9f, 0x17900ea4fda7c257 },
+	};
+	static const uint64_t corrTbl[] = {
+		0x0405554554544554, 0x0040041410041000, 0x4115555540010000, 0x0001004400000454,
+		0x4400004140000000, 0x5555005450454450, 0x4000400051655554, 0x0001050001000001,
+		0x0555555451515411, 0x0000000000000000,
+	};
+	const int base = (i + 25) / 26;
+	const int base2 = base * 26;
+	const int offset = base2 - i;
+	const uint64_t *mul = tbl[base];
+	if (offset == 0) {
+		r[0] = mul[0];
+		r[1] = mul[1];
+		return;
+	}
+	const uint64_t c = (corrTbl[i / 32] >> ((i % 32) * 2)) & 3;
+	const uint64_t mul1[2] = { mul[0] - 1, mul[1] };
+	mulShiftAdd(r, getPow5(offset), mul1, pow5bits(base2) - pow5bits(i), c + 1);
+}
+
+/*
+	return (m * mul) >> j for 64 < j < 128
+*/
+inline uint64_t mulShift64(uint64_t m, const uint64_t mul[2], int j)
+{
+	uint64_t H0, H1;
+	mulUnit(&H0, m, mul[0]);
+	const uint64_t L1 = mulUnit(&H1, m, mul[1]);
+	const uint64_t s1 = H0 + L1;
+	const uint64_t s2 = H1 + (s1 < H0);
+	return shiftRight128(s1, s2, j - 64);
+}
+
+/*
+	x = m * 2^e is an integer < 2^53
+*/
+inline bool getSmallInt(uint64_t *pd, int *pe, uint64_t ieeeMantissa, int ieeeExponent)
+{
+	const uint64_t m2 = (uint64_t(1) << 52) | ieeeMantissa;
+	const int e2 = ieeeExponent - 1023 - 52;
+	if (e2 > 0 || e2 < -52) return false;
+	if (m2 & ((uint64_t(1) << -e2) - 1)) return false;
+	uint64_t d = m2 >> -e2;
+	int e = 0;
+	while (d % 10 == 0) {
+		d /= 10;
+		e++;
+	}
+	*pd = d;
+	*pe = e;
+	return true;
+}
+
+/*
+	get the shortest d and e such that d * 10^e is converted to x
+	x must be positive and finite
+*/
+inline void toDecimal(uint64_t *pd, int *pe, double x)
+{
+	uint64_t bits;
+	memcpy(&bits, &x, sizeof(bits));
+	const uint64_t ieeeMantissa = bits & ((uint64_t(1) << 52) - 1);
+	const int ieeeExponent = int(bits >> 52) & 0x7ff;
+	if (ieeeExponent != 0 && getSmallInt(pd, pe, ieeeMantissa, ieeeExponent)) return;
+	int e2;
+	uint64_t m2;
+	if (ieeeExponent == 0) {
+		e2 = 1 - 1023 - 52 - 2;
+		m2 = ieeeMantissa;
+	} else {
+		e2 = ieeeExponent - 1023 - 52 - 2;
+		m2 = (uint64_t(1) << 52) | ieeeMantissa;
+	}
+	const bool acceptBounds = (m2 & 1) == 0;
+	const uint64_t mv = 4 * m2;
+	const uint32_t mmShift = ieeeMantissa != 0 || ieeeExponent <= 1;
+	uint64_t vr, vp, vm;
+	int e10;
+	bool vmIsTrailingZeros = false;
+	bool vrIsTrailingZeros = false;
+	uint64_t mul[2];
+	if (e2 >= 0) {
+		const int q = log10Pow2(e2) - (e2 > 3);
+		e10 = q;
+		const int k = 125 + pow5bits(q) - 1;
+		const int i = -e2 + q + k;
+		computeInvPow5(mul, q);
+		vr = mulShift64(mv, mul, i);
+		vp = mulShift64(mv + 2, mul, i);
+		vm = mulShift64(mv - 1 - mmShift, mul, i);
+		if (q <= 21) {
+			if (mv % 5 == 0) {
+				vrIsTrailingZeros = multipleOfPowerOf5(mv, q);
+			} else if (acceptBounds) {
+				vmIsTrailingZeros = multipleOfPowerOf5(mv - 1 - mmShift, q);
+			} else {
+				vp -= multipleOfPowerOf5(mv + 2, q);
+			}
+		}
+	} else {
+		const int q = log10Pow5(-e2) - (-e2 > 1);
+		e10 = q + e2;
+		const int i = -e2 - q;
+		const int k = pow5bits(i) - 125;
+		const int j = q - k;
+		computePow5(mul, i);
+		vr = mulShift64(mv, mul, j);
+		vp = mulShift64(mv + 2, mul, j);
+		vm = mulShift64(mv - 1 - mmShift, mul, j);
+		if (q <= 1) {
+			vrIsTrailingZeros = true;
+			if (acceptBounds) {
+				vmIsTrailingZeros = mmShift == 1;
+			} else {
+				vp--;
+			}
+		} else if (q < 63) {
+			vrIsTrailingZeros = multipleOfPowerOf2(mv, q);
+		}
+	}
+	int removed = 0;
+	uint64_t out;
+	if (vmIsTrailingZeros || vrIsTrailingZeros) {
+		uint32_t lastRemovedDigit = 0;
+		while (vp / 10 > vm / 10) {
+			vmIsTrailingZeros &= vm % 10 == 0;
+			vrIsTrailingZeros &= lastRemovedDigit == 0;
+			lastRemovedDigit = uint32_t(vr % 10);
+			vr /= 10;
+			vp /= 10;
+			vm /= 10;
+			removed++;
+		}
+		if (vmIsTrailingZeros) {
+			while (vm % 10 == 0) {
+				vrIsTrailingZeros &= lastRemovedDigit == 0;
+				lastRemovedDigit = uint32_t(vr % 10);
+				vr /= 10;
+				vp /= 10;
+				vm /= 10;
+				removed++;
+			}
+		}
+		// round to even
+		if (vrIsTrailingZeros && lastRemovedDigit == 5 && vr % 2 == 0) lastRemovedDigit = 4;
+		out = vr + ((vr == vm && (!acceptBounds || !vmIsTrailingZeros)) || lastRemovedDigit >= 5);
+	} else {
+		bool roundUp = false;
+		while (vp / 10 > vm / 10) {
+			roundUp = vr % 10 >= 5;
+			vr /= 10;
+			vp /= 10;
+			vm /= 10;
+			removed++;
+		}
+		out = vr + (vr == vm || roundUp);
+	}
+	*pd = out;
+	*pe = e10 + removed;
+}
+
+} // ryu
+
+/*
+	write d * 10^e in the format of Number.prototype.toString of JavaScript
+	use buf[0, 25)
+	return written size
+*/
+inline size_t decimalToStr(char *buf, bool neg, uint64_t d, int e)
+{
+	char digit[20];
+	const int n = int(uintToDec(digit, sizeof(digit), d));
+	const char *s = digit + sizeof(digit) - n;
+	// x = 0.s * 10^point
+	const int point = n + e;
+	char *p = buf;
+	if (neg) *p++ = '-';
+	if (0 < point && point <= 21) {
+		if (e >= 0) {
+			memcpy(p, s, n);
+			p += n;
+			memset(p, '0', e);
+			p += e;
+		} else {
+			memcpy(p, s, point);
+			p += point;
+			*p++ = '.';
+			memcpy(p, s + point, n - point);
+			p += n - point;
+		}
+	} else if (-6 < point && point <= 0) {
+		*p++ = '0';
+		*p++ = '.';
+		memset(p, '0', -point);
+		p += -point;
+		memcpy(p, s, n);
+		p += n;
+	} else {
+		*p++ = s[0];
+		if (n > 1) {
+			*p++ = '.';
+			memcpy(p, s + 1, n - 1);
+			p += n - 1;
+		}
+		*p++ = 'e';
+		int ee = point - 1;
+		if (ee < 0) {
+			*p++ = '-';
+			ee = -ee;
+		} else {
+			*p++ = '+';
+		}
+		char ebuf[4];
+		const size_t en = uintToDec(ebuf, sizeof(ebuf), uint32_t(ee));
+		memcpy(p, ebuf + sizeof(ebuf) - en, en);
+		p += en;
+	}
+	return p - buf;
+}
+
 #ifndef CYBOZU_DONT_USE_STRING
 template<typename T>
 void convertFromUint(std::string& out, T x)
@@ -180,6 +678,54 @@ void itobinLocal(std::string& out, T x, bool withZero)
 
 } // itoa_local
 
+/**
+	convert x to the shortest string which strtod converts back to x
+	the format is the same as Number.prototype.toString of JavaScript
+	e.g. 0.1, 123, 1e+21, 1.5e-7, NaN, Infinity, -Infinity
+	@param buf [out] not NUL terminated
+	@param bufSize [in] 25 bytes are enough
+	@return written size, 0 if bufSize is too small
+*/
+inline size_t dtoa(char *buf, size_t bufSize, double x)
+{
+	uint64_t bits;
+	memcpy(&bits, &x, sizeof(bits));
+	const bool neg = (bits >> 63) != 0;
+	const int ieeeExponent = int(bits >> 52) & 0x7ff;
+	const uint64_t ieeeMantissa = bits & ((uint64_t(1) << 52) - 1);
+	char tmp[32];
+	size_t n;
+	if (ieeeExponent == 0x7ff) {
+		const char *str = ieeeMantissa ? "NaN" : neg ? "-Infinity" : "Infinity";
+		n = strlen(str);
+		memcpy(tmp, str, n);
+	} else if (ieeeExponent == 0 && ieeeMantissa == 0) {
+		tmp[0] = '0';
+		n = 1;
+	} else {
+		uint64_t d;
+		int e;
+		itoa_local::ryu::toDecimal(&d, &e, neg ? -x : x);
+		n = itoa_local::decimalToStr(tmp, neg, d, e);
+	}
+	if (n > bufSize) return 0;
+	memcpy(buf, tmp, n);
+	return n;
+}
+
+/**
+	convert x to decimal string
+	@param buf [out] not NUL terminated
+	@param bufSize [in] 20 bytes are enough
+	@return written size, 0 if bufSize is too small
+*/
+inline size_t itoa(char *buf, size_t bufSize, int x) { return itoa_local::intToDecFront(buf, bufSize, x); }
+inline size_t itoa(char *buf, size_t bufSize, long x) { return itoa_local::intToDecFront(buf, bufSize, x); }
+inline size_t itoa(char *buf, size_t bufSize, long long x) { return itoa_local::intToDecFront(buf, bufSize, x); }
+inline size_t itoa(char *buf, size_t bufSize, unsigned int x) { return itoa_local::uintToDecFront(buf, bufSize, x, false); }
+inline size_t itoa(char *buf, size_t bufSize, unsigned long x) { return itoa_local::uintToDecFront(buf, bufSize, x, false); }
+inline size_t itoa(char *buf, size_t bufSize, unsigned long long x) { return itoa_local::uintToDecFront(buf, bufSize, x, false); }
+
 #ifndef CYBOZU_DONT_USE_STRING
 /**
 	convert int to string
@@ -228,6 +774,24 @@ inline void itoa(std::string& out, unsigned long x) { itoa(out, static_cast<unsi
 inline void itoa(std::string& out, long x) { itoa(out, static_cast<int>(x)); }
 inline void itoa(std::string& out, unsigned long x) { itoa(out, static_cast<int>(x)); }
 #endif
+/**
+	convert double to the shortest string
+	@param out [out] string
+	@param x [in] double
+*/
+inline void dtoa(std::string& out, double x)
+{
+	char buf[32];
+	out.assign(buf, dtoa(buf, sizeof(buf), x));
+}
+
+inline std::string dtoa(double x)
+{
+	std::string ret;
+	dtoa(ret, x);
+	return ret;
+}
+
 /**
 	convert integer to string
 	@param x [in] int
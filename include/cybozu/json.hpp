@@ -6,9 +6,22 @@
 	@author MITSUNARI Shigeo(@herumi)
 */
 #include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <vector>
 #include <map>
+#include <algorithm>
 #include <cybozu/exception.hpp>
+#include <cybozu/stream.hpp>
+#include <cybozu/arena.hpp>
+#include <cybozu/bit_operation.hpp>
+#include <cybozu/itoa.hpp>
+#include <float.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#define CYBOZU_JSON_USE_SSE2
+	#include <emmintrin.h>
+#endif
 
 namespace cybozu {
 
@@ -41,6 +54,7 @@ public:
 			case T_String: delete str_; break;
 			case T_Object: delete obj_; break;
 			case T_Array: delete arr_; break;
+			default: break;
 			}
 		}
 		explicit Value(double num)
@@ -116,5 +130,1253 @@ public:
 	};
 };
 
+namespace json_local {
+
+inline bool isSpace(int c)
+{
+	return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+inline bool isDigit(int c)
+{
+	return '0' <= c && c <= '9';
+}
+
+/*
+	same as std::isfinite, which C++03 does not have
+*/
+inline bool isFinite(double x)
+{
+	uint64_t bits;
+	memcpy(&bits, &x, sizeof(bits));
+	return ((bits >> 52) & 0x7ff) != 0x7ff;
+}
+
+inline int hexToInt(int c)
+{
+	if ('0' <= c && c <= '9') return c - '0';
+	if ('a' <= c && c <= 'f') return c - 'a' + 10;
+	if ('A' <= c && c <= 'F') return c - 'A' + 10;
+	return -1;
+}
+
+/*
+	write UTF-8 of code point c to p
+	return the written size
+*/
+inline size_t putUtf8(char *p, uint32_t c)
+{
+	if (c < 0x80) {
+		p[0] = char(c);
+		return 1;
+	}
+	if (c < 0x800) {
+		p[0] = char(0xc0 | (c >> 6));
+		p[1] = char(0x80 | (c & 0x3f));
+		return 2;
+	}
+	if (c < 0x10000) {
+		p[0] = char(0xe0 | (c >> 12));
+		p[1] = char(0x80 | ((c >> 6) & 0x3f));
+		p[2] = char(0x80 | (c & 0x3f));
+		return 3;
+	}
+	p[0] = char(0xf0 | (c >> 18));
+	p[1] = char(0x80 | ((c >> 12) & 0x3f));
+	p[2] = char(0x80 | ((c >> 6) & 0x3f));
+	p[3] = char(0x80 | (c & 0x3f));
+	return 4;
+}
+
+/*
+	append UTF-8 of code point c to str
+*/
+inline void appendUtf8(std::string& str, uint32_t c)
+{
+	char buf[4];
+	str.append(buf, putUtf8(buf, c));
+}
+
+/*
+	read 4 hex digits from [*pp, end)
+*/
+inline uint32_t getHex4(const char **pp, const char *end)
+{
+	const char *p = *pp;
+	if (end - p < 4) throw cybozu::Exception("json:getHex4:short");
+	uint32_t u = 0;
+	for (int i = 0; i < 4; i++) {
+		int v = hexToInt(static_cast<unsigned char>(p[i]));
+		if (v < 0) throw cybozu::Exception("json:getHex4:bad hex");
+		u = u * 16 + v;
+	}
+	*pp = p + 4;
+	return u;
+}
+
+/*
+	decode escaped string [p, end) into out
+	out must have end - p bytes
+	return the decoded size
+*/
+inline size_t unescape(char *out, const char *p, const char *end)
+{
+	char *const top = out;
+	while (p < end) {
+		char c = *p++;
+		if (c != '\\') {
+			*out++ = c;
+			continue;
+		}
+		if (p == end) throw cybozu::Exception("json:unescape:bad escape");
+		c = *p++;
+		switch (c) {
+		case '"': *out++ = '"'; break;
+		case '\\': *out++ = '\\'; break;
+		case '/': *out++ = '/'; break;
+		case 'b': *out++ = '\b'; break;
+		case 'f': *out++ = '\f'; break;
+		case 'n': *out++ = '\n'; break;
+		case 'r': *out++ = '\r'; break;
+		case 't': *out++ = '\t'; break;
+		case 'u':
+			{
+				uint32_t u = getHex4(&p, end);
+				if (0xd800 <= u && u < 0xdc00) {
+					if (end - p < 2 || p[0] != '\\' || p[1] != 'u') throw cybozu::Exception("json:unescape:no low surrogate");
+					p += 2;
+					uint32_t v = getHex4(&p, end);
+					if (!(0xdc00 <= v && v < 0xe000)) throw cybozu::Exception("json:unescape:bad low surrogate") << v;
+					u = 0x10000 + ((u - 0xd800) << 10) + (v - 0xdc00);
+				} else if (0xdc00 <= u && u < 0xe000) {
+					throw cybozu::Exception("json:unescape:bad surrogate") << u;
+				}
+				out += putUtf8(out, u);
+			}
+			break;
+		default:
+			throw cybozu::Exception("json:unescape:bad escape") << c;
+		}
+	}
+	return out - top;
+}
+
+/*
+	skip digits in [p, end)
+*/
+inline const char *skipDigits(const char *p, const char *end)
+{
+	while (p < end && isDigit(*p)) p++;
+	return p;
+}
+
+/*
+	return the end of the number starting at p
+	-?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)?
+*/
+inline const char *scanNumber(const char *p, const char *end)
+{
+	if (p < end && *p == '-') p++;
+	if (p == end || !isDigit(*p)) throw cybozu::Exception("json:scanNumber:no digit");
+	if (*p == '0') {
+		p++;
+	} else {
+		p = skipDigits(p, end);
+	}
+	if (p < end && *p == '.') {
+		p++;
+		if (p == end || !isDigit(*p)) throw cybozu::Exception("json:scanNumber:no digit after point");
+		p = skipDigits(p, end);
+	}
+	if (p < end && (*p == 'e' || *p == 'E')) {
+		p++;
+		if (p < end && (*p == '+' || *p == '-')) p++;
+		if (p == end || !isDigit(*p)) throw cybozu::Exception("json:scanNumber:no digit in exponent");
+		p = skipDigits(p, end);
+	}
+	return p;
+}
+
+/*
+	the parsers scan strings and white spaces on demand with the masks below
+	an index of structural chars built in advance(stage 1 of simdjson) is not used
+	because the extra pass costs more than it saves unless the input has long indents
+*/
+#ifdef CYBOZU_JSON_USE_SSE2
+/*
+	bit i of the return value is 1 if p[i] is '"', '\\' or a control char
+	for 0 <= i < 64
+*/
+inline uint64_t getStringSpecialMask64(const char *p)
+{
+	const __m128i quote = _mm_set1_epi8('"');
+	const __m128i backslash = _mm_set1_epi8('\\');
+	const __m128i ctrl = _mm_set1_epi8(0x1f);
+	uint64_t mask = 0;
+	for (int i = 0; i < 4; i++) {
+		const __m128i x = _mm_loadu_si128(cybozu::cast<const __m128i*>(p + i * 16));
+		__m128i m = _mm_or_si128(_mm_cmpeq_epi8(x, quote), _mm_cmpeq_epi8(x, backslash));
+		// x <= 0x1f as unsigned
+		m = _mm_or_si128(m, _mm_cmpeq_epi8(_mm_min_epu8(x, ctrl), x));
+		mask |= uint64_t(uint32_t(_mm_movemask_epi8(m))) << (i * 16);
+	}
+	return mask;
+}
+
+/*
+	bit i of the return value is 1 if p[i] is not a white space
+	for 0 <= i < 64
+*/
+inline uint64_t getNonSpaceMask64(const char *p)
+{
+	const __m128i sp = _mm_set1_epi8(' ');
+	const __m128i tab = _mm_set1_epi8('\t');
+	const __m128i cr = _mm_set1_epi8('\r');
+	const __m128i lf = _mm_set1_epi8('\n');
+	uint64_t mask = 0;
+	for (int i = 0; i < 4; i++) {
+		const __m128i x = _mm_loadu_si128(cybozu::cast<const __m128i*>(p + i * 16));
+		__m128i m = _mm_or_si128(_mm_cmpeq_epi8(x, sp), _mm_cmpeq_epi8(x, tab));
+		m = _mm_or_si128(m, _mm_or_si128(_mm_cmpeq_epi8(x, cr), _mm_cmpeq_epi8(x, lf)));
+		mask |= uint64_t(uint32_t(_mm_movemask_epi8(m))) << (i * 16);
+	}
+	return ~mask;
+}
+#endif
+
+/*
+	return the first position of '"', '\\' or a control char in [p, end)
+	return end if not found
+*/
+inline const char *findStringSpecial(const char *p, const char *end)
+{
+#ifdef CYBOZU_JSON_USE_SSE2
+	while (end - p >= 64) {
+		const uint64_t mask = getStringSpecialMask64(p);
+		if (mask) return p + cybozu::bsf(mask);
+		p += 64;
+	}
+#endif
+	while (p < end) {
+		const unsigned char c = static_cast<unsigned char>(*p);
+		if (c == '"' || c == '\\' || c < 0x20) return p;
+		p++;
+	}
+	return end;
+}
+
+/*
+	return the first position of a non space char in [p, end)
+	return end if not found
+*/
+inline const char *skipSpace(const char *p, const char *end)
+{
+	// short spaces are usual
+	for (int i = 0; i < 4; i++) {
+		if (p == end || !isSpace(*p)) return p;
+		p++;
+	}
+#ifdef CYBOZU_JSON_USE_SSE2
+	while (end - p >= 64) {
+		const uint64_t mask = getNonSpaceMask64(p);
+		if (mask) return p + cybozu::bsf(mask);
+		p += 64;
+	}
+#endif
+	while (p < end && isSpace(*p)) p++;
+	return p;
+}
+
+/*
+	convert a number validated by scanNumber
+	[p, p + n) need not be terminated by '\0'
+*/
+inline double toDoubleSlow(const char *p, size_t n)
+{
+	char buf[64];
+	if (n < sizeof(buf)) {
+		memcpy(buf, p, n);
+		buf[n] = '\0';
+		return strtod(buf, 0);
+	}
+	return strtod(std::string(p, n).c_str(), 0);
+}
+
+/*
+	convert a number validated by scanNumber
+	return true and set *pi if it is an integer in int64_t
+	otherwise return false and set *pd
+	m * 10^e is computed exactly by one multiplication or division
+	if m < 2^53 and |e| <= 22 (Clinger's fast path)
+	fall back to strtod for other cases
+*/
+inline bool toNumber(int64_t *pi, double *pd, const char *p, size_t n)
+{
+	const char *const top = p;
+	const char *const end = p + n;
+	bool neg = false;
+	if (*p == '-') {
+		neg = true;
+		p++;
+	}
+	uint64_t m = 0;
+	int digitN = 0; // number of significant digits in m
+	int e = 0;
+	bool truncated = false;
+	bool isInt = true;
+	for (; p < end && isDigit(*p); p++) {
+		if (digitN < 19) {
+			m = m * 10 + (*p - '0');
+			if (m) digitN++;
+		} else {
+			e++;
+			truncated = true;
+		}
+	}
+	if (p < end && *p == '.') {
+		isInt = false;
+		for (p++; p < end && isDigit(*p); p++) {
+			if (digitN < 19) {
+				m = m * 10 + (*p - '0');
+				if (m) digitN++;
+				e--;
+			} else {
+				truncated = true;
+			}
+		}
+	}
+	if (p < end) { // [eE]
+		isInt = false;
+		p++;
+		bool negE = false;
+		if (*p == '+' || *p == '-') {
+			negE = *p == '-';
+			p++;
+		}
+		int exp = 0;
+		for (; p < end; p++) {
+			if (exp < 100000) exp = exp * 10 + (*p - '0');
+		}
+		e += negE ? -exp : exp;
+	}
+	if (isInt && !truncated) {
+		const uint64_t maxInt = uint64_t(1) << 63;
+		if (neg ? (0 < m && m <= maxInt) : m < maxInt) {
+			*pi = neg ? int64_t(0 - m) : int64_t(m);
+			return true;
+		}
+	}
+#if defined(FLT_EVAL_METHOD) && FLT_EVAL_METHOD == 0
+	static const double tbl[] = {
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+		1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+	};
+	const uint64_t maxMantissa = uint64_t(1) << 53;
+	if (!truncated && m <= maxMantissa) {
+		if (m == 0) {
+			*pd = neg ? -0.0 : 0.0;
+			return false;
+		}
+		if (22 < e && e <= 22 + 15) {
+			// move zeros to m if it is still exact
+			for (; e > 22 && m <= maxMantissa / 10; e--) m *= 10;
+		}
+		if (-22 <= e && e <= 22) {
+			double d = double(m);
+			if (e >= 0) {
+				d *= tbl[e];
+			} else {
+				d /= tbl[-e];
+			}
+			*pd = neg ? -d : d;
+			return false;
+		}
+	}
+#endif
+	*pd = toDoubleSlow(top, n);
+	return false;
+}
+
+/*
+	convert a number validated by scanNumber to double
+*/
+inline double toDouble(const char *p, size_t n)
+{
+	int64_t i;
+	double d;
+	if (toNumber(&i, &d, p, n)) return double(i);
+	return d;
+}
+
+} // json_local
+
+/**
+	streaming(SAX-style) json parser
+	no tree is built ; each event is passed to Handler
+	Handler must have the following methods
+	void startObject();
+	void endObject();
+	void startArray();
+	void endArray();
+	void key(const std::string& str);
+	void string(const std::string& str);
+	void number(double x);
+	void boolean(bool b);
+	void null();
+	@note str is valid only in the callback
+	@note the nest of objects and arrays is not limited by the call stack
+*/
+template<class InputStream>
+class JsonReaderT {
+	JsonReaderT(const JsonReaderT&);
+	void operator=(const JsonReaderT&);
+public:
+	explicit JsonReaderT(InputStream& is)
+		: is_(is)
+		, pos_(0)
+		, bufSize_(0)
+		, readSize_(0)
+	{
+	}
+	/**
+		parse one json value from InputStream
+		@return false if no data(eof)
+		@note call parse repeatedly to read concatenated values such as JSON Lines
+	*/
+	template<class Handler>
+	bool parse(Handler& handler)
+	{
+		skipSpace();
+		if (peek() < 0) return false;
+		stack_.clear();
+		for (;;) {
+			parseValue(handler);
+			for (;;) {
+				if (stack_.empty()) return true;
+				skipSpace();
+				int c = get();
+				if (stack_.back() == '{') {
+					if (c == ',') {
+						parseKey(handler);
+						break;
+					}
+					if (c == '}') {
+						stack_.pop_back();
+						handler.endObject();
+						continue;
+					}
+					throw cybozu::Exception("json:parse:bad char in object") << c << getPos();
+				} else {
+					if (c == ',') break;
+					if (c == ']') {
+						stack_.pop_back();
+						handler.endArray();
+						continue;
+					}
+					throw cybozu::Exception("json:parse:bad char in array") << c << getPos();
+				}
+			}
+		}
+	}
+	/**
+		number of bytes consumed
+	*/
+	size_t getPos() const { return readSize_ + pos_; }
+private:
+	/*
+		parse a scalar or the beginning of an object/array
+	*/
+	template<class Handler>
+	void parseValue(Handler& handler)
+	{
+		for (;;) {
+			skipSpace();
+			int c = get();
+			switch (c) {
+			case '{':
+				handler.startObject();
+				skipSpace();
+				if (peek() == '}') {
+					pos_++;
+					handler.endObject();
+					return;
+				}
+				stack_.push_back('{');
+				parseKey(handler);
+				continue;
+			case '[':
+				handler.startArray();
+				skipSpace();
+				if (peek() == ']') {
+					pos_++;
+					handler.endArray();
+					return;
+				}
+				stack_.push_back('[');
+				continue;
+			case '"':
+				parseString();
+				handler.string(str_);
+				return;
+			case 't':
+				expect("rue");
+				handler.boolean(true);
+				return;
+			case 'f':
+				expect("alse");
+				handler.boolean(false);
+				return;
+			case 'n':
+				expect("ull");
+				handler.null();
+				return;
+			default:
+				if (c == '-' || json_local::isDigit(c)) {
+					handler.number(parseNumber(c));
+					return;
+				}
+				throw cybozu::Exception("json:parseValue:bad char") << c << getPos();
+			}
+		}
+	}
+	template<class Handler>
+	void parseKey(Handler& handler)
+	{
+		skipSpace();
+		if (get() != '"') throw cybozu::Exception("json:parseKey:no key") << getPos();
+		parseString();
+		handler.key(str_);
+		skipSpace();
+		if (get() != ':') throw cybozu::Exception("json:parseKey:no colon") << str_ << getPos();
+	}
+	/*
+		read string after '"' into str_
+	*/
+	void parseString()
+	{
+		str_.clear();
+		for (;;) {
+			if (!fill()) throw cybozu::Exception("json:parseString:no end quote") << getPos();
+			const size_t begin = pos_;
+			pos_ = json_local::findStringSpecial(buf_ + pos_, buf_ + bufSize_) - buf_;
+			str_.append(buf_ + begin, pos_ - begin);
+			if (pos_ == bufSize_) continue;
+			const int c = get();
+			if (c == '"') return;
+			if (c != '\\') throw cybozu::Exception("json:parseString:control char") << c << getPos();
+			parseEscape();
+		}
+	}
+	void parseEscape()
+	{
+		int c = get();
+		switch (c) {
+		case '"': str_ += '"'; break;
+		case '\\': str_ += '\\'; break;
+		case '/': str_ += '/'; break;
+		case 'b': str_ += '\b'; break;
+		case 'f': str_ += '\f'; break;
+		case 'n': str_ += '\n'; break;
+		case 'r': str_ += '\r'; break;
+		case 't': str_ += '\t'; break;
+		case 'u':
+			{
+				uint32_t u = getHex4();
+				if (0xd800 <= u && u < 0xdc00) {
+					if (get() != '\\' || get() != 'u') throw cybozu::Exception("json:parseEscape:no low surrogate") << getPos();
+					uint32_t v = getHex4();
+					if (!(0xdc00 <= v && v < 0xe000)) throw cybozu::Exception("json:parseEscape:bad low surrogate") << v << getPos();
+					u = 0x10000 + ((u - 0xd800) << 10) + (v - 0xdc00);
+				} else if (0xdc00 <= u && u < 0xe000) {
+					throw cybozu::Exception("json:parseEscape:bad surrogate") << u << getPos();
+				}
+				json_local::appendUtf8(str_, u);
+			}
+			break;
+		default:
+			throw cybozu::Exception("json:parseEscape:bad escape") << c << getPos();
+		}
+	}
+	uint32_t getHex4()
+	{
+		uint32_t u = 0;
+		for (int i = 0; i < 4; i++) {
+			int v = json_local::hexToInt(get());
+			if (v < 0) throw cybozu::Exception("json:getHex4:bad hex") << getPos();
+			u = u * 16 + v;
+		}
+		return u;
+	}
+	void appendDigits()
+	{
+		while (json_local::isDigit(peek())) {
+			num_ += buf_[pos_++];
+		}
+	}
+	/*
+		c is the first char of the number
+		-?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)?
+	*/
+	double parseNumber(int c)
+	{
+		num_.clear();
+		num_ += char(c);
+		if (c == '-') {
+			c = get();
+			if (!json_local::isDigit(c)) throw cybozu::Exception("json:parseNumber:no digit") << getPos();
+			num_ += char(c);
+		}
+		if (c != '0') appendDigits();
+		if (peek() == '.') {
+			num_ += buf_[pos_++];
+			if (!json_local::isDigit(peek())) throw cybozu::Exception("json:parseNumber:no digit after point") << num_ << getPos();
+			appendDigits();
+		}
+		c = peek();
+		if (c == 'e' || c == 'E') {
+			num_ += buf_[pos_++];
+			c = peek();
+			if (c == '+' || c == '-') num_ += buf_[pos_++];
+			if (!json_local::isDigit(peek())) throw cybozu::Exception("json:parseNumber:no digit in exponent") << num_ << getPos();
+			appendDigits();
+		}
+		return json_local::toDouble(num_.c_str(), num_.size());
+	}
+	void expect(const char *str)
+	{
+		while (*str) {
+			if (get() != *str) throw cybozu::Exception("json:expect:bad literal") << getPos();
+			str++;
+		}
+	}
+	bool fill()
+	{
+		if (pos_ < bufSize_) return true;
+		readSize_ += bufSize_;
+		pos_ = 0;
+		bufSize_ = cybozu::readSome(buf_, sizeof(buf_), is_);
+		return bufSize_ > 0;
+	}
+	/*
+		return -1 if eof
+	*/
+	int peek()
+	{
+		if (!fill()) return -1;
+		return static_cast<unsigned char>(buf_[pos_]);
+	}
+	int get()
+	{
+		int c = peek();
+		if (c >= 0) pos_++;
+		return c;
+	}
+	void skipSpace()
+	{
+		while (fill()) {
+			pos_ = json_local::skipSpace(buf_ + pos_, buf_ + bufSize_) - buf_;
+			if (pos_ < bufSize_) return;
+		}
+	}
+	InputStream& is_;
+	char buf_[4096];
+	size_t pos_;
+	size_t bufSize_;
+	size_t readSize_;
+	std::vector<char> stack_;
+	std::string str_;
+	std::string num_;
+};
+
+
+/**
+	compact read-only json DOM
+	all nodes, members and unescaped strings are allocated in an Arena
+	a string without escape refers to the input buffer
+	members of an object are sorted by key, keeping the order of duplicated keys
+	@note the input buffer must be alive while JsonDocument is used
+*/
+class JsonDocument {
+	JsonDocument(const JsonDocument&);
+	void operator=(const JsonDocument&);
+public:
+	struct Member;
+	/*
+		POD type to be put in Arena
+	*/
+	struct Node {
+		Json::Type type_;
+		uint32_t size_; // size of string, number of members or elements, 1 if number is int_ ; parse throws if it is too large
+		union {
+			const char *str_;
+			const Member *member_;
+			const Node *elem_;
+			double num_;
+			int64_t int_;
+			bool b_;
+		};
+		bool isNull() const { return type_ == Json::T_Null; }
+		bool isString() const { return type_ == Json::T_String; }
+		bool isObject() const { return type_ == Json::T_Object; }
+		bool isArray() const { return type_ == Json::T_Array; }
+		bool isBool() const { return type_ == Json::T_Bool; }
+		bool isNumber() const { return type_ == Json::T_Number; }
+
+		/*
+			string is not terminated by '\0'
+		*/
+		const char *getStr() const { assert(isString()); return str_; }
+		std::string getString() const { assert(isString()); return std::string(str_, size_); }
+		bool getBool() const { assert(isBool()); return b_; }
+		double getNumber() const { assert(isNumber()); return size_ ? double(int_) : num_; }
+		/*
+			true if the number is an integer representable by int64_t
+		*/
+		bool isInt() const { return isNumber() && size_ == 1; }
+		int64_t getInt() const { assert(isInt()); return int_; }
+		/*
+			size of string, number of members of object or elements of array
+		*/
+		size_t size() const { return size_; }
+		const Node& operator[](size_t i) const { assert(isArray() && i < size_); return elem_[i]; }
+		const Member *memberBegin() const { assert(isObject()); return member_; }
+		const Member *memberEnd() const { assert(isObject()); return member_ + size_; }
+		/*
+			find member by binary search
+			return the first one in the input if key is duplicated
+			return 0 if not found
+		*/
+		const Node *find(const char *key, size_t keySize) const
+		{
+			assert(isObject());
+			size_t lo = 0, hi = size_;
+			while (lo < hi) {
+				size_t mid = (lo + hi) / 2;
+				if (member_[mid].compare(key, keySize) < 0) {
+					lo = mid + 1;
+				} else {
+					hi = mid;
+				}
+			}
+			if (lo < size_ && member_[lo].compare(key, keySize) == 0) return &member_[lo].val;
+			return 0;
+		}
+		const Node *find(const std::string& key) const { return find(key.c_str(), key.size()); }
+		const Node& operator[](const std::string& key) const
+		{
+			const Node *p = find(key);
+			if (p) return *p;
+			throw cybozu::Exception("JsonDocument:Node:no key") << key;
+		}
+	};
+	struct Member {
+		const char *key;
+		uint32_t keySize;
+		Node val;
+		std::string getKey() const { return std::string(key, keySize); }
+		int compare(const char *rhs, size_t rhsSize) const
+		{
+			int r = memcmp(key, rhs, std::min<size_t>(keySize, rhsSize));
+			if (r) return r;
+			return keySize < rhsSize ? -1 : keySize > rhsSize ? 1 : 0;
+		}
+		bool operator<(const Member& rhs) const { return compare(rhs.key, rhs.keySize) < 0; }
+	};
+	/**
+		@param blockSize [in] block size of Arena
+	*/
+	explicit JsonDocument(size_t blockSize = 1024 * 1024)
+		: arena_(blockSize)
+	{
+		root_.type_ = Json::T_Null;
+		root_.size_ = 0;
+		root_.str_ = 0;
+	}
+	/**
+		parse [begin, end) and build DOM
+		@note previous DOM is released ; get() returns null if parse throws
+	*/
+	void parse(const char *begin, const char *end)
+	{
+		root_.type_ = Json::T_Null;
+		root_.size_ = 0;
+		root_.str_ = 0;
+		arena_.clear();
+		elems_.clear();
+		members_.clear();
+		frames_.clear();
+		begin_ = begin;
+		p_ = begin;
+		end_ = end;
+		Node v;
+		try {
+			for (;;) {
+				parseValue(v);
+				for (;;) {
+					if (frames_.empty()) {
+						skipSpace();
+						if (p_ != end_) throw cybozu::Exception("json:parse:extra data");
+						root_ = v;
+						return;
+					}
+					skipSpace();
+					if (p_ == end_) throw cybozu::Exception("json:parse:not closed");
+					const char c = *p_++;
+					Frame& f = frames_.back();
+					if (f.type == '{') {
+						members_.back().val = v;
+						if (c == ',') {
+							parseKey();
+							break;
+						}
+						if (c != '}') throw cybozu::Exception("json:parse:bad char in object") << c;
+						makeObject(v, f.pos);
+					} else {
+						elems_.push_back(v);
+						if (c == ',') break;
+						if (c != ']') throw cybozu::Exception("json:parse:bad char in array") << c;
+						makeArray(v, f.pos);
+					}
+					frames_.pop_back();
+				}
+			}
+		} catch (cybozu::Exception& e) {
+			e << "pos" << size_t(p_ - begin_);
+			throw;
+		}
+	}
+	void parse(const std::string& str)
+	{
+		parse(str.c_str(), str.c_str() + str.size());
+	}
+	const Node& get() const { return root_; }
+	size_t getAllocatedSize() const { return arena_.getAllocatedSize(); }
+private:
+	struct Frame {
+		char type; // '{' or '['
+		size_t pos; // top of members_ or elems_
+	};
+	void skipSpace()
+	{
+		p_ = json_local::skipSpace(p_, end_);
+	}
+	void pushFrame(char type, size_t pos)
+	{
+		Frame f;
+		f.type = type;
+		f.pos = pos;
+		frames_.push_back(f);
+	}
+	/*
+		sizes are kept in uint32_t to make Node small
+	*/
+	static uint32_t toSize(size_t n)
+	{
+		if (uint64_t(n) > 0xffffffffu) throw cybozu::Exception("json:parse:too large") << n;
+		return uint32_t(n);
+	}
+	void makeObject(Node& v, size_t pos)
+	{
+		const size_t n = members_.size() - pos;
+		Member *m = arena_.alloc<Member>(n);
+		std::copy(members_.begin() + pos, members_.end(), m);
+		std::stable_sort(m, m + n);
+		members_.resize(pos);
+		v.type_ = Json::T_Object;
+		v.size_ = toSize(n);
+		v.member_ = m;
+	}
+	void makeArray(Node& v, size_t pos)
+	{
+		const size_t n = elems_.size() - pos;
+		Node *a = arena_.alloc<Node>(n);
+		std::copy(elems_.begin() + pos, elems_.end(), a);
+		elems_.resize(pos);
+		v.type_ = Json::T_Array;
+		v.size_ = toSize(n);
+		v.elem_ = a;
+	}
+	/*
+		read string after '"'
+	*/
+	void parseString(const char **pstr, uint32_t *psize)
+	{
+		const char *top = p_;
+		bool hasEscape = false;
+		for (;;) {
+			p_ = json_local::findStringSpecial(p_, end_);
+			if (p_ == end_) throw cybozu::Exception("json:parseString:no end quote");
+			const unsigned char c = static_cast<unsigned char>(*p_);
+			if (c == '"') break;
+			if (c < 0x20) throw cybozu::Exception("json:parseString:control char") << int(c);
+			if (c == '\\') {
+				hasEscape = true;
+				p_++;
+				if (p_ == end_) throw cybozu::Exception("json:parseString:no end quote");
+			}
+			p_++;
+		}
+		const size_t n = p_ - top;
+		p_++;
+		if (hasEscape) {
+			char *q = static_cast<char*>(arena_.alloc(n, 1));
+			*pstr = q;
+			*psize = toSize(json_local::unescape(q, top, top + n));
+		} else {
+			*pstr = top;
+			*psize = toSize(n);
+		}
+	}
+	void parseKey()
+	{
+		skipSpace();
+		if (p_ == end_ || *p_ != '"') throw cybozu::Exception("json:parseKey:no key");
+		p_++;
+		Member m;
+		parseString(&m.key, &m.keySize);
+		skipSpace();
+		if (p_ == end_ || *p_ != ':') throw cybozu::Exception("json:parseKey:no colon");
+		p_++;
+		members_.push_back(m);
+	}
+	void expect(const char *str, size_t n)
+	{
+		if (size_t(end_ - p_) < n || memcmp(p_, str, n) != 0) throw cybozu::Exception("json:expect:bad literal");
+		p_ += n;
+	}
+	/*
+		parse a scalar into v or open object/array until a value is found
+	*/
+	void parseValue(Node& v)
+	{
+		for (;;) {
+			skipSpace();
+			if (p_ == end_) throw cybozu::Exception("json:parseValue:no value");
+			const char c = *p_++;
+			v.size_ = 0;
+			switch (c) {
+			case '{':
+				skipSpace();
+				if (p_ < end_ && *p_ == '}') {
+					p_++;
+					makeObject(v, members_.size());
+					return;
+				}
+				pushFrame('{', members_.size());
+				parseKey();
+				continue;
+			case '[':
+				skipSpace();
+				if (p_ < end_ && *p_ == ']') {
+					p_++;
+					makeArray(v, elems_.size());
+					return;
+				}
+				pushFrame('[', elems_.size());
+				continue;
+			case '"':
+				v.type_ = Json::T_String;
+				parseString(&v.str_, &v.size_);
+				return;
+			case 't':
+				expect("rue", 3);
+				v.type_ = Json::T_Bool;
+				v.b_ = true;
+				return;
+			case 'f':
+				expect("alse", 4);
+				v.type_ = Json::T_Bool;
+				v.b_ = false;
+				return;
+			case 'n':
+				expect("ull", 3);
+				v.type_ = Json::T_Null;
+				v.str_ = 0;
+				return;
+			default:
+				if (c == '-' || json_local::isDigit(c)) {
+					const char *top = p_ - 1;
+					p_ = json_local::scanNumber(top, end_);
+					v.type_ = Json::T_Number;
+					if (json_local::toNumber(&v.int_, &v.num_, top, p_ - top)) v.size_ = 1;
+					return;
+				}
+				throw cybozu::Exception("json:parseValue:bad char") << c;
+			}
+		}
+	}
+	cybozu::Arena arena_;
+	Node root_;
+	const char *begin_;
+	const char *p_;
+	const char *end_;
+	std::vector<Node> elems_;
+	std::vector<Member> members_;
+	std::vector<Frame> frames_;
+};
+
+/**
+	json writer
+	output is accumulated in an internal buffer and written to OutputStream
+	it has the same methods as Handler of JsonReaderT
+	so JsonReaderT can write to JsonWriterT directly
+	@note call flush() before using the output
+*/
+template<class OutputStream, size_t maxBufSize = 4096>
+class JsonWriterT {
+	JsonWriterT(const JsonWriterT&);
+	void operator=(const JsonWriterT&);
+public:
+	explicit JsonWriterT(OutputStream& os)
+		: os_(os)
+		, pos_(0)
+		, depth_(0)
+		, needComma_(false)
+		, afterKey_(false)
+	{
+	}
+	~JsonWriterT()
+	{
+		try {
+			flush();
+		} catch (std::exception& e) {
+			fprintf(stderr, "json:JsonWriterT:flush:exception:%s\n", e.what());
+		} catch (...) {
+			fprintf(stderr, "json:JsonWriterT:flush:unknown exception\n");
+		}
+	}
+	/**
+		write buffered data to OutputStream
+	*/
+	void flush()
+	{
+		if (pos_ == 0) return;
+		cybozu::write(os_, buf_, pos_);
+		pos_ = 0;
+	}
+	void startObject()
+	{
+		beginValue();
+		putChar('{');
+		depth_++;
+		needComma_ = false;
+	}
+	void endObject()
+	{
+		putChar('}');
+		depth_--;
+		endValue();
+	}
+	void startArray()
+	{
+		beginValue();
+		putChar('[');
+		depth_++;
+		needComma_ = false;
+	}
+	void endArray()
+	{
+		putChar(']');
+		depth_--;
+		endValue();
+	}
+	void key(const char *str, size_t size)
+	{
+		if (needComma_) putChar(',');
+		putString(str, size);
+		putChar(':');
+		afterKey_ = true;
+	}
+	void key(const std::string& str) { key(str.c_str(), str.size()); }
+	void string(const char *str, size_t size)
+	{
+		beginValue();
+		putString(str, size);
+		endValue();
+	}
+	void string(const std::string& str) { string(str.c_str(), str.size()); }
+	/**
+		@note throw exception if x is NaN or infinity
+	*/
+	void number(double x)
+	{
+		if (!json_local::isFinite(x)) throw cybozu::Exception("json:JsonWriterT:number:not finite") << x;
+		beginValue();
+		char *p = reserve(32);
+		pos_ += cybozu::dtoa(p, 32, x);
+		endValue();
+	}
+	void integer(int64_t x)
+	{
+		beginValue();
+		char tmp[24];
+		const size_t n = itoa_local::intToDec(tmp, sizeof(tmp), x);
+		putStr(tmp + sizeof(tmp) - n, n);
+		endValue();
+	}
+	void boolean(bool b)
+	{
+		beginValue();
+		if (b) {
+			putStr("true", 4);
+		} else {
+			putStr("false", 5);
+		}
+		endValue();
+	}
+	void null()
+	{
+		beginValue();
+		putStr("null", 4);
+		endValue();
+	}
+	void put(const Json::Value& v)
+	{
+		switch (v.type_) {
+		case Json::T_Null:
+			null();
+			break;
+		case Json::T_String:
+			string(v.getString());
+			break;
+		case Json::T_Object:
+			startObject();
+			for (Json::Object::const_iterator i = v.getObject().begin(), ie = v.getObject().end(); i != ie; ++i) {
+				key(i->first);
+				put(i->second);
+			}
+			endObject();
+			break;
+		case Json::T_Array:
+			startArray();
+			for (size_t i = 0, n = v.getArray().size(); i < n; i++) {
+				put(v.getArray()[i]);
+			}
+			endArray();
+			break;
+		case Json::T_Number:
+			number(v.getNumber());
+			break;
+		case Json::T_Bool:
+			boolean(v.getBool());
+			break;
+		}
+	}
+	void put(const JsonDocument::Node& v)
+	{
+		switch (v.type_) {
+		case Json::T_Null:
+			null();
+			break;
+		case Json::T_String:
+			string(v.getStr(), v.size());
+			break;
+		case Json::T_Object:
+			startObject();
+			for (const JsonDocument::Member *i = v.memberBegin(), *ie = v.memberEnd(); i != ie; ++i) {
+				key(i->key, i->keySize);
+				put(i->val);
+			}
+			endObject();
+			break;
+		case Json::T_Array:
+			startArray();
+			for (size_t i = 0, n = v.size(); i < n; i++) {
+				put(v[i]);
+			}
+			endArray();
+			break;
+		case Json::T_Number:
+			if (v.isInt()) {
+				integer(v.getInt());
+			} else {
+				number(v.getNumber());
+			}
+			break;
+		case Json::T_Bool:
+			boolean(v.getBool());
+			break;
+		}
+	}
+private:
+	void beginValue()
+	{
+		if (afterKey_) {
+			afterKey_ = false;
+		} else if (needComma_) {
+			putChar(',');
+		}
+	}
+	void endValue()
+	{
+		// separate values in an object or array
+		needComma_ = depth_ > 0;
+	}
+	/*
+		return buffer which has size bytes at least
+		@note size <= maxBufSize
+	*/
+	char *reserve(size_t size)
+	{
+		if (maxBufSize - pos_ < size) flush();
+		return buf_ + pos_;
+	}
+	void putChar(char c)
+	{
+		if (pos_ == maxBufSize) flush();
+		buf_[pos_++] = c;
+	}
+	void putStr(const char *str, size_t size)
+	{
+		if (maxBufSize - pos_ < size) {
+			flush();
+			if (size > maxBufSize) {
+				cybozu::write(os_, str, size);
+				return;
+			}
+		}
+		memcpy(buf_ + pos_, str, size);
+		pos_ += size;
+	}
+	void putString(const char *str, size_t size)
+	{
+		static const char hexTbl[] = "0123456789abcdef";
+		const char *const end = str + size;
+		putChar('"');
+		for (;;) {
+			const char *p = json_local::findStringSpecial(str, end);
+			putStr(str, p - str);
+			if (p == end) break;
+			const unsigned char c = static_cast<unsigned char>(*p);
+			char *q = reserve(6);
+			q[0] = '\\';
+			switch (c) {
+			case '"': q[1] = '"'; pos_ += 2; break;
+			case '\\': q[1] = '\\'; pos_ += 2; break;
+			case '\b': q[1] = 'b'; pos_ += 2; break;
+			case '\f': q[1] = 'f'; pos_ += 2; break;
+			case '\n': q[1] = 'n'; pos_ += 2; break;
+			case '\r': q[1] = 'r'; pos_ += 2; break;
+			case '\t': q[1] = 't'; pos_ += 2; break;
+			default:
+				q[1] = 'u';
+				q[2] = '0';
+				q[3] = '0';
+				q[4] = hexTbl[c >> 4];
+				q[5] = hexTbl[c & 15];
+				pos_ += 6;
+				break;
+			}
+			str = p + 1;
+		}
+		putChar('"');
+	}
+	OutputStream& os_;
+	char buf_[maxBufSize];
+	size_t pos_;
+	size_t depth_;
+	bool needComma_;
+	bool afterKey_;
+};
 
 } // cybozu
@@ -42,16 +42,24 @@ public:
 	{
 		closeFile();
 	}
+	bool isEnabled(LogPriority priority) const
+	{
+		return priority >= priority_;
+	}
 	void put(LogPriority priority, const std::string& str)
+	{
+		put(priority, str.c_str());
+	}
+	void put(LogPriority priority, const char *str)
 	{
 		if (priority < priority_) return;
 		if (fp_) {
 			cybozu::Time cur(true);
-			if (fprintf(fp_, "%s %s\n", cur.toString(useMsec_).c_str(), str.c_str()) < 0) {
-				fprintf(stderr, "ERR:cybozu:Logger:put:fprintf:%s\n", str.c_str());
+			if (fprintf(fp_, "%s %s\n", cur.toString(useMsec_).c_str(), str) < 0) {
+				fprintf(stderr, "ERR:cybozu:Logger:put:fprintf:%s\n", str);
 			}
 			if (fflush(fp_) < 0) {
-				fprintf(stderr, "ERR:cybozu:Logger:put:fflush:%s\n", str.c_str());
+				fprintf(stderr, "ERR:cybozu:Logger:put:fflush:%s\n", str);
 			}
 		}
 		if (useSyslog_) {
@@ -64,7 +72,7 @@ public:
 			} else if (priority == LogWarning) {
 				pri = LOG_WARNING;
 			}
-			::syslog(pri, "%s\n", str.c_str());
+			::syslog(pri, "%s\n", str);
 #endif
 		}
 	}
@@ -205,8 +213,45 @@ inline void PutLog(LogPriority priority, const char *format, ...) CYBOZU_NOEXCEP
 	fprintf(stderr, "faital error in cybozu::PutLog\n");
 }
 
+#if CYBOZU_CPP_VERSION >= CYBOZU_CPP_VERSION_CPP11
+/*
+	write log with the format of cybozu::formatTo such as "x={}"
+	the message is formatted only if the priority is enabled
+	a short message is formatted in a stack buffer without memory allocation
+	@note use CYBOZU_PUT_LOG to check the format at compile time
+*/
+template<class... Args>
+void PutLogFormat(LogPriority priority, const char *format, const Args&... args) CYBOZU_NOEXCEPT
+	try
+{
+	log_local::Logger& logger = log_local::Logger::getInstance();
+	if (!logger.isEnabled(priority)) return;
+	char buf[1024];
+	const size_t n = cybozu::formatTo(buf, sizeof(buf) - 1, format, args...);
+	if (n < sizeof(buf)) {
+		buf[n] = '\0';
+		logger.put(priority, buf);
+	} else {
+		std::string str;
+		cybozu::formatTo(str, format, args...);
+		logger.put(priority, str);
+	}
+} catch (std::exception& e) {
+	fprintf(stderr, "faital error in cybozu::PutLogFormat %s\n", e.what());
+} catch (...) {
+	fprintf(stderr, "faital error in cybozu::PutLogFormat\n");
+}
+#endif
+
 } // cybozu
 
+#if CYBOZU_CPP_VERSION >= CYBOZU_CPP_VERSION_CPP11
+/*
+	CYBOZU_PUT_LOG(priority, format, args...)
+*/
+#define CYBOZU_PUT_LOG(priority, ...) (CYBOZU_FORMAT_CHECK(__VA_ARGS__), cybozu::PutLogFormat(priority, __VA_ARGS__))
+#endif
+
 namespace cybozu {
 /*
 	write log like std::cout
@@ -7,10 +7,14 @@
 */
 
 #include <assert.h>
+#include <string.h>
 #include <cybozu/exception.hpp>
+#include <cybozu/stream.hpp>
 #include <map>
 #include <istream>
 #include <list>
+#include <vector>
+#include <algorithm>
 
 namespace cybozu {
 
@@ -449,4 +453,309 @@ public:
 	}
 };
 
+
+/**
+	streaming(pull-style) xml reader
+	memory usage is bounded by the largest token, not by the document
+	name and value returned by the methods refer to the internal buffer
+	and they are valid until the next call of next()
+	@note the value is not unescaped ; use getUnescapedValue() if necessary
+	@note <?...?>, <!--...--> and <!...> are skipped
+	@note a text of only white spaces is skipped
+*/
+template<class InputStream>
+class XmlReaderT {
+	XmlReaderT(const XmlReaderT&);
+	void operator=(const XmlReaderT&);
+public:
+	enum Type {
+		T_StartTag, // <name
+		T_Attribute, // key="value"
+		T_Text, // text or <![CDATA[text]]>
+		T_EndTag, // </name> or />
+		T_End // end of stream
+	};
+	/**
+		@param is [in] input stream
+		@param maxTokenSize [in] max size of a tag or a text
+	*/
+	explicit XmlReaderT(InputStream& is, size_t maxTokenSize = 16 * 1024 * 1024)
+		: is_(is)
+		, buf_(std::min<size_t>(64 * 1024, maxTokenSize))
+		, tok_(0)
+		, pos_(0)
+		, end_(0)
+		, maxTokenSize_(maxTokenSize)
+		, eof_(false)
+		, inTag_(false)
+		, popName_(false)
+		, name_(0)
+		, nameSize_(0)
+		, value_(0)
+		, valueSize_(0)
+	{
+	}
+	/**
+		read the next event
+	*/
+	Type next()
+	{
+		if (popName_) {
+			popName_ = false;
+			nameStack_.resize(nameStackPos_.back());
+			nameStackPos_.pop_back();
+		}
+		if (inTag_) {
+			Type type;
+			if (parseInTag(&type)) return type;
+		}
+		for (;;) {
+			tok_ = pos_;
+			int c = charAt(0);
+			if (c < 0) {
+				if (!nameStackPos_.empty()) throw cybozu::Exception("xml:XmlReaderT:no end tag") << std::string(nameStack_, nameStackPos_.back());
+				return T_End;
+			}
+			if (c != '<') {
+				size_t n = find(0, '<');
+				if (n == npos) n = end_ - tok_;
+				pos_ = tok_ + n;
+				if (isSpaceOnly(&buf_[tok_], n)) continue;
+				setValue(0, n);
+				return T_Text;
+			}
+			c = charAt(1);
+			if (c == '/') {
+				const size_t e = scanName(2);
+				const size_t n = skipSpace(e);
+				if (charAt(n) != '>') throw cybozu::Exception("xml:XmlReaderT:bad end tag");
+				pos_ = tok_ + n + 1;
+				const std::string name(&buf_[tok_ + 2], e - 2);
+				if (nameStackPos_.empty() || nameStack_.compare(nameStackPos_.back(), std::string::npos, name) != 0) {
+					throw cybozu::Exception("xml:XmlReaderT:end tag does not match") << name;
+				}
+				return endTag();
+			}
+			if (c == '?') {
+				skipTo(2, "?>");
+				continue;
+			}
+			if (c == '!') {
+				if (startsWith(2, "--")) {
+					skipTo(4, "-->");
+					continue;
+				}
+				if (startsWith(2, "[CDATA[")) {
+					const size_t n = skipTo(9, "]]>");
+					setValue(9, n - 9);
+					return T_Text;
+				}
+				skipTo(2, ">");
+				continue;
+			}
+			const size_t e = scanName(1);
+			if (e == 1) throw cybozu::Exception("xml:XmlReaderT:empty tag name");
+			nameStackPos_.push_back(nameStack_.size());
+			nameStack_.append(&buf_[tok_ + 1], e - 1);
+			pos_ = tok_ + e;
+			inTag_ = true;
+			setName();
+			return T_StartTag;
+		}
+	}
+	/**
+		name of tag or attribute
+	*/
+	const char *getName() const { return name_; }
+	size_t getNameSize() const { return nameSize_; }
+	std::string getNameStr() const { return std::string(name_, nameSize_); }
+	/**
+		value of attribute or text
+	*/
+	const char *getValue() const { return value_; }
+	size_t getValueSize() const { return valueSize_; }
+	std::string getValueStr() const { return std::string(value_, valueSize_); }
+	std::string getUnescapedValue() const { return minixml::unescape(getValueStr()); }
+	/**
+		depth of the current element(the root element is 1)
+	*/
+	size_t getDepth() const { return nameStackPos_.size(); }
+private:
+	static const size_t npos = size_t(-1);
+	/*
+		parse attribute or the end of start tag
+		return false if the start tag is closed by '>'
+	*/
+	bool parseInTag(Type *type)
+	{
+		tok_ = pos_;
+		size_t n = skipSpace(0);
+		int c = charAt(n);
+		if (c == '>') {
+			pos_ = tok_ + n + 1;
+			inTag_ = false;
+			return false;
+		}
+		if (c == '/') {
+			if (charAt(n + 1) != '>') throw cybozu::Exception("xml:XmlReaderT:bad tag char");
+			pos_ = tok_ + n + 2;
+			inTag_ = false;
+			*type = endTag();
+			return true;
+		}
+		if (c < 0) throw cybozu::Exception("xml:XmlReaderT:tag is not complete");
+		const size_t keyBegin = n;
+		const size_t keyEnd = scanName(keyBegin);
+		if (keyEnd == keyBegin) throw cybozu::Exception("xml:XmlReaderT:bad key") << char(c);
+		n = skipSpace(keyEnd);
+		if (charAt(n) != '=') throw cybozu::Exception("xml:XmlReaderT:no equal");
+		n = skipSpace(n + 1);
+		const int q = charAt(n);
+		if (!minixml::isQuote(char(q))) throw cybozu::Exception("xml:XmlReaderT:no quote");
+		const size_t valBegin = n + 1;
+		const size_t valEnd = find(valBegin, char(q));
+		if (valEnd == npos) throw cybozu::Exception("xml:XmlReaderT:no end quote");
+		pos_ = tok_ + valEnd + 1;
+		name_ = &buf_[tok_ + keyBegin];
+		nameSize_ = keyEnd - keyBegin;
+		setValue(valBegin, valEnd - valBegin);
+		*type = T_Attribute;
+		return true;
+	}
+	Type endTag()
+	{
+		setName();
+		popName_ = true;
+		return T_EndTag;
+	}
+	void setName()
+	{
+		const size_t top = nameStackPos_.back();
+		name_ = &nameStack_[top];
+		nameSize_ = nameStack_.size() - top;
+	}
+	/*
+		offsets are relative to tok_
+	*/
+	void setValue(size_t offset, size_t size)
+	{
+		value_ = &buf_[tok_ + offset];
+		valueSize_ = size;
+	}
+	static bool isSpaceOnly(const char *p, size_t n)
+	{
+		for (size_t i = 0; i < n; i++) {
+			if (!minixml::isSpace(p[i])) return false;
+		}
+		return true;
+	}
+	/*
+		read data keeping [tok_, end_)
+		return false if eof
+	*/
+	bool fill()
+	{
+		if (eof_) return false;
+		if (tok_ > 0) {
+			memmove(&buf_[0], &buf_[tok_], end_ - tok_);
+			end_ -= tok_;
+			pos_ -= tok_;
+			tok_ = 0;
+		}
+		if (end_ == buf_.size()) {
+			if (buf_.size() >= maxTokenSize_) throw cybozu::Exception("xml:XmlReaderT:too large token") << maxTokenSize_;
+			buf_.resize(std::min(buf_.size() * 2, maxTokenSize_));
+		}
+		const size_t readSize = cybozu::readSome(&buf_[end_], buf_.size() - end_, is_);
+		if (readSize == 0) {
+			eof_ = true;
+			return false;
+		}
+		end_ += readSize;
+		return true;
+	}
+	/*
+		return -1 if eof
+	*/
+	int charAt(size_t offset)
+	{
+		while (tok_ + offset >= end_) {
+			if (!fill()) return -1;
+		}
+		return static_cast<unsigned char>(buf_[tok_ + offset]);
+	}
+	bool startsWith(size_t offset, const char *str)
+	{
+		for (size_t i = 0; str[i]; i++) {
+			if (charAt(offset + i) != static_cast<unsigned char>(str[i])) return false;
+		}
+		return true;
+	}
+	/*
+		return offset of c at or after offset
+		return npos if not found
+	*/
+	size_t find(size_t offset, char c)
+	{
+		for (;;) {
+			if (tok_ + offset < end_) {
+				const void *p = memchr(&buf_[tok_ + offset], c, end_ - tok_ - offset);
+				if (p) return static_cast<const char*>(p) - &buf_[tok_];
+				offset = end_ - tok_;
+			}
+			if (!fill()) return npos;
+		}
+	}
+	/*
+		skip to the end of str
+		return offset of str
+	*/
+	size_t skipTo(size_t offset, const char *str)
+	{
+		for (;;) {
+			const size_t n = find(offset, str[0]);
+			if (n == npos) throw cybozu::Exception("xml:XmlReaderT:not found") << str;
+			if (startsWith(n, str)) {
+				pos_ = tok_ + n + strlen(str);
+				return n;
+			}
+			offset = n + 1;
+		}
+	}
+	size_t skipSpace(size_t offset)
+	{
+		for (;;) {
+			int c = charAt(offset);
+			if (c < 0 || !minixml::isSpace(char(c))) return offset;
+			offset++;
+		}
+	}
+	/*
+		return the end of name
+	*/
+	size_t scanName(size_t offset)
+	{
+		for (;;) {
+			int c = charAt(offset);
+			if (c < 0 || c == '>' || c == '/' || !minixml::isName(char(c))) return offset;
+			offset++;
+		}
+	}
+	InputStream& is_;
+	std::vector<char> buf_;
+	size_t tok_; // top of the current token
+	size_t pos_; // next position to read
+	size_t end_;
+	const size_t maxTokenSize_;
+	bool eof_;
+	bool inTag_;
+	bool popName_;
+	std::string nameStack_;
+	std::vector<size_t> nameStackPos_;
+	const char *name_;
+	size_t nameSize_;
+	const char *value_;
+	size_t valueSize_;
+};
+
 } // cybozu
@@ -0,0 +1,974 @@
+#pragma once
+/**
+	@file
+	@brief non-backtracking regex for cybozu::String
+
+	@author MITSUNARI Shigeo(@herumi)
+	@note
+	the pattern is compiled into a Thompson NFA and executed by Pike VM,
+	so the time is O(pattern size * text size) for any input,
+	and O(pattern size * number of groups * text size) if the match result is requested.
+	ECMAScript syntax except backreferences and lookaround is supported:
+	. [] [^] \d \D \w \W \s \S \b \B ^ $ | () (?:) * + ? {n} {n,} {n,m}
+	and lazy quantifiers.
+*/
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <cybozu/string.hpp>
+
+namespace cybozu {
+
+namespace nfa_regex_local {
+
+enum Op {
+	O_Char,
+	O_Any,
+	O_Class,
+	O_Split, // x has priority over y
+	O_Jmp,
+	O_Save,
+	O_Bol,
+	O_Eol,
+	O_WordB,
+	O_NotWordB,
+	O_Match
+};
+
+struct Inst {
+	Op op;
+	uint32_t x;
+	uint32_t y;
+	Char c;
+	Inst(Op op, uint32_t x = 0, uint32_t y = 0, Char c = 0) : op(op), x(x), y(y), c(c) {}
+};
+
+const size_t maxInstNum = 100000;
+const size_t maxCapSlotNum = size_t(1) << 22; // pattern size * 2 * (number of groups + 1)
+const size_t maxRepeat = 1000;
+const int maxDepth = 1000;
+const size_t npos = size_t(-1);
+const Char maxChar = 0x10ffff;
+
+inline bool isWordChar(Char c)
+{
+	return ('0' <= c && c <= '9') || ('a' <= c && c <= 'z') || ('A' <= c && c <= 'Z') || c == '_';
+}
+
+inline bool isLineTerminator(Char c)
+{
+	return c == '\n' || c == '\r' || c == 0x2028 || c == 0x2029;
+}
+
+inline Char fold(Char c)
+{
+	return cybozu::tolower(c);
+}
+
+class CharClass {
+	typedef std::pair<Char, Char> Range;
+	std::vector<Range> range_; // sorted and merged [first, second]
+	bool negate_;
+	bool has(Char c) const
+	{
+		std::vector<Range>::const_iterator i = std::upper_bound(range_.begin(), range_.end(), Range(c, maxChar));
+		return i != range_.begin() && c <= (i - 1)->second;
+	}
+public:
+	CharClass() : negate_(false) {}
+	void setNegate(bool negate) { negate_ = negate; }
+	void add(Char a, Char b) { range_.push_back(Range(a, b)); }
+	void add(Char c) { add(c, c); }
+	/*
+		add [\d\w\s] and complement if negate
+	*/
+	void addEscape(char type, bool negate)
+	{
+		CharClass t;
+		switch (type) {
+		case 'd':
+			t.add('0', '9');
+			break;
+		case 'w':
+			t.add('0', '9'); t.add('A', 'Z'); t.add('_'); t.add('a', 'z');
+			break;
+		case 's':
+		default:
+			t.add('\t', '\r'); t.add(' '); t.add(0xa0); t.add(0x1680); t.add(0x2000, 0x200a);
+			t.add(0x2028, 0x2029); t.add(0x202f); t.add(0x205f); t.add(0x3000); t.add(0xfeff);
+			break;
+		}
+		if (!negate) {
+			range_.insert(range_.end(), t.range_.begin(), t.range_.end());
+			return;
+		}
+		Char prev = 0;
+		for (size_t i = 0; i < t.range_.size(); i++) {
+			if (prev < t.range_[i].first) add(prev, t.range_[i].first - 1);
+			prev = t.range_[i].second + 1;
+		}
+		add(prev, maxChar);
+	}
+	void normalize()
+	{
+		std::sort(range_.begin(), range_.end());
+		std::vector<Range> v;
+		for (size_t i = 0; i < range_.size(); i++) {
+			if (!v.empty() && range_[i].first <= v.back().second + 1) {
+				v.back().second = std::max(v.back().second, range_[i].second);
+			} else {
+				v.push_back(range_[i]);
+			}
+		}
+		range_.swap(v);
+	}
+	bool match(Char c, bool icase) const
+	{
+		bool b = has(c);
+		if (!b && icase) {
+			b = has(cybozu::tolower(c)) || has(cybozu::toupper(c));
+		}
+		return b != negate_;
+	}
+};
+
+struct Node {
+	enum Type {
+		N_Empty,
+		N_Char,
+		N_Any,
+		N_Class,
+		N_Cat,
+		N_Alt,
+		N_Repeat,
+		N_Group,
+		N_Bol,
+		N_Eol,
+		N_WordB,
+		N_NotWordB
+	};
+	Type type;
+	Char c; // char or index of class
+	int capIdx; // -1 if not capturing
+	size_t min;
+	size_t max; // npos means infinity
+	bool greedy;
+	std::vector<uint32_t> child;
+	explicit Node(Type type, Char c = 0) : type(type), c(c), capIdx(-1), min(0), max(0), greedy(true) {}
+};
+
+class Parser {
+	const Char *p_;
+	const Char *end_;
+	std::vector<Node>& nodes_;
+	std::vector<CharClass>& cls_;
+	int capNum_;
+	int depth_;
+	uint32_t newNode(const Node& node)
+	{
+		nodes_.push_back(node);
+		return static_cast<uint32_t>(nodes_.size() - 1);
+	}
+	uint32_t newClass(const CharClass& cc)
+	{
+		cls_.push_back(cc);
+		cls_.back().normalize();
+		return newNode(Node(Node::N_Class, Char(cls_.size() - 1)));
+	}
+	bool eof() const { return p_ == end_; }
+	static bool isDigit(Char c) { return '0' <= c && c <= '9'; }
+	static int hexToInt(Char c)
+	{
+		if ('0' <= c && c <= '9') return c - '0';
+		if ('a' <= c && c <= 'f') return c - 'a' + 10;
+		if ('A' <= c && c <= 'F') return c - 'A' + 10;
+		return -1;
+	}
+	Char getHex(int n)
+	{
+		uint32_t v = 0;
+		for (int i = 0; i < n; i++) {
+			const int d = eof() ? -1 : hexToInt(*p_);
+			if (d < 0) throw cybozu::Exception("nfa_regex:bad hex escape");
+			v = v * 16 + d;
+			p_++;
+		}
+		return Char(v);
+	}
+	/*
+		parse an escape after '\' which represents one char
+	*/
+	Char parseEscapeChar()
+	{
+		const Char c = *p_++;
+		switch (c) {
+		case 't': return '\t';
+		case 'n': return '\n';
+		case 'r': return '\r';
+		case 'f': return '\f';
+		case 'v': return '\v';
+		case '0': return 0;
+		case 'x': return getHex(2);
+		case 'u': return getHex(4);
+		default:
+			if (isDigit(c)) throw cybozu::Exception("nfa_regex:backreference is not supported");
+			return c;
+		}
+	}
+	static bool isClassEscape(Char c)
+	{
+		return c == 'd' || c == 'D' || c == 'w' || c == 'W' || c == 's' || c == 'S';
+	}
+	static char toLowerClassEscape(Char c)
+	{
+		return static_cast<char>(cybozu::tolower(c));
+	}
+	uint32_t parseClass()
+	{
+		CharClass cc;
+		if (!eof() && *p_ == '^') {
+			cc.setNegate(true);
+			p_++;
+		}
+		for (;;) {
+			if (eof()) throw cybozu::Exception("nfa_regex:missing ]");
+			Char c = *p_++;
+			if (c == ']') break;
+			if (c == '\\') {
+				if (eof()) throw cybozu::Exception("nfa_regex:bad escape");
+				if (isClassEscape(*p_)) {
+					const Char e = *p_++;
+					cc.addEscape(toLowerClassEscape(e), e != cybozu::tolower(e));
+					continue;
+				}
+				c = (*p_ == 'b') ? (p_++, Char('\b')) : parseEscapeChar();
+			}
+			if (end_ - p_ >= 2 && p_[0] == '-' && p_[1] != ']') {
+				p_++;
+				Char d = *p_++;
+				if (d == '\\') {
+					if (eof() || isClassEscape(*p_)) throw cybozu::Exception("nfa_regex:bad range");
+					d = parseEscapeChar();
+				}
+				if (d < c) throw cybozu::Exception("nfa_regex:bad range") << c << d;
+				cc.add(c, d);
+			} else {
+				cc.add(c);
+			}
+		}
+		return newClass(cc);
+	}
+	uint32_t parseAtom()
+	{
+		const Char c = *p_++;
+		switch (c) {
+		case '.':
+			return newNode(Node(Node::N_Any));
+		case '^':
+			return newNode(Node(Node::N_Bol));
+		case '$':
+			return newNode(Node(Node::N_Eol));
+		case '[':
+			return parseClass();
+		case '(':
+			{
+				int capIdx = -1;
+				if (!eof() && *p_ == '?') {
+					if (end_ - p_ >= 2 && p_[1] == ':') {
+						p_ += 2;
+					} else {
+						throw cybozu::Exception("nfa_regex:lookaround is not supported");
+					}
+				} else {
+					capIdx = ++capNum_;
+				}
+				if (++depth_ > maxDepth) throw cybozu::Exception("nfa_regex:too deep");
+				Node node(Node::N_Group);
+				node.capIdx = capIdx;
+				node.child.push_back(parseAlt());
+				depth_--;
+				if (eof() || *p_ != ')') throw cybozu::Exception("nfa_regex:missing )");
+				p_++;
+				return newNode(node);
+			}
+		case ')':
+			throw cybozu::Exception("nfa_regex:unmatched )");
+		case '*': case '+': case '?':
+			throw cybozu::Exception("nfa_regex:nothing to repeat");
+		case '\\':
+			{
+				if (eof()) throw cybozu::Exception("nfa_regex:bad escape");
+				const Char e = *p_;
+				if (isClassEscape(e)) {
+					p_++;
+					CharClass cc;
+					cc.addEscape(toLowerClassEscape(e), e != cybozu::tolower(e));
+					return newClass(cc);
+				}
+				if (e == 'b' || e == 'B') {
+					p_++;
+					return newNode(Node(e == 'b' ? Node::N_WordB : Node::N_NotWordB));
+				}
+				return newNode(Node(Node::N_Char, parseEscapeChar()));
+			}
+		default:
+			return newNode(Node(Node::N_Char, c));
+		}
+	}
+	bool parseNum(size_t *v)
+	{
+		if (eof() || !isDigit(*p_)) return false;
+		size_t x = 0;
+		while (!eof() && isDigit(*p_)) {
+			x = x * 10 + (*p_++ - '0');
+			if (x > maxRepeat) throw cybozu::Exception("nfa_regex:too large repeat");
+		}
+		*v = x;
+		return true;
+	}
+	/*
+		parse {n}, {n,}, {n,m}
+		@return false if it is not a quantifier(p_ is not changed)
+	*/
+	bool parseBrace(size_t *min, size_t *max)
+	{
+		const Char *save = p_;
+		p_++;
+		if (parseNum(min)) {
+			*max = *min;
+			if (!eof() && *p_ == ',') {
+				p_++;
+				if (!parseNum(max)) *max = npos;
+			}
+			if (!eof() && *p_ == '}') {
+				p_++;
+				if (*max < *min) throw cybozu::Exception("nfa_regex:bad repeat") << *min << *max;
+				return true;
+			}
+		}
+		p_ = save;
+		return false;
+	}
+	uint32_t parseRepeat()
+	{
+		uint32_t atom = parseAtom();
+		if (!eof()) {
+			size_t min, max;
+			const Char c = *p_;
+			if (c == '*') {
+				min = 0; max = npos; p_++;
+			} else if (c == '+') {
+				min = 1; max = npos; p_++;
+			} else if (c == '?') {
+				min = 0; max = 1; p_++;
+			} else if (c == '{' && parseBrace(&min, &max)) {
+			} else {
+				return atom;
+			}
+			const Node::Type t = nodes_[atom].type;
+			if (t == Node::N_Bol || t == Node::N_Eol || t == Node::N_WordB || t == Node::N_NotWordB) {
+				throw cybozu::Exception("nfa_regex:nothing to repeat");
+			}
+			Node node(Node::N_Repeat);
+			node.min = min;
+			node.max = max;
+			if (!eof() && *p_ == '?') {
+				node.greedy = false;
+				p_++;
+			}
+			node.child.push_back(atom);
+			atom = newNode(node);
+		}
+		return atom;
+	}
+	uint32_t parseCat()
+	{
+		Node node(Node::N_Cat);
+		while (!eof() && *p_ != '|' && *p_ != ')') {
+			node.child.push_back(parseRepeat());
+		}
+		if (node.child.empty()) return newNode(Node(Node::N_Empty));
+		if (node.child.size() == 1) return node.child[0];
+		return newNode(node);
+	}
+public:
+	Parser(const Char *begin, const Char *end, std::vector<Node>& nodes, std::vector<CharClass>& cls)
+		: p_(begin), end_(end), nodes_(nodes), cls_(cls), capNum_(0), depth_(0)
+	{
+	}
+	uint32_t parseAlt()
+	{
+		Node node(Node::N_Alt);
+		node.child.push_back(parseCat());
+		while (!eof() && *p_ == '|') {
+			p_++;
+			node.child.push_back(parseCat());
+		}
+		if (node.child.size() == 1) return node.child[0];
+		return newNode(node);
+	}
+	uint32_t parse()
+	{
+		const uint32_t root = parseAlt();
+		if (!eof()) throw cybozu::Exception("nfa_regex:unmatched )");
+		return root;
+	}
+	int getCapNum() const { return capNum_; }
+};
+
+class Compiler {
+	const std::vector<Node>& nodes_;
+	std::vector<Inst>& prog_;
+	bool icase_;
+	uint32_t emit(const Inst& inst)
+	{
+		if (prog_.size() >= maxInstNum) throw cybozu::Exception("nfa_regex:too large pattern");
+		prog_.push_back(inst);
+		return static_cast<uint32_t>(prog_.size() - 1);
+	}
+	uint32_t cur() const { return static_cast<uint32_t>(prog_.size()); }
+	/*
+		emit Split which prefers x if greedy
+	*/
+	uint32_t emitSplit(bool greedy, uint32_t x, uint32_t y)
+	{
+		return greedy ? emit(Inst(O_Split, x, y)) : emit(Inst(O_Split, y, x));
+	}
+	void patchSplit(uint32_t pc, bool greedy, uint32_t out)
+	{
+		if (greedy) {
+			prog_[pc].y = out;
+		} else {
+			prog_[pc].x = out;
+		}
+	}
+public:
+	Compiler(const std::vector<Node>& nodes, std::vector<Inst>& prog, bool icase)
+		: nodes_(nodes), prog_(prog), icase_(icase)
+	{
+	}
+	void compile(uint32_t idx)
+	{
+		const Node& node = nodes_[idx];
+		switch (node.type) {
+		case Node::N_Empty:
+			break;
+		case Node::N_Char:
+			emit(Inst(O_Char, 0, 0, icase_ ? fold(node.c) : node.c));
+			break;
+		case Node::N_Any:
+			emit(Inst(O_Any));
+			break;
+		case Node::N_Class:
+			emit(Inst(O_Class, static_cast<uint32_t>(node.c)));
+			break;
+		case Node::N_Bol:
+			emit(Inst(O_Bol));
+			break;
+		case Node::N_Eol:
+			emit(Inst(O_Eol));
+			break;
+		case Node::N_WordB:
+			emit(Inst(O_WordB));
+			break;
+		case Node::N_NotWordB:
+			emit(Inst(O_NotWordB));
+			break;
+		case Node::N_Cat:
+			for (size_t i = 0; i < node.child.size(); i++) compile(node.child[i]);
+			break;
+		case Node::N_Group:
+			if (node.capIdx >= 0) emit(Inst(O_Save, node.capIdx * 2));
+			compile(node.child[0]);
+			if (node.capIdx >= 0) emit(Inst(O_Save, node.capIdx * 2 + 1));
+			break;
+		case Node::N_Alt:
+			{
+				/*
+					split L1, L2
+					L1: e1; jmp end
+					L2: split L3, L4
+					...
+				*/
+				std::vector<uint32_t> jmp;
+				const size_t n = node.child.size();
+				for (size_t i = 0; i < n - 1; i++) {
+					const uint32_t split = emit(Inst(O_Split, cur() + 1));
+					compile(node.child[i]);
+					jmp.push_back(emit(Inst(O_Jmp)));
+					prog_[split].y = cur();
+				}
+				compile(node.child[n - 1]);
+				for (size_t i = 0; i < jmp.size(); i++) prog_[jmp[i]].x = cur();
+			}
+			break;
+		case Node::N_Repeat:
+			{
+				const uint32_t e = node.child[0];
+				for (size_t i = 0; i < node.min; i++) compile(e);
+				if (node.max == npos) {
+					// L: split body, end; body: e; jmp L
+					const uint32_t split = emitSplit(node.greedy, cur() + 1, 0);
+					compile(e);
+					emit(Inst(O_Jmp, split));
+					patchSplit(split, node.greedy, cur());
+				} else {
+					// (e(e(e)?)?)?
+					std::vector<uint32_t> splitList;
+					for (size_t i = node.min; i < node.max; i++) {
+						splitList.push_back(emitSplit(node.greedy, cur() + 1, 0));
+						compile(e);
+					}
+					for (size_t i = 0; i < splitList.size(); i++) patchSplit(splitList[i], node.greedy, cur());
+				}
+			}
+			break;
+		}
+	}
+};
+
+/*
+	set of pc with captures
+*/
+class ThreadList {
+	std::vector<uint32_t> dense_;
+	std::vector<uint32_t> sparse_;
+	std::vector<size_t> cap_;
+	size_t n_;
+	size_t capNum_;
+public:
+	ThreadList() : n_(0), capNum_(0) {}
+	/*
+		capNum may be 0 not to keep captures
+		memory is reused if possible
+	*/
+	void init(size_t progSize, size_t capNum)
+	{
+		dense_.resize(progSize);
+		sparse_.resize(progSize);
+		cap_.resize(progSize * capNum);
+		n_ = 0;
+		capNum_ = capNum;
+	}
+	bool contains(uint32_t pc) const
+	{
+		const uint32_t i = sparse_[pc];
+		return i < n_ && dense_[i] == pc;
+	}
+	void add(uint32_t pc)
+	{
+		sparse_[pc] = static_cast<uint32_t>(n_);
+		dense_[n_++] = pc;
+	}
+	void clear() { n_ = 0; }
+	bool empty() const { return n_ == 0; }
+	size_t size() const { return n_; }
+	uint32_t operator[](size_t i) const { return dense_[i]; }
+	size_t *getCap(uint32_t pc) { return capNum_ == 0 ? 0 : &cap_[pc * capNum_]; }
+	void swap(ThreadList& rhs)
+	{
+		dense_.swap(rhs.dense_);
+		sparse_.swap(rhs.sparse_);
+		cap_.swap(rhs.cap_);
+		std::swap(n_, rhs.n_);
+		std::swap(capNum_, rhs.capNum_);
+	}
+};
+
+} // nfa_regex_local
+
+/**
+	result of regex_search and regex_match for nfa_regex
+	@note str(), prefix() and suffix() refer to the searched text, which must outlive this object
+*/
+class nfa_smatch {
+	const Char *begin_;
+	const Char *end_;
+	std::vector<size_t> cap_; // [begin, end) of each group
+	friend class nfa_regex;
+public:
+	nfa_smatch() : begin_(0), end_(0) {}
+	/**
+		number of groups including the whole match(0 if not matched)
+	*/
+	size_t size() const { return cap_.size() / 2; }
+	bool empty() const { return cap_.empty(); }
+	bool matched(size_t sub = 0) const { return sub < size() && cap_[sub * 2] != nfa_regex_local::npos; }
+	/**
+		position of sub-th group in the text(npos if not matched)
+	*/
+	size_t position(size_t sub = 0) const { return matched(sub) ? cap_[sub * 2] : nfa_regex_local::npos; }
+	size_t length(size_t sub = 0) const { return matched(sub) ? cap_[sub * 2 + 1] - cap_[sub * 2] : 0; }
+	String str(size_t sub = 0) const
+	{
+		if (!matched(sub)) return String();
+		return String(begin_ + cap_[sub * 2], length(sub));
+	}
+	String prefix() const { return empty() ? String() : String(begin_, cap_[0]); }
+	String suffix() const { return empty() ? String() : String(begin_ + cap_[1], end_ - begin_ - cap_[1]); }
+};
+
+/**
+	regex which never backtracks
+	@note an object can be shared among threads after construction
+*/
+class nfa_regex {
+	std::vector<nfa_regex_local::Inst> prog_;
+	std::vector<nfa_regex_local::CharClass> cls_;
+	String prefix_; // literal prefix of all matches
+	size_t capNum_;
+	int flags_;
+	bool anchored_;
+	void init(const Char *begin, const Char *end)
+	{
+		using namespace nfa_regex_local;
+		std::vector<Node> nodes;
+		Parser parser(begin, end, nodes, cls_);
+		const uint32_t root = parser.parse();
+		capNum_ = parser.getCapNum() + 1;
+		Compiler compiler(nodes, prog_, (flags_ & icase) != 0);
+		prog_.push_back(Inst(O_Save, 0));
+		compiler.compile(root);
+		prog_.push_back(Inst(O_Save, 1));
+		prog_.push_back(Inst(O_Match));
+		// a thread list keeps captures for each pc
+		if (prog_.size() * capNum_ * 2 > maxCapSlotNum) throw cybozu::Exception("nfa_regex:too many groups") << mark_count() << prog_.size();
+		uint32_t pc = 1;
+		while (prog_[pc].op == O_Save) pc++;
+		anchored_ = prog_[pc].op == O_Bol && (flags_ & multiline) == 0;
+		if ((flags_ & icase) == 0) {
+			for (; prog_[pc].op == O_Char || prog_[pc].op == O_Save; pc++) {
+				if (prog_[pc].op == O_Char) prefix_ += prog_[pc].c;
+			}
+		}
+	}
+	bool isBol(const Char *text, size_t pos) const
+	{
+		return pos == 0 || ((flags_ & multiline) && nfa_regex_local::isLineTerminator(text[pos - 1]));
+	}
+	bool isEol(const Char *text, size_t n, size_t pos) const
+	{
+		return pos == n || ((flags_ & multiline) && nfa_regex_local::isLineTerminator(text[pos]));
+	}
+	static bool isWordB(const Char *text, size_t n, size_t pos)
+	{
+		const bool a = pos > 0 && nfa_regex_local::isWordChar(text[pos - 1]);
+		const bool b = pos < n && nfa_regex_local::isWordChar(text[pos]);
+		return a != b;
+	}
+	struct Entry {
+		uint32_t pc;
+		size_t capIdx; // npos if not restore
+		size_t val;
+		Entry(uint32_t pc, size_t capIdx = nfa_regex_local::npos, size_t val = 0) : pc(pc), capIdx(capIdx), val(val) {}
+	};
+public:
+	/*
+		work area of exec to be reused for repeated calls
+	*/
+	class Work {
+		friend class nfa_regex;
+		nfa_regex_local::ThreadList clist;
+		nfa_regex_local::ThreadList nlist;
+		std::vector<size_t> unset;
+		std::vector<size_t> result;
+		std::vector<size_t> cap;
+		std::vector<Entry> stack;
+	};
+private:
+	/*
+		add pc0 and all pc reachable by empty transitions from pc0
+		captures are not kept if capSize == 0
+	*/
+	void addThread(nfa_regex_local::ThreadList& list, uint32_t pc0, const Char *text, size_t n, size_t pos, const size_t *cap0, size_t capSize, Work& w) const
+	{
+		using namespace nfa_regex_local;
+		w.cap.assign(cap0, cap0 + capSize);
+		w.stack.clear();
+		w.stack.push_back(Entry(pc0));
+		while (!w.stack.empty()) {
+			const Entry e = w.stack.back();
+			w.stack.pop_back();
+			if (e.capIdx != npos) {
+				w.cap[e.capIdx] = e.val;
+				continue;
+			}
+			const uint32_t pc = e.pc;
+			if (list.contains(pc)) continue;
+			list.add(pc);
+			const Inst& inst = prog_[pc];
+			switch (inst.op) {
+			case O_Jmp:
+				w.stack.push_back(Entry(inst.x));
+				break;
+			case O_Split:
+				w.stack.push_back(Entry(inst.y));
+				w.stack.push_back(Entry(inst.x));
+				break;
+			case O_Save:
+				if (capSize > 0) {
+					w.stack.push_back(Entry(0, inst.x, w.cap[inst.x]));
+					w.cap[inst.x] = pos;
+				}
+				w.stack.push_back(Entry(pc + 1));
+				break;
+			case O_Bol:
+				if (isBol(text, pos)) w.stack.push_back(Entry(pc + 1));
+				break;
+			case O_Eol:
+				if (isEol(text, n, pos)) w.stack.push_back(Entry(pc + 1));
+				break;
+			case O_WordB:
+			case O_NotWordB:
+				if (isWordB(text, n, pos) == (inst.op == O_WordB)) w.stack.push_back(Entry(pc + 1));
+				break;
+			default:
+				std::copy(w.cap.begin(), w.cap.end(), list.getCap(pc));
+				break;
+			}
+		}
+	}
+	size_t findPrefix(const Char *text, size_t n, size_t pos) const
+	{
+		const Char *p = std::search(text + pos, text + n, prefix_.c_str(), prefix_.c_str() + prefix_.size());
+		return p == text + n ? nfa_regex_local::npos : size_t(p - text);
+	}
+public:
+	enum {
+		icase = 1, // ignore case of ASCII
+		multiline = 2 // ^ and $ match at line terminators
+	};
+	/**
+		compile pattern
+		@param pattern [in] regex
+		@param flags [in] icase, multiline
+	*/
+	explicit nfa_regex(const String& pattern, int flags = 0)
+		: capNum_(0), flags_(flags), anchored_(false)
+	{
+		const Char *p = pattern.c_str();
+		init(p, p + pattern.size());
+	}
+	nfa_regex(const Char *begin, const Char *end, int flags = 0)
+		: capNum_(0), flags_(flags), anchored_(false)
+	{
+		init(begin, end);
+	}
+	/**
+		number of capturing groups
+	*/
+	size_t mark_count() const { return capNum_ - 1; }
+	/**
+		search [text + start, text + n)
+		@param m [out] match result(may be 0)
+		@param full [in] whole text must match if true
+		@note positions in m are relative to text
+	*/
+	bool exec(nfa_smatch *m, const Char *text, size_t n, size_t start, bool full) const
+	{
+		Work w;
+		return exec(w, m, text, n, start, full);
+	}
+	/**
+		same as exec above with a work area which keeps memory for the next call
+		@note captures are not tracked if m is 0
+	*/
+	bool exec(Work& w, nfa_smatch *m, const Char *text, size_t n, size_t start, bool full) const
+	{
+		using namespace nfa_regex_local;
+		const size_t capSize = m ? capNum_ * 2 : 0;
+		ThreadList& clist = w.clist;
+		ThreadList& nlist = w.nlist;
+		clist.init(prog_.size(), capSize);
+		nlist.init(prog_.size(), capSize);
+		w.unset.assign(capSize, npos);
+		const size_t *unset = capSize > 0 ? &w.unset[0] : 0;
+		std::vector<size_t>& result = w.result;
+		result.clear();
+		bool matched = false;
+		const bool usePrefix = !full && !anchored_ && !prefix_.empty();
+		for (size_t pos = start;; pos++) {
+			if (!matched && (pos == start || !(full || anchored_))) {
+				if (clist.empty() && usePrefix) {
+					pos = findPrefix(text, n, pos);
+					if (pos == npos) break;
+				}
+				addThread(clist, 0, text, n, pos, unset, capSize, w);
+			}
+			if (clist.empty()) break;
+			nlist.clear();
+			const Char c = pos < n ? text[pos] : 0;
+			for (size_t i = 0; i < clist.size(); i++) {
+				const uint32_t pc = clist[i];
+				const Inst& inst = prog_[pc];
+				bool ok = false;
+				switch (inst.op) {
+				case O_Match:
+					if (full && pos != n) continue;
+					{
+						const size_t *cap = clist.getCap(pc);
+						result.assign(cap, cap + capSize);
+					}
+					matched = true;
+					// cut off lower priority threads
+					i = clist.size();
+					continue;
+				case O_Char:
+					ok = pos < n && ((flags_ & icase) ? fold(c) : c) == inst.c;
+					break;
+				case O_Any:
+					ok = pos < n && !isLineTerminator(c);
+					break;
+				case O_Class:
+					ok = pos < n && cls_[inst.x].match(c, (flags_ & icase) != 0);
+					break;
+				default:
+					break;
+				}
+				if (ok) addThread(nlist, pc + 1, text, n, pos + 1, clist.getCap(pc), capSize, w);
+			}
+			clist.swap(nlist);
+			if (pos >= n) break;
+		}
+		if (m) {
+			m->begin_ = text;
+			m->end_ = text + n;
+			if (matched) {
+				m->cap_.swap(result);
+			} else {
+				m->cap_.clear();
+			}
+		}
+		return matched;
+	}
+};
+
+namespace nfa_regex_local {
+
+inline const Char *toPtr(const String::const_iterator& begin, const String::const_iterator& end)
+{
+	return begin == end ? 0 : &*begin;
+}
+
+/*
+	append fmt to out with $&, $n, $nn, $$, $`, $'
+*/
+inline void appendFormat(String& out, const String& fmt, const nfa_smatch& m)
+{
+	for (size_t i = 0, n = fmt.size(); i < n; i++) {
+		const Char c = fmt[i];
+		if (c != '$' || i + 1 == n) {
+			out += c;
+			continue;
+		}
+		const Char d = fmt[i + 1];
+		if (d == '$') {
+			out += '$';
+			i++;
+		} else if (d == '&') {
+			out += m.str();
+			i++;
+		} else if (d == '`') {
+			out += m.prefix();
+			i++;
+		} else if (d == '\'') {
+			out += m.suffix();
+			i++;
+		} else if ('0' <= d && d <= '9') {
+			size_t sub = d - '0';
+			size_t len = 1;
+			if (i + 2 < n && '0' <= fmt[i + 2] && fmt[i + 2] <= '9') {
+				const size_t sub2 = sub * 10 + (fmt[i + 2] - '0');
+				if (sub2 < m.size()) {
+					sub = sub2;
+					len = 2;
+				}
+			}
+			if (sub == 0 || sub >= m.size()) {
+				out += c;
+				continue;
+			}
+			out += m.str(sub);
+			i += len;
+		} else {
+			out += c;
+		}
+	}
+}
+
+} // nfa_regex_local
+
+inline bool regex_search(const String::const_iterator begin, const String::const_iterator end, nfa_smatch& m, const nfa_regex& e)
+{
+	return e.exec(&m, nfa_regex_local::toPtr(begin, end), end - begin, 0, false);
+}
+
+inline bool regex_search(const String& s, nfa_smatch& m, const nfa_regex& e)
+{
+	return e.exec(&m, s.c_str(), s.size(), 0, false);
+}
+
+inline bool regex_search(const String& s, const nfa_regex& e)
+{
+	return e.exec(0, s.c_str(), s.size(), 0, false);
+}
+
+inline bool regex_search(const String::const_iterator begin, const String::const_iterator end, const nfa_regex& e)
+{
+	return e.exec(0, nfa_regex_local::toPtr(begin, end), end - begin, 0, false);
+}
+
+inline bool regex_match(const String::const_iterator begin, const String::const_iterator end, nfa_smatch& m, const nfa_regex& e)
+{
+	return e.exec(&m, nfa_regex_local::toPtr(begin, end), end - begin, 0, true);
+}
+
+inline bool regex_match(const String& s, nfa_smatch& m, const nfa_regex& e)
+{
+	return e.exec(&m, s.c_str(), s.size(), 0, true);
+}
+
+inline bool regex_match(const String::const_iterator begin, const String::const_iterator end, const nfa_regex& e)
+{
+	return e.exec(0, nfa_regex_local::toPtr(begin, end), end - begin, 0, true);
+}
+
+inline bool regex_match(const String& s, const nfa_regex& e)
+{
+	return e.exec(0, s.c_str(), s.size(), 0, true);
+}
+
+/**
+	replace all matches of e in [begin, end) by fmt
+	fmt may have $&, $1, ..., $99, $$, $`, $'
+*/
+inline String regex_replace(const String::const_iterator begin, const String::const_iterator end, const nfa_regex& e, const String& fmt)
+{
+	const Char *text = nfa_regex_local::toPtr(begin, end);
+	const size_t n = end - begin;
+	String result;
+	nfa_smatch m;
+	nfa_regex::Work w;
+	size_t pos = 0;
+	while (pos <= n && e.exec(w, &m, text, n, pos, false)) {
+		const size_t matchBegin = m.position();
+		const size_t len = m.length();
+		result.append(text + pos, matchBegin - pos);
+		nfa_regex_local::appendFormat(result, fmt, m);
+		pos = matchBegin + len;
+		if (len == 0) {
+			// avoid an infinite loop for an empty match
+			if (pos < n) result += text[pos];
+			pos++;
+		}
+	}
+	if (pos < n) result.append(text + pos, n - pos);
+	return result;
+}
+
+inline String regex_replace(const String& s, const nfa_regex& e, const String& fmt)
+{
+	return regex_replace(s.begin(), s.end(), e, fmt);
+}
+
+} // cybozu
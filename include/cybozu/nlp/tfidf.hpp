@@ -8,8 +8,14 @@
 #include <set>
 #include <map>
 #include <string>
+#include <vector>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
 #include <stdio.h>
+#include <math.h>
 #include <cybozu/string_operation.hpp>
+#include <cybozu/string_pool.hpp>
 #include <cybozu/nlp/sparse.hpp>
 
 namespace cybozu { namespace nlp {
@@ -55,39 +61,42 @@ struct Df {
 	};
 	typedef std::vector<Pair> PairVec;
 	int docNum_;
-	Str2Int word2id_;
-	StrVec id2word_;
+	cybozu::StringPool word2id_;
 	IntVec df_;
-	StrSet set_; // for one doc
+	IntVec lastDoc_; // the last doc where the word appears
 	PairVec pv_;
+	std::string lower_; // work area
 	Df()
 		: docNum_(0)
 	{
 	}
+	/*
+		a word is counted once in a doc after ToLower
+		so "The" and "the" in a doc make df of "the" one and df <= docNum
+	*/
 	void append(const std::string& word)
 	{
-		std::string lower;
-		cybozu::ToLower(lower, word);
-		std::pair<Str2Int::iterator, bool> ret = word2id_.insert(Str2Int::value_type(lower, (int)id2word_.size()));
-//printf("word=%s, id=%d, ret=%d\n", ret.first->first.c_str(), ret.first->second, ret.second);
-		if (ret.second) {
-			id2word_.push_back(lower);
-			df_.resize(id2word_.size());
+		cybozu::ToLower(lower_, word);
+		const uint32_t id = word2id_.intern(lower_);
+		if (id == df_.size()) {
+			df_.push_back(0);
+			lastDoc_.push_back(-1);
 		}
-		if (set_.insert(word).second) {
-			df_[ret.first->second]++;
+		// count a word once in a doc
+		if (lastDoc_[id] != docNum_) {
+			lastDoc_[id] = docNum_;
+			df_[id]++;
 		}
 	}
 	void endDoc()
 	{
 		docNum_++;
-		set_.clear();
 	}
 	// sort freq order
 	void term(int lowerLimit = 3, double upperRateLimit = 0.98)
 	{
 		fprintf(stderr, "#doc=%d, #word=%d\n", docNum_, (int)df_.size());
-		for (size_t i = 0, n = id2word_.size(); i < n; i++) {
+		for (size_t i = 0, n = df_.size(); i < n; i++) {
 			const int freq = df_[i];
 			if (freq <= lowerLimit) continue;
 			pv_.push_back(Pair(i, freq));
@@ -105,14 +114,13 @@ inline std::ostream& operator<<(std::ostream& os, const Df& df)
 	for (size_t i = 0, n = df.pv_.size(); i < n; i++) {
 		int freq = df.pv_[i].freq;
 		double idf = logN - log(double(freq));
-		os << df.id2word_[df.pv_[i].id] << '\t' << freq << '\t' << idf << std::endl;
+		os << df.word2id_.c_str(df.pv_[i].id) << '\t' << freq << '\t' << idf << std::endl;
 	}
 	return os;
 }
 
 struct TfIdf {
-	Str2Int word2id_;
-	StrVec id2word_;
+	cybozu::StringPool word2id_;
 	IntVec df_;
 	Int2IntVec tf_;
 
@@ -121,7 +129,8 @@ struct TfIdf {
 
 	// work area
 	Int2Int *curTf_;
-	StrSet set_; // for one doc
+	IntVec lastDoc_; // the last doc where the word appears
+	std::string lower_;
 
 	TfIdf()
 		: curTf_(0)
@@ -136,38 +145,38 @@ struct TfIdf {
 			size_t pos = word.find('\t');
 			if (pos == std::string::npos) break;
 			word.resize(pos);
-			std::pair<Str2Int::iterator, bool> ret = word2id_.insert(Str2Int::value_type(word, (int)id2word_.size()));
-			if (ret.second) {
-				id2word_.push_back(word);
+			if (word2id_.find(word) == cybozu::StringPool::none) {
+				word2id_.intern(word);
 			} else {
 				fprintf(stderr, "ERR already set %s\n", word.c_str());
 			}
 		}
-		df_.resize(id2word_.size());
+		df_.resize(word2id_.size());
+		lastDoc_.resize(word2id_.size(), -1);
 		fprintf(stderr, "#word = %d\n", (int)df_.size());
 		return true;
 	}
 
 	void append(const std::string& word)
 	{
-		std::string lower;
-		cybozu::ToLower(lower, word);
-		Str2Int::const_iterator i = word2id_.find(lower);
-		if (i == word2id_.end()) return;
-		const int id = i->second;
+		cybozu::ToLower(lower_, word);
+		const uint32_t id = word2id_.find(lower_);
+		if (id == cybozu::StringPool::none) return;
 		if (curTf_ == 0) {
 			tf_.push_back(Int2Int());
 			curTf_ = &tf_.back();
 		}
 		(*curTf_)[id]++;
-		if (set_.insert(lower).second) {
+		// count a word once in a doc
+		const int doc = (int)tf_.size() - 1;
+		if (lastDoc_[id] != doc) {
+			lastDoc_[id] = doc;
 			df_[id]++;
 		}
 	}
 	void endDoc()
 	{
 		curTf_ = 0;
-		set_.clear();
 	}
 	void put() const
 	{
@@ -177,7 +186,12 @@ struct TfIdf {
 			tf_[i].put();
 		}
 		puts("word:idx");
-		word2id_.put();
+		// in the order of words
+		Str2Int word2id;
+		for (uint32_t i = 0, n = (uint32_t)word2id_.size(); i < n; i++) {
+			word2id[word2id_.c_str(i)] = (int)i;
+		}
+		word2id.put();
 	}
 
 	void term()
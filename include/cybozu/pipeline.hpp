@@ -0,0 +1,260 @@
+#pragma once
+/**
+	@file
+	@brief pipeline stages of OutputStream (cipher, hash and thread)
+
+	@author MITSUNARI Shigeo(@herumi)
+	@license modified new BSD license
+	http://opensource.org/licenses/BSD-3-Clause
+*/
+#include <vector>
+#include <string>
+#include <string.h>
+#include <cybozu/stream.hpp>
+#include <cybozu/exception.hpp>
+#include <cybozu/thread.hpp>
+#include <cybozu/mutex.hpp>
+#include <cybozu/condition_variable.hpp>
+
+/*
+	a stage is an OutputStream which transforms data and writes it to the next OutputStream
+	so all stages process data in a single pass over buffers in cache
+	ZlibCompressorT in cybozu/zlib.hpp is also a stage
+
+	compress -> encrypt -> checksum -> (another thread) -> file
+	    cybozu::crypto::Cipher cipher(cybozu::crypto::Cipher::N_AES256_CTR);
+	    cybozu::crypto::Hash hash(cybozu::crypto::Hash::N_SHA256);
+	    typedef cybozu::AsyncOutputStreamT<cybozu::File> Async;
+	    typedef cybozu::HashOutputStreamT<Async, cybozu::crypto::Hash> Sum;
+	    typedef cybozu::CipherOutputStreamT<Sum, cybozu::crypto::Cipher> Enc;
+	    Async async(file);
+	    Sum sum(async, hash);
+	    Enc enc(sum, cipher);
+	    cybozu::ZlibCompressorT<Enc> z(enc);
+	    z.write(buf, size); ...
+	    z.flush(); // flush() of each stage calls flush() of the next one, so all stages and the thread are flushed
+	put AsyncOutputStreamT between stages to run the following stages on another thread
+*/
+
+namespace cybozu {
+
+/**
+	encrypt data by Cipher and write it to OutputStream
+	Cipher must have int update(char *out, const char *in, int inSize) such as crypto::Cipher and crypto::AesGcm
+	@note finalize Cipher by yourself after the last write
+*/
+template<class OutputStream, class Cipher>
+class CipherOutputStreamT {
+	OutputStream& os_;
+	Cipher& cipher_;
+	std::vector<char> buf_;
+	size_t bufSize_;
+	CipherOutputStreamT(const CipherOutputStreamT&);
+	void operator=(const CipherOutputStreamT&);
+public:
+	static const size_t blockSize = 16;
+	/**
+		@param os [in] output stream
+		@param cipher [in] initialized cipher
+		@param bufSize [in] data is encrypted bufSize bytes at a time
+	*/
+	CipherOutputStreamT(OutputStream& os, Cipher& cipher, size_t bufSize = 64 * 1024)
+		: os_(os)
+		, cipher_(cipher)
+		, buf_(bufSize + blockSize)
+		, bufSize_(bufSize)
+	{
+		if (bufSize == 0 || bufSize >= (1u << 30)) throw cybozu::Exception("CipherOutputStream:bad bufSize") << bufSize;
+	}
+	void write(const void *buf, size_t size)
+	{
+		const char *p = static_cast<const char*>(buf);
+		while (size > 0) {
+			const size_t n = size < bufSize_ ? size : bufSize_;
+			const int outSize = cipher_.update(&buf_[0], p, int(n));
+			if (outSize < 0) throw cybozu::Exception("CipherOutputStream:write:update") << n;
+			cybozu::OutputStreamTag<OutputStream>::write(os_, &buf_[0], size_t(outSize));
+			p += n;
+			size -= n;
+		}
+	}
+	void flush()
+	{
+		cybozu::OutputStreamTag<OutputStream>::flush(os_);
+	}
+};
+
+/**
+	update Hash by data and write it to OutputStream as is
+	Hash must have void update(const void *buf, size_t size) such as crypto::Hash, Sha256 and Sha256Tree
+*/
+template<class OutputStream, class Hash>
+class HashOutputStreamT {
+	OutputStream& os_;
+	Hash& hash_;
+	HashOutputStreamT(const HashOutputStreamT&);
+	void operator=(const HashOutputStreamT&);
+public:
+	HashOutputStreamT(OutputStream& os, Hash& hash)
+		: os_(os)
+		, hash_(hash)
+	{
+	}
+	void write(const void *buf, size_t size)
+	{
+		hash_.update(buf, size);
+		cybozu::OutputStreamTag<OutputStream>::write(os_, buf, size);
+	}
+	void flush()
+	{
+		cybozu::OutputStreamTag<OutputStream>::flush(os_);
+	}
+};
+
+/**
+	write data to OutputStream on another thread
+	data is copied into one of queueSize buffers of bufSize bytes
+	and write() waits while all buffers are waiting to be written
+	an exception of OutputStream is thrown by the next write() or flush()
+	@note the destructor writes the rest of data but ignores errors ; call flush() to check them
+*/
+template<class OutputStream>
+class AsyncOutputStreamT : private cybozu::ThreadBase {
+	struct Buffer {
+		std::vector<char> buf;
+		size_t size;
+	};
+	OutputStream& os_;
+	std::vector<Buffer> queue_;
+	const size_t bufSize_;
+	size_t head_; // the first buffer to be written
+	size_t num_; // number of buffers to be written
+	Buffer *cur_; // buffer being filled by write()
+	bool quit_;
+	std::string err_;
+	cybozu::Mutex mutex_;
+	cybozu::ConditionVariable notEmpty_;
+	cybozu::ConditionVariable notFull_;
+	AsyncOutputStreamT(const AsyncOutputStreamT&);
+	void operator=(const AsyncOutputStreamT&);
+	void threadEntry()
+	{
+		for (;;) {
+			Buffer *b;
+			bool hasErr;
+			{
+				cybozu::AutoLock al(mutex_);
+				while (num_ == 0 && !quit_) notEmpty_.wait(mutex_);
+				if (num_ == 0) return;
+				b = &queue_[head_];
+				hasErr = !err_.empty();
+			}
+			// discard data after an error so that write() does not wait forever
+			std::string err;
+			if (!hasErr) {
+				try {
+					cybozu::OutputStreamTag<OutputStream>::write(os_, &b->buf[0], b->size);
+				} catch (std::exception& e) {
+					err = e.what();
+					if (err.empty()) err = "exception";
+				} catch (...) {
+					err = "unknown exception";
+				}
+			}
+			{
+				cybozu::AutoLock al(mutex_);
+				if (!err.empty()) err_ = err;
+				head_ = (head_ + 1) % queue_.size();
+				num_--;
+				notFull_.notifyAll();
+			}
+		}
+	}
+	void throwIfError(const char *msg)
+	{
+		if (!err_.empty()) throw cybozu::Exception(msg) << err_;
+	}
+	/*
+		get an empty buffer
+	*/
+	void acquire()
+	{
+		cybozu::AutoLock al(mutex_);
+		while (num_ == queue_.size() && err_.empty()) notFull_.wait(mutex_);
+		throwIfError("AsyncOutputStream:write");
+		cur_ = &queue_[(head_ + num_) % queue_.size()];
+		cur_->size = 0;
+	}
+	/*
+		pass the current buffer to the thread
+	*/
+	void commit()
+	{
+		cybozu::AutoLock al(mutex_);
+		cur_ = 0;
+		num_++;
+		notEmpty_.notifyOne();
+	}
+public:
+	/**
+		@param os [in] output stream
+		@param bufSize [in] byte size of a buffer
+		@param queueSize [in] number of buffers
+	*/
+	AsyncOutputStreamT(OutputStream& os, size_t bufSize = 64 * 1024, size_t queueSize = 4)
+		: os_(os)
+		, queue_(queueSize)
+		, bufSize_(bufSize)
+		, head_(0)
+		, num_(0)
+		, cur_(0)
+		, quit_(false)
+	{
+		if (bufSize == 0 || queueSize == 0) throw cybozu::Exception("AsyncOutputStream:bad param") << bufSize << queueSize;
+		for (size_t i = 0; i < queueSize; i++) {
+			queue_[i].buf.resize(bufSize);
+			queue_[i].size = 0;
+		}
+		if (!beginThread()) throw cybozu::Exception("AsyncOutputStream:can't beginThread");
+	}
+	~AsyncOutputStreamT()
+	{
+		if (cur_ && cur_->size > 0) commit();
+		{
+			cybozu::AutoLock al(mutex_);
+			quit_ = true;
+			notEmpty_.notifyOne();
+		}
+		joinThread();
+	}
+	void write(const void *buf, size_t size)
+	{
+		const char *p = static_cast<const char*>(buf);
+		while (size > 0) {
+			if (cur_ == 0) acquire();
+			size_t n = bufSize_ - cur_->size;
+			if (n > size) n = size;
+			memcpy(&cur_->buf[cur_->size], p, n);
+			cur_->size += n;
+			p += n;
+			size -= n;
+			if (cur_->size == bufSize_) commit();
+		}
+	}
+	/**
+		wait until all data is written to OutputStream and flush it
+	*/
+	void flush()
+	{
+		if (cur_ && cur_->size > 0) commit();
+		{
+			cybozu::AutoLock al(mutex_);
+			while (num_ > 0) notFull_.wait(mutex_);
+			throwIfError("AsyncOutputStream:flush");
+		}
+		// the thread is idle while num_ == 0
+		cybozu::OutputStreamTag<OutputStream>::flush(os_);
+	}
+};
+
+} // cybozu
@@ -8,6 +8,7 @@
 */
 
 #include <cybozu/string.hpp>
+#include <cybozu/nfa_regex.hpp>
 
 #ifdef __GNUC__
 	#define CYBOZU_RE_USE_BOOST_REGEX
@@ -53,6 +53,42 @@ struct has_iterator {
     static const bool value = sizeof(test<T>(0)) == 1;
 };
 
+template<class T>
+struct is_container {
+	static const bool value = has_iterator<T>::value;
+};
+
+template<class T, class U>
+struct is_same {
+	static const bool value = false;
+};
+
+template<class T>
+struct is_same<T, T> {
+	static const bool value = true;
+};
+
+/*
+	detect a set by key_type == value_type
+	to distinguish unordered_set<K, Hash, Pred, Alloc> from map<K, V, Pred, Alloc>
+*/
+template<class T>
+struct is_set {
+	template<class U> static char test(typename stream_local::enable_if<is_same<typename U::key_type, typename U::value_type>::value>::type*);
+	template<class U> static int test(...);
+	static const bool value = sizeof(test<T>(0)) == 1;
+};
+
+template<class T>
+struct is_map4 {
+	static const bool value = is_container<T>::value && !is_set<T>::value;
+};
+
+template<class T>
+struct is_set4 {
+	static const bool value = is_container<T>::value && is_set<T>::value;
+};
+
 } // serializer_local
 
 template<class InputStream, class T>
@@ -265,7 +301,7 @@ void save(OutputStream& os, const char *x)
 
 // for vector, list
 template<class InputStream, class T, class Alloc, template<class T_, class Alloc_>class Container>
-void load(Container<T, Alloc>& x, InputStream& is, typename stream_local::enable_if<serializer_local::has_iterator<Container<T, Alloc> >::value>::type* = 0)
+void load(Container<T, Alloc>& x, InputStream& is, typename stream_local::enable_if<serializer_local::is_container<Container<T, Alloc> >::value>::type* = 0)
 {
 	size_t size;
 	load(size, is);
@@ -279,7 +315,7 @@ void load(Container<T, Alloc>& x, InputStream& is, typename stream_local::enable
 }
 
 template<class OutputStream, class T, class Alloc, template<class T_, class Alloc_>class Container>
-void save(OutputStream& os, const Container<T, Alloc>& x, typename stream_local::enable_if<serializer_local::has_iterator<Container<T, Alloc> >::value>::type* = 0)
+void save(OutputStream& os, const Container<T, Alloc>& x, typename stream_local::enable_if<serializer_local::is_container<Container<T, Alloc> >::value>::type* = 0)
 {
 	typedef Container<T, Alloc> V;
 	save(os, x.size());
@@ -290,7 +326,7 @@ void save(OutputStream& os, const Container<T, Alloc>& x, typename stream_local:
 
 // for set
 template<class InputStream, class K, class Pred, class Alloc, template<class K_, class Pred_, class Alloc_>class Container>
-void load(Container<K, Pred, Alloc>& x, InputStream& is, typename stream_local::enable_if<serializer_local::has_iterator<Container<K, Pred, Alloc> >::value>::type* = 0)
+void load(Container<K, Pred, Alloc>& x, InputStream& is, typename stream_local::enable_if<serializer_local::is_container<Container<K, Pred, Alloc> >::value>::type* = 0)
 {
 	size_t size;
 	load(size, is);
@@ -302,7 +338,7 @@ void load(Container<K, Pred, Alloc>& x, InputStream& is, typename stream_local::
 }
 
 template<class OutputStream, class K, class Pred, class Alloc, template<class K_, class Pred_, class Alloc_>class Container>
-void save(OutputStream& os, const Container<K, Pred, Alloc>& x, typename stream_local::enable_if<serializer_local::has_iterator<Container<K, Pred, Alloc> >::value>::type* = 0)
+void save(OutputStream& os, const Container<K, Pred, Alloc>& x, typename stream_local::enable_if<serializer_local::is_container<Container<K, Pred, Alloc> >::value>::type* = 0)
 {
 	typedef Container<K, Pred, Alloc> Set;
 	save(os, x.size());
@@ -313,7 +349,7 @@ void save(OutputStream& os, const Container<K, Pred, Alloc>& x, typename stream_
 
 // for map
 template<class InputStream, class K, class V, class Pred, class Alloc, template<class K_, class V_, class Pred_, class Alloc_>class Container>
-void load(Container<K, V, Pred, Alloc>& x, InputStream& is, typename stream_local::enable_if<serializer_local::has_iterator<Container<K, V, Pred, Alloc> >::value>::type* = 0)
+void load(Container<K, V, Pred, Alloc>& x, InputStream& is, typename stream_local::enable_if<serializer_local::is_map4<Container<K, V, Pred, Alloc> >::value>::type* = 0)
 {
 	typedef Container<K, V, Pred, Alloc> Map;
 	size_t size;
@@ -327,7 +363,7 @@ void load(Container<K, V, Pred, Alloc>& x, InputStream& is, typename stream_loca
 }
 
 template<class OutputStream, class K, class V, class Pred, class Alloc, template<class K_, class V_, class Pred_, class Alloc_>class Container>
-void save(OutputStream& os, const Container<K, V, Pred, Alloc>& x, typename stream_local::enable_if<serializer_local::has_iterator<Container<K, V, Pred, Alloc> >::value>::type* = 0)
+void save(OutputStream& os, const Container<K, V, Pred, Alloc>& x, typename stream_local::enable_if<serializer_local::is_map4<Container<K, V, Pred, Alloc> >::value>::type* = 0)
 {
 	typedef Container<K, V, Pred, Alloc> Map;
 	save(os, x.size());
@@ -339,7 +375,7 @@ void save(OutputStream& os, const Container<K, V, Pred, Alloc>& x, typename stre
 
 // unordered_map
 template<class InputStream, class K, class V, class Hash, class Pred, class Alloc, template<class K_, class V_, class Hash_, class Pred_, class Alloc_>class Container>
-void load(Container<K, V, Hash, Pred, Alloc>& x, InputStream& is, typename stream_local::enable_if<serializer_local::has_iterator<Container<K, V, Hash, Pred, Alloc> >::value>::type* = 0)
+void load(Container<K, V, Hash, Pred, Alloc>& x, InputStream& is, typename stream_local::enable_if<serializer_local::is_container<Container<K, V, Hash, Pred, Alloc> >::value>::type* = 0)
 {
 	typedef Container<K, V, Hash, Pred, Alloc> Map;
 	size_t size;
@@ -355,7 +391,7 @@ void load(Container<K, V, Hash, Pred, Alloc>& x, InputStream& is, typename strea
 }
 
 template<class OutputStream, class K, class V, class Hash, class Pred, class Alloc, template<class K_, class V_, class Hash_, class Pred_, class Alloc_>class Container>
-void save(OutputStream& os, const Container<K, V, Hash, Pred, Alloc>& x, typename stream_local::enable_if<serializer_local::has_iterator<Container<K, V, Hash, Pred, Alloc> >::value>::type* = 0)
+void save(OutputStream& os, const Container<K, V, Hash, Pred, Alloc>& x, typename stream_local::enable_if<serializer_local::is_container<Container<K, V, Hash, Pred, Alloc> >::value>::type* = 0)
 {
 	typedef Container<K, V, Hash, Pred, Alloc> Map;
 	save(os, x.size());
@@ -365,6 +401,31 @@ void save(OutputStream& os, const Container<K, V, Hash, Pred, Alloc>& x, typenam
 	}
 }
 
+// unordered_set and FlatHashSet in cybozu/unordered_set.hpp (FlatHashMap is saved as unordered_map)
+template<class InputStream, class K, class Hash, class Pred, class Alloc, template<class K_, class Hash_, class Pred_, class Alloc_>class Container>
+void load(Container<K, Hash, Pred, Alloc>& x, InputStream& is, typename stream_local::enable_if<serializer_local::is_set4<Container<K, Hash, Pred, Alloc> >::value>::type* = 0)
+{
+	size_t size;
+	load(size, is);
+	x.clear();
+	serializer_local::reserve_if_exists(x, size);
+	for (size_t i = 0; i < size; i++) {
+		K t;
+		load(t, is);
+		x.insert(t);
+	}
+}
+
+template<class OutputStream, class K, class Hash, class Pred, class Alloc, template<class K_, class Hash_, class Pred_, class Alloc_>class Container>
+void save(OutputStream& os, const Container<K, Hash, Pred, Alloc>& x, typename stream_local::enable_if<serializer_local::is_set4<Container<K, Hash, Pred, Alloc> >::value>::type* = 0)
+{
+	typedef Container<K, Hash, Pred, Alloc> Set;
+	save(os, x.size());
+	for (typename Set::const_iterator i = x.begin(), end = x.end(); i != end; ++i) {
+		save(os, *i);
+	}
+}
+
 } // cybozu
 
 #ifdef _MSC_VER
@@ -14,6 +14,263 @@
 */
 #include <cybozu/sha2.hpp>
 
+namespace cybozu {
+
+namespace sha1_local {
+
+inline uint32_t rol32(uint32_t x, int s)
+{
+#ifdef _MSC_VER
+	return _rotl(x, s);
+#else
+	return (x << s) | (x >> (32 - s));
+#endif
+}
+
+inline void setSha1Iv(uint32_t h[5])
+{
+	h[0] = 0x67452301;
+	h[1] = 0xefcdab89;
+	h[2] = 0x98badcfe;
+	h[3] = 0x10325476;
+	h[4] = 0xc3d2e1f0;
+}
+
+/*
+	SHA-1 compression function
+	@param h [in/out] state
+	@param p [in] blockNum * 64 bytes
+*/
+inline void sha1BlocksScalar(uint32_t h[5], const uint8_t *p, size_t blockNum)
+{
+#define CYBOZU_SHA1_RND(f, k) \
+	{ \
+		const uint32_t t = rol32(a, 5) + (f) + e + (k) + w[i]; \
+		e = d; \
+		d = c; \
+		c = rol32(b, 30); \
+		b = a; \
+		a = t; \
+	}
+	for (size_t blk = 0; blk < blockNum; blk++) {
+		uint32_t w[80];
+		for (int i = 0; i < 16; i++) {
+			w[i] = cybozu::Get32bitAsBE(&p[i * 4]);
+		}
+		for (int i = 16 ; i < 80; i++) {
+			w[i] = rol32(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+		}
+		uint32_t a = h[0];
+		uint32_t b = h[1];
+		uint32_t c = h[2];
+		uint32_t d = h[3];
+		uint32_t e = h[4];
+		int i = 0;
+		for (; i < 20; i++) CYBOZU_SHA1_RND(d ^ (b & (c ^ d)), 0x5a827999)
+		for (; i < 40; i++) CYBOZU_SHA1_RND(b ^ c ^ d, 0x6ed9eba1)
+		for (; i < 60; i++) CYBOZU_SHA1_RND((b & c) | (d & (b | c)), 0x8f1bbcdc)
+		for (; i < 80; i++) CYBOZU_SHA1_RND(b ^ c ^ d, 0xca62c1d6)
+		h[0] += a;
+		h[1] += b;
+		h[2] += c;
+		h[3] += d;
+		h[4] += e;
+		p += 64;
+	}
+#undef CYBOZU_SHA1_RND
+}
+
+#ifdef CYBOZU_SHA2_USE_SIMD
+/*
+	4 rounds by SHA-NI
+	m0 is the current message, and the next messages m1, m2, m3 are scheduled
+*/
+#define CYBOZU_SHA1_NI_RND4(e0, e1, m0, m1, m2, m3, f) \
+	e0 = _mm_sha1nexte_epu32(e0, m0); \
+	e1 = abcd; \
+	m1 = _mm_sha1msg2_epu32(m1, m0); \
+	abcd = _mm_sha1rnds4_epu32(abcd, e0, f); \
+	m3 = _mm_sha1msg1_epu32(m3, m0); \
+	m2 = _mm_xor_si128(m2, m0)
+__attribute__((target("sha,sse4.1")))
+inline void sha1BlocksShaNi(uint32_t h[5], const uint8_t *p, size_t blockNum)
+{
+	const __m128i mask = _mm_set_epi64x(0x0001020304050607ULL, 0x08090a0b0c0d0e0fULL);
+	__m128i abcd = _mm_shuffle_epi32(_mm_loadu_si128(cybozu::cast<const __m128i*>(h)), 0x1b);
+	__m128i e0 = _mm_set_epi32(int(h[4]), 0, 0, 0);
+	for (size_t b = 0; b < blockNum; b++) {
+		const __m128i saveAbcd = abcd;
+		const __m128i saveE = e0;
+		const __m128i *src = cybozu::cast<const __m128i*>(p);
+		__m128i m0 = _mm_shuffle_epi8(_mm_loadu_si128(src + 0), mask);
+		__m128i m1 = _mm_shuffle_epi8(_mm_loadu_si128(src + 1), mask);
+		__m128i m2 = _mm_shuffle_epi8(_mm_loadu_si128(src + 2), mask);
+		__m128i m3 = _mm_shuffle_epi8(_mm_loadu_si128(src + 3), mask);
+		__m128i e1;
+		// rounds 0-15 ; the message schedule starts
+		e0 = _mm_add_epi32(e0, m0);
+		e1 = abcd;
+		abcd = _mm_sha1rnds4_epu32(abcd, e0, 0);
+		e1 = _mm_sha1nexte_epu32(e1, m1);
+		e0 = abcd;
+		abcd = _mm_sha1rnds4_epu32(abcd, e1, 0);
+		m0 = _mm_sha1msg1_epu32(m0, m1);
+		e0 = _mm_sha1nexte_epu32(e0, m2);
+		e1 = abcd;
+		abcd = _mm_sha1rnds4_epu32(abcd, e0, 0);
+		m1 = _mm_sha1msg1_epu32(m1, m2);
+		m0 = _mm_xor_si128(m0, m2);
+		e1 = _mm_sha1nexte_epu32(e1, m3);
+		e0 = abcd;
+		m0 = _mm_sha1msg2_epu32(m0, m3);
+		abcd = _mm_sha1rnds4_epu32(abcd, e1, 0);
+		m2 = _mm_sha1msg1_epu32(m2, m3);
+		m1 = _mm_xor_si128(m1, m3);
+		// rounds 16-67
+		CYBOZU_SHA1_NI_RND4(e0, e1, m0, m1, m2, m3, 0);
+		CYBOZU_SHA1_NI_RND4(e1, e0, m1, m2, m3, m0, 1);
+		CYBOZU_SHA1_NI_RND4(e0, e1, m2, m3, m0, m1, 1);
+		CYBOZU_SHA1_NI_RND4(e1, e0, m3, m0, m1, m2, 1);
+		CYBOZU_SHA1_NI_RND4(e0, e1, m0, m1, m2, m3, 1);
+		CYBOZU_SHA1_NI_RND4(e1, e0, m1, m2, m3, m0, 1);
+		CYBOZU_SHA1_NI_RND4(e0, e1, m2, m3, m0, m1, 2);
+		CYBOZU_SHA1_NI_RND4(e1, e0, m3, m0, m1, m2, 2);
+		CYBOZU_SHA1_NI_RND4(e0, e1, m0, m1, m2, m3, 2);
+		CYBOZU_SHA1_NI_RND4(e1, e0, m1, m2, m3, m0, 2);
+		CYBOZU_SHA1_NI_RND4(e0, e1, m2, m3, m0, m1, 2);
+		CYBOZU_SHA1_NI_RND4(e1, e0, m3, m0, m1, m2, 3);
+		CYBOZU_SHA1_NI_RND4(e0, e1, m0, m1, m2, m3, 3);
+		// rounds 68-79 ; the message schedule ends
+		e1 = _mm_sha1nexte_epu32(e1, m1);
+		e0 = abcd;
+		m2 = _mm_sha1msg2_epu32(m2, m1);
+		abcd = _mm_sha1rnds4_epu32(abcd, e1, 3);
+		m3 = _mm_xor_si128(m3, m1);
+		e0 = _mm_sha1nexte_epu32(e0, m2);
+		e1 = abcd;
+		m3 = _mm_sha1msg2_epu32(m3, m2);
+		abcd = _mm_sha1rnds4_epu32(abcd, e0, 3);
+		e1 = _mm_sha1nexte_epu32(e1, m3);
+		e0 = abcd;
+		abcd = _mm_sha1rnds4_epu32(abcd, e1, 3);
+		e0 = _mm_sha1nexte_epu32(e0, saveE);
+		abcd = _mm_add_epi32(abcd, saveAbcd);
+		p += 64;
+	}
+	_mm_storeu_si128(cybozu::cast<__m128i*>(h), _mm_shuffle_epi32(abcd, 0x1b));
+	h[4] = uint32_t(_mm_extract_epi32(e0, 3));
+}
+#undef CYBOZU_SHA1_NI_RND4
+
+/*
+	process blockNum blocks of N messages in parallel by vector extensions of GCC
+	@param st [in/out] st[i * N + j] is h[i] of the j-th message
+	@param p [in] p[j] has blockNum * 64 bytes of the j-th message
+	@note see sha2_local::sha256LanesT
+*/
+template<class V, int N>
+__attribute__((always_inline)) inline void sha1LanesT(uint32_t *st, const uint8_t *const *p, size_t blockNum)
+{
+#define CYBOZU_SHA1_ROL(x, s) (((x) << (s)) | ((x) >> (32 - (s))))
+#define CYBOZU_SHA1_RND(f, k) \
+	{ \
+		if (i >= 16) { \
+			const V t = w[(i + 13) & 15] ^ w[(i + 8) & 15] ^ w[(i + 2) & 15] ^ w[i & 15]; \
+			w[i & 15] = CYBOZU_SHA1_ROL(t, 1); \
+		} \
+		const V t = CYBOZU_SHA1_ROL(a, 5) + (f) + e + (k) + w[i & 15]; \
+		e = d; \
+		d = c; \
+		c = CYBOZU_SHA1_ROL(b, 30); \
+		b = a; \
+		a = t; \
+	}
+	V h[5];
+	memcpy(h, st, sizeof(h));
+	for (size_t blk = 0; blk < blockNum; blk++) {
+		// transpose the message words
+		CYBOZU_ALIGN(64) uint32_t wbuf[16 * N];
+		for (int j = 0; j < N; j++) {
+			const uint8_t *q = p[j] + blk * 64;
+			for (int i = 0; i < 16; i++) {
+				wbuf[i * N + j] = cybozu::Get32bitAsBE(q + i * 4);
+			}
+		}
+		V w[16];
+		memcpy(w, wbuf, sizeof(w));
+		V a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+		int i = 0;
+		for (; i < 20; i++) CYBOZU_SHA1_RND(d ^ (b & (c ^ d)), 0x5a827999)
+		for (; i < 40; i++) CYBOZU_SHA1_RND(b ^ c ^ d, 0x6ed9eba1)
+		for (; i < 60; i++) CYBOZU_SHA1_RND((b & c) | (d & (b | c)), 0x8f1bbcdc)
+		for (; i < 80; i++) CYBOZU_SHA1_RND(b ^ c ^ d, 0xca62c1d6)
+		h[0] += a; h[1] += b; h[2] += c; h[3] += d; h[4] += e;
+	}
+	memcpy(st, h, sizeof(h));
+#undef CYBOZU_SHA1_RND
+#undef CYBOZU_SHA1_ROL
+}
+
+__attribute__((target("avx2")))
+inline void sha1Lanes8(uint32_t *st, const uint8_t *const *p, size_t blockNum)
+{
+	sha1LanesT<sha2_local::Sha256V8, 8>(st, p, blockNum);
+}
+
+__attribute__((target("avx512f")))
+inline void sha1Lanes16(uint32_t *st, const uint8_t *const *p, size_t blockNum)
+{
+	sha1LanesT<sha2_local::Sha256V16, 16>(st, p, blockNum);
+}
+#endif
+
+/*
+	SHA-NI of SHA-256 (sha2_local::sha256ShaNi) has SHA-1 instructions too
+*/
+inline void sha1Blocks(uint32_t h[5], const uint8_t *p, size_t blockNum)
+{
+#ifdef CYBOZU_SHA2_USE_SIMD
+	if (sha2_local::getSha256Feature() & sha2_local::sha256ShaNi) {
+		sha1BlocksShaNi(h, p, blockNum);
+		return;
+	}
+#endif
+	sha1BlocksScalar(h, p, blockNum);
+}
+
+inline void putSha1Digest(void *out, const uint32_t h[5])
+{
+	uint8_t *q = static_cast<uint8_t*>(out);
+	for (int i = 0; i < 5; i++) {
+		cybozu::Set32bitAsBE(q + i * 4, h[i]);
+	}
+}
+
+/*
+	raw SHA-1 for sha2_local::hashBatch and HmacT
+*/
+struct Sha1Func {
+	typedef uint32_t Word;
+	static const size_t hSize = 5;
+	static const size_t mdSize = 20;
+	static const size_t blockSize = 64;
+	static void setIv(uint32_t *h) { setSha1Iv(h); }
+	static void blocks(uint32_t *h, const uint8_t *p, size_t blockNum) { sha1Blocks(h, p, blockNum); }
+	static void putDigest(uint8_t *out, const uint32_t *h) { putSha1Digest(out, h); }
+#ifdef CYBOZU_SHA2_USE_SIMD
+	static void lanes8(uint32_t *st, const uint8_t *const *p, size_t blockNum) { sha1Lanes8(st, p, blockNum); }
+	static void lanes16(uint32_t *st, const uint8_t *const *p, size_t blockNum) { sha1Lanes16(st, p, blockNum); }
+#endif
+	static void batch(uint8_t *out, const void *const *bufs, const size_t *sizes, size_t n, const uint32_t *iv, uint64_t prefixSize)
+	{
+		sha2_local::hashBatch<Sha1Func>(out, bufs, sizes, n, iv, prefixSize);
+	}
+};
+
+} // cybozu::sha1_local
+
+} // cybozu
+
 #if CYBOZU_USE_APPLE_COMMONCRYPTO == 1
 
 #ifdef __APPLE__
@@ -133,107 +390,31 @@ public:
 
 #else
 
-#include <cybozu/endian.hpp>
-#include <algorithm>
-#include <memory.h>
-#include <assert.h>
-
 namespace cybozu {
 
-class Sha1 {
+class Sha1 : public sha2_local::Common<Sha1> {
+	friend struct sha2_local::Common<Sha1>;
 private:
+	static const size_t blockSize_ = 64;
+	static const size_t hSize_ = 5;
+	static const size_t msgLenByte_ = 8;
 	uint64_t totalSize_;
 	size_t roundBufSize_;
-	char roundBuf_[64];
-	uint32_t H_[5];
-	uint32_t K_[80];
-	uint32_t digest_[5];
-	bool done_;
-
-	uint32_t S(uint32_t x, int s) const
-	{
-#ifdef _MSC_VER
-		return _rotl(x, s);
-#else
-		return (x << s) | (x >> (32 - s));
-#endif
-	}
-
-	uint32_t f0(uint32_t b, uint32_t c, uint32_t d) const { return (b & c) | (~b & d); }
-	uint32_t f1(uint32_t b, uint32_t c, uint32_t d) const { return b ^ c ^ d; }
-	uint32_t f2(uint32_t b, uint32_t c, uint32_t d) const { return (b & c) | (b & d) | (c & d); }
-	uint32_t f(int t, uint32_t b, uint32_t c, uint32_t d) const
-	{
-		if (t < 20) {
-			return f0(b, c, d);
-		} else
-		if (t < 40) {
-			return f1(b, c, d);
-		} else
-		if (t < 60) {
-			return f2(b, c, d);
-		} else {
-			return f1(b, c, d);
-		}
-	}
+	uint8_t roundBuf_[blockSize_];
+	uint32_t h_[hSize_];
+	static const size_t outByteSize_ = hSize_ * sizeof(uint32_t);
 
 	/**
 		@param buf [in] buffer(64byte)
 	*/
-	void round(const char *buf)
+	void round(const uint8_t *buf)
 	{
-		uint32_t W[80];
-		for (int i = 0; i < 16; i++) {
-			W[i] = cybozu::Get32bitAsBE(&buf[i * 4]);
-		}
-		for (int i = 16 ; i < 80; i++) {
-			W[i] = S(W[i - 3] ^ W[i - 8] ^ W[i - 14] ^ W[i - 16], 1);
-		}
-		uint32_t a = H_[0];
-		uint32_t b = H_[1];
-		uint32_t c = H_[2];
-		uint32_t d = H_[3];
-		uint32_t e = H_[4];
-		for (int i = 0; i < 80; i++) {
-			uint32_t tmp = S(a, 5) + f(i, b, c, d) + e + W[i] + K_[i];
-			e = d;
-			d = c;
-			c = S(b, 30);
-			b = a;
-			a = tmp;
-		}
-		H_[0] += a;
-		H_[1] += b;
-		H_[2] += c;
-		H_[3] += d;
-		H_[4] += e;
-		totalSize_ += 64;
+		rounds(buf, 1);
 	}
-	/*
-		final phase
-		@note bufSize < 64
-	*/
-	void term(const char *buf, size_t bufSize)
+	void rounds(const uint8_t *buf, size_t n)
 	{
-		assert(bufSize < 64);
-		const uint64_t totalSize = totalSize_ + bufSize;
-
-		uint8_t last[64];
-		memcpy(last, buf, bufSize);
-		memset(&last[bufSize], 0, 64 - bufSize);
-		last[bufSize] = uint8_t(0x80); /* top bit = 1 */
-		if (bufSize >= 56) {
-			round(cybozu::cast<const char*>(last));
-			memset(last, 0, sizeof(last)); // clear stack
-		}
-		cybozu::Set32bitAsBE(&last[56], uint32_t(totalSize >> 29));
-		cybozu::Set32bitAsBE(&last[60], uint32_t(totalSize * 8));
-		round(cybozu::cast<const char*>(last));
-
-		for (size_t i = 0; i < CYBOZU_NUM_OF_ARRAY(H_); i++) {
-			cybozu::Set32bitAsBE(&digest_[i], H_[i]);
-		}
-		done_ = true;
+		sha1_local::sha1Blocks(h_, buf, n);
+		totalSize_ += n * blockSize_;
 	}
 public:
 	Sha1()
@@ -242,64 +423,22 @@ public:
 	}
 	void clear()
 	{
-		static const uint32_t tbl[] = {
-			0x5a827999, 0x6ed9eba1, 0x8f1bbcdc, 0xca62c1d6
-		};
-		for (size_t i = 0; i < CYBOZU_NUM_OF_ARRAY(tbl); i++) {
-			for (int j = 0; j < 20; j++) {
-				K_[i * 20 + j] = tbl[i];
-			}
-		}
 		totalSize_ = 0;
 		roundBufSize_ = 0;
-		H_[0] = 0x67452301;
-		H_[1] = 0xefcdab89;
-		H_[2] = 0x98badcfe;
-		H_[3] = 0x10325476;
-		H_[4] = 0xc3d2e1f0;
-		done_ = false;
+		sha1_local::setSha1Iv(h_);
 	}
-	void update(const void *_buf, size_t bufSize)
+	void update(const void *buf, size_t bufSize)
 	{
-		const char *buf = (const char *)_buf;
-		if (bufSize == 0) return;
-		assert(!done_);
-		if (roundBufSize_ > 0) {
-			size_t size = std::min(64 - roundBufSize_, bufSize);
-			memcpy(roundBuf_ + roundBufSize_, buf, size);
-			roundBufSize_ += size;
-			buf += size;
-			bufSize -= size;
-		}
-		if (roundBufSize_ == 64) {
-			round(roundBuf_);
-			roundBufSize_ = 0;
-		}
-		while (bufSize >= 64) {
-			assert(roundBufSize_ == 0);
-			round(buf);
-			buf += 64;
-			bufSize -= 64;
-		}
-		if (bufSize > 0) {
-			assert(bufSize < 64);
-			assert(roundBufSize_ == 0);
-			memcpy(roundBuf_, buf, bufSize);
-			roundBufSize_ = bufSize;
-		}
-		assert(roundBufSize_ < 64);
+		inner_update(reinterpret_cast<const uint8_t*>(buf), bufSize);
 	}
-	size_t digest(void *md, size_t mdSize, const void *_buf, size_t bufSize)
+	size_t digest(void *md, size_t mdSize, const void *buf, size_t bufSize)
 	{
-		const char *buf = (const char *)_buf;
-		assert(!done_);
+		if (mdSize < outByteSize_) return 0;
 		update(buf, bufSize);
 		term(roundBuf_, roundBufSize_);
-		const size_t outByteSize = sizeof(digest_);
-		if (mdSize < outByteSize) return 0;
-		memcpy(md, digest_, outByteSize);
+		sha1_local::putSha1Digest(md, h_);
 		clear();
-		return outByteSize;
+		return outByteSize_;
 	}
 };
 
@@ -309,6 +448,8 @@ public:
 
 namespace cybozu {
 
+typedef HmacT<sha1_local::Sha1Func> Hmac1;
+
 /*
 	HMAC-SHA-1 (deprecated)
 	hmac must have 20 bytes buffer
@@ -318,4 +459,18 @@ inline void hmac1(void *hmac, const void *key, size_t keySize, const void *msg,
 	sha2_local::hmac<Sha1, 20, 64>(hmac, key, keySize, msg, msgSize);
 }
 
+/*
+	SHA-1 of n messages (deprecated)
+	@param bufs [in] bufs[i] is the i-th message
+	@param sizes [in] sizes[i] is the byte size of bufs[i]
+	@param out [out] n * 20 bytes ; out + i * 20 is the digest of bufs[i]
+	@note messages are hashed in parallel by AVX-512(16 lanes) or AVX2(8 lanes) if available
+*/
+inline void sha1Batch(const void *const *bufs, const size_t *sizes, size_t n, void *out)
+{
+	uint32_t iv[5];
+	sha1_local::setSha1Iv(iv);
+	sha2_local::hashBatch<sha1_local::Sha1Func>(static_cast<uint8_t*>(out), bufs, sizes, n, iv, 0);
+}
+
 } // cybozu
@@ -40,6 +40,450 @@
 #endif
 
 #include <memory.h>
+#include <cybozu/endian.hpp>
+
+/*
+	SIMD kernels of the built-in SHA-256 used by sha256Batch (and Sha256 if CYBOZU_DONT_USE_OPENSSL is defined)
+	SHA-NI and AVX2/AVX-512 are selected at runtime
+	define CYBOZU_SHA2_DONT_USE_SIMD to disable them
+*/
+#if !defined(CYBOZU_SHA2_DONT_USE_SIMD) && CYBOZU_HOST == CYBOZU_HOST_INTEL && !defined(_MSC_VER) \
+	&& ((defined(__clang__) && __clang_major__ >= 8) || (!defined(__clang__) && __GNUC__ >= 5))
+	#define CYBOZU_SHA2_USE_SIMD
+	#include <immintrin.h>
+	#include <cpuid.h>
+#endif
+
+namespace cybozu {
+
+namespace sha2_local {
+
+inline uint32_t rot32(uint32_t x, int s)
+{
+#ifdef _MSC_VER
+	return _rotr(x, s);
+#else
+	return (x >> s) | (x << (32 - s));
+#endif
+}
+
+inline const uint32_t *getSha256K()
+{
+	static const uint32_t kTbl[] = {
+		0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+		0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+		0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+		0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+		0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+		0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+		0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+		0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+	};
+	return kTbl;
+}
+
+inline void setSha256Iv(uint32_t h[8])
+{
+	h[0] = 0x6a09e667;
+	h[1] = 0xbb67ae85;
+	h[2] = 0x3c6ef372;
+	h[3] = 0xa54ff53a;
+	h[4] = 0x510e527f;
+	h[5] = 0x9b05688c;
+	h[6] = 0x1f83d9ab;
+	h[7] = 0x5be0cd19;
+}
+
+template<size_t i0, size_t i1, size_t i2, size_t i3, size_t i4, size_t i5, size_t i6, size_t i7>
+void sha256Round1(uint32_t *s, const uint32_t *w, const uint32_t *k, int i)
+{
+	uint32_t e = s[i4];
+	uint32_t h = s[i7];
+	h += rot32(e, 6) ^ rot32(e, 11) ^ rot32(e, 25);
+	uint32_t f = s[i5];
+	uint32_t g = s[i6];
+	h += g ^ (e & (f ^ g));
+	h += k[i];
+	h += w[i];
+	s[i3] += h;
+	uint32_t a = s[i0];
+	uint32_t b = s[i1];
+	uint32_t c = s[i2];
+	h += rot32(a, 2) ^ rot32(a, 13) ^ rot32(a, 22);
+	h += ((a | b) & c) | (a & b);
+	s[i7] = h;
+}
+
+/*
+	SHA-256 compression function
+	@param h [in/out] state
+	@param p [in] blockNum * 64 bytes
+*/
+inline void sha256BlocksScalar(uint32_t h[8], const uint8_t *p, size_t blockNum)
+{
+	const uint32_t *k = getSha256K();
+	for (size_t b = 0; b < blockNum; b++) {
+		uint32_t w[64];
+		for (int i = 0; i < 16; i++) {
+			w[i] = cybozu::Get32bitAsBE(&p[i * 4]);
+		}
+		for (int i = 16 ; i < 64; i++) {
+			uint32_t t = w[i - 15];
+			uint32_t s0 = rot32(t, 7) ^ rot32(t, 18) ^ (t >> 3);
+			t = w[i - 2];
+			uint32_t s1 = rot32(t, 17) ^ rot32(t, 19) ^ (t >> 10);
+			w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+		}
+		uint32_t s[8];
+		for (int i = 0; i < 8; i++) {
+			s[i] = h[i];
+		}
+		for (int i = 0; i < 64; i += 8) {
+			sha256Round1<0, 1, 2, 3, 4, 5, 6, 7>(s, w, k, i + 0);
+			sha256Round1<7, 0, 1, 2, 3, 4, 5, 6>(s, w, k, i + 1);
+			sha256Round1<6, 7, 0, 1, 2, 3, 4, 5>(s, w, k, i + 2);
+			sha256Round1<5, 6, 7, 0, 1, 2, 3, 4>(s, w, k, i + 3);
+			sha256Round1<4, 5, 6, 7, 0, 1, 2, 3>(s, w, k, i + 4);
+			sha256Round1<3, 4, 5, 6, 7, 0, 1, 2>(s, w, k, i + 5);
+			sha256Round1<2, 3, 4, 5, 6, 7, 0, 1>(s, w, k, i + 6);
+			sha256Round1<1, 2, 3, 4, 5, 6, 7, 0>(s, w, k, i + 7);
+		}
+		for (int i = 0; i < 8; i++) {
+			h[i] += s[i];
+		}
+		p += 64;
+	}
+}
+
+enum {
+	sha256ShaNi = 1,
+	sha256Avx2 = 2,
+	sha256Avx512 = 4
+};
+
+#ifdef CYBOZU_SHA2_USE_SIMD
+inline int detectSha256Feature()
+{
+	unsigned int a, b, c, d;
+	if (__get_cpuid_max(0, 0) < 7) return 0;
+	__cpuid(1, a, b, c, d);
+	const bool sse41 = (c & (1u << 19)) != 0 && (c & (1u << 9)) != 0; // SSE4.1 and SSSE3
+	uint32_t xcr0 = 0, xcr0H;
+	if (c & (1u << 27)) { // OSXSAVE
+		__asm__ volatile("xgetbv" : "=a"(xcr0), "=d"(xcr0H) : "c"(0));
+	}
+	__cpuid_count(7, 0, a, b, c, d);
+	int f = 0;
+	if (sse41 && (b & (1u << 29))) f |= sha256ShaNi;
+	if ((xcr0 & 0x06) == 0x06 && (b & (1u << 5))) f |= sha256Avx2;
+	if ((xcr0 & 0xe6) == 0xe6 && (b & (1u << 16))) f |= sha256Avx512;
+	return f;
+}
+
+inline int& getSha256FeatureRef()
+{
+	static int f = detectSha256Feature();
+	return f;
+}
+#endif
+
+inline int getSha256Feature()
+{
+#ifdef CYBOZU_SHA2_USE_SIMD
+	return getSha256FeatureRef();
+#else
+	return 0;
+#endif
+}
+
+/*
+	use only the kernels in mask (for test)
+*/
+inline void limitSha256Feature(int mask)
+{
+#ifdef CYBOZU_SHA2_USE_SIMD
+	getSha256FeatureRef() = detectSha256Feature() & mask;
+#else
+	(void)mask;
+#endif
+}
+
+#ifdef CYBOZU_SHA2_USE_SIMD
+#define CYBOZU_SHA256_NI_RND4(w, i) \
+	m = _mm_add_epi32(w, _mm_loadu_si128(cybozu::cast<const __m128i*>(k + (i) * 4))); \
+	s1 = _mm_sha256rnds2_epu32(s1, s0, m); \
+	s0 = _mm_sha256rnds2_epu32(s0, s1, _mm_shuffle_epi32(m, 0x0e))
+#define CYBOZU_SHA256_NI_MSG(w0, w1, w2, w3) \
+	w0 = _mm_sha256msg2_epu32(_mm_add_epi32(_mm_sha256msg1_epu32(w0, w1), _mm_alignr_epi8(w3, w2, 4)), w3)
+__attribute__((target("sha,sse4.1")))
+inline void sha256BlocksShaNi(uint32_t h[8], const uint8_t *p, size_t blockNum)
+{
+	const uint32_t *k = getSha256K();
+	const __m128i mask = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+	__m128i t = _mm_shuffle_epi32(_mm_loadu_si128(cybozu::cast<const __m128i*>(h)), 0xb1); // CDAB
+	__m128i s1 = _mm_shuffle_epi32(_mm_loadu_si128(cybozu::cast<const __m128i*>(h + 4)), 0x1b); // EFGH
+	__m128i s0 = _mm_alignr_epi8(t, s1, 8); // ABEF
+	s1 = _mm_blend_epi16(s1, t, 0xf0); // CDGH
+	for (size_t b = 0; b < blockNum; b++) {
+		const __m128i save0 = s0;
+		const __m128i save1 = s1;
+		const __m128i *src = cybozu::cast<const __m128i*>(p);
+		__m128i w0 = _mm_shuffle_epi8(_mm_loadu_si128(src + 0), mask);
+		__m128i w1 = _mm_shuffle_epi8(_mm_loadu_si128(src + 1), mask);
+		__m128i w2 = _mm_shuffle_epi8(_mm_loadu_si128(src + 2), mask);
+		__m128i w3 = _mm_shuffle_epi8(_mm_loadu_si128(src + 3), mask);
+		__m128i m;
+		CYBOZU_SHA256_NI_RND4(w0, 0);
+		CYBOZU_SHA256_NI_RND4(w1, 1);
+		CYBOZU_SHA256_NI_RND4(w2, 2);
+		CYBOZU_SHA256_NI_RND4(w3, 3);
+		for (int i = 4; i < 16; i += 4) {
+			CYBOZU_SHA256_NI_MSG(w0, w1, w2, w3);
+			CYBOZU_SHA256_NI_RND4(w0, i);
+			CYBOZU_SHA256_NI_MSG(w1, w2, w3, w0);
+			CYBOZU_SHA256_NI_RND4(w1, i + 1);
+			CYBOZU_SHA256_NI_MSG(w2, w3, w0, w1);
+			CYBOZU_SHA256_NI_RND4(w2, i + 2);
+			CYBOZU_SHA256_NI_MSG(w3, w0, w1, w2);
+			CYBOZU_SHA256_NI_RND4(w3, i + 3);
+		}
+		s0 = _mm_add_epi32(s0, save0);
+		s1 = _mm_add_epi32(s1, save1);
+		p += 64;
+	}
+	t = _mm_shuffle_epi32(s0, 0x1b); // FEBA
+	s1 = _mm_shuffle_epi32(s1, 0xb1); // DCHG
+	_mm_storeu_si128(cybozu::cast<__m128i*>(h), _mm_blend_epi16(t, s1, 0xf0)); // DCBA
+	_mm_storeu_si128(cybozu::cast<__m128i*>(h + 4), _mm_alignr_epi8(s1, t, 8)); // HGFE
+}
+#undef CYBOZU_SHA256_NI_RND4
+#undef CYBOZU_SHA256_NI_MSG
+
+/*
+	process blockNum blocks of N messages in parallel by vector extensions of GCC
+	it is inlined into the functions with target attributes to use AVX2/AVX-512
+	@param st [in/out] st[i * N + j] is h[i] of the j-th message
+	@param p [in] p[j] has blockNum * 64 bytes of the j-th message
+*/
+template<class V, int N>
+__attribute__((always_inline)) inline void sha256LanesT(uint32_t *st, const uint8_t *const *p, size_t blockNum)
+{
+#define CYBOZU_SHA256_ROR(x, s) (((x) >> (s)) | ((x) << (32 - (s))))
+	const uint32_t *k = getSha256K();
+	V h[8];
+	memcpy(h, st, sizeof(h));
+	for (size_t b = 0; b < blockNum; b++) {
+		// transpose the message words
+		CYBOZU_ALIGN(64) uint32_t wbuf[16 * N];
+		for (int j = 0; j < N; j++) {
+			const uint8_t *q = p[j] + b * 64;
+			for (int i = 0; i < 16; i++) {
+				wbuf[i * N + j] = cybozu::Get32bitAsBE(q + i * 4);
+			}
+		}
+		V w[16];
+		memcpy(w, wbuf, sizeof(w));
+		V a = h[0], bb = h[1], c = h[2], d = h[3], e = h[4], f = h[5], g = h[6], hh = h[7];
+		for (int i = 0; i < 64; i++) {
+			if (i >= 16) {
+				const V x = w[(i + 1) & 15];
+				const V y = w[(i + 14) & 15];
+				w[i & 15] += (CYBOZU_SHA256_ROR(x, 7) ^ CYBOZU_SHA256_ROR(x, 18) ^ (x >> 3)) + w[(i + 9) & 15]
+					+ (CYBOZU_SHA256_ROR(y, 17) ^ CYBOZU_SHA256_ROR(y, 19) ^ (y >> 10));
+			}
+			const V t1 = hh + (CYBOZU_SHA256_ROR(e, 6) ^ CYBOZU_SHA256_ROR(e, 11) ^ CYBOZU_SHA256_ROR(e, 25))
+				+ (g ^ (e & (f ^ g))) + k[i] + w[i & 15];
+			const V t2 = (CYBOZU_SHA256_ROR(a, 2) ^ CYBOZU_SHA256_ROR(a, 13) ^ CYBOZU_SHA256_ROR(a, 22))
+				+ (((a | bb) & c) | (a & bb));
+			hh = g;
+			g = f;
+			f = e;
+			e = d + t1;
+			d = c;
+			c = bb;
+			bb = a;
+			a = t1 + t2;
+		}
+		h[0] += a; h[1] += bb; h[2] += c; h[3] += d;
+		h[4] += e; h[5] += f; h[6] += g; h[7] += hh;
+	}
+	memcpy(st, h, sizeof(h));
+#undef CYBOZU_SHA256_ROR
+}
+
+typedef uint32_t Sha256V8 __attribute__((vector_size(32)));
+typedef uint32_t Sha256V16 __attribute__((vector_size(64)));
+
+__attribute__((target("avx2")))
+inline void sha256Lanes8(uint32_t *st, const uint8_t *const *p, size_t blockNum)
+{
+	sha256LanesT<Sha256V8, 8>(st, p, blockNum);
+}
+
+__attribute__((target("avx512f")))
+inline void sha256Lanes16(uint32_t *st, const uint8_t *const *p, size_t blockNum)
+{
+	sha256LanesT<Sha256V16, 16>(st, p, blockNum);
+}
+#endif
+
+inline void sha256Blocks(uint32_t h[8], const uint8_t *p, size_t blockNum)
+{
+#ifdef CYBOZU_SHA2_USE_SIMD
+	if (getSha256Feature() & sha256ShaNi) {
+		sha256BlocksShaNi(h, p, blockNum);
+		return;
+	}
+#endif
+	sha256BlocksScalar(h, p, blockNum);
+}
+
+/*
+	make the padded last blocks of a message (also used by SHA-1 and SHA-512)
+	@param tail [out] blockSize * 2 bytes
+	@param p [in] message
+	@param size [in] byte size of message
+	@param prefixSize [in] byte size of data hashed before the message (blockSize for HMAC)
+	@return the number of blocks in tail (1 or 2)
+*/
+template<size_t blockSize>
+size_t makeHashTail(uint8_t *tail, const uint8_t *p, size_t size, uint64_t prefixSize)
+{
+	const size_t lenSize = blockSize / 8; // byte size of bit length
+	const size_t r = size % blockSize;
+	if (r > 0) memcpy(tail, p + size - r, r);
+	tail[r] = 0x80;
+	const size_t n = r < blockSize - lenSize ? 1 : 2;
+	memset(tail + r + 1, 0, n * blockSize - 8 - r - 1);
+	cybozu::Set64bitAsBE(tail + n * blockSize - 8, (uint64_t(size) + prefixSize) * 8);
+	return n;
+}
+
+inline void putSha256Digest(void *out, const uint32_t h[8])
+{
+	uint8_t *q = static_cast<uint8_t*>(out);
+	for (int i = 0; i < 8; i++) {
+		cybozu::Set32bitAsBE(q + i * 4, h[i]);
+	}
+}
+
+inline uint64_t rot64(uint64_t x, int s)
+{
+#ifdef _MSC_VER
+	return _rotr64(x, s);
+#else
+	return (x >> s) | (x << (64 - s));
+#endif
+}
+
+inline const uint64_t *getSha512K()
+{
+	static const uint64_t kTbl[] = {
+	    0x428a2f98d728ae22ULL, 0x7137449123ef65cdULL, 0xb5c0fbcfec4d3b2fULL, 0xe9b5dba58189dbbcULL, 0x3956c25bf348b538ULL,
+	    0x59f111f1b605d019ULL, 0x923f82a4af194f9bULL, 0xab1c5ed5da6d8118ULL, 0xd807aa98a3030242ULL, 0x12835b0145706fbeULL,
+	    0x243185be4ee4b28cULL, 0x550c7dc3d5ffb4e2ULL, 0x72be5d74f27b896fULL, 0x80deb1fe3b1696b1ULL, 0x9bdc06a725c71235ULL,
+	    0xc19bf174cf692694ULL, 0xe49b69c19ef14ad2ULL, 0xefbe4786384f25e3ULL, 0x0fc19dc68b8cd5b5ULL, 0x240ca1cc77ac9c65ULL,
+	    0x2de92c6f592b0275ULL, 0x4a7484aa6ea6e483ULL, 0x5cb0a9dcbd41fbd4ULL, 0x76f988da831153b5ULL, 0x983e5152ee66dfabULL,
+	    0xa831c66d2db43210ULL, 0xb00327c898fb213fULL, 0xbf597fc7beef0ee4ULL, 0xc6e00bf33da88fc2ULL, 0xd5a79147930aa725ULL,
+	    0x06ca6351e003826fULL, 0x142929670a0e6e70ULL, 0x27b70a8546d22ffcULL, 0x2e1b21385c26c926ULL, 0x4d2c6dfc5ac42aedULL,
+	    0x53380d139d95b3dfULL, 0x650a73548baf63deULL, 0x766a0abb3c77b2a8ULL, 0x81c2c92e47edaee6ULL, 0x92722c851482353bULL,
+	    0xa2bfe8a14cf10364ULL, 0xa81a664bbc423001ULL, 0xc24b8b70d0f89791ULL, 0xc76c51a30654be30ULL, 0xd192e819d6ef5218ULL,
+	    0xd69906245565a910ULL, 0xf40e35855771202aULL, 0x106aa07032bbd1b8ULL, 0x19a4c116b8d2d0c8ULL, 0x1e376c085141ab53ULL,
+	    0x2748774cdf8eeb99ULL, 0x34b0bcb5e19b48a8ULL, 0x391c0cb3c5c95a63ULL, 0x4ed8aa4ae3418acbULL, 0x5b9cca4f7763e373ULL,
+	    0x682e6ff3d6b2b8a3ULL, 0x748f82ee5defb2fcULL, 0x78a5636f43172f60ULL, 0x84c87814a1f0ab72ULL, 0x8cc702081a6439ecULL,
+	    0x90befffa23631e28ULL, 0xa4506cebde82bde9ULL, 0xbef9a3f7b2c67915ULL, 0xc67178f2e372532bULL, 0xca273eceea26619cULL,
+	    0xd186b8c721c0c207ULL, 0xeada7dd6cde0eb1eULL, 0xf57d4f7fee6ed178ULL, 0x06f067aa72176fbaULL, 0x0a637dc5a2c898a6ULL,
+	    0x113f9804bef90daeULL, 0x1b710b35131c471bULL, 0x28db77f523047d84ULL, 0x32caab7b40c72493ULL, 0x3c9ebe0a15c9bebcULL,
+	    0x431d67c49c100d4cULL, 0x4cc5d4becb3e42b6ULL, 0x597f299cfc657e2aULL, 0x5fcb6fab3ad6faecULL, 0x6c44198c4a475817ULL
+	};
+	return kTbl;
+}
+
+inline void setSha512Iv(uint64_t h[8])
+{
+	h[0] = 0x6a09e667f3bcc908ull;
+	h[1] = 0xbb67ae8584caa73bull;
+	h[2] = 0x3c6ef372fe94f82bull;
+	h[3] = 0xa54ff53a5f1d36f1ull;
+	h[4] = 0x510e527fade682d1ull;
+	h[5] = 0x9b05688c2b3e6c1full;
+	h[6] = 0x1f83d9abfb41bd6bull;
+	h[7] = 0x5be0cd19137e2179ull;
+}
+
+template<size_t i0, size_t i1, size_t i2, size_t i3, size_t i4, size_t i5, size_t i6, size_t i7>
+void sha512Round1(uint64_t *S, const uint64_t *w, const uint64_t *k, size_t i)
+{
+	uint64_t& a = S[i0];
+	uint64_t& b = S[i1];
+	uint64_t& c = S[i2];
+	uint64_t& d = S[i3];
+	uint64_t& e = S[i4];
+	uint64_t& f = S[i5];
+	uint64_t& g = S[i6];
+	uint64_t& h = S[i7];
+
+	uint64_t s1 = rot64(e, 14) ^ rot64(e, 18) ^ rot64(e, 41);
+	uint64_t ch = g ^ (e & (f ^ g));
+	uint64_t t0 = h + s1 + ch + k[i] + w[i];
+	uint64_t s0 = rot64(a, 28) ^ rot64(a, 34) ^ rot64(a, 39);
+	uint64_t maj = ((a | b) & c) | (a & b);
+	uint64_t t1 = s0 + maj;
+	d += t0;
+	h = t0 + t1;
+}
+
+/*
+	built-in SHA-512 used by Hmac512 (and Sha512 if CYBOZU_DONT_USE_OPENSSL is defined)
+	@param p [in] blockNum * 128 bytes
+*/
+inline void sha512Blocks(uint64_t h[8], const uint8_t *p, size_t blockNum)
+{
+	const uint64_t *k = getSha512K();
+	for (size_t j = 0; j < blockNum; j++) {
+		const uint8_t *buf = p + j * 128;
+		uint64_t w[80];
+		for (int i = 0; i < 16; i++) {
+			w[i] = cybozu::Get64bitAsBE(&buf[i * 8]);
+		}
+		for (int i = 16 ; i < 80; i++) {
+			uint64_t t = w[i - 15];
+			uint64_t s0 = rot64(t, 1) ^ rot64(t, 8) ^ (t >> 7);
+			t = w[i - 2];
+			uint64_t s1 = rot64(t, 19) ^ rot64(t, 61) ^ (t >> 6);
+			w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+		}
+		uint64_t s[8];
+		for (int i = 0; i < 8; i++) {
+			s[i] = h[i];
+		}
+		for (int i = 0; i < 80; i += 8) {
+			sha512Round1<0, 1, 2, 3, 4, 5, 6, 7>(s, w, k, i + 0);
+			sha512Round1<7, 0, 1, 2, 3, 4, 5, 6>(s, w, k, i + 1);
+			sha512Round1<6, 7, 0, 1, 2, 3, 4, 5>(s, w, k, i + 2);
+			sha512Round1<5, 6, 7, 0, 1, 2, 3, 4>(s, w, k, i + 3);
+			sha512Round1<4, 5, 6, 7, 0, 1, 2, 3>(s, w, k, i + 4);
+			sha512Round1<3, 4, 5, 6, 7, 0, 1, 2>(s, w, k, i + 5);
+			sha512Round1<2, 3, 4, 5, 6, 7, 0, 1>(s, w, k, i + 6);
+			sha512Round1<1, 2, 3, 4, 5, 6, 7, 0>(s, w, k, i + 7);
+		}
+		for (int i = 0; i < 8; i++) {
+			h[i] += s[i];
+		}
+	}
+}
+
+inline void putSha512Digest(void *out, const uint64_t h[8])
+{
+	uint8_t *q = static_cast<uint8_t*>(out);
+	for (int i = 0; i < 8; i++) {
+		cybozu::Set64bitAsBE(q + i * 8, h[i]);
+	}
+}
+
+} // cybozu::sha2_local
+
+} // cybozu
 
 #if CYBOZU_USE_APPLE_COMMONCRYPTO == 1
 
@@ -488,24 +932,6 @@ namespace sha2_local {
 template<class T>
 T min_(T x, T y) { return x < y ? x : y;; }
 
-inline uint32_t rot32(uint32_t x, int s)
-{
-#ifdef _MSC_VER
-	return _rotr(x, s);
-#else
-	return (x >> s) | (x << (32 - s));
-#endif
-}
-
-inline uint64_t rot64(uint64_t x, int s)
-{
-#ifdef _MSC_VER
-	return _rotr64(x, s);
-#else
-	return (x >> s) | (x << (64 - s));
-#endif
-}
-
 template<class T>
 struct Common {
 	void term(uint8_t *buf, size_t bufSize)
@@ -538,11 +964,12 @@ struct Common {
 			self.round(self.roundBuf_);
 			self.roundBufSize_ = 0;
 		}
-		while (bufSize >= T::blockSize_) {
+		if (bufSize >= T::blockSize_) {
 			assert(self.roundBufSize_ == 0);
-			self.round(buf);
-			buf += T::blockSize_;
-			bufSize -= T::blockSize_;
+			const size_t n = bufSize / T::blockSize_;
+			self.rounds(buf, n);
+			buf += n * T::blockSize_;
+			bufSize -= n * T::blockSize_;
 		}
 		if (bufSize > 0) {
 			assert(bufSize < T::blockSize_);
@@ -567,63 +994,18 @@ private:
 	uint8_t roundBuf_[blockSize_];
 	uint32_t h_[hSize_];
 	static const size_t outByteSize_ = hSize_ * sizeof(uint32_t);
-	const uint32_t *k_;
-
-	template<size_t i0, size_t i1, size_t i2, size_t i3, size_t i4, size_t i5, size_t i6, size_t i7>
-	void round1(uint32_t *s, uint32_t *w, int i)
-	{
-		using namespace sha2_local;
-		uint32_t e = s[i4];
-		uint32_t h = s[i7];
-		h += rot32(e, 6) ^ rot32(e, 11) ^ rot32(e, 25);
-		uint32_t f = s[i5];
-		uint32_t g = s[i6];
-		h += g ^ (e & (f ^ g));
-		h += k_[i];
-		h += w[i];
-		s[i3] += h;
-		uint32_t a = s[i0];
-		uint32_t b = s[i1];
-		uint32_t c = s[i2];
-		h += rot32(a, 2) ^ rot32(a, 13) ^ rot32(a, 22);
-		h += ((a | b) & c) | (a & b);
-		s[i7] = h;
-	}
+
 	/**
 		@param buf [in] buffer(64byte)
 	*/
 	void round(const uint8_t *buf)
 	{
-		using namespace sha2_local;
-		uint32_t w[64];
-		for (int i = 0; i < 16; i++) {
-			w[i] = cybozu::Get32bitAsBE(&buf[i * 4]);
-		}
-		for (int i = 16 ; i < 64; i++) {
-			uint32_t t = w[i - 15];
-			uint32_t s0 = rot32(t, 7) ^ rot32(t, 18) ^ (t >> 3);
-			t = w[i - 2];
-			uint32_t s1 = rot32(t, 17) ^ rot32(t, 19) ^ (t >> 10);
-			w[i] = w[i - 16] + s0 + w[i - 7] + s1;
-		}
-		uint32_t s[8];
-		for (int i = 0; i < 8; i++) {
-			s[i] = h_[i];
-		}
-		for (int i = 0; i < 64; i += 8) {
-			round1<0, 1, 2, 3, 4, 5, 6, 7>(s, w, i + 0);
-			round1<7, 0, 1, 2, 3, 4, 5, 6>(s, w, i + 1);
-			round1<6, 7, 0, 1, 2, 3, 4, 5>(s, w, i + 2);
-			round1<5, 6, 7, 0, 1, 2, 3, 4>(s, w, i + 3);
-			round1<4, 5, 6, 7, 0, 1, 2, 3>(s, w, i + 4);
-			round1<3, 4, 5, 6, 7, 0, 1, 2>(s, w, i + 5);
-			round1<2, 3, 4, 5, 6, 7, 0, 1>(s, w, i + 6);
-			round1<1, 2, 3, 4, 5, 6, 7, 0>(s, w, i + 7);
-		}
-		for (int i = 0; i < 8; i++) {
-			h_[i] += s[i];
-		}
-		totalSize_ += blockSize_;
+		rounds(buf, 1);
+	}
+	void rounds(const uint8_t *buf, size_t n)
+	{
+		sha2_local::sha256Blocks(h_, buf, n);
+		totalSize_ += n * blockSize_;
 	}
 public:
 	Sha256()
@@ -632,27 +1014,9 @@ public:
 	}
 	void clear()
 	{
-		static const uint32_t kTbl[] = {
-			0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
-			0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
-			0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
-			0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
-			0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
-			0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
-			0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
-			0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
-		};
-		k_ = kTbl;
 		totalSize_ = 0;
 		roundBufSize_ = 0;
-		h_[0] = 0x6a09e667;
-		h_[1] = 0xbb67ae85;
-		h_[2] = 0x3c6ef372;
-		h_[3] = 0xa54ff53a;
-		h_[4] = 0x510e527f;
-		h_[5] = 0x9b05688c;
-		h_[6] = 0x1f83d9ab;
-		h_[7] = 0x5be0cd19;
+		sha2_local::setSha256Iv(h_);
 	}
 	void update(const void *buf, size_t bufSize)
 	{
@@ -682,65 +1046,18 @@ private:
 	uint8_t roundBuf_[blockSize_];
 	uint64_t h_[hSize_];
 	static const size_t outByteSize_ = hSize_ * sizeof(uint64_t);
-	const uint64_t *k_;
-
-	template<size_t i0, size_t i1, size_t i2, size_t i3, size_t i4, size_t i5, size_t i6, size_t i7>
-	void round1(uint64_t *S, const uint64_t *w, size_t i)
-	{
-		using namespace sha2_local;
-		uint64_t& a = S[i0];
-		uint64_t& b = S[i1];
-		uint64_t& c = S[i2];
-		uint64_t& d = S[i3];
-		uint64_t& e = S[i4];
-		uint64_t& f = S[i5];
-		uint64_t& g = S[i6];
-		uint64_t& h = S[i7];
-
-		uint64_t s1 = rot64(e, 14) ^ rot64(e, 18) ^ rot64(e, 41);
-		uint64_t ch = g ^ (e & (f ^ g));
-		uint64_t t0 = h + s1 + ch + k_[i] + w[i];
-		uint64_t s0 = rot64(a, 28) ^ rot64(a, 34) ^ rot64(a, 39);
-		uint64_t maj = ((a | b) & c) | (a & b);
-		uint64_t t1 = s0 + maj;
-		d += t0;
-		h = t0 + t1;
-	}
+
 	/**
-		@param buf [in] buffer(64byte)
+		@param buf [in] buffer(128byte)
 	*/
 	void round(const uint8_t *buf)
 	{
-		using namespace sha2_local;
-		uint64_t w[80];
-		for (int i = 0; i < 16; i++) {
-			w[i] = cybozu::Get64bitAsBE(&buf[i * 8]);
-		}
-		for (int i = 16 ; i < 80; i++) {
-			uint64_t t = w[i - 15];
-			uint64_t s0 = rot64(t, 1) ^ rot64(t, 8) ^ (t >> 7);
-			t = w[i - 2];
-			uint64_t s1 = rot64(t, 19) ^ rot64(t, 61) ^ (t >> 6);
-			w[i] = w[i - 16] + s0 + w[i - 7] + s1;
-		}
-		uint64_t s[8];
-		for (int i = 0; i < 8; i++) {
-			s[i] = h_[i];
-		}
-		for (int i = 0; i < 80; i += 8) {
-			round1<0, 1, 2, 3, 4, 5, 6, 7>(s, w, i + 0);
-			round1<7, 0, 1, 2, 3, 4, 5, 6>(s, w, i + 1);
-			round1<6, 7, 0, 1, 2, 3, 4, 5>(s, w, i + 2);
-			round1<5, 6, 7, 0, 1, 2, 3, 4>(s, w, i + 3);
-			round1<4, 5, 6, 7, 0, 1, 2, 3>(s, w, i + 4);
-			round1<3, 4, 5, 6, 7, 0, 1, 2>(s, w, i + 5);
-			round1<2, 3, 4, 5, 6, 7, 0, 1>(s, w, i + 6);
-			round1<1, 2, 3, 4, 5, 6, 7, 0>(s, w, i + 7);
-		}
-		for (int i = 0; i < 8; i++) {
-			h_[i] += s[i];
-		}
-		totalSize_ += blockSize_;
+		rounds(buf, 1);
+	}
+	void rounds(const uint8_t *buf, size_t n)
+	{
+		sha2_local::sha512Blocks(h_, buf, n);
+		totalSize_ += n * blockSize_;
 	}
 public:
 	Sha512()
@@ -749,35 +1066,9 @@ public:
 	}
 	void clear()
 	{
-		static const uint64_t kTbl[] = {
-		    0x428a2f98d728ae22ULL, 0x7137449123ef65cdULL, 0xb5c0fbcfec4d3b2fULL, 0xe9b5dba58189dbbcULL, 0x3956c25bf348b538ULL,
-		    0x59f111f1b605d019ULL, 0x923f82a4af194f9bULL, 0xab1c5ed5da6d8118ULL, 0xd807aa98a3030242ULL, 0x12835b0145706fbeULL,
-		    0x243185be4ee4b28cULL, 0x550c7dc3d5ffb4e2ULL, 0x72be5d74f27b896fULL, 0x80deb1fe3b1696b1ULL, 0x9bdc06a725c71235ULL,
-		    0xc19bf174cf692694ULL, 0xe49b69c19ef14ad2ULL, 0xefbe4786384f25e3ULL, 0x0fc19dc68b8cd5b5ULL, 0x240ca1cc77ac9c65ULL,
-		    0x2de92c6f592b0275ULL, 0x4a7484aa6ea6e483ULL, 0x5cb0a9dcbd41fbd4ULL, 0x76f988da831153b5ULL, 0x983e5152ee66dfabULL,
-		    0xa831c66d2db43210ULL, 0xb00327c898fb213fULL, 0xbf597fc7beef0ee4ULL, 0xc6e00bf33da88fc2ULL, 0xd5a79147930aa725ULL,
-		    0x06ca6351e003826fULL, 0x142929670a0e6e70ULL, 0x27b70a8546d22ffcULL, 0x2e1b21385c26c926ULL, 0x4d2c6dfc5ac42aedULL,
-		    0x53380d139d95b3dfULL, 0x650a73548baf63deULL, 0x766a0abb3c77b2a8ULL, 0x81c2c92e47edaee6ULL, 0x92722c851482353bULL,
-		    0xa2bfe8a14cf10364ULL, 0xa81a664bbc423001ULL, 0xc24b8b70d0f89791ULL, 0xc76c51a30654be30ULL, 0xd192e819d6ef5218ULL,
-		    0xd69906245565a910ULL, 0xf40e35855771202aULL, 0x106aa07032bbd1b8ULL, 0x19a4c116b8d2d0c8ULL, 0x1e376c085141ab53ULL,
-		    0x2748774cdf8eeb99ULL, 0x34b0bcb5e19b48a8ULL, 0x391c0cb3c5c95a63ULL, 0x4ed8aa4ae3418acbULL, 0x5b9cca4f7763e373ULL,
-		    0x682e6ff3d6b2b8a3ULL, 0x748f82ee5defb2fcULL, 0x78a5636f43172f60ULL, 0x84c87814a1f0ab72ULL, 0x8cc702081a6439ecULL,
-		    0x90befffa23631e28ULL, 0xa4506cebde82bde9ULL, 0xbef9a3f7b2c67915ULL, 0xc67178f2e372532bULL, 0xca273eceea26619cULL,
-		    0xd186b8c721c0c207ULL, 0xeada7dd6cde0eb1eULL, 0xf57d4f7fee6ed178ULL, 0x06f067aa72176fbaULL, 0x0a637dc5a2c898a6ULL,
-		    0x113f9804bef90daeULL, 0x1b710b35131c471bULL, 0x28db77f523047d84ULL, 0x32caab7b40c72493ULL, 0x3c9ebe0a15c9bebcULL,
-		    0x431d67c49c100d4cULL, 0x4cc5d4becb3e42b6ULL, 0x597f299cfc657e2aULL, 0x5fcb6fab3ad6faecULL, 0x6c44198c4a475817ULL
-		};
-		k_ = kTbl;
 		totalSize_ = 0;
 		roundBufSize_ = 0;
-		h_[0] = 0x6a09e667f3bcc908ull;
-		h_[1] = 0xbb67ae8584caa73bull;
-		h_[2] = 0x3c6ef372fe94f82bull;
-		h_[3] = 0xa54ff53a5f1d36f1ull;
-		h_[4] = 0x510e527fade682d1ull;
-		h_[5] = 0x9b05688c2b3e6c1full;
-		h_[6] = 0x1f83d9abfb41bd6bull;
-		h_[7] = 0x5be0cd19137e2179ull;
+		sha2_local::setSha512Iv(h_);
 	}
 	void update(const void *buf, size_t bufSize)
 	{
@@ -788,10 +1079,7 @@ public:
 		if (mdSize < outByteSize_) return 0;
 		update(buf, bufSize);
 		term(roundBuf_, roundBufSize_);
-		char *p = reinterpret_cast<char*>(md);
-		for (size_t i = 0; i < hSize_; i++) {
-			cybozu::Set64bitAsBE(&p[i * sizeof(h_[0])], h_[i]);
-		}
+		sha2_local::putSha512Digest(md, h_);
 		return outByteSize_;
 	}
 };
@@ -805,9 +1093,169 @@ namespace cybozu {
 namespace sha2_local {
 
 /*
-	HMAC (RFC 2104)
-	@param out [out] must have hashSize bytes
-	@param T [in] Sha256 or Sha512
+	hash n messages one by one
+	H is Sha256Func, Sha512Func or sha1_local::Sha1Func
+	@param iv [in] initial state
+	@param prefixSize [in] byte size of data hashed into iv
+*/
+template<class H>
+void hashBatchSeq(uint8_t *out, const void *const *bufs, const size_t *sizes, size_t n, const typename H::Word *iv, uint64_t prefixSize)
+{
+	for (size_t i = 0; i < n; i++) {
+		const uint8_t *p = static_cast<const uint8_t*>(bufs[i]);
+		typename H::Word h[H::hSize];
+		uint8_t tail[H::blockSize * 2];
+		memcpy(h, iv, sizeof(h));
+		H::blocks(h, p, sizes[i] / H::blockSize);
+		H::blocks(h, tail, makeHashTail<H::blockSize>(tail, p, sizes[i], prefixSize));
+		H::putDigest(out + i * H::mdSize, h);
+	}
+}
+
+/*
+	lane scheduler of sha256Batch and sha1Batch
+	each lane hashes the full blocks of a message and then its padded tail
+	a finished lane takes the next message, and idle lanes hash a copy of an active lane
+	the rest is hashed one by one if less than half of the lanes are active
+	@param lanes [in] st[i * N + j] is h[i] of the j-th lane
+	@note out may overlap bufs[i] if sizes[i] < 64 because a short message is copied before hashing
+*/
+template<class H, int N>
+void hashBatchT(void (*lanes)(uint32_t*, const uint8_t *const*, size_t), uint8_t *out, const void *const *bufs, const size_t *sizes, size_t n, const uint32_t *iv, uint64_t prefixSize)
+{
+	struct Lane {
+		size_t idx; // index of message or n if idle
+		const uint8_t *p;
+		size_t blockNum; // rest of blocks of p
+		size_t tailNum;
+		uint8_t tail[128];
+	} lane[N];
+	uint32_t st[H::hSize * N];
+	const uint8_t *ptr[N];
+	size_t next = 0;
+	int active = 0;
+	for (int j = 0; j < N; j++) lane[j].idx = n;
+	for (;;) {
+		for (int j = 0; j < N && next < n; j++) {
+			Lane& L = lane[j];
+			if (L.idx != n) continue;
+			L.idx = next++;
+			L.p = static_cast<const uint8_t*>(bufs[L.idx]);
+			L.blockNum = sizes[L.idx] / 64;
+			L.tailNum = makeHashTail<64>(L.tail, L.p, sizes[L.idx], prefixSize);
+			if (L.blockNum == 0) {
+				L.p = L.tail;
+				L.blockNum = L.tailNum;
+				L.tailNum = 0;
+			}
+			for (size_t i = 0; i < H::hSize; i++) st[i * N + j] = iv[i];
+			active++;
+		}
+		if (active == 0) return;
+		if (next == n && active * 2 < N) break;
+		size_t m = size_t(-1);
+		const uint8_t *dummy = 0;
+		for (int j = 0; j < N; j++) {
+			if (lane[j].idx == n) continue;
+			if (lane[j].blockNum < m) m = lane[j].blockNum;
+			dummy = lane[j].p;
+		}
+		for (int j = 0; j < N; j++) {
+			ptr[j] = lane[j].idx == n ? dummy : lane[j].p;
+		}
+		lanes(st, ptr, m);
+		for (int j = 0; j < N; j++) {
+			Lane& L = lane[j];
+			if (L.idx == n) continue;
+			L.p += m * 64;
+			L.blockNum -= m;
+			if (L.blockNum > 0) continue;
+			if (L.tailNum > 0) {
+				L.p = L.tail;
+				L.blockNum = L.tailNum;
+				L.tailNum = 0;
+				continue;
+			}
+			uint32_t h[H::hSize];
+			for (size_t i = 0; i < H::hSize; i++) h[i] = st[i * N + j];
+			H::putDigest(out + L.idx * H::mdSize, h);
+			L.idx = n;
+			active--;
+		}
+	}
+	for (int j = 0; j < N; j++) {
+		Lane& L = lane[j];
+		if (L.idx == n) continue;
+		uint32_t h[H::hSize];
+		for (size_t i = 0; i < H::hSize; i++) h[i] = st[i * N + j];
+		H::blocks(h, L.p, L.blockNum);
+		if (L.tailNum > 0) H::blocks(h, L.tail, L.tailNum);
+		H::putDigest(out + L.idx * H::mdSize, h);
+	}
+}
+
+/*
+	select the lanes of H by CPU features
+	H is Sha256Func or sha1_local::Sha1Func
+*/
+template<class H>
+void hashBatch(uint8_t *out, const void *const *bufs, const size_t *sizes, size_t n, const uint32_t *iv, uint64_t prefixSize)
+{
+#ifdef CYBOZU_SHA2_USE_SIMD
+	const int f = getSha256Feature();
+	if (f & sha256Avx512) {
+		hashBatchT<H, 16>(H::lanes16, out, bufs, sizes, n, iv, prefixSize);
+		return;
+	}
+	if ((f & sha256Avx2) && !(f & sha256ShaNi)) {
+		hashBatchT<H, 8>(H::lanes8, out, bufs, sizes, n, iv, prefixSize);
+		return;
+	}
+#endif
+	hashBatchSeq<H>(out, bufs, sizes, n, iv, prefixSize);
+}
+
+/*
+	raw SHA-256 for hashBatch and HmacT
+*/
+struct Sha256Func {
+	typedef uint32_t Word;
+	static const size_t hSize = 8;
+	static const size_t mdSize = 32;
+	static const size_t blockSize = 64;
+	static void setIv(uint32_t *h) { setSha256Iv(h); }
+	static void blocks(uint32_t *h, const uint8_t *p, size_t blockNum) { sha256Blocks(h, p, blockNum); }
+	static void putDigest(uint8_t *out, const uint32_t *h) { putSha256Digest(out, h); }
+#ifdef CYBOZU_SHA2_USE_SIMD
+	static void lanes8(uint32_t *st, const uint8_t *const *p, size_t blockNum) { sha256Lanes8(st, p, blockNum); }
+	static void lanes16(uint32_t *st, const uint8_t *const *p, size_t blockNum) { sha256Lanes16(st, p, blockNum); }
+#endif
+	static void batch(uint8_t *out, const void *const *bufs, const size_t *sizes, size_t n, const uint32_t *iv, uint64_t prefixSize)
+	{
+		hashBatch<Sha256Func>(out, bufs, sizes, n, iv, prefixSize);
+	}
+};
+
+/*
+	raw SHA-512 for HmacT ; there are no lanes
+*/
+struct Sha512Func {
+	typedef uint64_t Word;
+	static const size_t hSize = 8;
+	static const size_t mdSize = 64;
+	static const size_t blockSize = 128;
+	static void setIv(uint64_t *h) { setSha512Iv(h); }
+	static void blocks(uint64_t *h, const uint8_t *p, size_t blockNum) { sha512Blocks(h, p, blockNum); }
+	static void putDigest(uint8_t *out, const uint64_t *h) { putSha512Digest(out, h); }
+	static void batch(uint8_t *out, const void *const *bufs, const size_t *sizes, size_t n, const uint64_t *iv, uint64_t prefixSize)
+	{
+		hashBatchSeq<Sha512Func>(out, bufs, sizes, n, iv, prefixSize);
+	}
+};
+
+/*
+	one-shot HMAC by T = Sha256, Sha512 or Sha1
+	it uses the backend of T (OpenSSL etc.), which is faster than HmacT for a long message
 */
 template<class T, size_t hashSize, size_t blockSize>
 void hmac(void *out, const void *key, size_t keySize, const void *msg, size_t msgSize)
@@ -820,7 +1268,7 @@ void hmac(void *out, const void *key, size_t keySize, const void *msg, size_t ms
 		hash.digest(k, hashSize, key, keySize);
 		hash.clear();
 		keySize = hashSize;
-	} else {
+	} else if (keySize > 0) {
 		memcpy(k, key, keySize);
 	}
 	for (size_t i = 0; i < keySize; i++) {
@@ -839,6 +1287,177 @@ void hmac(void *out, const void *key, size_t keySize, const void *msg, size_t ms
 
 } // cybozu::sha2_local
 
+/*
+	HMAC (RFC 2104) context of a key
+	setKey hashes key ^ ipad and key ^ opad once and keeps the two states,
+	so a MAC costs the hash of the message and one more block
+	it uses no heap memory, and its running time depends only on the sizes of the key and message
+	H is sha2_local::Sha256Func, Sha512Func or sha1_local::Sha1Func ; use Hmac256, Hmac512 or Hmac1
+
+	cybozu::Hmac256 hmac(key, keySize);
+	hmac.compute(mac, msg, msgSize);
+	hmac.computeBatch(macs, msgs, sizes, n); // 32 * n bytes
+	if (!hmac.verify(mac, msg, msgSize)) error;
+*/
+template<class H>
+class HmacT {
+	typedef typename H::Word Word;
+	static const size_t blockSize = H::blockSize;
+	Word inner_[H::hSize]; // state after key ^ ipad
+	Word outer_[H::hSize]; // state after key ^ opad
+	Word h_[H::hSize]; // state of update
+	uint8_t buf_[H::blockSize];
+	size_t bufSize_;
+	uint64_t totalSize_; // byte size given by update
+	/*
+		md = hash of [p, p + size) from the state iv after prefixSize bytes
+	*/
+	static void hash(uint8_t *md, const Word *iv, const uint8_t *p, size_t size, uint64_t prefixSize)
+	{
+		Word h[H::hSize];
+		uint8_t tail[blockSize * 2];
+		memcpy(h, iv, sizeof(h));
+		H::blocks(h, p, size / blockSize);
+		H::blocks(h, tail, sha2_local::makeHashTail<blockSize>(tail, p, size, prefixSize));
+		H::putDigest(md, h);
+	}
+public:
+	static const size_t macSize = H::mdSize;
+	/*
+		the key is empty
+	*/
+	HmacT()
+	{
+		setKey(0, 0);
+	}
+	HmacT(const void *key, size_t keySize)
+	{
+		setKey(key, keySize);
+	}
+	void setKey(const void *key, size_t keySize)
+	{
+		const uint8_t ipad = 0x36;
+		const uint8_t opad = 0x5c;
+		uint8_t k[blockSize];
+		if (keySize > blockSize) {
+			Word iv[H::hSize];
+			H::setIv(iv);
+			hash(k, iv, static_cast<const uint8_t*>(key), keySize, 0);
+			keySize = H::mdSize;
+		} else if (keySize > 0) {
+			memcpy(k, key, keySize);
+		}
+		memset(k + keySize, 0, blockSize - keySize);
+		for (size_t i = 0; i < blockSize; i++) {
+			k[i] ^= ipad;
+		}
+		H::setIv(inner_);
+		H::blocks(inner_, k, 1);
+		for (size_t i = 0; i < blockSize; i++) {
+			k[i] ^= ipad ^ opad;
+		}
+		H::setIv(outer_);
+		H::blocks(outer_, k, 1);
+		clear();
+	}
+	/*
+		discard data given by update
+	*/
+	void clear()
+	{
+		memcpy(h_, inner_, sizeof(h_));
+		bufSize_ = 0;
+		totalSize_ = 0;
+	}
+	void update(const void *buf, size_t bufSize)
+	{
+		if (bufSize == 0) return;
+		const uint8_t *p = static_cast<const uint8_t*>(buf);
+		totalSize_ += bufSize;
+		if (bufSize_ > 0) {
+			const size_t n = bufSize < blockSize - bufSize_ ? bufSize : blockSize - bufSize_;
+			memcpy(buf_ + bufSize_, p, n);
+			bufSize_ += n;
+			if (bufSize_ < blockSize) return;
+			H::blocks(h_, buf_, 1);
+			bufSize_ = 0;
+			p += n;
+			bufSize -= n;
+		}
+		const size_t blockNum = bufSize / blockSize;
+		H::blocks(h_, p, blockNum);
+		p += blockNum * blockSize;
+		bufSize -= blockNum * blockSize;
+		if (bufSize > 0) memcpy(buf_, p, bufSize);
+		bufSize_ = bufSize;
+	}
+	/*
+		MAC of data given by update and [buf, buf + bufSize)
+		data is cleared for the next message
+		@return macSize or 0 if mdSize < macSize
+	*/
+	size_t digest(void *md, size_t mdSize, const void *buf = 0, size_t bufSize = 0)
+	{
+		if (mdSize < macSize) return 0;
+		update(buf, bufSize);
+		uint8_t t[H::mdSize];
+		hash(t, h_, buf_, bufSize_, blockSize + totalSize_ - bufSize_);
+		hash(static_cast<uint8_t*>(md), outer_, t, H::mdSize, blockSize);
+		clear();
+		return macSize;
+	}
+	/*
+		MAC of [msg, msg + msgSize) ; it does not change data given by update
+		@param mac [out] macSize bytes
+	*/
+	void compute(void *mac, const void *msg, size_t msgSize) const
+	{
+		uint8_t t[H::mdSize];
+		hash(t, inner_, static_cast<const uint8_t*>(msg), msgSize, blockSize);
+		hash(static_cast<uint8_t*>(mac), outer_, t, H::mdSize, blockSize);
+	}
+	/*
+		MACs of n messages
+		messages are hashed in parallel by the lanes of sha256Batch and sha1Batch
+		@param macs [out] n * macSize bytes ; macs + i * macSize is the MAC of msgs[i]
+	*/
+	void computeBatch(void *macs, const void *const *msgs, const size_t *sizes, size_t n) const
+	{
+		uint8_t *q = static_cast<uint8_t*>(macs);
+		H::batch(q, msgs, sizes, n, inner_, blockSize);
+		// outer hashes of the inner digests in q
+		const size_t maxN = 64;
+		const void *ptr[maxN];
+		size_t size[maxN];
+		for (size_t i = 0; i < n; i += maxN) {
+			const size_t m = n - i < maxN ? n - i : maxN;
+			for (size_t j = 0; j < m; j++) {
+				ptr[j] = q + (i + j) * H::mdSize;
+				size[j] = H::mdSize;
+			}
+			H::batch(q + i * H::mdSize, ptr, size, m, outer_, blockSize);
+		}
+	}
+	/*
+		compare mac with the MAC of [msg, msg + msgSize) in constant time
+		@param mac [in] macSize bytes
+	*/
+	bool verify(const void *mac, const void *msg, size_t msgSize) const
+	{
+		uint8_t t[H::mdSize];
+		compute(t, msg, msgSize);
+		const uint8_t *p = static_cast<const uint8_t*>(mac);
+		uint8_t diff = 0;
+		for (size_t i = 0; i < H::mdSize; i++) {
+			diff |= t[i] ^ p[i];
+		}
+		return diff == 0;
+	}
+};
+
+typedef HmacT<sha2_local::Sha256Func> Hmac256;
+typedef HmacT<sha2_local::Sha512Func> Hmac512;
+
 /*
 	HMAC-SHA-256
 	hmac must have 32 bytes buffer
@@ -857,4 +1476,18 @@ inline void hmac512(void *hmac, const void *key, size_t keySize, const void *msg
 	sha2_local::hmac<Sha512, 64, 128>(hmac, key, keySize, msg, msgSize);
 }
 
+/*
+	SHA-256 of n messages
+	@param bufs [in] bufs[i] is the i-th message
+	@param sizes [in] sizes[i] is the byte size of bufs[i]
+	@param out [out] n * 32 bytes ; out + i * 32 is the digest of bufs[i]
+	@note messages are hashed in parallel by AVX-512(16 lanes) or AVX2(8 lanes) if available
+*/
+inline void sha256Batch(const void *const *bufs, const size_t *sizes, size_t n, void *out)
+{
+	uint32_t iv[8];
+	sha2_local::setSha256Iv(iv);
+	sha2_local::hashBatch<sha2_local::Sha256Func>(static_cast<uint8_t*>(out), bufs, sizes, n, iv, 0);
+}
+
 } // cybozu
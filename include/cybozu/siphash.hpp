@@ -7,6 +7,17 @@
 */
 
 #include <cybozu/endian.hpp>
+#include <memory.h>
+
+/*
+	siphash24Batch uses AVX2/AVX-512 lanes selected at runtime
+	define CYBOZU_SIPHASH_DONT_USE_SIMD to disable them
+*/
+#if !defined(CYBOZU_SIPHASH_DONT_USE_SIMD) && CYBOZU_HOST == CYBOZU_HOST_INTEL && !defined(_MSC_VER) \
+	&& ((defined(__clang__) && __clang_major__ >= 8) || (!defined(__clang__) && __GNUC__ >= 5))
+	#define CYBOZU_SIPHASH_USE_SIMD
+	#include <cpuid.h>
+#endif
 
 namespace cybozu {
 
@@ -33,9 +44,174 @@ inline void doubleRound(uint64_t &v0, uint64_t &v1, uint64_t &v2, uint64_t &v3)
 	halfRound(v2, v1, v0, v3, 17, 21);
 }
 
+/*
+	the last block made of the rest of bytes and the size
+*/
+inline uint64_t getLastBlock(const uint8_t *in, size_t srcSize)
+{
+	uint64_t b = (uint64_t)srcSize << 56;
+	in += srcSize & ~size_t(7);
+	switch (srcSize & 7) {
+	case 7: b |= uint64_t(in[6]) << 48; // fallthrough
+	case 6: b |= uint64_t(in[5]) << 40; // fallthrough
+	case 5: b |= uint64_t(in[4]) << 32; // fallthrough
+	case 4: b |= uint64_t(in[3]) << 24; // fallthrough
+	case 3: b |= uint64_t(in[2]) << 16; // fallthrough
+	case 2: b |= uint64_t(in[1]) << 8; // fallthrough
+	case 1: b |= in[0]; // fallthrough
+	}
+	return b;
+}
+
+enum {
+	simdAvx2 = 1,
+	simdAvx512 = 2
+};
+
+#ifdef CYBOZU_SIPHASH_USE_SIMD
+inline int detectSimdFeature()
+{
+	unsigned int a, b, c, d;
+	if (__get_cpuid_max(0, 0) < 7) return 0;
+	__cpuid(1, a, b, c, d);
+	if ((c & (1u << 27)) == 0) return 0; // OSXSAVE
+	uint32_t xcr0, xcr0H;
+	__asm__ volatile("xgetbv" : "=a"(xcr0), "=d"(xcr0H) : "c"(0));
+	__cpuid_count(7, 0, a, b, c, d);
+	int f = 0;
+	if ((xcr0 & 0x06) == 0x06 && (b & (1u << 5))) f |= simdAvx2;
+	if ((xcr0 & 0xe6) == 0xe6 && (b & (1u << 16))) f |= simdAvx512;
+	return f;
+}
+
+inline int& getSimdFeatureRef()
+{
+	static int f = detectSimdFeature();
+	return f;
+}
+#endif
+
+inline int getSimdFeature()
+{
+#ifdef CYBOZU_SIPHASH_USE_SIMD
+	return getSimdFeatureRef();
+#else
+	return 0;
+#endif
+}
+
+/*
+	use only the kernels in mask (for test)
+*/
+inline void limitSimdFeature(int mask)
+{
+#ifdef CYBOZU_SIPHASH_USE_SIMD
+	getSimdFeatureRef() = detectSimdFeature() & mask;
+#else
+	(void)mask;
+#endif
+}
+
+#ifdef CYBOZU_SIPHASH_USE_SIMD
+/*
+	siphash24 of N messages in parallel by vector extensions of GCC
+	it is inlined into the functions with target attributes to use AVX2/AVX-512
+	a lane which has finished keeps its state by mask
+*/
+template<class V, int N>
+__attribute__((always_inline)) inline void siphash24LanesT(uint64_t *out, const void *const *bufs, const size_t *sizes, uint64_t k0, uint64_t k1)
+{
+#define CYBOZU_SIPHASH_ROT(x, s) (((x) << (s)) | ((x) >> (64 - (s))))
+#define CYBOZU_SIPHASH_HALF(a, b, c, d, s, t) \
+	a += b; c += d; \
+	b = CYBOZU_SIPHASH_ROT(b, s) ^ a; \
+	d = CYBOZU_SIPHASH_ROT(d, t) ^ c; \
+	a = CYBOZU_SIPHASH_ROT(a, 32);
+#define CYBOZU_SIPHASH_DOUBLE \
+	CYBOZU_SIPHASH_HALF(v0, v1, v2, v3, 13, 16) \
+	CYBOZU_SIPHASH_HALF(v2, v1, v0, v3, 17, 21) \
+	CYBOZU_SIPHASH_HALF(v0, v1, v2, v3, 13, 16) \
+	CYBOZU_SIPHASH_HALF(v2, v1, v0, v3, 17, 21)
+	const V zero = V();
+	V v0 = zero + (k0 ^ uint64_t(0x736f6d6570736575ULL));
+	V v1 = zero + (k1 ^ uint64_t(0x646f72616e646f6dULL));
+	V v2 = zero + (k0 ^ uint64_t(0x6c7967656e657261ULL));
+	V v3 = zero + (k1 ^ uint64_t(0x7465646279746573ULL));
+	size_t blockNum[N];
+	size_t minBlockNum = size_t(-1), maxBlockNum = 0;
+	for (int j = 0; j < N; j++) {
+		blockNum[j] = sizes[j] / 8;
+		if (blockNum[j] < minBlockNum) minBlockNum = blockNum[j];
+		if (blockNum[j] > maxBlockNum) maxBlockNum = blockNum[j];
+	}
+	CYBOZU_ALIGN(64) uint64_t mBuf[N];
+	CYBOZU_ALIGN(64) uint64_t maskBuf[N];
+	// all lanes are active
+	for (size_t i = 0; i < minBlockNum; i++) {
+		for (int j = 0; j < N; j++) {
+			mBuf[j] = cybozu::Get64bitAsLE(static_cast<const uint8_t*>(bufs[j]) + i * 8);
+		}
+		V m;
+		memcpy(&m, mBuf, sizeof(m));
+		v3 ^= m;
+		CYBOZU_SIPHASH_DOUBLE
+		v0 ^= m;
+	}
+	for (size_t i = minBlockNum; i <= maxBlockNum; i++) {
+		for (int j = 0; j < N; j++) {
+			const uint8_t *in = static_cast<const uint8_t*>(bufs[j]);
+			if (i < blockNum[j]) {
+				mBuf[j] = cybozu::Get64bitAsLE(in + i * 8);
+				maskBuf[j] = ~uint64_t(0);
+			} else if (i == blockNum[j]) {
+				mBuf[j] = getLastBlock(in, sizes[j]);
+				maskBuf[j] = ~uint64_t(0);
+			} else {
+				mBuf[j] = 0;
+				maskBuf[j] = 0;
+			}
+		}
+		V m, mask;
+		memcpy(&m, mBuf, sizeof(m));
+		memcpy(&mask, maskBuf, sizeof(mask));
+		const V t0 = v0, t1 = v1, t2 = v2, t3 = v3;
+		v3 ^= m;
+		CYBOZU_SIPHASH_DOUBLE
+		v0 ^= m;
+		v0 = (v0 & mask) | (t0 & ~mask);
+		v1 = (v1 & mask) | (t1 & ~mask);
+		v2 = (v2 & mask) | (t2 & ~mask);
+		v3 = (v3 & mask) | (t3 & ~mask);
+	}
+	v2 ^= 0xff;
+	CYBOZU_SIPHASH_DOUBLE
+	CYBOZU_SIPHASH_DOUBLE
+	const V r = (v0 ^ v1) ^ (v2 ^ v3);
+	memcpy(out, &r, sizeof(r));
+#undef CYBOZU_SIPHASH_DOUBLE
+#undef CYBOZU_SIPHASH_HALF
+#undef CYBOZU_SIPHASH_ROT
+}
+
+typedef uint64_t SipHashV4 __attribute__((vector_size(32)));
+typedef uint64_t SipHashV8 __attribute__((vector_size(64)));
+
+__attribute__((target("avx2")))
+inline void siphash24Lanes4(uint64_t *out, const void *const *bufs, const size_t *sizes, uint64_t k0, uint64_t k1)
+{
+	siphash24LanesT<SipHashV4, 4>(out, bufs, sizes, k0, k1);
+}
+
+__attribute__((target("avx512f")))
+inline void siphash24Lanes8(uint64_t *out, const void *const *bufs, const size_t *sizes, uint64_t k0, uint64_t k1)
+{
+	siphash24LanesT<SipHashV8, 8>(out, bufs, sizes, k0, k1);
+}
+#endif
+
 } // cybozu::siphash_local
 
-uint64_t siphash24(const void *src, size_t srcSize, uint64_t k0 = uint64_t(0x0706050403020100ULL), uint64_t k1 = uint64_t(0x0f0e0d0c0b0a0908ULL))
+inline uint64_t siphash24(const void *src, size_t srcSize, uint64_t k0 = uint64_t(0x0706050403020100ULL), uint64_t k1 = uint64_t(0x0f0e0d0c0b0a0908ULL))
 {
 	uint64_t v0 = k0 ^ uint64_t(0x736f6d6570736575ULL);
 	uint64_t v1 = k1 ^ uint64_t(0x646f72616e646f6dULL);
@@ -43,7 +219,7 @@ uint64_t siphash24(const void *src, size_t srcSize, uint64_t k0 = uint64_t(0x070
 	uint64_t v3 = k1 ^ uint64_t(0x7465646279746573ULL);
 
 	const uint8_t *in = (const uint8_t*)src;
-	uint64_t b = (uint64_t)srcSize << 56;
+	const uint64_t b = siphash_local::getLastBlock(in, srcSize);
 
 	while (srcSize >= 8) {
 		uint64_t mi = cybozu::Get64bitAsLE(in);
@@ -53,16 +229,6 @@ uint64_t siphash24(const void *src, size_t srcSize, uint64_t k0 = uint64_t(0x070
 		v0 ^= mi;
 	}
 
-	switch (srcSize) {
-	case 7: b |= uint64_t(in[6]) << 48; // fallthrough
-	case 6: b |= uint64_t(in[5]) << 40; // fallthrough
-	case 5: b |= uint64_t(in[4]) << 32; // fallthrough
-	case 4: b |= uint64_t(in[3]) << 24; // fallthrough
-	case 3: b |= uint64_t(in[2]) << 16; // fallthrough
-	case 2: b |= uint64_t(in[1]) << 8; // fallthrough
-	case 1: b |= in[0]; // fallthrough
-	}
-
 	v3 ^= b;
 	siphash_local::doubleRound(v0, v1, v2, v3);
 	v0 ^= b; v2 ^= 0xff;
@@ -71,6 +237,43 @@ uint64_t siphash24(const void *src, size_t srcSize, uint64_t k0 = uint64_t(0x070
 	return (v0 ^ v1) ^ (v2 ^ v3);
 }
 
+/*
+	out[i] = siphash24(bufs[i], sizes[i], k0, k1) for i = 0, ..., n - 1
+	@note keys of similar sizes are hashed in parallel by AVX-512(8 lanes) or AVX2(4 lanes) if available
+*/
+inline void siphash24Batch(uint64_t *out, const void *const *bufs, const size_t *sizes, size_t n, uint64_t k0 = uint64_t(0x0706050403020100ULL), uint64_t k1 = uint64_t(0x0f0e0d0c0b0a0908ULL))
+{
+	size_t i = 0;
+#ifdef CYBOZU_SIPHASH_USE_SIMD
+	using namespace siphash_local;
+	const int f = getSimdFeature();
+	const size_t N = (f & simdAvx512) ? 8 : (f & simdAvx2) ? 4 : 0;
+	if (N > 0) {
+		for (; i + N <= n; i += N) {
+			// a lane waits for the longest key, so a group of various sizes is hashed one by one
+			size_t minBlockNum = size_t(-1), maxBlockNum = 0;
+			for (size_t j = 0; j < N; j++) {
+				const size_t blockNum = sizes[i + j] / 8;
+				if (blockNum < minBlockNum) minBlockNum = blockNum;
+				if (blockNum > maxBlockNum) maxBlockNum = blockNum;
+			}
+			if (maxBlockNum > minBlockNum * 2 + 4) {
+				for (size_t j = 0; j < N; j++) {
+					out[i + j] = siphash24(bufs[i + j], sizes[i + j], k0, k1);
+				}
+			} else if (N == 8) {
+				siphash24Lanes8(out + i, bufs + i, sizes + i, k0, k1);
+			} else {
+				siphash24Lanes4(out + i, bufs + i, sizes + i, k0, k1);
+			}
+		}
+	}
+#endif
+	for (; i < n; i++) {
+		out[i] = siphash24(bufs[i], sizes[i], k0, k1);
+	}
+}
+
 } // cybozu
 
 /*
@@ -98,6 +98,49 @@ void writeSub(bool *pb, OutputStream& os, const void *buf, size_t size)
 }
 #endif
 
+/* true if OutputStream has void flush() */
+template<class OutputStream>
+struct has_flush {
+	typedef char yes;
+	typedef int no;
+	template<class T, void (T::*)()> struct Check;
+	template<class T> static yes test(Check<T, &T::flush>*);
+	template<class T> static no test(...);
+	static const bool value = sizeof(test<OutputStream>(0)) == sizeof(yes);
+};
+
+#if !defined(CYBOZU_DONT_USE_STRING) && !defined(CYBOZU_DONT_USE_EXCEPTION)
+/* specialization for ostream */
+template<class OutputStream>
+void flushSub(OutputStream& os, typename enable_if<is_convertible<OutputStream, std::ostream>::value>::type* = 0)
+{
+	if (!os.flush()) throw cybozu::Exception("stream:flushSub");
+}
+
+/* call void flush() if exists */
+template<class OutputStream>
+void flushSub(OutputStream& os, typename enable_if<!is_convertible<OutputStream, std::ostream>::value && has_flush<OutputStream>::value>::type* = 0)
+{
+	os.flush();
+}
+
+template<class OutputStream>
+void flushSub(OutputStream&, typename enable_if<!is_convertible<OutputStream, std::ostream>::value && !has_flush<OutputStream>::value>::type* = 0)
+{
+}
+#else
+template<class OutputStream>
+void flushSub(OutputStream& os, typename enable_if<has_flush<OutputStream>::value>::type* = 0)
+{
+	os.flush();
+}
+
+template<class OutputStream>
+void flushSub(OutputStream&, typename enable_if<!has_flush<OutputStream>::value>::type* = 0)
+{
+}
+#endif
+
 } // stream_local
 
 /*
@@ -121,6 +164,11 @@ struct OutputStreamTag {
 	{
 		stream_local::writeSub<OutputStream>(os, buf, size);
 	}
+	/* call flush() of os if it has one ; a stage forwards its flush() by this */
+	static void flush(OutputStream& os)
+	{
+		stream_local::flushSub<OutputStream>(os);
+	}
 };
 
 class MemoryInputStream {
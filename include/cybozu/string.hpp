@@ -23,6 +23,23 @@
 
 #include <cybozu/exception.hpp>
 #include <cybozu/hash.hpp>
+#include <cybozu/bit_operation.hpp>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#define CYBOZU_STRING_USE_SSE2
+	#include <emmintrin.h>
+#endif
+
+/*
+	SSSE3/AVX2 kernels of UTF-8 validation and conversion are selected at runtime
+	define CYBOZU_STRING_DONT_USE_SIMD to disable them
+*/
+#if !defined(CYBOZU_STRING_DONT_USE_SIMD) && defined(CYBOZU_STRING_USE_SSE2) && CYBOZU_HOST == CYBOZU_HOST_INTEL && !defined(_MSC_VER) \
+	&& ((defined(__clang__) && __clang_major__ >= 8) || (!defined(__clang__) && __GNUC__ >= 5))
+	#define CYBOZU_STRING_USE_SIMD
+	#include <immintrin.h>
+	#include <cpuid.h>
+#endif
 
 #if CYBOZU_CPLUSPLUS >= 202002L
 #include <compare>
@@ -171,6 +188,437 @@ struct disable_if { typedef T type; };
 template <class T>
 struct disable_if<true, T> {};
 
+/*
+	decode a non-ASCII character of UTF-8 at p(p < end, *p >= 0x80)
+	and seek p to next char
+	@return false if invalid(p is not changed)
+*/
+inline bool decodeUtf8(uint32_t *c, const uint8_t *&p, const uint8_t *end)
+{
+	const uint32_t c0 = p[0];
+	const size_t rest = end - p;
+	if (c0 < 0xe0) {
+		if (c0 < 0xc2 || rest < 2) return false;
+		const uint32_t c1 = p[1] ^ 0x80u;
+		if (c1 > 0x3f) return false;
+		*c = ((c0 & 0x1f) << 6) | c1;
+		p += 2;
+		return true;
+	}
+	if (c0 < 0xf0) {
+		if (rest < 3) return false;
+		const uint32_t c1 = p[1] ^ 0x80u;
+		const uint32_t c2 = p[2] ^ 0x80u;
+		if ((c1 | c2) > 0x3f) return false;
+		const uint32_t v = ((c0 & 0x0f) << 12) | (c1 << 6) | c2;
+		// reject overlong form and surrogate
+		if (v < 0x800 || v - 0xd800 < 0x800) return false;
+		*c = v;
+		p += 3;
+		return true;
+	}
+	if (c0 > 0xf4 || rest < 4) return false;
+	const uint32_t c1 = p[1] ^ 0x80u;
+	const uint32_t c2 = p[2] ^ 0x80u;
+	const uint32_t c3 = p[3] ^ 0x80u;
+	if ((c1 | c2 | c3) > 0x3f) return false;
+	const uint32_t v = ((c0 & 0x07) << 18) | (c1 << 12) | (c2 << 6) | c3;
+	if (v < 0x10000 || v > 0x10ffff) return false;
+	*c = v;
+	p += 4;
+	return true;
+}
+
+/*
+	encode c(0x80 <= c <= 0x10ffff and not surrogate) to UTF-8
+*/
+inline char *encodeUtf8(char *q, uint32_t c)
+{
+	if (c <= 0x7ff) {
+		q[0] = static_cast<char>((c >> 6) | 0xc0);
+		q[1] = static_cast<char>((c & 0x3f) | 0x80);
+		return q + 2;
+	}
+	if (c <= 0xffff) {
+		q[0] = static_cast<char>((c >> 12) | 0xe0);
+		q[1] = static_cast<char>(((c >> 6) & 0x3f) | 0x80);
+		q[2] = static_cast<char>((c & 0x3f) | 0x80);
+		return q + 3;
+	}
+	q[0] = static_cast<char>((c >> 18) | 0xf0);
+	q[1] = static_cast<char>(((c >> 12) & 0x3f) | 0x80);
+	q[2] = static_cast<char>(((c >> 6) & 0x3f) | 0x80);
+	q[3] = static_cast<char>((c & 0x3f) | 0x80);
+	return q + 4;
+}
+
+#ifdef CYBOZU_STRING_USE_SSE2
+/*
+	return a bit mask of non-ASCII bytes in [p, p + 16)
+*/
+inline int getNonAsciiMask16(const uint8_t *p)
+{
+	return _mm_movemask_epi8(_mm_loadu_si128(cybozu::cast<const __m128i*>(p)));
+}
+#endif
+
+enum {
+	stringSsse3 = 1,
+	stringAvx2 = 2
+};
+
+#ifdef CYBOZU_STRING_USE_SIMD
+inline int detectStringFeature()
+{
+	unsigned int a, b, c, d;
+	if (__get_cpuid_max(0, 0) < 1) return 0;
+	__cpuid(1, a, b, c, d);
+	if ((c & (1u << 9)) == 0) return 0; // SSSE3
+	int f = stringSsse3;
+	uint32_t xcr0 = 0, xcr0H;
+	if (c & (1u << 27)) { // OSXSAVE
+		__asm__ volatile("xgetbv" : "=a"(xcr0), "=d"(xcr0H) : "c"(0));
+	}
+	if (__get_cpuid_max(0, 0) < 7) return f;
+	__cpuid_count(7, 0, a, b, c, d);
+	if ((xcr0 & 0x06) == 0x06 && (b & (1u << 5))) f |= stringAvx2;
+	return f;
+}
+
+inline int& getStringFeatureRef()
+{
+	static int f = detectStringFeature();
+	return f;
+}
+#endif
+
+inline int getStringFeature()
+{
+#ifdef CYBOZU_STRING_USE_SIMD
+	return getStringFeatureRef();
+#else
+	return 0;
+#endif
+}
+
+/*
+	use only the kernels in mask (for test)
+*/
+inline void limitStringFeature(int mask)
+{
+#ifdef CYBOZU_STRING_USE_SIMD
+	getStringFeatureRef() = detectStringFeature() & mask;
+#else
+	(void)mask;
+#endif
+}
+
+#ifdef CYBOZU_STRING_USE_SIMD
+/*
+	lookup tables of the UTF-8 validation by Keiser and Lemire
+	("Validating UTF-8 In Less Than One Instruction Per Byte")
+	[0, 16) : error flags indexed by the high nibble of the previous byte
+	[16, 32) : error flags indexed by the low nibble of the previous byte
+	[32, 48) : error flags indexed by the high nibble of the current byte
+	[48, 80) : a byte greater than it at the end of a block starts an incomplete character
+*/
+inline const uint8_t *getUtf8CheckTbl()
+{
+	static const uint8_t tbl[] = {
+		0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x80, 0x80, 0x80, 0x80, 0x21, 0x01, 0x15, 0x49,
+		0xe7, 0xa3, 0x83, 0x83, 0x8b, 0xcb, 0xcb, 0xcb, 0xcb, 0xcb, 0xcb, 0xcb, 0xcb, 0xdb, 0xcb, 0xcb,
+		0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0xe6, 0xae, 0xba, 0xba, 0x01, 0x01, 0x01, 0x01,
+		0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+		0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xef, 0xdf, 0xbf,
+	};
+	return tbl;
+}
+
+/*
+	accumulate the errors of a block x of UTF-8 following a block prev into err
+*/
+__attribute__((target("ssse3")))
+inline void checkUtf8Ssse3(__m128i& err, __m128i& incomplete, __m128i& prev, __m128i x, const uint8_t *tbl)
+{
+	if (_mm_movemask_epi8(x) == 0) {
+		err = _mm_or_si128(err, incomplete);
+	} else {
+		const __m128i mask = _mm_set1_epi8(0x0f);
+		const __m128i prev1 = _mm_alignr_epi8(x, prev, 15);
+		const __m128i b1h = _mm_shuffle_epi8(_mm_loadu_si128(cybozu::cast<const __m128i*>(tbl)), _mm_and_si128(_mm_srli_epi16(prev1, 4), mask));
+		const __m128i b1l = _mm_shuffle_epi8(_mm_loadu_si128(cybozu::cast<const __m128i*>(tbl + 16)), _mm_and_si128(prev1, mask));
+		const __m128i b2h = _mm_shuffle_epi8(_mm_loadu_si128(cybozu::cast<const __m128i*>(tbl + 32)), _mm_and_si128(_mm_srli_epi16(x, 4), mask));
+		// the 3rd and 4th bytes of a character must be continuation bytes
+		const __m128i prev2 = _mm_subs_epu8(_mm_alignr_epi8(x, prev, 14), _mm_set1_epi8(0xe0 - 0x80));
+		const __m128i prev3 = _mm_subs_epu8(_mm_alignr_epi8(x, prev, 13), _mm_set1_epi8(0xf0 - 0x80));
+		const __m128i must23 = _mm_and_si128(_mm_or_si128(prev2, prev3), _mm_set1_epi8(static_cast<char>(0x80)));
+		err = _mm_or_si128(err, _mm_xor_si128(must23, _mm_and_si128(_mm_and_si128(b1h, b1l), b2h)));
+		incomplete = _mm_subs_epu8(x, _mm_loadu_si128(cybozu::cast<const __m128i*>(tbl + 64)));
+	}
+	prev = x;
+}
+
+__attribute__((target("ssse3")))
+inline bool isValidUtf8Ssse3(const uint8_t *p, size_t n)
+{
+	const uint8_t *tbl = getUtf8CheckTbl();
+	__m128i err = _mm_setzero_si128();
+	__m128i incomplete = err;
+	__m128i prev = err;
+	for (; n >= 16; p += 16, n -= 16) {
+		checkUtf8Ssse3(err, incomplete, prev, _mm_loadu_si128(cybozu::cast<const __m128i*>(p)), tbl);
+	}
+	if (n > 0) {
+		uint8_t buf[16] = {};
+		memcpy(buf, p, n);
+		checkUtf8Ssse3(err, incomplete, prev, _mm_loadu_si128(cybozu::cast<const __m128i*>(buf)), tbl);
+	}
+	err = _mm_or_si128(err, incomplete);
+	return _mm_movemask_epi8(_mm_cmpeq_epi8(err, _mm_setzero_si128())) == 0xffff;
+}
+
+__attribute__((target("avx2")))
+inline void checkUtf8Avx2(__m256i& err, __m256i& incomplete, __m256i& prev, __m256i x, const uint8_t *tbl)
+{
+	if (_mm256_movemask_epi8(x) == 0) {
+		err = _mm256_or_si256(err, incomplete);
+	} else {
+		const __m256i mask = _mm256_set1_epi8(0x0f);
+		// [prev[16, 32), x[0, 16)]
+		const __m256i mid = _mm256_permute2x128_si256(prev, x, 0x21);
+		const __m256i prev1 = _mm256_alignr_epi8(x, mid, 15);
+		const __m256i b1h = _mm256_shuffle_epi8(_mm256_broadcastsi128_si256(_mm_loadu_si128(cybozu::cast<const __m128i*>(tbl))), _mm256_and_si256(_mm256_srli_epi16(prev1, 4), mask));
+		const __m256i b1l = _mm256_shuffle_epi8(_mm256_broadcastsi128_si256(_mm_loadu_si128(cybozu::cast<const __m128i*>(tbl + 16))), _mm256_and_si256(prev1, mask));
+		const __m256i b2h = _mm256_shuffle_epi8(_mm256_broadcastsi128_si256(_mm_loadu_si128(cybozu::cast<const __m128i*>(tbl + 32))), _mm256_and_si256(_mm256_srli_epi16(x, 4), mask));
+		const __m256i prev2 = _mm256_subs_epu8(_mm256_alignr_epi8(x, mid, 14), _mm256_set1_epi8(0xe0 - 0x80));
+		const __m256i prev3 = _mm256_subs_epu8(_mm256_alignr_epi8(x, mid, 13), _mm256_set1_epi8(0xf0 - 0x80));
+		const __m256i must23 = _mm256_and_si256(_mm256_or_si256(prev2, prev3), _mm256_set1_epi8(static_cast<char>(0x80)));
+		err = _mm256_or_si256(err, _mm256_xor_si256(must23, _mm256_and_si256(_mm256_and_si256(b1h, b1l), b2h)));
+		incomplete = _mm256_subs_epu8(x, _mm256_loadu_si256(cybozu::cast<const __m256i*>(tbl + 48)));
+	}
+	prev = x;
+}
+
+__attribute__((target("avx2")))
+inline bool isValidUtf8Avx2(const uint8_t *p, size_t n)
+{
+	const uint8_t *tbl = getUtf8CheckTbl();
+	__m256i err = _mm256_setzero_si256();
+	__m256i incomplete = err;
+	__m256i prev = err;
+	for (; n >= 32; p += 32, n -= 32) {
+		checkUtf8Avx2(err, incomplete, prev, _mm256_loadu_si256(cybozu::cast<const __m256i*>(p)), tbl);
+	}
+	if (n > 0) {
+		uint8_t buf[32] = {};
+		memcpy(buf, p, n);
+		checkUtf8Avx2(err, incomplete, prev, _mm256_loadu_si256(cybozu::cast<const __m256i*>(buf)), tbl);
+	}
+	err = _mm256_or_si256(err, incomplete);
+	return _mm256_testz_si256(err, err) != 0;
+}
+
+/*
+	decode 8 characters of 2 bytes in x to 16-bit lanes
+	@return false if x does not consist of them
+*/
+__attribute__((target("ssse3")))
+inline bool decodeUtf8x2Ssse3(__m128i *v, __m128i x)
+{
+	// a lane is (2nd byte << 8) | 1st byte
+	const __m128i ok = _mm_cmpeq_epi16(_mm_and_si128(x, _mm_set1_epi16(static_cast<short>(0xc0e0))), _mm_set1_epi16(static_cast<short>(0x80c0)));
+	const __m128i c = _mm_or_si128(_mm_slli_epi16(_mm_and_si128(x, _mm_set1_epi16(0x1f)), 6), _mm_and_si128(_mm_srli_epi16(x, 8), _mm_set1_epi16(0x3f)));
+	// reject overlong form
+	if (_mm_movemask_epi8(_mm_andnot_si128(_mm_cmplt_epi16(c, _mm_set1_epi16(0x80)), ok)) != 0xffff) return false;
+	*v = c;
+	return true;
+}
+
+/*
+	decode 4 characters of 3 bytes in the low 12 bytes of x to 32-bit lanes
+	@return false if x does not start with them
+*/
+__attribute__((target("ssse3")))
+inline bool decodeUtf8x3Ssse3(__m128i *v, __m128i x)
+{
+	// a lane is (1st byte << 16) | (2nd byte << 8) | 3rd byte
+	const __m128i y = _mm_shuffle_epi8(x, _mm_setr_epi8(2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1));
+	const __m128i ok = _mm_cmpeq_epi32(_mm_and_si128(y, _mm_set1_epi32(0xf0c0c0)), _mm_set1_epi32(0xe08080));
+	const __m128i c = _mm_or_si128(_mm_or_si128(_mm_and_si128(y, _mm_set1_epi32(0x3f)), _mm_srli_epi32(_mm_and_si128(y, _mm_set1_epi32(0x3f00)), 2)), _mm_srli_epi32(_mm_and_si128(y, _mm_set1_epi32(0x0f0000)), 4));
+	// reject overlong form and surrogate
+	const __m128i ng = _mm_or_si128(_mm_cmplt_epi32(c, _mm_set1_epi32(0x800)), _mm_cmpeq_epi32(_mm_and_si128(c, _mm_set1_epi32(0xf800)), _mm_set1_epi32(0xd800)));
+	if (_mm_movemask_epi8(_mm_andnot_si128(ng, ok)) != 0xffff) return false;
+	*v = c;
+	return true;
+}
+
+__attribute__((target("ssse3")))
+inline void storeUtf8x2Ssse3(Char *dst, __m128i v)
+{
+	const __m128i zero = _mm_setzero_si128();
+	_mm_storeu_si128(cybozu::cast<__m128i*>(dst), _mm_unpacklo_epi16(v, zero));
+	_mm_storeu_si128(cybozu::cast<__m128i*>(dst + 4), _mm_unpackhi_epi16(v, zero));
+}
+
+__attribute__((target("ssse3")))
+inline void storeUtf8x2Ssse3(Char16 *dst, __m128i v)
+{
+	_mm_storeu_si128(cybozu::cast<__m128i*>(dst), v);
+}
+
+__attribute__((target("ssse3")))
+inline void storeUtf8x3Ssse3(Char *dst, __m128i v)
+{
+	_mm_storeu_si128(cybozu::cast<__m128i*>(dst), v);
+}
+
+__attribute__((target("ssse3")))
+inline void storeUtf8x3Ssse3(Char16 *dst, __m128i v)
+{
+	_mm_storel_epi64(cybozu::cast<__m128i*>(dst), _mm_shuffle_epi8(v, _mm_setr_epi8(0, 1, 4, 5, 8, 9, 12, 13, -1, -1, -1, -1, -1, -1, -1, -1)));
+}
+
+/*
+	convert a block of characters of 2 or 3 bytes of UTF-8 at p to UTF-32 or UTF-16(CharT = Char or Char16)
+	and seek p and dst if they are valid
+*/
+template<class CharT>
+__attribute__((target("ssse3")))
+inline bool decodeUtf8BlockSsse3(CharT *&dst, const uint8_t *&p, const uint8_t *end)
+{
+	if (end - p < 16) return false;
+	const __m128i x = _mm_loadu_si128(cybozu::cast<const __m128i*>(p));
+	__m128i v;
+	if (*p >= 0xe0) {
+		if (!decodeUtf8x3Ssse3(&v, x)) return false;
+		storeUtf8x3Ssse3(dst, v);
+		p += 12;
+		dst += 4;
+	} else {
+		if (!decodeUtf8x2Ssse3(&v, x)) return false;
+		storeUtf8x2Ssse3(dst, v);
+		p += 16;
+		dst += 8;
+	}
+	return true;
+}
+
+/*
+	convert a run of characters of 2 or 3 bytes of UTF-8 at p while a block of them is valid
+	@return the number of written characters
+*/
+template<class CharT>
+__attribute__((target("ssse3")))
+inline size_t decodeUtf8RunSsse3(CharT *dst, const uint8_t *&p, const uint8_t *end)
+{
+	CharT *const top = dst;
+	while (decodeUtf8BlockSsse3(dst, p, end)) {
+	}
+	return dst - top;
+}
+
+/*
+	AVX2 version of decodeUtf8x2Ssse3 for 16 characters
+*/
+__attribute__((target("avx2")))
+inline bool decodeUtf8x2Avx2(__m256i *v, __m256i x)
+{
+	const __m256i ok = _mm256_cmpeq_epi16(_mm256_and_si256(x, _mm256_set1_epi16(static_cast<short>(0xc0e0))), _mm256_set1_epi16(static_cast<short>(0x80c0)));
+	const __m256i c = _mm256_or_si256(_mm256_slli_epi16(_mm256_and_si256(x, _mm256_set1_epi16(0x1f)), 6), _mm256_and_si256(_mm256_srli_epi16(x, 8), _mm256_set1_epi16(0x3f)));
+	const __m256i ng = _mm256_cmpgt_epi16(_mm256_set1_epi16(0x80), c);
+	if (_mm256_movemask_epi8(_mm256_andnot_si256(ng, ok)) != -1) return false;
+	*v = c;
+	return true;
+}
+
+/*
+	AVX2 version of decodeUtf8x3Ssse3 for 8 characters
+	x has 12 bytes in each 128-bit lane
+*/
+__attribute__((target("avx2")))
+inline bool decodeUtf8x3Avx2(__m256i *v, __m256i x)
+{
+	const __m256i y = _mm256_shuffle_epi8(x, _mm256_setr_epi8(
+		2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1,
+		2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1));
+	const __m256i ok = _mm256_cmpeq_epi32(_mm256_and_si256(y, _mm256_set1_epi32(0xf0c0c0)), _mm256_set1_epi32(0xe08080));
+	const __m256i c = _mm256_or_si256(_mm256_or_si256(_mm256_and_si256(y, _mm256_set1_epi32(0x3f)), _mm256_srli_epi32(_mm256_and_si256(y, _mm256_set1_epi32(0x3f00)), 2)), _mm256_srli_epi32(_mm256_and_si256(y, _mm256_set1_epi32(0x0f0000)), 4));
+	const __m256i ng = _mm256_or_si256(_mm256_cmpgt_epi32(_mm256_set1_epi32(0x800), c), _mm256_cmpeq_epi32(_mm256_and_si256(c, _mm256_set1_epi32(0xf800)), _mm256_set1_epi32(0xd800)));
+	if (_mm256_movemask_epi8(_mm256_andnot_si256(ng, ok)) != -1) return false;
+	*v = c;
+	return true;
+}
+
+__attribute__((target("avx2")))
+inline void storeUtf8x2Avx2(Char *dst, __m256i v)
+{
+	_mm256_storeu_si256(cybozu::cast<__m256i*>(dst), _mm256_cvtepu16_epi32(_mm256_castsi256_si128(v)));
+	_mm256_storeu_si256(cybozu::cast<__m256i*>(dst + 8), _mm256_cvtepu16_epi32(_mm256_extracti128_si256(v, 1)));
+}
+
+__attribute__((target("avx2")))
+inline void storeUtf8x2Avx2(Char16 *dst, __m256i v)
+{
+	_mm256_storeu_si256(cybozu::cast<__m256i*>(dst), v);
+}
+
+__attribute__((target("avx2")))
+inline void storeUtf8x3Avx2(Char *dst, __m256i v)
+{
+	_mm256_storeu_si256(cybozu::cast<__m256i*>(dst), v);
+}
+
+__attribute__((target("avx2")))
+inline void storeUtf8x3Avx2(Char16 *dst, __m256i v)
+{
+	const __m256i y = _mm256_shuffle_epi8(v, _mm256_setr_epi8(
+		0, 1, 4, 5, 8, 9, 12, 13, -1, -1, -1, -1, -1, -1, -1, -1,
+		0, 1, 4, 5, 8, 9, 12, 13, -1, -1, -1, -1, -1, -1, -1, -1));
+	_mm_storeu_si128(cybozu::cast<__m128i*>(dst), _mm256_castsi256_si128(_mm256_permute4x64_epi64(y, 0x08)));
+}
+
+/*
+	AVX2 version of decodeUtf8RunSsse3
+*/
+template<class CharT>
+__attribute__((target("avx2")))
+inline size_t decodeUtf8RunAvx2(CharT *dst, const uint8_t *&p, const uint8_t *end)
+{
+	CharT *const top = dst;
+	// a run in mixed text is often shorter than 32 bytes, so 32-byte blocks are used after two 16-byte ones
+	if (!decodeUtf8BlockSsse3(dst, p, end) || !decodeUtf8BlockSsse3(dst, p, end)) return dst - top;
+	while (end - p >= 32) {
+		__m256i v;
+		if (*p >= 0xe0) {
+			const __m256i x = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128(cybozu::cast<const __m128i*>(p))), _mm_loadu_si128(cybozu::cast<const __m128i*>(p + 12)), 1);
+			if (!decodeUtf8x3Avx2(&v, x)) break;
+			storeUtf8x3Avx2(dst, v);
+			p += 24;
+			dst += 8;
+		} else {
+			if (!decodeUtf8x2Avx2(&v, _mm256_loadu_si256(cybozu::cast<const __m256i*>(p)))) break;
+			storeUtf8x2Avx2(dst, v);
+			p += 32;
+			dst += 16;
+		}
+	}
+	// the rest or a block shorter than 32 bytes
+	dst += decodeUtf8RunSsse3(dst, p, end);
+	return dst - top;
+}
+
+/*
+	seek p over a run of characters of 2 or 3 bytes and write them to dst by the best kernel in f
+*/
+template<class CharT>
+inline size_t decodeUtf8Run(int f, CharT *dst, const uint8_t *&p, const uint8_t *end)
+{
+	if (f & stringAvx2) return decodeUtf8RunAvx2(dst, p, end);
+	if (f & stringSsse3) return decodeUtf8RunSsse3(dst, p, end);
+	return 0;
+}
+#endif
+
 } // string_local
 
 /**
@@ -358,6 +806,245 @@ inline bool AppendUtf16(String16& out, Char c)
 	return false;
 }
 
+/*
+	bulk conversion between UTF-8, UTF-16 and UTF-32
+	a run of ASCII characters is converted 16 characters at a time with SSE2
+	and a run of 2 or 3 byte characters 4 to 16 characters at a time with SSSE3/AVX2 if available
+	IsValidUtf8 uses the lookup table validation with SSSE3/AVX2 if available
+	@note each function returns the number of written elements, or
+	size_t(-1) if the input is invalid(the contents of dst are undefined)
+*/
+
+/*
+	is [src, src + n) valid UTF-8?
+*/
+inline bool IsValidUtf8(const char *src, size_t n)
+{
+	const uint8_t *p = cybozu::cast<const uint8_t*>(src);
+#ifdef CYBOZU_STRING_USE_SIMD
+	const int f = string_local::getStringFeature();
+	if (f & string_local::stringAvx2) return string_local::isValidUtf8Avx2(p, n);
+	if (f & string_local::stringSsse3) return string_local::isValidUtf8Ssse3(p, n);
+#endif
+	const uint8_t *const end = p + n;
+	while (p != end) {
+		if (*p < 0x80) {
+#ifdef CYBOZU_STRING_USE_SSE2
+			while (end - p >= 16) {
+				const int m = string_local::getNonAsciiMask16(p);
+				if (m) {
+					p += cybozu::bsf(m);
+					goto MULTI;
+				}
+				p += 16;
+			}
+			if (p == end) break;
+			if (*p >= 0x80) goto MULTI;
+#endif
+			p++;
+			continue;
+		}
+#ifdef CYBOZU_STRING_USE_SSE2
+	MULTI:
+#endif
+		uint32_t c;
+		if (!string_local::decodeUtf8(&c, p, end)) return false;
+	}
+	return true;
+}
+
+/*
+	convert UTF-8 [src, src + n) to UTF-32
+	@note dst must have n elements
+*/
+inline size_t Utf8ToUtf32(Char *dst, const char *src, size_t n)
+{
+	const uint8_t *p = cybozu::cast<const uint8_t*>(src);
+	const uint8_t *const end = p + n;
+	Char *const top = dst;
+#ifdef CYBOZU_STRING_USE_SIMD
+	const int f = string_local::getStringFeature();
+#endif
+	while (p != end) {
+		if (*p < 0x80) {
+#ifdef CYBOZU_STRING_USE_SSE2
+			const __m128i zero = _mm_setzero_si128();
+			while (end - p >= 16) {
+				const __m128i x = _mm_loadu_si128(cybozu::cast<const __m128i*>(p));
+				const int m = _mm_movemask_epi8(x);
+				if (m) {
+					for (int i = 0, k = cybozu::bsf(m); i < k; i++) *dst++ = *p++;
+					goto MULTI;
+				}
+				const __m128i lo = _mm_unpacklo_epi8(x, zero);
+				const __m128i hi = _mm_unpackhi_epi8(x, zero);
+				__m128i *q = cybozu::cast<__m128i*>(dst);
+				_mm_storeu_si128(q + 0, _mm_unpacklo_epi16(lo, zero));
+				_mm_storeu_si128(q + 1, _mm_unpackhi_epi16(lo, zero));
+				_mm_storeu_si128(q + 2, _mm_unpacklo_epi16(hi, zero));
+				_mm_storeu_si128(q + 3, _mm_unpackhi_epi16(hi, zero));
+				p += 16;
+				dst += 16;
+			}
+			if (p == end) break;
+			if (*p >= 0x80) goto MULTI;
+#endif
+			*dst++ = *p++;
+			continue;
+		}
+#ifdef CYBOZU_STRING_USE_SSE2
+	MULTI:
+#endif
+#ifdef CYBOZU_STRING_USE_SIMD
+		if (f) {
+			dst += string_local::decodeUtf8Run(f, dst, p, end);
+			if (p == end) break;
+			if (*p < 0x80) continue;
+		}
+#endif
+		uint32_t c;
+		if (!string_local::decodeUtf8(&c, p, end)) return size_t(-1);
+		*dst++ = static_cast<Char>(c);
+	}
+	return dst - top;
+}
+
+/*
+	convert UTF-8 [src, src + n) to UTF-16
+	@note dst must have n elements
+*/
+inline size_t Utf8ToUtf16(Char16 *dst, const char *src, size_t n)
+{
+	const uint8_t *p = cybozu::cast<const uint8_t*>(src);
+	const uint8_t *const end = p + n;
+	Char16 *const top = dst;
+#ifdef CYBOZU_STRING_USE_SIMD
+	const int f = string_local::getStringFeature();
+#endif
+	while (p != end) {
+		if (*p < 0x80) {
+#ifdef CYBOZU_STRING_USE_SSE2
+			const __m128i zero = _mm_setzero_si128();
+			while (end - p >= 16) {
+				const __m128i x = _mm_loadu_si128(cybozu::cast<const __m128i*>(p));
+				const int m = _mm_movemask_epi8(x);
+				if (m) {
+					for (int i = 0, k = cybozu::bsf(m); i < k; i++) *dst++ = *p++;
+					goto MULTI;
+				}
+				__m128i *q = cybozu::cast<__m128i*>(dst);
+				_mm_storeu_si128(q + 0, _mm_unpacklo_epi8(x, zero));
+				_mm_storeu_si128(q + 1, _mm_unpackhi_epi8(x, zero));
+				p += 16;
+				dst += 16;
+			}
+			if (p == end) break;
+			if (*p >= 0x80) goto MULTI;
+#endif
+			*dst++ = *p++;
+			continue;
+		}
+#ifdef CYBOZU_STRING_USE_SSE2
+	MULTI:
+#endif
+#ifdef CYBOZU_STRING_USE_SIMD
+		if (f) {
+			dst += string_local::decodeUtf8Run(f, dst, p, end);
+			if (p == end) break;
+			if (*p < 0x80) continue;
+		}
+#endif
+		uint32_t c;
+		if (!string_local::decodeUtf8(&c, p, end)) return size_t(-1);
+		if (c <= 0xffff) {
+			*dst++ = static_cast<Char16>(c);
+		} else {
+			dst[0] = static_cast<Char16>((c >> 10) + 0xd7c0);
+			dst[1] = static_cast<Char16>((c & 0x3ff) | 0xdc00);
+			dst += 2;
+		}
+	}
+	return dst - top;
+}
+
+/*
+	convert UTF-32 [src, src + n) to UTF-8
+	@note dst must have n * 4 elements
+*/
+inline size_t Utf32ToUtf8(char *dst, const Char *src, size_t n)
+{
+	const Char *const end = src + n;
+	char *const top = dst;
+	while (src != end) {
+#ifdef CYBOZU_STRING_USE_SSE2
+		const __m128i notAscii = _mm_set1_epi32(~0x7f);
+		while (end - src >= 16) {
+			const __m128i *p = cybozu::cast<const __m128i*>(src);
+			const __m128i x0 = _mm_loadu_si128(p + 0);
+			const __m128i x1 = _mm_loadu_si128(p + 1);
+			const __m128i x2 = _mm_loadu_si128(p + 2);
+			const __m128i x3 = _mm_loadu_si128(p + 3);
+			const __m128i t = _mm_and_si128(_mm_or_si128(_mm_or_si128(x0, x1), _mm_or_si128(x2, x3)), notAscii);
+			if (_mm_movemask_epi8(_mm_cmpeq_epi32(t, _mm_setzero_si128())) != 0xffff) break;
+			const __m128i y = _mm_packus_epi16(_mm_packs_epi32(x0, x1), _mm_packs_epi32(x2, x3));
+			_mm_storeu_si128(cybozu::cast<__m128i*>(dst), y);
+			src += 16;
+			dst += 16;
+		}
+		if (src == end) break;
+#endif
+		const uint32_t c = static_cast<uint32_t>(*src++);
+		if (c < 0x80) {
+			*dst++ = static_cast<char>(c);
+			continue;
+		}
+		if (c > 0x10ffff || c - 0xd800 < 0x800) return size_t(-1);
+		dst = string_local::encodeUtf8(dst, c);
+	}
+	return dst - top;
+}
+
+/*
+	convert UTF-16 [src, src + n) to UTF-8
+	@note dst must have n * 3 elements
+*/
+inline size_t Utf16ToUtf8(char *dst, const Char16 *src, size_t n)
+{
+	const Char16 *const end = src + n;
+	char *const top = dst;
+	while (src != end) {
+#ifdef CYBOZU_STRING_USE_SSE2
+		const __m128i notAscii = _mm_set1_epi16(~0x7f);
+		while (end - src >= 16) {
+			const __m128i *p = cybozu::cast<const __m128i*>(src);
+			const __m128i x0 = _mm_loadu_si128(p + 0);
+			const __m128i x1 = _mm_loadu_si128(p + 1);
+			const __m128i t = _mm_and_si128(_mm_or_si128(x0, x1), notAscii);
+			if (_mm_movemask_epi8(_mm_cmpeq_epi16(t, _mm_setzero_si128())) != 0xffff) break;
+			_mm_storeu_si128(cybozu::cast<__m128i*>(dst), _mm_packus_epi16(x0, x1));
+			src += 16;
+			dst += 16;
+		}
+		if (src == end) break;
+#endif
+		uint32_t c = static_cast<uint16_t>(*src++);
+		if (c < 0x80) {
+			*dst++ = static_cast<char>(c);
+			continue;
+		}
+		if (c - 0xd800 < 0x800) {
+			// c must be a lead surrogate followed by a trail one
+			if (c >= 0xdc00 || src == end) return size_t(-1);
+			const uint32_t c1 = static_cast<uint16_t>(*src);
+			if (c1 - 0xdc00 >= 0x400) return size_t(-1);
+			src++;
+			c = (c << 10) + c1 - ((0xd800 << 10) + 0xdc00 - 0x10000);
+		}
+		dst = string_local::encodeUtf8(dst, c);
+	}
+	return dst - top;
+}
+
 } // string
 
 template<class CharT, class Traits = std::char_traits<CharT>, class Alloc = std::allocator<CharT> >
@@ -396,16 +1083,70 @@ public:
 	*/
 	StringT() { }
 
+	/**
+		construct empty string with allocator
+		@param a [in] allocator such as cybozu::ArenaAllocator
+	*/
+	explicit StringT(const Alloc& a)
+		: str_(a)
+	{
+	}
+
 	/**
 		construct from str [off, off + count)
 		@param str [in] original string
 		@param off [in] offset
 		@param count [in] count of character(default npos)
+		@note the allocator of str is used
 	*/
 	StringT(const StringT& str, size_type off, size_type count = npos)
-		: str_(str.str_, off, count)
+		: str_(str.str_, off, count, str.get_allocator())
 	{ }
 
+	/**
+		construct by copying str with allocator
+		@param str [in] original string
+		@param a [in] allocator
+	*/
+	StringT(const StringT& str, const Alloc& a)
+		: str_(str.str_.begin(), str.str_.end(), a)
+	{
+	}
+
+	/**
+		construct from UTF-8 [str, str + count) with allocator
+		@param str [in] original string
+		@param count [in] count of character
+		@param a [in] allocator
+	*/
+	StringT(const char *str, size_type count, const Alloc& a) // A
+		: str_(a)
+	{
+		append(str, count);
+	}
+
+	/**
+		construct from UTF-8 [str, NUL) with allocator
+		@param str [in] original string
+		@param a [in] allocator
+	*/
+	StringT(const char *str, const Alloc& a) // A
+		: str_(a)
+	{
+		append(str);
+	}
+
+	/**
+		construct from UTF-8 str with allocator
+		@param str [in] original string
+		@param a [in] allocator
+	*/
+	StringT(const std::string& str, const Alloc& a) // A
+		: str_(a)
+	{
+		append(str);
+	}
+
 	/**
 		construct from [str, str + count)
 		@param str [in] original string
@@ -656,7 +1397,16 @@ public:
 	*/
 	StringT& append(const char *str, size_type count) // A
 	{
-		return append(str, str + count);
+		if (count == 0) return *this;
+		const size_t pos = str_.size();
+		str_.resize(pos + count);
+		const size_t n = cybozu::string::Utf8ToUtf32(&str_[pos], str, count);
+		if (n == size_t(-1)) {
+			str_.resize(pos);
+			throw cybozu::Exception("string:append:bad utf8");
+		}
+		str_.resize(pos + n);
+		return *this;
 	}
 
 	/**
@@ -669,6 +1419,7 @@ public:
 	}
 	StringT& append(const Char16 *begin, const Char16 *end)
 	{
+		str_.reserve(str_.size() + (end - begin));
 		while (begin != end) {
 			Char c;
 			if (!string::GetCharFromUtf16(c, begin, end)) {
@@ -688,7 +1439,7 @@ public:
 	*/
 	StringT& append(const std::string& str) // A
 	{
-		return append(str.begin(), str.end());
+		return append(str.data(), str.size());
 	}
 
 	/**
@@ -1444,8 +2195,12 @@ public:
 	*/
 	StringT substr(size_type off = 0, size_type count = npos) const
 	{
-		return str_.substr(off, count);
+		return StringT(*this, off, count);
 	}
+	/**
+		get allocator
+	*/
+	Alloc get_allocator() const { return str_.get_allocator(); }
 	/**
 		compare *this with rhs
 		@param rhs [in] target
@@ -1520,11 +2275,19 @@ public:
 	*/
 	void toUtf8(std::string& str) const
 	{
-		for (size_t i = 0, n = str_.size(); i < n; i++) {
-			if (!cybozu::string::AppendUtf8(str, str_[i])) {
-				throw cybozu::Exception("string:toUtf8") << i;
-			}
+		const size_t n = str_.size();
+		if (n == 0) return;
+		const size_t pos = str.size();
+		str.resize(pos + n * 4);
+		const size_t len = cybozu::string::Utf32ToUtf8(&str[pos], str_.data(), n);
+		if (len == size_t(-1)) {
+			str.resize(pos);
+			size_t i = 0;
+			char buf[4];
+			while (cybozu::string::Utf32ToUtf8(buf, &str_[i], 1) != size_t(-1)) i++;
+			throw cybozu::Exception("string:toUtf8") << i;
 		}
+		str.resize(pos + len);
 	}
 	std::string toUtf8() const
 	{
@@ -1537,6 +2300,7 @@ public:
 	*/
 	void toUtf16(cybozu::String16& str) const
 	{
+		str.reserve(str.size() + str_.size());
 		for (size_t i = 0, n = str_.size(); i < n; i++) {
 			if (!cybozu::string::AppendUtf16(str, str_[i])) {
 				throw cybozu::Exception("string:toUtf16") << i;
@@ -1651,7 +2415,8 @@ inline std::istream& operator>>(std::istream& is, String& str)
 	return is;
 }
 
-inline std::ostream& operator<<(std::ostream& os, const String& str)
+template<class Traits, class Alloc>
+std::ostream& operator<<(std::ostream& os, const StringT<cybozu::Char, Traits, Alloc>& str)
 {
 	return os << str.toUtf8();
 }
@@ -1713,9 +2478,25 @@ bool ConvertUtf16ToUtf8(std::string *out, Iter16 begin, Iter16 end)
 	}
 	return true;
 }
+inline bool ConvertUtf16ToUtf8(std::string *out, const cybozu::Char16 *begin, const cybozu::Char16 *end)
+{
+	const size_t n = end - begin;
+	if (n == 0) {
+		out->clear();
+		return true;
+	}
+	out->resize(n * 3);
+	const size_t len = string::Utf16ToUtf8(&(*out)[0], begin, n);
+	if (len == size_t(-1)) {
+		out->clear();
+		return false;
+	}
+	out->resize(len);
+	return true;
+}
 inline bool ConvertUtf16ToUtf8(std::string *out, const cybozu::String16& in)
 {
-	return ConvertUtf16ToUtf8(out, &in[0], &in[0] + in.size());
+	return ConvertUtf16ToUtf8(out, in.data(), in.data() + in.size());
 }
 
 template<class Iter8>
@@ -1731,9 +2512,25 @@ bool ConvertUtf8ToUtf16(cybozu::String16 *out, Iter8 begin, Iter8 end)
 	return true;
 }
 
+inline bool ConvertUtf8ToUtf16(cybozu::String16 *out, const char *begin, const char *end)
+{
+	const size_t n = end - begin;
+	if (n == 0) {
+		out->clear();
+		return true;
+	}
+	out->resize(n);
+	const size_t len = string::Utf8ToUtf16(&(*out)[0], begin, n);
+	if (len == size_t(-1)) {
+		out->clear();
+		return false;
+	}
+	out->resize(len);
+	return true;
+}
 inline bool ConvertUtf8ToUtf16(cybozu::String16 *out, const std::string& in)
 {
-	return ConvertUtf8ToUtf16(out, &in[0], &in[0] + in.size());
+	return ConvertUtf8ToUtf16(out, in.data(), in.data() + in.size());
 }
 
 inline cybozu::String16 ToUtf16(const std::string& in)
@@ -1805,7 +2602,7 @@ struct hash<cybozu::String> {
 	typedef size_t result_type;
 	size_t operator()(const cybozu::String& str) const
 	{
-		return static_cast<size_t>(cybozu::hash64(str.c_str(), str.size()));
+		return static_cast<size_t>(cybozu::fastHash64(str.c_str(), str.size() * sizeof(cybozu::Char)));
 	}
 };
 
@@ -1825,7 +2622,7 @@ struct hash<cybozu::String> {
 	typedef size_t result_type;
 	size_t operator()(const cybozu::String& str) const
 	{
-		return static_cast<size_t>(cybozu::hash64(str.c_str(), str.size()));
+		return static_cast<size_t>(cybozu::fastHash64(str.c_str(), str.size() * sizeof(cybozu::Char)));
 	}
 };
 
@@ -14,6 +14,7 @@
 
 #include <algorithm>
 #include <vector>
+#include <utility>
 #include <cybozu/string.hpp>
 
 #ifdef _MSC_VER
@@ -358,6 +359,466 @@ std::vector<StringT> Split(const StringT& inStr, typename StringT::value_type sp
 	return out;
 }
 
+namespace string_local {
+
+#ifdef CYBOZU_STRING_USE_SIMD
+/*
+	return the first i in [pos, n - 15) such that p[i] is in a set of bytes, or the position of the last block
+	tbl[l] (resp. tbl[16 + l]) has the bit h if (h << 4) | l (resp. ((h + 8) << 4) | l) is in the set
+	so that the nibbles of a byte select its bit by pshufb
+*/
+__attribute__((target("ssse3")))
+inline size_t findByteSetSsse3(const uint8_t *tbl, const uint8_t *p, size_t pos, size_t n)
+{
+	const __m128i loA = _mm_loadu_si128(cybozu::cast<const __m128i*>(tbl));
+	const __m128i loB = _mm_loadu_si128(cybozu::cast<const __m128i*>(tbl + 16));
+	const __m128i hiA = _mm_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 0, 0, 0, 0, 0, 0, 0, 0);
+	const __m128i hiB = _mm_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, 1, 2, 4, 8, 16, 32, 64, -128);
+	const __m128i mask = _mm_set1_epi8(0x0f);
+	const __m128i zero = _mm_setzero_si128();
+	while (pos + 16 <= n) {
+		const __m128i x = _mm_loadu_si128(cybozu::cast<const __m128i*>(p + pos));
+		const __m128i lo = _mm_and_si128(x, mask);
+		const __m128i hi = _mm_and_si128(_mm_srli_epi16(x, 4), mask);
+		const __m128i a = _mm_and_si128(_mm_shuffle_epi8(loA, lo), _mm_shuffle_epi8(hiA, hi));
+		const __m128i b = _mm_and_si128(_mm_shuffle_epi8(loB, lo), _mm_shuffle_epi8(hiB, hi));
+		const int m = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_or_si128(a, b), zero)) ^ 0xffff;
+		if (m) return pos + cybozu::bsf(m);
+		pos += 16;
+	}
+	return pos;
+}
+
+/*
+	AVX2 version of findByteSetSsse3 for 32-byte blocks
+*/
+__attribute__((target("avx2")))
+inline size_t findByteSetAvx2(const uint8_t *tbl, const uint8_t *p, size_t pos, size_t n)
+{
+	const __m256i loA = _mm256_broadcastsi128_si256(_mm_loadu_si128(cybozu::cast<const __m128i*>(tbl)));
+	const __m256i loB = _mm256_broadcastsi128_si256(_mm_loadu_si128(cybozu::cast<const __m128i*>(tbl + 16)));
+	const __m256i hiA = _mm256_setr_epi8(
+		1, 2, 4, 8, 16, 32, 64, -128, 0, 0, 0, 0, 0, 0, 0, 0,
+		1, 2, 4, 8, 16, 32, 64, -128, 0, 0, 0, 0, 0, 0, 0, 0);
+	const __m256i hiB = _mm256_setr_epi8(
+		0, 0, 0, 0, 0, 0, 0, 0, 1, 2, 4, 8, 16, 32, 64, -128,
+		0, 0, 0, 0, 0, 0, 0, 0, 1, 2, 4, 8, 16, 32, 64, -128);
+	const __m256i mask = _mm256_set1_epi8(0x0f);
+	const __m256i zero = _mm256_setzero_si256();
+	while (pos + 32 <= n) {
+		const __m256i x = _mm256_loadu_si256(cybozu::cast<const __m256i*>(p + pos));
+		const __m256i lo = _mm256_and_si256(x, mask);
+		const __m256i hi = _mm256_and_si256(_mm256_srli_epi16(x, 4), mask);
+		const __m256i a = _mm256_and_si256(_mm256_shuffle_epi8(loA, lo), _mm256_shuffle_epi8(hiA, hi));
+		const __m256i b = _mm256_and_si256(_mm256_shuffle_epi8(loB, lo), _mm256_shuffle_epi8(hiB, hi));
+		const uint32_t m = ~uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_or_si256(a, b), zero)));
+		if (m) return pos + cybozu::bsf(m);
+		pos += 32;
+	}
+	return findByteSetSsse3(tbl, p, pos, n);
+}
+#endif
+
+/*
+	Aho-Corasick automaton on bytes
+	the root has a dense transition table and the other states have
+	sorted sparse edges and failure links
+	a full DFA on byte classes is built if it is small enough
+*/
+class AhoCorasick {
+	static const uint32_t none = uint32_t(-1);
+	struct Node {
+		std::vector<std::pair<uint8_t, uint32_t> > edge;
+		uint32_t id; // first pattern id ending here
+	};
+	std::vector<Node> trie_; // used while building
+	std::vector<uint32_t> sameNext_; // next id of the same pattern
+	uint32_t root_[256];
+	std::vector<uint32_t> edgeBegin_;
+	std::vector<uint8_t> edgeByte_;
+	std::vector<uint32_t> edgeTo_;
+	std::vector<uint32_t> fail_;
+	std::vector<uint32_t> id_;
+	std::vector<uint32_t> out_; // the first state with id in the failure chain(0 if none)
+	std::vector<uint32_t> dict_; // the next state with id in the failure chain(0 if none)
+	uint16_t class_[256]; // bytes not in patterns are class 0
+	uint32_t classNum_;
+	std::vector<uint32_t> dfa_; // next state of (state, class)
+	uint8_t first_[4];
+	size_t firstNum_;
+	uint8_t firstTbl_[32]; // the set of first bytes for findByteSet if firstNum_ > 4
+	bool compiled_;
+	uint32_t findEdge(uint32_t s, uint8_t c) const
+	{
+		const uint8_t *p = &edgeByte_[0];
+		uint32_t b = edgeBegin_[s], e = edgeBegin_[s + 1];
+		if (e - b <= 8) {
+			for (; b < e; b++) {
+				if (p[b] == c) return edgeTo_[b];
+			}
+			return 0;
+		}
+		const uint8_t *q = std::lower_bound(p + b, p + e, c);
+		return (q != p + e && *q == c) ? edgeTo_[q - p] : 0;
+	}
+	static uint32_t findTrieEdge(const Node& node, uint8_t c)
+	{
+		for (size_t i = 0; i < node.edge.size(); i++) {
+			if (node.edge[i].first == c) return node.edge[i].second;
+		}
+		return 0;
+	}
+public:
+	AhoCorasick()
+		: trie_(1)
+		, classNum_(0)
+		, firstNum_(0)
+		, compiled_(false)
+	{
+		trie_[0].id = none;
+	}
+	/*
+		add a pattern [str, str + size) with id
+		@note size > 0
+	*/
+	void add(const uint8_t *str, size_t size, uint32_t id)
+	{
+		if (compiled_) throw cybozu::Exception("AhoCorasick:add:already compiled");
+		uint32_t s = 0;
+		for (size_t i = 0; i < size; i++) {
+			uint32_t t = findTrieEdge(trie_[s], str[i]);
+			if (t == 0) {
+				t = static_cast<uint32_t>(trie_.size());
+				trie_[s].edge.push_back(std::make_pair(str[i], t));
+				trie_.resize(t + 1);
+				trie_[t].id = none;
+			}
+			s = t;
+		}
+		if (sameNext_.size() <= id) sameNext_.resize(id + 1, uint32_t(none));
+		sameNext_[id] = trie_[s].id;
+		trie_[s].id = id;
+	}
+	/*
+		@param maxDfaSize [in] max number of entries of DFA
+	*/
+	void compile(size_t maxDfaSize)
+	{
+		if (compiled_) return;
+		const size_t n = trie_.size();
+		edgeBegin_.resize(n + 1);
+		edgeByte_.clear();
+		edgeTo_.clear();
+		fail_.assign(n, 0);
+		id_.resize(n);
+		out_.assign(n, 0);
+		dict_.assign(n, 0);
+		for (size_t i = 0; i < n; i++) {
+			std::vector<std::pair<uint8_t, uint32_t> >& edge = trie_[i].edge;
+			std::sort(edge.begin(), edge.end());
+			edgeBegin_[i] = static_cast<uint32_t>(edgeByte_.size());
+			for (size_t j = 0; j < edge.size(); j++) {
+				edgeByte_.push_back(edge[j].first);
+				edgeTo_.push_back(edge[j].second);
+			}
+			id_[i] = trie_[i].id;
+		}
+		edgeBegin_[n] = static_cast<uint32_t>(edgeByte_.size());
+		edgeByte_.push_back(0); // for &edgeByte_[0]
+		for (int c = 0; c < 256; c++) root_[c] = 0;
+		const std::vector<std::pair<uint8_t, uint32_t> >& rootEdge = trie_[0].edge;
+		firstNum_ = rootEdge.size();
+		for (int i = 0; i < 32; i++) firstTbl_[i] = 0;
+		for (size_t i = 0; i < rootEdge.size(); i++) {
+			const uint8_t c = rootEdge[i].first;
+			root_[c] = rootEdge[i].second;
+			if (i < 4) first_[i] = c;
+			firstTbl_[(c & 15) + (c & 0x80 ? 16 : 0)] |= uint8_t(1u << ((c >> 4) & 7));
+		}
+		// set failure links in BFS order
+		std::vector<uint32_t> queue;
+		queue.reserve(n);
+		for (size_t i = 0; i < rootEdge.size(); i++) queue.push_back(rootEdge[i].second);
+		for (size_t qi = 0; qi < queue.size(); qi++) {
+			const uint32_t u = queue[qi];
+			const uint32_t f = fail_[u];
+			out_[u] = id_[u] != none ? u : out_[f];
+			dict_[u] = out_[f];
+			for (uint32_t i = edgeBegin_[u]; i < edgeBegin_[u + 1]; i++) {
+				const uint32_t v = edgeTo_[i];
+				fail_[v] = next(f, edgeByte_[i]);
+				queue.push_back(v);
+			}
+		}
+		buildDfa(queue, maxDfaSize);
+		std::vector<Node>().swap(trie_);
+		compiled_ = true;
+	}
+	/*
+		@param order [in] states except root in BFS order
+	*/
+	void buildDfa(const std::vector<uint32_t>& order, size_t maxDfaSize)
+	{
+		for (int c = 0; c < 256; c++) class_[c] = 0;
+		classNum_ = 1;
+		uint8_t rep[257];
+		rep[0] = 0;
+		for (size_t i = 0, n = edgeTo_.size(); i < n; i++) {
+			const uint8_t c = edgeByte_[i];
+			if (class_[c]) continue;
+			rep[classNum_] = c;
+			class_[c] = uint16_t(classNum_++);
+		}
+		const size_t n = fail_.size();
+		dfa_.clear();
+		if (n * classNum_ > maxDfaSize) return;
+		dfa_.resize(n * classNum_);
+		for (uint32_t k = 1; k < classNum_; k++) {
+			dfa_[k] = root_[rep[k]];
+		}
+		for (size_t i = 0; i < order.size(); i++) {
+			const uint32_t u = order[i];
+			uint32_t *d = &dfa_[size_t(u) * classNum_];
+			const uint32_t *f = &dfa_[size_t(fail_[u]) * classNum_];
+			for (uint32_t k = 0; k < classNum_; k++) d[k] = f[k];
+			for (uint32_t j = edgeBegin_[u]; j < edgeBegin_[u + 1]; j++) {
+				d[class_[edgeByte_[j]]] = edgeTo_[j];
+			}
+		}
+	}
+	bool isCompiled() const { return compiled_; }
+	/*
+		transition from s by c
+	*/
+	uint32_t next(uint32_t s, uint8_t c) const
+	{
+		if (!dfa_.empty()) return dfa_[size_t(s) * classNum_ + class_[c]];
+		for (;;) {
+			if (s == 0) return root_[c];
+			const uint32_t t = findEdge(s, c);
+			if (t) return t;
+			s = fail_[s];
+		}
+	}
+	bool isStart(uint8_t c) const { return root_[c] != 0; }
+	/*
+		return the first position i >= pos where a pattern may start
+	*/
+	size_t skip(const uint8_t *p, size_t pos, size_t n) const
+	{
+#ifdef CYBOZU_STRING_USE_SSE2
+		if (firstNum_ > 0 && firstNum_ <= 4) {
+			const __m128i c0 = _mm_set1_epi8(char(first_[0]));
+			const __m128i c1 = _mm_set1_epi8(char(first_[firstNum_ > 1 ? 1 : 0]));
+			const __m128i c2 = _mm_set1_epi8(char(first_[firstNum_ > 2 ? 2 : 0]));
+			const __m128i c3 = _mm_set1_epi8(char(first_[firstNum_ > 3 ? 3 : 0]));
+			while (pos + 16 <= n) {
+				const __m128i x = _mm_loadu_si128(cybozu::cast<const __m128i*>(p + pos));
+				const __m128i m = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(x, c0), _mm_cmpeq_epi8(x, c1)),
+					_mm_or_si128(_mm_cmpeq_epi8(x, c2), _mm_cmpeq_epi8(x, c3)));
+				const int mask = _mm_movemask_epi8(m);
+				if (mask) return pos + cybozu::bsf(mask);
+				pos += 16;
+			}
+		}
+#endif
+#ifdef CYBOZU_STRING_USE_SIMD
+		if (firstNum_ > 4 && pos < n && root_[p[pos]] == 0) {
+			const int f = getStringFeature();
+			if (f & stringAvx2) {
+				pos = findByteSetAvx2(firstTbl_, p, pos, n);
+			} else if (f & stringSsse3) {
+				pos = findByteSetSsse3(firstTbl_, p, pos, n);
+			}
+		}
+#endif
+		while (pos < n && root_[p[pos]] == 0) pos++;
+		return pos;
+	}
+	/*
+		call f(id) for all patterns which end at s
+	*/
+	template<class F>
+	void report(uint32_t s, F& f) const
+	{
+		for (uint32_t t = out_[s]; t; t = dict_[t]) {
+			for (uint32_t id = id_[t]; id != none; id = sameNext_[id]) {
+				f(id);
+			}
+		}
+	}
+	bool hasOutput(uint32_t s) const { return out_[s] != 0; }
+};
+
+} // string_local
+
+/**
+	find all occurrences of many patterns in one pass by Aho-Corasick
+	CharT = char : search bytes
+	CharT = cybozu::Char : search code points
+	usage:
+	MultiPatternFinder f;
+	f.add("abc"); f.add("bcd"); ...
+	f.compile();
+	f.findAll(matchList, text);
+	@note find functions are thread-safe after compile()
+*/
+template<class CharT>
+class MultiPatternFinderT {
+public:
+	typedef typename string_local::SelectString<CharT>::string_type string_type;
+	struct Match {
+		size_t pos; // position of the match in text
+		size_t size; // size of the pattern
+		size_t id; // return value of add()
+		Match(size_t pos = 0, size_t size = 0, size_t id = 0) : pos(pos), size(size), id(id) {}
+		bool operator==(const Match& rhs) const { return pos == rhs.pos && size == rhs.size && id == rhs.id; }
+		bool operator<(const Match& rhs) const
+		{
+			if (pos != rhs.pos) return pos < rhs.pos;
+			if (size != rhs.size) return size < rhs.size;
+			return id < rhs.id;
+		}
+	};
+	/**
+		add pattern [str, str + size)
+		@return id of the pattern(0, 1, 2, ...)
+	*/
+	size_t add(const CharT *str, size_t size)
+	{
+		if (size == 0) throw cybozu::Exception("MultiPatternFinder:add:empty pattern");
+		const size_t id = size_.size();
+		std::string utf8;
+		size_t n = size;
+		const char *p = toBytes(utf8, &n, str);
+		ac_.add(cybozu::cast<const uint8_t*>(p), n, static_cast<uint32_t>(id));
+		size_.push_back(size);
+		return id;
+	}
+	size_t add(const string_type& str) { return add(str.c_str(), str.size()); }
+	/**
+		build automaton
+		@param maxDfaSize [in] use a full DFA if (number of states) * (number of kinds of bytes) <= maxDfaSize
+		(4 bytes per entry); set 0 to save memory
+		@note add() can not be called after compile()
+	*/
+	void compile(size_t maxDfaSize = size_t(1) << 22) { ac_.compile(maxDfaSize); }
+	size_t getPatternNum() const { return size_.size(); }
+	/**
+		call f(const Match&) for each occurrence of patterns in [str, str + size)
+		in the order of the end position
+		@note stop searching if f returns false
+	*/
+	template<class F>
+	void find(const CharT *str, size_t size, F& f) const
+	{
+		if (!ac_.isCompiled()) throw cybozu::Exception("MultiPatternFinder:find:not compiled");
+		findSub(f, str, size);
+	}
+	template<class F>
+	void find(const string_type& str, F& f) const { find(str.c_str(), str.size(), f); }
+	/**
+		get all occurrences of patterns in [str, str + size)
+	*/
+	void findAll(std::vector<Match>& out, const CharT *str, size_t size) const
+	{
+		out.clear();
+		Pusher pusher(out);
+		find(str, size, pusher);
+	}
+	void findAll(std::vector<Match>& out, const string_type& str) const { findAll(out, str.c_str(), str.size()); }
+	/**
+		return true if str contains any pattern
+	*/
+	bool contains(const CharT *str, size_t size) const
+	{
+		Finder finder;
+		find(str, size, finder);
+		return finder.found;
+	}
+	bool contains(const string_type& str) const { return contains(str.c_str(), str.size()); }
+private:
+	string_local::AhoCorasick ac_;
+	std::vector<size_t> size_;
+	struct Pusher {
+		std::vector<Match>& out;
+		explicit Pusher(std::vector<Match>& out) : out(out) {}
+		bool operator()(const Match& m) { out.push_back(m); return true; }
+	};
+	struct Finder {
+		bool found;
+		Finder() : found(false) {}
+		bool operator()(const Match&) { found = true; return false; }
+	};
+	template<class F>
+	struct Reporter {
+		F& f;
+		const std::vector<size_t>& size;
+		size_t end;
+		bool cont;
+		Reporter(F& f, const std::vector<size_t>& size, size_t end) : f(f), size(size), end(end), cont(true) {}
+		void operator()(uint32_t id)
+		{
+			if (cont && !f(Match(end - size[id], size[id], id))) cont = false;
+		}
+	};
+	/*
+		get bytes of [str, str + *pn) and set its size to *pn
+	*/
+	static const char *toBytes(std::string&, size_t *, const char *str) { return str; }
+	static const char *toBytes(std::string& utf8, size_t *pn, const cybozu::Char *str)
+	{
+		utf8.resize(*pn * 4);
+		const size_t n = cybozu::string::Utf32ToUtf8(&utf8[0], str, *pn);
+		if (n == size_t(-1)) throw cybozu::Exception("MultiPatternFinder:add:bad char");
+		*pn = n;
+		return utf8.c_str();
+	}
+	template<class F>
+	void findSub(F& f, const char *str, size_t size) const
+	{
+		const uint8_t *p = cybozu::cast<const uint8_t*>(str);
+		uint32_t s = 0;
+		for (size_t i = 0; i < size; i++) {
+			if (s == 0) {
+				i = ac_.skip(p, i, size);
+				if (i == size) break;
+			}
+			s = ac_.next(s, p[i]);
+			if (ac_.hasOutput(s)) {
+				Reporter<F> r(f, size_, i + 1);
+				ac_.report(s, r);
+				if (!r.cont) return;
+			}
+		}
+	}
+	template<class F>
+	void findSub(F& f, const cybozu::Char *str, size_t size) const
+	{
+		uint32_t s = 0;
+		for (size_t i = 0; i < size; i++) {
+			char buf[4];
+			const size_t len = cybozu::string::Utf32ToUtf8(buf, &str[i], 1);
+			if (len == size_t(-1)) {
+				// an invalid char never matches
+				s = 0;
+				continue;
+			}
+			if (s == 0 && !ac_.isStart(uint8_t(buf[0]))) continue;
+			for (size_t j = 0; j < len; j++) {
+				s = ac_.next(s, uint8_t(buf[j]));
+			}
+			if (ac_.hasOutput(s)) {
+				Reporter<F> r(f, size_, i + 1);
+				ac_.report(s, r);
+				if (!r.cont) return;
+			}
+		}
+	}
+};
+
+typedef MultiPatternFinderT<char> MultiPatternFinder;
+
 } // cybozu
 
 #ifdef _MSC_VER
@@ -0,0 +1,183 @@
+#pragma once
+/**
+	@file
+	@brief string interning pool which maps strings to dense ids
+
+	@author MITSUNARI Shigeo(@herumi)
+*/
+#include <string>
+#include <vector>
+#include <string.h>
+#include <cybozu/arena.hpp>
+#include <cybozu/hash.hpp>
+#include <cybozu/exception.hpp>
+#include <cybozu/serializer.hpp>
+
+namespace cybozu {
+
+/**
+	intern strings into Arena and give them ids 0, 1, 2, ... in the order of insertion
+	an id is found by an open addressing hash table of ids
+	@note pointers returned by c_str() are valid until clear() or the destructor
+*/
+class StringPool {
+	struct Entry {
+		const char *p;
+		uint32_t size;
+		uint32_t hash;
+	};
+	Arena arena_;
+	std::vector<Entry> entry_; // id -> string
+	std::vector<uint32_t> tbl_; // id + 1 or 0 if empty
+	StringPool(const StringPool&);
+	void operator=(const StringPool&);
+	static uint32_t getHash(const char *p, size_t n)
+	{
+		return uint32_t(cybozu::fastHash64(p, n));
+	}
+	/*
+		return the position in tbl_ of [p, p + n) or an empty slot
+	*/
+	size_t getPos(const char *p, size_t n, uint32_t h) const
+	{
+		const size_t mask = tbl_.size() - 1;
+		size_t pos = h & mask;
+		for (;;) {
+			const uint32_t v = tbl_[pos];
+			if (v == 0) return pos;
+			const Entry& e = entry_[v - 1];
+			if (e.hash == h && e.size == n && memcmp(e.p, p, n) == 0) return pos;
+			pos = (pos + 1) & mask;
+		}
+	}
+	void rehash(size_t tblSize)
+	{
+		tbl_.assign(tblSize, 0);
+		const size_t mask = tblSize - 1;
+		for (size_t i = 0, n = entry_.size(); i < n; i++) {
+			size_t pos = entry_[i].hash & mask;
+			while (tbl_[pos]) pos = (pos + 1) & mask;
+			tbl_[pos] = uint32_t(i + 1);
+		}
+	}
+public:
+	static const uint32_t none = uint32_t(-1);
+	/**
+		@param blockSize [in] block size of Arena keeping strings
+	*/
+	explicit StringPool(size_t blockSize = 1024 * 1024)
+		: arena_(blockSize)
+	{
+		clear();
+	}
+	void clear()
+	{
+		arena_.clear();
+		entry_.clear();
+		tbl_.assign(16, 0);
+	}
+	/**
+		prepare for n strings
+	*/
+	void reserve(size_t n)
+	{
+		entry_.reserve(n);
+		size_t tblSize = tbl_.size();
+		while (tblSize < n * 2) tblSize *= 2;
+		if (tblSize != tbl_.size()) rehash(tblSize);
+	}
+	/**
+		get the id of [p, p + n) and add it if not found
+	*/
+	uint32_t intern(const char *p, size_t n)
+	{
+		const uint32_t h = getHash(p, n);
+		size_t pos = getPos(p, n, h);
+		if (tbl_[pos]) return tbl_[pos] - 1;
+		if (entry_.size() >= none - 1 || uint64_t(n) >= none) throw cybozu::Exception("StringPool:intern:too large") << entry_.size() << n;
+		// keep the load factor <= 1/2
+		if ((entry_.size() + 1) * 2 > tbl_.size()) {
+			rehash(tbl_.size() * 2);
+			pos = getPos(p, n, h);
+		}
+		char *q = static_cast<char*>(arena_.alloc(n + 1, 1));
+		memcpy(q, p, n);
+		q[n] = '\0';
+		const Entry e = { q, uint32_t(n), h };
+		const uint32_t id = uint32_t(entry_.size());
+		entry_.push_back(e);
+		tbl_[pos] = id + 1;
+		return id;
+	}
+	uint32_t intern(const std::string& str) { return intern(str.c_str(), str.size()); }
+	uint32_t intern(const char *str) { return intern(str, strlen(str)); }
+	/**
+		get the id of [p, p + n)
+		@return none if not found
+	*/
+	uint32_t find(const char *p, size_t n) const
+	{
+		const uint32_t v = tbl_[getPos(p, n, getHash(p, n))];
+		return v ? v - 1 : none;
+	}
+	uint32_t find(const std::string& str) const { return find(str.c_str(), str.size()); }
+	uint32_t find(const char *str) const { return find(str, strlen(str)); }
+	/**
+		NUL terminated string of id
+	*/
+	const char *c_str(uint32_t id) const
+	{
+		if (id >= entry_.size()) throw cybozu::Exception("StringPool:c_str:bad id") << id;
+		return entry_[id].p;
+	}
+	size_t getSize(uint32_t id) const
+	{
+		if (id >= entry_.size()) throw cybozu::Exception("StringPool:getSize:bad id") << id;
+		return entry_[id].size;
+	}
+	std::string getString(uint32_t id) const
+	{
+		return std::string(c_str(id), entry_[id].size);
+	}
+	/**
+		number of strings
+	*/
+	size_t size() const { return entry_.size(); }
+	bool empty() const { return entry_.empty(); }
+	/**
+		total size of memory used by strings and tables
+	*/
+	size_t getAllocatedSize() const
+	{
+		return arena_.getAllocatedSize() + entry_.capacity() * sizeof(Entry) + tbl_.capacity() * sizeof(uint32_t);
+	}
+	template<class InputStream>
+	void load(InputStream& is)
+	{
+		clear();
+		uint32_t n;
+		cybozu::load(n, is);
+		if (n >= none) throw cybozu::Exception("StringPool:load:bad size") << n;
+		// n is not trusted ; tables grow by strings actually read
+		const uint32_t maxReserveNum = 1u << 16;
+		reserve(n < maxReserveNum ? n : maxReserveNum);
+		std::string str;
+		for (uint32_t i = 0; i < n; i++) {
+			cybozu::load(str, is);
+			if (intern(str) != i) throw cybozu::Exception("StringPool:load:duplicated string") << str;
+		}
+	}
+	template<class OutputStream>
+	void save(OutputStream& os) const
+	{
+		cybozu::save(os, uint32_t(entry_.size()));
+		for (size_t i = 0, n = entry_.size(); i < n; i++) {
+			// same format as std::string
+			const Entry& e = entry_[i];
+			cybozu::save(os, size_t(e.size));
+			if (e.size > 0) cybozu::saveRange(os, e.p, e.size);
+		}
+	}
+};
+
+} // cybozu
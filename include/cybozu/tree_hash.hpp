@@ -0,0 +1,285 @@
+#pragma once
+/**
+	@file
+	@brief parallel tree hash over SHA-256
+	@author MITSUNARI Shigeo(@herumi)
+	@license modified new BSD license
+	http://opensource.org/licenses/BSD-3-Clause
+*/
+#include <vector>
+#include <algorithm>
+#include <string.h>
+#include <cybozu/sha2.hpp>
+#include <cybozu/parallel.hpp>
+#include <cybozu/file.hpp>
+#include <cybozu/exception.hpp>
+
+namespace cybozu {
+
+/*
+	Merkle tree hash (RFC 6962) of data split into leaves of leafSize bytes
+	leaf hash = SHA-256(0x00 || leaf) ; the last leaf may be shorter
+	node hash = SHA-256(0x01 || left || right)
+	the root of empty data is SHA-256("")
+	full leaves given to update() are hashed by threadNum threads
+
+	a sub-range of data can be verified by the root and the proof given by getProof()
+	without hashing the rest of data
+	@note the root depends on leafSize
+*/
+class Sha256Tree {
+public:
+	static const size_t digestSize = 32;
+	struct Digest {
+		uint8_t buf[digestSize];
+		bool operator==(const Digest& rhs) const { return memcmp(buf, rhs.buf, digestSize) == 0; }
+		bool operator!=(const Digest& rhs) const { return !operator==(rhs); }
+	};
+	typedef std::vector<Digest> DigestVec;
+private:
+	size_t leafSize_;
+	size_t threadNum_;
+	uint64_t totalSize_;
+	DigestVec leaves_;
+	Sha256 cur_; // hash of the current leaf
+	size_t curSize_;
+	Sha256Tree(const Sha256Tree&);
+	void operator=(const Sha256Tree&);
+	struct LeafHasher {
+		const uint8_t *p;
+		size_t size;
+		size_t leafSize;
+		Digest *out;
+		bool operator()(size_t i, size_t)
+		{
+			const size_t pos = i * leafSize;
+			hashLeaf(out[i], p + pos, std::min(leafSize, size - pos));
+			return true;
+		}
+	};
+	/*
+		hash [p, p + size) into leaves of out in parallel
+	*/
+	void hashLeaves(Digest *out, const uint8_t *p, size_t size) const
+	{
+		const size_t n = (size + leafSize_ - 1) / leafSize_;
+		LeafHasher hasher = { p, size, leafSize_, out };
+		if (threadNum_ == 1 || n == 1) {
+			for (size_t i = 0; i < n; i++) hasher(i, 0);
+			return;
+		}
+		cybozu::parallel_for(hasher, n, threadNum_);
+	}
+	void closeLeaf()
+	{
+		Digest d;
+		cur_.digest(d.buf, digestSize, "", 0);
+		cur_.clear();
+		curSize_ = 0;
+		leaves_.push_back(d);
+	}
+	/*
+		the left subtree of n (> 1) leaves has k leaves where k is the largest power of 2 less than n
+	*/
+	static size_t getSplit(size_t n)
+	{
+		size_t k = 1;
+		while (k * 2 < n) k *= 2;
+		return k;
+	}
+	static void getProofSub(DigestVec& proof, const Digest *leaves, size_t lo, size_t hi, size_t begin, size_t end)
+	{
+		if (hi <= begin || end <= lo) {
+			proof.push_back(getRoot(leaves + lo, hi - lo));
+			return;
+		}
+		if (begin <= lo && hi <= end) return;
+		const size_t mid = lo + getSplit(hi - lo);
+		getProofSub(proof, leaves, lo, mid, begin, end);
+		getProofSub(proof, leaves, mid, hi, begin, end);
+	}
+	/*
+		rebuild the node of [lo, hi) by leaves[begin, end) and proof in the same order as getProofSub
+	*/
+	static bool verifySub(Digest& d, const DigestVec& proof, size_t& pos, const Digest *leaves, size_t lo, size_t hi, size_t begin, size_t end)
+	{
+		if (hi <= begin || end <= lo) {
+			if (pos >= proof.size()) return false;
+			d = proof[pos++];
+			return true;
+		}
+		if (begin <= lo && hi <= end) {
+			d = getRoot(leaves + (lo - begin), hi - lo);
+			return true;
+		}
+		const size_t mid = lo + getSplit(hi - lo);
+		Digest left, right;
+		if (!verifySub(left, proof, pos, leaves, lo, mid, begin, end)) return false;
+		if (!verifySub(right, proof, pos, leaves, mid, hi, begin, end)) return false;
+		hashNode(d, left, right);
+		return true;
+	}
+	/*
+		get the leaf range [begin, end) of [offset, offset + size) of data of totalSize bytes
+	*/
+	void getLeafRange(size_t& begin, size_t& end, uint64_t totalSize, uint64_t offset, uint64_t size) const
+	{
+		if (size == 0 || offset % leafSize_ != 0 || offset > totalSize || size > totalSize - offset
+			|| (size % leafSize_ != 0 && offset + size != totalSize)) {
+			throw cybozu::Exception("Sha256Tree:getLeafRange:bad range") << totalSize << offset << size;
+		}
+		begin = size_t(offset / leafSize_);
+		end = size_t((offset + size + leafSize_ - 1) / leafSize_);
+	}
+public:
+	/**
+		@param leafSize [in] byte size of a leaf
+		@param threadNum [in] number of threads to hash leaves
+	*/
+	explicit Sha256Tree(size_t leafSize = 1024 * 1024, size_t threadNum = 1)
+		: leafSize_(leafSize)
+		, threadNum_(threadNum)
+	{
+		if (leafSize == 0 || threadNum == 0) throw cybozu::Exception("Sha256Tree:bad param") << leafSize << threadNum;
+		clear();
+	}
+	void clear()
+	{
+		totalSize_ = 0;
+		leaves_.clear();
+		cur_.clear();
+		curSize_ = 0;
+	}
+	size_t getLeafSize() const { return leafSize_; }
+	uint64_t getTotalSize() const { return totalSize_; }
+	/**
+		hashes of leaves
+		@note the last leaf is added by digest()
+	*/
+	const DigestVec& getLeaves() const { return leaves_; }
+	static void hashLeaf(Digest& d, const void *buf, size_t size)
+	{
+		Sha256 h;
+		const uint8_t prefix = 0;
+		h.update(&prefix, 1);
+		h.digest(d.buf, digestSize, buf, size);
+	}
+	static void hashNode(Digest& d, const Digest& left, const Digest& right)
+	{
+		uint8_t buf[1 + digestSize * 2];
+		buf[0] = 1;
+		memcpy(buf + 1, left.buf, digestSize);
+		memcpy(buf + 1 + digestSize, right.buf, digestSize);
+		Sha256().digest(d.buf, digestSize, buf, sizeof(buf));
+	}
+	/**
+		root of n leaves
+	*/
+	static Digest getRoot(const Digest *leaves, size_t n)
+	{
+		Digest d;
+		if (n == 0) {
+			Sha256().digest(d.buf, digestSize, "", 0);
+			return d;
+		}
+		if (n == 1) return leaves[0];
+		const size_t k = getSplit(n);
+		hashNode(d, getRoot(leaves, k), getRoot(leaves + k, n - k));
+		return d;
+	}
+	void update(const void *buf, size_t bufSize)
+	{
+		const uint8_t *p = static_cast<const uint8_t*>(buf);
+		totalSize_ += bufSize;
+		if (curSize_ > 0) {
+			const size_t n = std::min(leafSize_ - curSize_, bufSize);
+			cur_.update(p, n);
+			curSize_ += n;
+			p += n;
+			bufSize -= n;
+			if (curSize_ < leafSize_) return;
+			closeLeaf();
+		}
+		const size_t leafNum = bufSize / leafSize_;
+		if (leafNum > 0) {
+			const size_t n = leafNum * leafSize_;
+			const size_t pos = leaves_.size();
+			leaves_.resize(pos + leafNum);
+			hashLeaves(&leaves_[pos], p, n);
+			p += n;
+			bufSize -= n;
+		}
+		if (bufSize > 0) {
+			const uint8_t prefix = 0;
+			cur_.update(&prefix, 1);
+			cur_.update(p, bufSize);
+			curSize_ = bufSize;
+		}
+	}
+	/**
+		read f from the current position to the end
+		@param bufSize [in] byte size of the read buffer (0 means leafSize * threadNum * 4)
+	*/
+	void update(cybozu::File& f, size_t bufSize = 0)
+	{
+		if (bufSize == 0) bufSize = leafSize_ * threadNum_ * 4;
+		std::vector<char> buf(bufSize);
+		for (;;) {
+			size_t n = 0;
+			while (n < bufSize) {
+				const size_t readSize = f.readSome(&buf[n], bufSize - n);
+				if (readSize == 0) break;
+				n += readSize;
+			}
+			if (n == 0) return;
+			update(&buf[0], n);
+			if (n < bufSize) return;
+		}
+	}
+	/**
+		get the root
+		@note call clear() to reuse this object
+	*/
+	size_t digest(void *md, size_t mdSize)
+	{
+		if (mdSize < digestSize) return 0;
+		if (curSize_ > 0) closeLeaf();
+		const Digest d = getRoot(leaves_.empty() ? 0 : &leaves_[0], leaves_.size());
+		memcpy(md, d.buf, digestSize);
+		return digestSize;
+	}
+	/**
+		get the proof of [offset, offset + size) of data
+		offset must be a multiple of leafSize and size must be so unless the range reaches the end
+		@note call after digest()
+	*/
+	void getProof(DigestVec& proof, uint64_t offset, uint64_t size) const
+	{
+		size_t begin, end;
+		getLeafRange(begin, end, totalSize_, offset, size);
+		if (end > leaves_.size()) throw cybozu::Exception("Sha256Tree:getProof:call digest() before") << leaves_.size() << end;
+		proof.clear();
+		getProofSub(proof, &leaves_[0], 0, leaves_.size(), begin, end);
+	}
+	/**
+		verify [offset, offset + size) of data of totalSize bytes
+		@param root [in] the root of data
+		@param buf [in] the range of data
+		@param proof [in] the proof given by getProof(proof, offset, size)
+		@note leafSize must be the same as the one used to get root
+	*/
+	bool verify(const void *root, uint64_t totalSize, uint64_t offset, const void *buf, size_t size, const DigestVec& proof) const
+	{
+		size_t begin, end;
+		getLeafRange(begin, end, totalSize, offset, size);
+		DigestVec leaves(end - begin);
+		hashLeaves(&leaves[0], static_cast<const uint8_t*>(buf), size);
+		const size_t leafNum = size_t((totalSize + leafSize_ - 1) / leafSize_);
+		Digest d;
+		size_t pos = 0;
+		if (!verifySub(d, proof, pos, &leaves[0], 0, leafNum, begin, end)) return false;
+		return pos == proof.size() && memcmp(d.buf, root, digestSize) == 0;
+	}
+};
+
+} // cybozu
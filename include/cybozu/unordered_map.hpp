@@ -11,3 +11,492 @@
 	#include <tr1/unordered_map>
 #endif
 
+#include <memory>
+#include <new>
+#include <utility>
+#include <functional>
+#include <string.h>
+#include <stddef.h>
+#include <cybozu/hash.hpp>
+#include <cybozu/bit_operation.hpp>
+#include <cybozu/exception.hpp>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#define CYBOZU_FLAT_HASH_USE_SSE2
+	#include <emmintrin.h>
+#endif
+
+namespace cybozu {
+
+namespace flat_hash_local {
+
+/*
+	control byte of a slot
+	full slot has the low 7 bits of the hash
+*/
+enum {
+	ctrlEmpty = -128,
+	ctrlDeleted = -2,
+	ctrlSentinel = -1 // end of slots
+};
+
+/*
+	16 control bytes are compared at once
+*/
+struct Group {
+	static const size_t width = 16;
+#ifdef CYBOZU_FLAT_HASH_USE_SSE2
+	__m128i v;
+	explicit Group(const int8_t *p) : v(_mm_loadu_si128(cybozu::cast<const __m128i*>(p))) {}
+	uint32_t match(int8_t h2) const { return _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(h2), v)); }
+	uint32_t matchEmpty() const { return match(int8_t(ctrlEmpty)); }
+	uint32_t matchEmptyOrDeleted() const { return _mm_movemask_epi8(_mm_cmpgt_epi8(_mm_set1_epi8(ctrlSentinel), v)); }
+#else
+	int8_t v[width];
+	explicit Group(const int8_t *p) { memcpy(v, p, width); }
+	uint32_t match(int8_t h2) const
+	{
+		uint32_t m = 0;
+		for (size_t i = 0; i < width; i++) {
+			if (v[i] == h2) m |= 1u << i;
+		}
+		return m;
+	}
+	uint32_t matchEmpty() const { return match(int8_t(ctrlEmpty)); }
+	uint32_t matchEmptyOrDeleted() const
+	{
+		uint32_t m = 0;
+		for (size_t i = 0; i < width; i++) {
+			if (v[i] < ctrlSentinel) m |= 1u << i;
+		}
+		return m;
+	}
+#endif
+};
+
+inline int8_t *getEmptyGroup()
+{
+	static int8_t tbl[Group::width] = {
+		ctrlSentinel, ctrlEmpty, ctrlEmpty, ctrlEmpty, ctrlEmpty, ctrlEmpty, ctrlEmpty, ctrlEmpty,
+		ctrlEmpty, ctrlEmpty, ctrlEmpty, ctrlEmpty, ctrlEmpty, ctrlEmpty, ctrlEmpty, ctrlEmpty,
+	};
+	return tbl;
+}
+
+template<class K, class V>
+struct Select1st {
+	const K& operator()(const std::pair<const K, V>& x) const { return x.first; }
+};
+
+template<class K>
+struct Identity {
+	const K& operator()(const K& x) const { return x; }
+};
+
+/*
+	open addressing hash table with control bytes (Swiss table)
+	@param T [in] value_type
+	@param KeyOf [in] get key of T
+	@note the maximum load factor is 7/8
+	@note an iterator is invalidated if an element is inserted
+*/
+template<class K, class T, class KeyOf, class Hash, class Pred, class Alloc>
+class Table {
+public:
+	typedef K key_type;
+	typedef T value_type;
+	typedef Hash hasher;
+	typedef Pred key_equal;
+	typedef Alloc allocator_type;
+	typedef size_t size_type;
+	typedef ptrdiff_t difference_type;
+	typedef T& reference;
+	typedef const T& const_reference;
+	typedef T* pointer;
+	typedef const T* const_pointer;
+
+	template<class U>
+	class Iterator {
+		friend class Table;
+		template<class> friend class Iterator;
+		const int8_t *ctrl_;
+		U *slot_;
+		Iterator(const int8_t *ctrl, U *slot) : ctrl_(ctrl), slot_(slot) { skip(); }
+		// skip empty and deleted slots
+		void skip()
+		{
+			while (*ctrl_ < ctrlSentinel) {
+				ctrl_++;
+				slot_++;
+			}
+		}
+	public:
+		typedef std::forward_iterator_tag iterator_category;
+		typedef T value_type;
+		typedef ptrdiff_t difference_type;
+		typedef U* pointer;
+		typedef U& reference;
+		Iterator() : ctrl_(0), slot_(0) {}
+		// iterator to const_iterator
+		template<class V>
+		Iterator(const Iterator<V>& rhs) : ctrl_(rhs.ctrl_), slot_(rhs.slot_) {}
+		U& operator*() const { return *slot_; }
+		U* operator->() const { return slot_; }
+		Iterator& operator++()
+		{
+			ctrl_++;
+			slot_++;
+			skip();
+			return *this;
+		}
+		Iterator operator++(int)
+		{
+			Iterator t = *this;
+			++*this;
+			return t;
+		}
+		template<class V>
+		bool operator==(const Iterator<V>& rhs) const { return ctrl_ == rhs.ctrl_; }
+		template<class V>
+		bool operator!=(const Iterator<V>& rhs) const { return ctrl_ != rhs.ctrl_; }
+	};
+	typedef Iterator<T> iterator;
+	typedef Iterator<const T> const_iterator;
+private:
+	/*
+		ctrl_[capacity_] is ctrlSentinel and ctrl_[capacity_ + 1, capacity_ + width) is a copy of ctrl_[0, width - 1)
+		so that a group can be loaded at any position
+	*/
+	int8_t *ctrl_;
+	T *slot_;
+	size_t capacity_; // 0 or power of 2 minus 1 (>= width - 1)
+	size_t size_;
+	size_t growthLeft_; // number of empty slots which can be used
+	Hash hash_;
+	Pred pred_;
+	Alloc alloc_;
+	static size_t getGrowth(size_t capacity) { return capacity - capacity / 8; }
+	size_t getHash(const K& key) const
+	{
+		return size_t(hash_local::mix(uint64_t(hash_(key)), 0x9e3779b97f4a7c15ULL));
+	}
+	static int8_t getH2(size_t h) { return int8_t(h & 0x7f); }
+	void setCtrl(size_t i, int8_t c)
+	{
+		ctrl_[i] = c;
+		// copy of the first width - 1 bytes
+		ctrl_[((i - (Group::width - 1)) & capacity_) + (Group::width - 1)] = c;
+	}
+	void init(size_t capacity)
+	{
+		capacity_ = capacity;
+		size_ = 0;
+		if (capacity == 0) {
+			ctrl_ = getEmptyGroup();
+			slot_ = 0;
+			growthLeft_ = 0;
+			return;
+		}
+		const size_t ctrlSize = capacity + Group::width;
+		ctrl_ = new int8_t[ctrlSize];
+		try {
+			slot_ = alloc_.allocate(capacity);
+		} catch (...) {
+			delete[] ctrl_;
+			throw;
+		}
+		memset(ctrl_, ctrlEmpty, ctrlSize);
+		ctrl_[capacity] = ctrlSentinel;
+		growthLeft_ = getGrowth(capacity);
+	}
+	void destroyAll()
+	{
+		for (size_t i = 0; i < capacity_; i++) {
+			if (ctrl_[i] >= 0) slot_[i].~T();
+		}
+	}
+	void release()
+	{
+		if (capacity_ == 0) return;
+		delete[] ctrl_;
+		alloc_.deallocate(slot_, capacity_);
+	}
+	/*
+		find the position of key or return capacity_
+	*/
+	template<class Key>
+	size_t findPos(const Key& key, size_t h) const
+	{
+		const int8_t h2 = getH2(h);
+		size_t pos = (h >> 7) & capacity_;
+		for (size_t step = Group::width; ; step += Group::width) {
+			const Group g(ctrl_ + pos);
+			for (uint32_t m = g.match(h2); m; m &= m - 1) {
+				const size_t i = (pos + cybozu::bsf(m)) & capacity_;
+				if (pred_(KeyOf()(slot_[i]), key)) return i;
+			}
+			if (g.matchEmpty()) return capacity_;
+			pos = (pos + step) & capacity_;
+		}
+	}
+	/*
+		find an empty or deleted slot for h
+	*/
+	size_t findFreePos(size_t h) const
+	{
+		size_t pos = (h >> 7) & capacity_;
+		for (size_t step = Group::width; ; step += Group::width) {
+			const uint32_t m = Group(ctrl_ + pos).matchEmptyOrDeleted();
+			if (m) return (pos + cybozu::bsf(m)) & capacity_;
+			pos = (pos + step) & capacity_;
+		}
+	}
+	/*
+		rebuild the table with newCapacity(power of 2 minus 1) and remove deleted slots
+		elements are moved if the move constructor does not throw, otherwise copied
+		so that the table is not changed by an exception
+	*/
+	void resize(size_t newCapacity)
+	{
+		Table t(hash_, pred_, alloc_);
+		t.init(newCapacity);
+		for (size_t i = 0; i < capacity_; i++) {
+			if (ctrl_[i] < 0) continue;
+			const size_t h = getHash(KeyOf()(slot_[i]));
+			const size_t pos = t.findFreePos(h);
+#if CYBOZU_CPP_VERSION >= CYBOZU_CPP_VERSION_CPP11
+			new (&t.slot_[pos]) T(std::move_if_noexcept(slot_[i]));
+#else
+			new (&t.slot_[pos]) T(slot_[i]);
+#endif
+			t.setCtrl(pos, getH2(h));
+			t.size_++;
+			t.growthLeft_--;
+		}
+		swap(t);
+	}
+	static size_t getCapacity(size_t n)
+	{
+		// the smallest capacity whose growth >= n
+		size_t c = Group::width - 1;
+		while (getGrowth(c) < n) c = c * 2 + 1;
+		return c;
+	}
+	/*
+		insert x which is not in the table
+	*/
+	size_t insertNew(const T& x, size_t h)
+	{
+		size_t pos = findFreePos(h);
+		if (growthLeft_ == 0 && ctrl_[pos] != ctrlDeleted) {
+			// remove deleted slots if they are many, otherwise grow
+			resize(size_ * 2 < getGrowth(capacity_) ? capacity_ : getCapacity(capacity_ == 0 ? 1 : (capacity_ + 1)));
+			pos = findFreePos(h);
+		}
+		new (&slot_[pos]) T(x);
+		if (ctrl_[pos] == ctrlEmpty) growthLeft_--;
+		setCtrl(pos, getH2(h));
+		size_++;
+		return pos;
+	}
+	void eraseAt(size_t pos)
+	{
+		slot_[pos].~T();
+		setCtrl(pos, ctrlDeleted);
+		size_--;
+	}
+public:
+	explicit Table(const Hash& hash = Hash(), const Pred& pred = Pred(), const Alloc& alloc = Alloc())
+		: hash_(hash)
+		, pred_(pred)
+		, alloc_(alloc)
+	{
+		init(0);
+	}
+	Table(const Table& rhs)
+		: hash_(rhs.hash_)
+		, pred_(rhs.pred_)
+		, alloc_(rhs.alloc_)
+	{
+		init(rhs.size_ == 0 ? 0 : getCapacity(rhs.size_));
+		try {
+			for (const_iterator i = rhs.begin(), ie = rhs.end(); i != ie; ++i) {
+				insertNew(*i, getHash(KeyOf()(*i)));
+			}
+		} catch (...) {
+			// the destructor is not called
+			destroyAll();
+			release();
+			throw;
+		}
+	}
+#if CYBOZU_CPP_VERSION >= CYBOZU_CPP_VERSION_CPP11
+	Table(Table&& rhs)
+		: hash_(rhs.hash_)
+		, pred_(rhs.pred_)
+		, alloc_(rhs.alloc_)
+	{
+		init(0);
+		swap(rhs);
+	}
+	Table& operator=(Table&& rhs)
+	{
+		swap(rhs);
+		return *this;
+	}
+#endif
+	Table& operator=(const Table& rhs)
+	{
+		if (this != &rhs) {
+			Table t(rhs);
+			swap(t);
+		}
+		return *this;
+	}
+	~Table()
+	{
+		destroyAll();
+		release();
+	}
+	void swap(Table& rhs)
+	{
+		std::swap(ctrl_, rhs.ctrl_);
+		std::swap(slot_, rhs.slot_);
+		std::swap(capacity_, rhs.capacity_);
+		std::swap(size_, rhs.size_);
+		std::swap(growthLeft_, rhs.growthLeft_);
+		std::swap(hash_, rhs.hash_);
+		std::swap(pred_, rhs.pred_);
+		std::swap(alloc_, rhs.alloc_);
+	}
+	iterator begin() { return iterator(ctrl_, slot_); }
+	iterator end() { return iterator(ctrl_ + capacity_, slot_ + capacity_); }
+	const_iterator begin() const { return const_iterator(ctrl_, slot_); }
+	const_iterator end() const { return const_iterator(ctrl_ + capacity_, slot_ + capacity_); }
+	const_iterator cbegin() const { return begin(); }
+	const_iterator cend() const { return end(); }
+	bool empty() const { return size_ == 0; }
+	size_t size() const { return size_; }
+	size_t max_size() const { return size_t(-1) / (sizeof(T) + 1); }
+	void clear()
+	{
+		destroyAll();
+		if (capacity_ > 0) {
+			memset(ctrl_, ctrlEmpty, capacity_ + Group::width);
+			ctrl_[capacity_] = ctrlSentinel;
+		}
+		size_ = 0;
+		growthLeft_ = getGrowth(capacity_);
+	}
+	std::pair<iterator, bool> insert(const T& x)
+	{
+		const size_t h = getHash(KeyOf()(x));
+		size_t pos = findPos(KeyOf()(x), h);
+		if (pos != capacity_) return std::make_pair(iterator(ctrl_ + pos, slot_ + pos), false);
+		pos = insertNew(x, h);
+		return std::make_pair(iterator(ctrl_ + pos, slot_ + pos), true);
+	}
+	template<class Iter>
+	void insert(Iter begin, Iter end)
+	{
+		for (; begin != end; ++begin) insert(*begin);
+	}
+	iterator find(const K& key)
+	{
+		const size_t pos = findPos(key, getHash(key));
+		return iterator(ctrl_ + pos, slot_ + pos);
+	}
+	const_iterator find(const K& key) const
+	{
+		const size_t pos = findPos(key, getHash(key));
+		return const_iterator(ctrl_ + pos, slot_ + pos);
+	}
+	size_t count(const K& key) const
+	{
+		return findPos(key, getHash(key)) != capacity_ ? 1 : 0;
+	}
+	size_t erase(const K& key)
+	{
+		const size_t pos = findPos(key, getHash(key));
+		if (pos == capacity_) return 0;
+		eraseAt(pos);
+		return 1;
+	}
+	/*
+		@return the next iterator
+	*/
+	iterator erase(const_iterator it)
+	{
+		const size_t pos = it.ctrl_ - ctrl_;
+		eraseAt(pos);
+		return iterator(ctrl_ + pos + 1, slot_ + pos + 1);
+	}
+	/*
+		prepare for n elements
+	*/
+	void reserve(size_t n)
+	{
+		if (n > size_ + growthLeft_) resize(getCapacity(n));
+	}
+	void rehash(size_t n)
+	{
+		if (n < size_) n = size_;
+		resize(n == 0 ? 0 : getCapacity(n));
+	}
+	size_t bucket_count() const { return capacity_; }
+	float load_factor() const { return capacity_ ? float(size_) / capacity_ : 0; }
+	float max_load_factor() const { return 7.0f / 8; }
+	hasher hash_function() const { return hash_; }
+	key_equal key_eq() const { return pred_; }
+	allocator_type get_allocator() const { return alloc_; }
+};
+
+} // cybozu::flat_hash_local
+
+/*
+	hash map with open addressing (Swiss table)
+	elements are stored in one array without a node per element
+	the API is a subset of std::unordered_map
+	@note an iterator and a reference to an element are invalidated by insert
+	@note loaded and saved by cybozu/serializer.hpp as unordered_map
+*/
+template<class K, class V, class Hash = CYBOZU_NAMESPACE_STD::hash<K>, class Pred = std::equal_to<K>, class Alloc = std::allocator<std::pair<const K, V> > >
+class FlatHashMap : public flat_hash_local::Table<K, std::pair<const K, V>, flat_hash_local::Select1st<K, V>, Hash, Pred, Alloc> {
+	typedef flat_hash_local::Table<K, std::pair<const K, V>, flat_hash_local::Select1st<K, V>, Hash, Pred, Alloc> Base;
+public:
+	typedef V mapped_type;
+	typedef typename Base::iterator iterator;
+	typedef typename Base::const_iterator const_iterator;
+	explicit FlatHashMap(size_t n = 0, const Hash& hash = Hash(), const Pred& pred = Pred(), const Alloc& alloc = Alloc())
+		: Base(hash, pred, alloc)
+	{
+		if (n > 0) Base::reserve(n);
+	}
+	template<class Iter>
+	FlatHashMap(Iter begin, Iter end, size_t n = 0, const Hash& hash = Hash(), const Pred& pred = Pred(), const Alloc& alloc = Alloc())
+		: Base(hash, pred, alloc)
+	{
+		if (n > 0) Base::reserve(n);
+		Base::insert(begin, end);
+	}
+	V& operator[](const K& key)
+	{
+		iterator i = Base::find(key);
+		if (i == Base::end()) i = Base::insert(std::pair<const K, V>(key, V())).first;
+		return i->second;
+	}
+	V& at(const K& key)
+	{
+		iterator i = Base::find(key);
+		if (i == Base::end()) throw cybozu::Exception("FlatHashMap:at:not found");
+		return i->second;
+	}
+	const V& at(const K& key) const
+	{
+		const_iterator i = Base::find(key);
+		if (i == Base::end()) throw cybozu::Exception("FlatHashMap:at:not found");
+		return i->second;
+	}
+};
+
+} // cybozu
@@ -11,3 +11,51 @@
 	#include <tr1/unordered_set>
 #endif
 
+
+#include <cybozu/unordered_map.hpp>
+
+namespace cybozu {
+
+/*
+	hash set with open addressing (Swiss table)
+	the API is a subset of std::unordered_set
+	@note an iterator and a reference to an element are invalidated by insert
+	@note loaded and saved by cybozu/serializer.hpp
+*/
+template<class K, class Hash = CYBOZU_NAMESPACE_STD::hash<K>, class Pred = std::equal_to<K>, class Alloc = std::allocator<K> >
+class FlatHashSet : public flat_hash_local::Table<K, K, flat_hash_local::Identity<K>, Hash, Pred, Alloc> {
+	typedef flat_hash_local::Table<K, K, flat_hash_local::Identity<K>, Hash, Pred, Alloc> Base;
+public:
+	typedef typename Base::const_iterator iterator;
+	typedef typename Base::const_iterator const_iterator;
+	explicit FlatHashSet(size_t n = 0, const Hash& hash = Hash(), const Pred& pred = Pred(), const Alloc& alloc = Alloc())
+		: Base(hash, pred, alloc)
+	{
+		if (n > 0) Base::reserve(n);
+	}
+	template<class Iter>
+	FlatHashSet(Iter begin, Iter end, size_t n = 0, const Hash& hash = Hash(), const Pred& pred = Pred(), const Alloc& alloc = Alloc())
+		: Base(hash, pred, alloc)
+	{
+		if (n > 0) Base::reserve(n);
+		Base::insert(begin, end);
+	}
+	// elements are immutable
+	const_iterator begin() const { return Base::begin(); }
+	const_iterator end() const { return Base::end(); }
+	const_iterator find(const K& key) const { return Base::find(key); }
+	std::pair<const_iterator, bool> insert(const K& x)
+	{
+		std::pair<typename Base::iterator, bool> r = Base::insert(x);
+		return std::make_pair(const_iterator(r.first), r.second);
+	}
+	template<class Iter>
+	void insert(Iter begin, Iter end)
+	{
+		Base::insert(begin, end);
+	}
+	size_t erase(const K& key) { return Base::erase(key); }
+	const_iterator erase(const_iterator it) { return Base::erase(it); }
+};
+
+} // cybozu
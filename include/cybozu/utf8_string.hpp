@@ -0,0 +1,477 @@
+#pragma once
+/**
+	@file
+	@brief unicode string class holding UTF-8 internally
+
+	@author MITSUNARI Shigeo(@herumi)
+*/
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <iterator>
+#include <iosfwd>
+#include <cybozu/string.hpp>
+
+namespace cybozu {
+
+namespace utf8_string_local {
+
+/*
+	byte size of a character starting with c(valid lead byte)
+*/
+inline size_t getCharLen(uint8_t c)
+{
+	return 1 + (c >= 0xc0) + (c >= 0xe0) + (c >= 0xf0);
+}
+
+inline bool isLead(uint8_t c)
+{
+	return (c & 0xc0) != 0x80;
+}
+
+/*
+	the number of characters in valid UTF-8 [p, p + n)
+*/
+inline size_t countChar(const char *p, size_t n)
+{
+	size_t num = 0;
+	size_t i = 0;
+#ifdef CYBOZU_STRING_USE_SSE2
+	// a byte is not a continuation byte iff it is greater than 0xbf as int8_t
+	const __m128i c0xbf = _mm_set1_epi8(-65);
+	for (; i + 16 <= n; i += 16) {
+		const __m128i x = _mm_loadu_si128(cybozu::cast<const __m128i*>(p + i));
+		num += cybozu::popcnt<uint32_t>(_mm_movemask_epi8(_mm_cmpgt_epi8(x, c0xbf)));
+	}
+#endif
+	for (; i < n; i++) {
+		num += isLead(uint8_t(p[i]));
+	}
+	return num;
+}
+
+/*
+	get a character from valid UTF-8 at p
+*/
+inline Char decode(const char *p)
+{
+	const uint32_t c0 = uint8_t(p[0]);
+	if (c0 < 0x80) return Char(c0);
+	if (c0 < 0xe0) return Char(((c0 & 0x1f) << 6) | (uint8_t(p[1]) & 0x3f));
+	if (c0 < 0xf0) return Char(((c0 & 0x0f) << 12) | ((uint8_t(p[1]) & 0x3f) << 6) | (uint8_t(p[2]) & 0x3f));
+	return Char(((c0 & 0x07) << 18) | ((uint8_t(p[1]) & 0x3f) << 12) | ((uint8_t(p[2]) & 0x3f) << 6) | (uint8_t(p[3]) & 0x3f));
+}
+
+} // utf8_string_local
+
+/**
+	unicode string holding valid UTF-8
+	the interface is similar to cybozu::String but positions and sizes are
+	counted in characters(code points)
+	@note operator[] uses a sparse index of byte offsets built on demand,
+	which makes random access O(1) amortized.
+	call buildIndex() before sharing a const object among threads
+	because the index is created in const member functions.
+*/
+class Utf8String {
+public:
+	typedef Char value_type;
+	typedef size_t size_type;
+	typedef ptrdiff_t difference_type;
+	static const size_t npos = size_t(-1);
+	/*
+		the index has an offset every indexInterval characters
+	*/
+	static const size_t indexInterval = 32;
+	/*
+		linear scan is used for a string shorter than this without the index
+	*/
+	static const size_t minIndexByteSize = 256;
+
+	class const_iterator {
+		const char *p_;
+	public:
+		typedef std::bidirectional_iterator_tag iterator_category;
+		typedef Char value_type;
+		typedef ptrdiff_t difference_type;
+		typedef const Char *pointer;
+		typedef Char reference;
+		const_iterator() : p_(0) {}
+		explicit const_iterator(const char *p) : p_(p) {}
+		Char operator*() const { return utf8_string_local::decode(p_); }
+		const_iterator& operator++()
+		{
+			p_ += utf8_string_local::getCharLen(uint8_t(*p_));
+			return *this;
+		}
+		const_iterator operator++(int)
+		{
+			const_iterator t = *this;
+			++*this;
+			return t;
+		}
+		const_iterator& operator--()
+		{
+			do {
+				p_--;
+			} while (!utf8_string_local::isLead(uint8_t(*p_)));
+			return *this;
+		}
+		const_iterator operator--(int)
+		{
+			const_iterator t = *this;
+			--*this;
+			return t;
+		}
+		bool operator==(const const_iterator& rhs) const { return p_ == rhs.p_; }
+		bool operator!=(const const_iterator& rhs) const { return p_ != rhs.p_; }
+		/*
+			pointer to UTF-8 of the current character
+		*/
+		const char *get() const { return p_; }
+	};
+	typedef const_iterator iterator;
+
+	Utf8String() : size_(0), idx_(0) {}
+	/**
+		construct from UTF-8 [str, str + size)
+		@note throw exception if str is invalid
+	*/
+	Utf8String(const char *str, size_t size)
+		: size_(npos), idx_(0)
+	{
+		assignUtf8(str, size);
+	}
+	/**
+		construct from UTF-8 [str, NUL)
+	*/
+	Utf8String(const char *str)
+		: size_(npos), idx_(0)
+	{
+		assignUtf8(str, std::strlen(str));
+	}
+	/**
+		construct from UTF-8 str
+	*/
+	Utf8String(const std::string& str)
+		: size_(npos), idx_(0)
+	{
+		assignUtf8(str.data(), str.size());
+	}
+	/**
+		construct from cybozu::String
+	*/
+	Utf8String(const cybozu::String& str)
+		: size_(str.size()), idx_(0)
+	{
+		str.toUtf8(str_);
+	}
+	Utf8String(const Utf8String& rhs)
+		: str_(rhs.str_), size_(rhs.size_), idx_(0)
+	{
+	}
+	~Utf8String()
+	{
+		delete idx_;
+	}
+	Utf8String& operator=(const Utf8String& rhs)
+	{
+		if (this == &rhs) return *this;
+		str_ = rhs.str_;
+		size_ = rhs.size_;
+		clearIndex();
+		return *this;
+	}
+#if CYBOZU_CPP_VERSION >= CYBOZU_CPP_VERSION_CPP11
+	Utf8String(Utf8String&& rhs) CYBOZU_NOEXCEPT
+		: str_(std::move(rhs.str_)), size_(rhs.size_), idx_(rhs.idx_)
+	{
+		rhs.size_ = npos;
+		rhs.idx_ = 0;
+	}
+	Utf8String& operator=(Utf8String&& rhs) CYBOZU_NOEXCEPT
+	{
+		swap(rhs);
+		return *this;
+	}
+#endif
+	void swap(Utf8String& rhs) CYBOZU_NOEXCEPT
+	{
+		str_.swap(rhs.str_);
+		std::swap(size_, rhs.size_);
+		std::swap(idx_, rhs.idx_);
+	}
+	Utf8String& assign(const char *str, size_t size)
+	{
+		assignUtf8(str, size);
+		return *this;
+	}
+	Utf8String& assign(const std::string& str) { return assign(str.data(), str.size()); }
+	Utf8String& assign(const char *str) { return assign(str, std::strlen(str)); }
+	Utf8String& operator=(const char *str) { return assign(str); }
+	Utf8String& operator=(const std::string& str) { return assign(str); }
+	Utf8String& operator=(const cybozu::String& str) { return *this = Utf8String(str); }
+	/**
+		append UTF-8 [str, str + size)
+		@note throw exception if str is invalid(this is not changed)
+	*/
+	Utf8String& append(const char *str, size_t size)
+	{
+		if (!cybozu::string::IsValidUtf8(str, size)) {
+			throw cybozu::Exception("Utf8String:append:bad utf8");
+		}
+		if (size_ != npos) size_ += utf8_string_local::countChar(str, size);
+		str_.append(str, size);
+		clearIndex();
+		return *this;
+	}
+	Utf8String& append(const std::string& str) { return append(str.data(), str.size()); }
+	Utf8String& append(const char *str) { return append(str, std::strlen(str)); }
+	Utf8String& append(const Utf8String& str)
+	{
+		if (size_ != npos && str.size_ != npos) {
+			size_ += str.size_;
+		} else {
+			size_ = npos;
+		}
+		str_.append(str.str_);
+		clearIndex();
+		return *this;
+	}
+	/**
+		append a character
+		@note throw exception if c is invalid
+	*/
+	Utf8String& append(Char c)
+	{
+		if (!cybozu::string::AppendUtf8(str_, c)) {
+			throw cybozu::Exception("Utf8String:append:bad char") << c;
+		}
+		if (size_ != npos) size_++;
+		clearIndex();
+		return *this;
+	}
+	void push_back(Char c) { append(c); }
+	Utf8String& operator+=(const Utf8String& str) { return append(str); }
+	Utf8String& operator+=(const char *str) { return append(str); }
+	Utf8String& operator+=(const std::string& str) { return append(str); }
+	Utf8String& operator+=(Char c) { return append(c); }
+	void clear()
+	{
+		str_.clear();
+		size_ = 0;
+		clearIndex();
+	}
+	/**
+		number of characters
+	*/
+	size_t size() const
+	{
+		if (size_ == npos) size_ = utf8_string_local::countChar(str_.data(), str_.size());
+		return size_;
+	}
+	size_t length() const { return size(); }
+	bool empty() const { return str_.empty(); }
+	/**
+		byte size of UTF-8
+	*/
+	size_t byteSize() const { return str_.size(); }
+	/**
+		get UTF-8 string
+	*/
+	const std::string& get() const { return str_; }
+	const char *c_str() const { return str_.c_str(); }
+	const char *data() const { return str_.data(); }
+	std::string toUtf8() const { return str_; }
+	void toUtf8(std::string& str) const { str.append(str_); }
+	cybozu::String toString() const { return cybozu::String(str_); }
+	cybozu::String16 toUtf16() const { return cybozu::ToUtf16(str_); }
+
+	const_iterator begin() const { return const_iterator(str_.data()); }
+	const_iterator end() const { return const_iterator(str_.data() + str_.size()); }
+
+	/**
+		get the pos-th character
+	*/
+	Char operator[](size_t pos) const
+	{
+		return utf8_string_local::decode(str_.data() + getByteOffset(pos));
+	}
+	Char at(size_t pos) const
+	{
+		if (pos >= size()) throw cybozu::Exception("Utf8String:at:out of range") << pos << size();
+		return operator[](pos);
+	}
+	/**
+		byte offset of the pos-th character
+		@note return byteSize() if pos == size()
+	*/
+	size_t getByteOffset(size_t pos) const
+	{
+		const size_t n = size();
+		if (pos >= n) return pos == n ? str_.size() : npos;
+		if (n == str_.size()) return pos; // ASCII only
+		const char *p = str_.data();
+		size_t offset = 0;
+		if (str_.size() >= minIndexByteSize) {
+			buildIndex();
+			offset = (*idx_)[pos / indexInterval];
+			pos %= indexInterval;
+		}
+		while (pos > 0) {
+			offset += utf8_string_local::getCharLen(uint8_t(p[offset]));
+			pos--;
+		}
+		return offset;
+	}
+	/**
+		character position of byteOffset
+		@note byteOffset must be a boundary of characters
+	*/
+	size_t getPos(size_t byteOffset) const
+	{
+		if (byteOffset == npos) return npos;
+		const size_t n = size();
+		if (n == str_.size()) return byteOffset; // ASCII only
+		if (str_.size() < minIndexByteSize) {
+			return utf8_string_local::countChar(str_.data(), byteOffset);
+		}
+		buildIndex();
+		const std::vector<size_t>& idx = *idx_;
+		const size_t i = std::upper_bound(idx.begin(), idx.end(), byteOffset) - idx.begin() - 1;
+		return i * indexInterval + utf8_string_local::countChar(str_.data() + idx[i], byteOffset - idx[i]);
+	}
+	/**
+		build the index for random access
+		@note not thread-safe
+	*/
+	void buildIndex() const
+	{
+		if (idx_) return;
+		const size_t n = size();
+		std::vector<size_t> *idx = new std::vector<size_t>();
+		idx->reserve(n / indexInterval + 1);
+		const char *p = str_.data();
+		size_t offset = 0;
+		for (size_t i = 0; i < n; i++) {
+			if ((i % indexInterval) == 0) idx->push_back(offset);
+			offset += utf8_string_local::getCharLen(uint8_t(p[offset]));
+		}
+		if (idx->empty()) idx->push_back(0);
+		idx_ = idx;
+	}
+	/**
+		get [pos, pos + count) as a string
+	*/
+	Utf8String substr(size_t pos = 0, size_t count = npos) const
+	{
+		const size_t n = size();
+		if (pos > n) throw cybozu::Exception("Utf8String:substr:out of range") << pos << n;
+		if (count > n - pos) count = n - pos;
+		const size_t begin = getByteOffset(pos);
+		const size_t end = getByteOffset(pos + count);
+		Utf8String ret;
+		ret.str_.assign(str_, begin, end - begin);
+		ret.size_ = count;
+		return ret;
+	}
+	/**
+		find str in [pos, size())
+		@return position of characters or npos if not found
+	*/
+	size_t find(const Utf8String& str, size_t pos = 0) const
+	{
+		return findUtf8(str.str_.data(), str.str_.size(), pos);
+	}
+	size_t find(const char *str, size_t pos = 0) const
+	{
+		return findUtf8(str, std::strlen(str), pos);
+	}
+	size_t find(const std::string& str, size_t pos = 0) const
+	{
+		return findUtf8(str.data(), str.size(), pos);
+	}
+	size_t find(Char c, size_t pos = 0) const
+	{
+		char buf[4];
+		const int len = cybozu::string::toUtf8(buf, c);
+		if (len == 0) return npos;
+		return findUtf8(buf, len, pos);
+	}
+	/**
+		find str in [0, pos]
+		@return position of characters or npos if not found
+	*/
+	size_t rfind(const Utf8String& str, size_t pos = npos) const
+	{
+		return rfindUtf8(str.str_.data(), str.str_.size(), pos);
+	}
+	size_t rfind(const char *str, size_t pos = npos) const
+	{
+		return rfindUtf8(str, std::strlen(str), pos);
+	}
+	size_t rfind(const std::string& str, size_t pos = npos) const
+	{
+		return rfindUtf8(str.data(), str.size(), pos);
+	}
+	size_t rfind(Char c, size_t pos = npos) const
+	{
+		char buf[4];
+		const int len = cybozu::string::toUtf8(buf, c);
+		if (len == 0) return npos;
+		return rfindUtf8(buf, len, pos);
+	}
+	/**
+		compare by code points
+		@note the order of UTF-8 bytes is the same as the one of code points
+	*/
+	int compare(const Utf8String& rhs) const { return str_.compare(rhs.str_); }
+	int compare(const std::string& rhs) const { return str_.compare(rhs); }
+	int compare(const char *rhs) const { return str_.compare(rhs); }
+	template<class T>bool operator==(const T& rhs) const { return compare(rhs) == 0; }
+	template<class T>bool operator!=(const T& rhs) const { return compare(rhs) != 0; }
+	template<class T>bool operator<=(const T& rhs) const { return compare(rhs) <= 0; }
+	template<class T>bool operator>=(const T& rhs) const { return compare(rhs) >= 0; }
+	template<class T>bool operator<(const T& rhs) const { return compare(rhs) < 0; }
+	template<class T>bool operator>(const T& rhs) const { return compare(rhs) > 0; }
+private:
+	std::string str_;
+	mutable size_t size_; // npos if not counted
+	mutable std::vector<size_t> *idx_; // byte offset of every indexInterval-th character
+	void clearIndex()
+	{
+		delete idx_;
+		idx_ = 0;
+	}
+	void assignUtf8(const char *str, size_t size)
+	{
+		if (!cybozu::string::IsValidUtf8(str, size)) {
+			throw cybozu::Exception("Utf8String:bad utf8");
+		}
+		str_.assign(str, size);
+		size_ = npos;
+		clearIndex();
+	}
+	size_t findUtf8(const char *str, size_t len, size_t pos) const
+	{
+		const size_t offset = getByteOffset(pos);
+		if (offset == npos) return npos;
+		return getPos(str_.find(str, offset, len));
+	}
+	size_t rfindUtf8(const char *str, size_t len, size_t pos) const
+	{
+		const size_t offset = pos < size() ? getByteOffset(pos) : npos;
+		return getPos(str_.rfind(str, offset, len));
+	}
+};
+
+inline std::ostream& operator<<(std::ostream& os, const Utf8String& str)
+{
+	return os << str.get();
+}
+
+inline Utf8String operator+(const Utf8String& lhs, const Utf8String& rhs) { return Utf8String(lhs) += rhs; }
+
+inline void swap(Utf8String& lhs, Utf8String& rhs) { lhs.swap(rhs); }
+
+} // cybozu
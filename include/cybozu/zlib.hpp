@@ -140,6 +140,7 @@ public:
 			cybozu::Set32bitAsLE(&tail[4], totalSize_);
 			write_os(tail, sizeof(tail));
 		}
+		cybozu::OutputStreamTag<OutputStream>::flush(os_);
 	}
 private:
 	void write_os(const char *buf, size_t size)
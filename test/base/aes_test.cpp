@@ -2,6 +2,8 @@
 #include <cybozu/aes.hpp>
 #include <cybozu/itoa.hpp>
 #include <cybozu/atoi.hpp>
+#include <algorithm>
+#include "test_util.hpp"
 
 std::string toHexStr(const std::string& buf)
 {
@@ -295,3 +297,297 @@ CYBOZU_TEST_AUTO(aesPartialUpdate)
 		}
 	}
 }
+
+const cybozu::crypto::Cipher::Name allNameTbl[] = {
+	cybozu::crypto::Cipher::N_AES128_CBC, cybozu::crypto::Cipher::N_AES192_CBC, cybozu::crypto::Cipher::N_AES256_CBC,
+	cybozu::crypto::Cipher::N_AES128_CTR, cybozu::crypto::Cipher::N_AES192_CTR, cybozu::crypto::Cipher::N_AES256_CTR,
+	cybozu::crypto::Cipher::N_AES128_ECB, cybozu::crypto::Cipher::N_AES192_ECB, cybozu::crypto::Cipher::N_AES256_ECB,
+};
+
+// multi-block kernels must give the same result as block by block processing
+CYBOZU_TEST_AUTO(aesMultiBlock)
+{
+	const std::string iv = fromHexStr("f0f1f2f3f4f5f6f7f8f9fafbfcfdfeff");
+	const size_t sizeTbl[] = { 16, 16 * 7, 16 * 8, 16 * 9, 16 * 15, 16 * 16, 16 * 17, 16 * 33 + 5, 16 * 100 };
+	for (size_t i = 0; i < CYBOZU_NUM_OF_ARRAY(allNameTbl); i++) {
+		const cybozu::crypto::Cipher::Name name = allNameTbl[i];
+		const std::string key = makeData(cybozu::crypto::Cipher::getSize(name) / 8);
+		for (size_t j = 0; j < CYBOZU_NUM_OF_ARRAY(sizeTbl); j++) {
+			size_t n = sizeTbl[j];
+			if (name < cybozu::crypto::Cipher::N_AES128_CTR || name > cybozu::crypto::Cipher::N_AES256_CTR) n &= ~size_t(15);
+			const std::string plain = makeData(n);
+			const std::string cipher = evalCipher(name, cybozu::crypto::Cipher::Encoding, key, iv, plain);
+			CYBOZU_TEST_EQUAL(evalCipherChunked(name, cybozu::crypto::Cipher::Encoding, key, iv, plain, 16), cipher);
+			CYBOZU_TEST_EQUAL(evalCipherChunked(name, cybozu::crypto::Cipher::Decoding, key, iv, cipher, 16), plain);
+			CYBOZU_TEST_EQUAL(evalCipher(name, cybozu::crypto::Cipher::Decoding, key, iv, cipher), plain);
+		}
+	}
+}
+
+CYBOZU_TEST_AUTO(aesInPlace)
+{
+	const std::string iv = fromHexStr("000102030405060708090a0b0c0d0e0f");
+	for (size_t i = 0; i < CYBOZU_NUM_OF_ARRAY(allNameTbl); i++) {
+		const cybozu::crypto::Cipher::Name name = allNameTbl[i];
+		const std::string key = makeData(cybozu::crypto::Cipher::getSize(name) / 8);
+		const std::string plain = makeData(16 * 37);
+		const std::string cipher = evalCipher(name, cybozu::crypto::Cipher::Encoding, key, iv, plain);
+		std::string s = cipher;
+		cybozu::crypto::Cipher dec(name);
+		dec.setup(cybozu::crypto::Cipher::Decoding, key, iv);
+		CYBOZU_TEST_EQUAL(dec.update(&s[0], s.data(), (int)s.size()), (int)s.size());
+		CYBOZU_TEST_EQUAL(s, plain);
+	}
+}
+
+// the counter is a 128-bit big endian integer
+CYBOZU_TEST_AUTO(aesCtrCarry)
+{
+	const std::string key = fromHexStr("2b7e151628aed2a6abf7158809cf4f3c");
+	const std::string iv = fromHexStr("00000000000000fffffffffffffffff6");
+	const size_t n = 16 * 40;
+	const std::string ks = evalCipher(cybozu::crypto::Cipher::N_AES128_CTR, cybozu::crypto::Cipher::Encoding, key, iv, std::string(n, 0));
+	std::string ctr;
+	std::string c = iv;
+	for (size_t i = 0; i < n / 16; i++) {
+		ctr += c;
+		for (int j = 15; j >= 0; j--) {
+			if (++c[j] != 0) break;
+		}
+	}
+	CYBOZU_TEST_EQUAL(evalCipher(cybozu::crypto::Cipher::N_AES128_ECB, cybozu::crypto::Cipher::Encoding, key, "", ctr), ks);
+}
+
+// the chunks of threads start from their own counters, which may carry
+CYBOZU_TEST_AUTO(aesCtrParallel)
+{
+	typedef cybozu::crypto::Cipher Cipher;
+	const std::string key = makeData(32);
+	const char *ivTbl[] = { "000102030405060708090a0b0c0d0e0f", "00000000000000fffffffffffffffff6" };
+	const std::string plain = makeData(16 * 16 * 1024 * 5 + 16 * 17 + 7);
+	const size_t headTbl[] = { 0, 5, 16 };
+	for (size_t i = 0; i < CYBOZU_NUM_OF_ARRAY(ivTbl); i++) {
+		const std::string iv = fromHexStr(ivTbl[i]);
+		const std::string expected = evalCipher(Cipher::N_AES256_CTR, Cipher::Encoding, key, iv, plain);
+		for (size_t j = 0; j < CYBOZU_NUM_OF_ARRAY(headTbl); j++) {
+			const size_t head = headTbl[j];
+			for (size_t threadNum = 1; threadNum <= 6; threadNum++) {
+				Cipher cipher(Cipher::N_AES256_CTR);
+				cipher.setup(Cipher::Encoding, key, iv);
+				std::string out(plain.size(), 0);
+				CYBOZU_TEST_EQUAL(cipher.update(&out[0], plain.data(), (int)head), (int)head);
+				cipher.updateParallel(&out[head], plain.data() + head, plain.size() - head - 3, threadNum);
+				// the counter continues
+				CYBOZU_TEST_EQUAL(cipher.update(&out[plain.size() - 3], plain.data() + plain.size() - 3, 3), 3);
+				CYBOZU_TEST_ASSERT(out == expected);
+				// in place
+				cipher.setup(Cipher::Decoding, key, iv);
+				cipher.updateParallel(&out[0], out.data(), out.size(), threadNum);
+				CYBOZU_TEST_ASSERT(out == plain);
+			}
+		}
+	}
+#ifdef CYBOZU_AES_NI
+	{
+		Cipher cipher(Cipher::N_AES256_CBC);
+		cipher.setup(Cipher::Encoding, key, makeData(16));
+		std::string out(plain.size(), 0);
+		CYBOZU_TEST_EXCEPTION(cipher.updateParallel(&out[0], plain.data(), plain.size(), 2), cybozu::Exception);
+	}
+#endif
+}
+
+#ifdef CYBOZU_AES_NI
+CYBOZU_TEST_AUTO(aesVaes)
+{
+	typedef cybozu::crypto::local::AesNi AesNi;
+	printf("hasVaes=%d\n", cybozu::crypto::local::hasVaes());
+	const std::string key = makeData(32);
+	const std::string iv = makeData(16);
+	const std::string plain = makeData(16 * 77 + 3);
+	const AesNi::Mode modeTbl[] = { AesNi::M_CBC, AesNi::M_CTR, AesNi::M_ECB, AesNi::M_GCM };
+	for (size_t i = 0; i < CYBOZU_NUM_OF_ARRAY(modeTbl); i++) {
+		const bool isStream = modeTbl[i] == AesNi::M_CTR || modeTbl[i] == AesNi::M_GCM;
+		const int n = isStream ? (int)plain.size() : (int)(plain.size() & ~size_t(15));
+		for (int enc = 0; enc < 2; enc++) {
+			std::string out[2];
+			uint8_t tag[2][16] = {};
+			for (int useVaes = 0; useVaes < 2; useVaes++) {
+				AesNi aes;
+				aes.init(key.size(), modeTbl[i]);
+				aes.setUseVaes(useVaes == 1);
+				aes.setup(enc == 1, key, iv);
+				out[useVaes].resize(n);
+				CYBOZU_TEST_EQUAL(aes.update((uint8_t*)&out[useVaes][0], (const uint8_t*)plain.data(), n), n);
+				if (modeTbl[i] == AesNi::M_GCM) aes.getTag(tag[useVaes]);
+			}
+			CYBOZU_TEST_EQUAL(out[0], out[1]);
+			CYBOZU_TEST_EQUAL_ARRAY(tag[0], tag[1], 16);
+		}
+	}
+}
+#endif
+
+#ifdef CYBOZU_AES_GCM
+struct AesGcmTestVec {
+	const char *keyHex;
+	const char *ivHex;
+	const char *aadHex;
+	const char *plainHex;
+	const char *cipherHex;
+	const char *tagHex;
+};
+
+// The Galois/Counter Mode of Operation (GCM), test cases 1-6, 10 and 16
+const AesGcmTestVec aesGcmTbl[] = {
+	{
+		"00000000000000000000000000000000",
+		"000000000000000000000000",
+		"",
+		"",
+		"",
+		"58e2fccefa7e3061367f1d57a4e7455a",
+	},
+	{
+		"00000000000000000000000000000000",
+		"000000000000000000000000",
+		"",
+		"00000000000000000000000000000000",
+		"0388dace60b6a392f328c2b971b2fe78",
+		"ab6e47d42cec13bdf53a67b21257bddf",
+	},
+	{
+		"feffe9928665731c6d6a8f9467308308",
+		"cafebabefacedbaddecaf888",
+		"",
+		"d9313225f88406e5a55909c5aff5269a86a7a9531534f7da2e4c303d8a318a721c3c0c95956809532fcf0e2449a6b525b16aedf5aa0de657ba637b391aafd255",
+		"42831ec2217774244b7221b784d0d49ce3aa212f2c02a4e035c17e2329aca12e21d514b25466931c7d8f6a5aac84aa051ba30b396a0aac973d58e091473f5985",
+		"4d5c2af327cd64a62cf35abd2ba6fab4",
+	},
+	{
+		"feffe9928665731c6d6a8f9467308308",
+		"cafebabefacedbaddecaf888",
+		"feedfacedeadbeeffeedfacedeadbeefabaddad2",
+		"d9313225f88406e5a55909c5aff5269a86a7a9531534f7da2e4c303d8a318a721c3c0c95956809532fcf0e2449a6b525b16aedf5aa0de657ba637b39",
+		"42831ec2217774244b7221b784d0d49ce3aa212f2c02a4e035c17e2329aca12e21d514b25466931c7d8f6a5aac84aa051ba30b396a0aac973d58e091",
+		"5bc94fbc3221a5db94fae95ae7121a47",
+	},
+	{
+		"feffe9928665731c6d6a8f9467308308",
+		"cafebabefacedbad",
+		"feedfacedeadbeeffeedfacedeadbeefabaddad2",
+		"d9313225f88406e5a55909c5aff5269a86a7a9531534f7da2e4c303d8a318a721c3c0c95956809532fcf0e2449a6b525b16aedf5aa0de657ba637b39",
+		"61353b4c2806934a777ff51fa22a4755699b2a714fcdc6f83766e5f97b6c742373806900e49f24b22b097544d4896b424989b5e1ebac0f07c23f4598",
+		"3612d2e79e3b0785561be14aaca2fccb",
+	},
+	{
+		"feffe9928665731c6d6a8f9467308308",
+		"9313225df88406e555909c5aff5269aa6a7a9538534f7da1e4c303d2a318a728c3c0c95156809539fcf0e2429a6b525416aedbf5a0de6a57a637b39b",
+		"feedfacedeadbeeffeedfacedeadbeefabaddad2",
+		"d9313225f88406e5a55909c5aff5269a86a7a9531534f7da2e4c303d8a318a721c3c0c95956809532fcf0e2449a6b525b16aedf5aa0de657ba637b39",
+		"8ce24998625615b603a033aca13fb894be9112a5c3a211a8ba262a3cca7e2ca701e4a9a4fba43c90ccdcb281d48c7c6fd62875d2aca417034c34aee5",
+		"619cc5aefffe0bfa462af43c1699d050",
+	},
+	{
+		"feffe9928665731c6d6a8f9467308308feffe9928665731c",
+		"cafebabefacedbaddecaf888",
+		"feedfacedeadbeeffeedfacedeadbeefabaddad2",
+		"d9313225f88406e5a55909c5aff5269a86a7a9531534f7da2e4c303d8a318a721c3c0c95956809532fcf0e2449a6b525b16aedf5aa0de657ba637b39",
+		"3980ca0b3c00e841eb06fac4872a2757859e1ceaa6efd984628593b40ca1e19c7d773d00c144c525ac619d18c84a3f4718e2448b2fe324d9ccda2710",
+		"2519498e80f1478f37ba55bd6d27618c",
+	},
+	{
+		"feffe9928665731c6d6a8f9467308308feffe9928665731c6d6a8f9467308308",
+		"cafebabefacedbaddecaf888",
+		"feedfacedeadbeeffeedfacedeadbeefabaddad2",
+		"d9313225f88406e5a55909c5aff5269a86a7a9531534f7da2e4c303d8a318a721c3c0c95956809532fcf0e2449a6b525b16aedf5aa0de657ba637b39",
+		"522dc1f099567d07f47f37a32a84427d643a8cdcbfe5c0c97598a2bd2555d1aa8cb08e48590dbb3da7b08b1056828838c5f61e6393ba7a0abcc9f662",
+		"76fc6ece0f4e1768cddf8853bb2d551b",
+	},
+};
+
+// encrypt or decrypt input by chunkSize bytes and return output + tag
+std::string evalGcm(cybozu::crypto::Cipher::Mode mode, const std::string& key, const std::string& iv, const std::string& aad, const std::string& input, size_t chunkSize, const std::string& tag = "")
+{
+	cybozu::crypto::AesGcm gcm;
+	gcm.setup(mode, key, iv);
+	for (size_t i = 0; i < aad.size(); i += chunkSize) {
+		gcm.updateAad(aad.data() + i, std::min(chunkSize, aad.size() - i));
+	}
+	std::string out(input.size(), 0);
+	for (size_t i = 0; i < input.size(); i += chunkSize) {
+		const int n = (int)std::min(chunkSize, input.size() - i);
+		CYBOZU_TEST_EQUAL(gcm.update(&out[i], input.data() + i, n), n);
+	}
+	if (mode == cybozu::crypto::Cipher::Encoding) {
+		char t[cybozu::crypto::AesGcm::tagSize];
+		gcm.finalize(t);
+		return out + std::string(t, sizeof(t));
+	}
+	CYBOZU_TEST_ASSERT(gcm.verify(tag.data(), tag.size()));
+	return out;
+}
+
+CYBOZU_TEST_AUTO(aesGcm)
+{
+	const size_t chunkTbl[] = { 1, 5, 16, 17, 1000 };
+	for (size_t i = 0; i < CYBOZU_NUM_OF_ARRAY(aesGcmTbl); i++) {
+		const AesGcmTestVec& v = aesGcmTbl[i];
+		const std::string key = fromHexStr(v.keyHex);
+		const std::string iv = fromHexStr(v.ivHex);
+		const std::string aad = fromHexStr(v.aadHex);
+		const std::string plain = fromHexStr(v.plainHex);
+		const std::string cipher = fromHexStr(v.cipherHex);
+		const std::string tag = fromHexStr(v.tagHex);
+		for (size_t j = 0; j < CYBOZU_NUM_OF_ARRAY(chunkTbl); j++) {
+			CYBOZU_TEST_EQUAL(evalGcm(cybozu::crypto::Cipher::Encoding, key, iv, aad, plain, chunkTbl[j]), cipher + tag);
+			CYBOZU_TEST_EQUAL(evalGcm(cybozu::crypto::Cipher::Decoding, key, iv, aad, cipher, chunkTbl[j], tag), plain);
+		}
+	}
+}
+
+CYBOZU_TEST_AUTO(aesGcmVerify)
+{
+	const std::string key = makeData(16);
+	const std::string iv = makeData(12);
+	const std::string aad = "header";
+	const std::string plain = makeData(16 * 40 + 7);
+	const std::string out = evalGcm(cybozu::crypto::Cipher::Encoding, key, iv, aad, plain, 1000);
+	const std::string cipher = out.substr(0, plain.size());
+	const std::string tag = out.substr(plain.size());
+	// large data goes through the multi-block kernels
+	CYBOZU_TEST_EQUAL(evalGcm(cybozu::crypto::Cipher::Encoding, key, iv, aad, plain, 16 * 33), out);
+	CYBOZU_TEST_EQUAL(evalGcm(cybozu::crypto::Cipher::Decoding, key, iv, aad, cipher, 3, tag), plain);
+	// truncated tag
+	CYBOZU_TEST_EQUAL(evalGcm(cybozu::crypto::Cipher::Decoding, key, iv, aad, cipher, 1000, tag.substr(0, 12)), plain);
+	{
+		// modified ciphertext
+		std::string c = cipher;
+		c[100] ^= 1;
+		cybozu::crypto::AesGcm gcm;
+		gcm.setup(cybozu::crypto::Cipher::Decoding, key, iv);
+		gcm.updateAad(aad.data(), aad.size());
+		std::string dec(c.size(), 0);
+		gcm.update(&dec[0], c.data(), (int)c.size());
+		CYBOZU_TEST_ASSERT(!gcm.verify(tag.data()));
+	}
+	{
+		// modified aad
+		cybozu::crypto::AesGcm gcm;
+		gcm.setup(cybozu::crypto::Cipher::Decoding, key, iv);
+		gcm.updateAad("Header", 6);
+		std::string dec(cipher.size(), 0);
+		gcm.update(&dec[0], cipher.data(), (int)cipher.size());
+		CYBOZU_TEST_EQUAL(dec, plain);
+		CYBOZU_TEST_ASSERT(!gcm.verify(tag.data()));
+	}
+	{
+		cybozu::crypto::AesGcm gcm;
+		CYBOZU_TEST_EXCEPTION(gcm.setup(cybozu::crypto::Cipher::Encoding, makeData(15), iv), cybozu::Exception);
+		CYBOZU_TEST_EXCEPTION(gcm.setup(cybozu::crypto::Cipher::Encoding, key, ""), cybozu::Exception);
+		gcm.setup(cybozu::crypto::Cipher::Encoding, key, iv);
+		char t[16];
+		CYBOZU_TEST_EXCEPTION(gcm.finalize(t, 3), cybozu::Exception);
+	}
+}
+#endif
@@ -0,0 +1,88 @@
+#include <cybozu/test.hpp>
+#include <cybozu/arena.hpp>
+#include <vector>
+
+CYBOZU_TEST_AUTO(alloc)
+{
+	cybozu::Arena arena(1024);
+	CYBOZU_TEST_EQUAL(arena.getAllocatedSize(), 0u);
+	std::vector<char*> v;
+	for (int i = 0; i < 1000; i++) {
+		char *p = static_cast<char*>(arena.alloc(i % 37 + 1, 1));
+		memset(p, char(i), i % 37 + 1);
+		v.push_back(p);
+	}
+	for (int i = 0; i < 1000; i++) {
+		for (int j = 0; j < i % 37 + 1; j++) {
+			CYBOZU_TEST_EQUAL(v[i][j], char(i));
+		}
+	}
+	CYBOZU_TEST_ASSERT(arena.getAllocatedSize() > 0);
+	arena.clear();
+	CYBOZU_TEST_EQUAL(arena.getAllocatedSize(), 0u);
+}
+
+CYBOZU_TEST_AUTO(align)
+{
+	cybozu::Arena arena;
+	for (size_t align = 1; align <= 64; align *= 2) {
+		arena.alloc(1, 1);
+		void *p = arena.alloc(3, align);
+		CYBOZU_TEST_EQUAL(size_t(p) % align, 0u);
+	}
+	double *d = arena.alloc<double>(10);
+	CYBOZU_TEST_EQUAL(size_t(d) % sizeof(double), 0u);
+}
+
+CYBOZU_TEST_AUTO(large)
+{
+	cybozu::Arena arena(4096);
+	char *p = static_cast<char*>(arena.alloc(10, 1));
+	char *q = static_cast<char*>(arena.alloc(100000, 1));
+	memset(q, 1, 100000);
+	char *r = static_cast<char*>(arena.alloc(10, 1));
+	// small allocation continues in the first block
+	CYBOZU_TEST_EQUAL(static_cast<void*>(r), static_cast<void*>(p + 10));
+	const char *s = arena.dup("abc", 3);
+	CYBOZU_TEST_EQUAL(std::string(s, 3), "abc");
+}
+
+CYBOZU_TEST_AUTO(allocator)
+{
+	cybozu::Arena arena;
+	typedef std::vector<int, cybozu::ArenaAllocator<int> > Vec;
+	Vec v((cybozu::ArenaAllocator<int>(arena)));
+	for (int i = 0; i < 10000; i++) {
+		v.push_back(i);
+	}
+	for (int i = 0; i < 10000; i++) {
+		CYBOZU_TEST_EQUAL(v[i], i);
+	}
+	CYBOZU_TEST_ASSERT(arena.getAllocatedSize() >= 10000 * sizeof(int));
+	const cybozu::ArenaAllocator<char> a(v.get_allocator());
+	CYBOZU_TEST_ASSERT(a == v.get_allocator());
+	CYBOZU_TEST_ASSERT(a != cybozu::ArenaAllocator<int>());
+	Vec w;
+	w.push_back(1);
+	CYBOZU_TEST_ASSERT(w.get_allocator().getArena() == 0);
+}
+
+CYBOZU_TEST_AUTO(freeLast)
+{
+	cybozu::Arena arena(4096);
+	char *p = static_cast<char*>(arena.alloc(10, 1));
+	char *q = static_cast<char*>(arena.alloc(20, 1));
+	CYBOZU_TEST_ASSERT(!arena.freeLast(p, 10));
+	CYBOZU_TEST_ASSERT(arena.freeLast(q, 20));
+	CYBOZU_TEST_EQUAL(arena.alloc(5, 1), static_cast<void*>(q));
+	// a temporary container in a loop reuses the same memory
+	cybozu::ArenaAllocator<int> a(arena);
+	const size_t allocSize = arena.getAllocatedSize();
+	for (int i = 0; i < 1000; i++) {
+		std::vector<int, cybozu::ArenaAllocator<int> > v(a);
+		v.reserve(100);
+		v.push_back(i);
+		CYBOZU_TEST_EQUAL(v[0], i);
+	}
+	CYBOZU_TEST_EQUAL(arena.getAllocatedSize(), allocSize);
+}
@@ -1,5 +1,9 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
 #include <iostream>
+#include <sstream>
 #include <cybozu/atoi.hpp>
 #include <cybozu/test.hpp>
 
@@ -772,3 +776,116 @@ CYBOZU_TEST_AUTO(hextoi)
         CYBOZU_TEST_EXCEPTION(cybozu::disable_warning_unused_variable(static_cast<unsigned int>(cybozu::hextoi(tbl[i].str, tbl[i].len))), cybozu::Exception);
     }
 }
+
+CYBOZU_TEST_AUTO(long_digits)
+{
+    // digits are parsed 8 chars at a time
+    const char *okTbl[] = {
+        "12345678", "123456789", "1234567890123456", "00000000000001234567", "-2147483648", "2147483647",
+        "9223372036854775807", "-9223372036854775808", "18446744073709551615", "000000000000000000000000",
+    };
+    for (size_t i = 0; i < CYBOZU_NUM_OF_ARRAY(okTbl); i++) {
+        const std::string s = okTbl[i];
+        bool b;
+        const uint64_t u = cybozu::atoi(&b, s);
+        const uint64_t u2 = strtoull(s.c_str(), 0, 10);
+        CYBOZU_TEST_EQUAL(b, s[0] != '-');
+        if (b) CYBOZU_TEST_EQUAL(u, u2);
+        const int64_t x = cybozu::atoi(&b, s);
+        CYBOZU_TEST_EQUAL(b, s != "18446744073709551615");
+        if (b) CYBOZU_TEST_EQUAL(x, strtoll(s.c_str(), 0, 10));
+        const int y = cybozu::atoi(&b, s);
+        const long long ll = strtoll(s.c_str(), 0, 10);
+        const bool inInt = ll >= INT_MIN && ll <= INT_MAX && s != "18446744073709551615";
+        CYBOZU_TEST_EQUAL(b, inInt);
+        if (b) CYBOZU_TEST_EQUAL(y, ll);
+    }
+    const char *ngTbl[] = {
+        "1234567x", "12345678x", "1234567890123456x", "12345678 ", "18446744073709551616", "99999999999999999999",
+    };
+    for (size_t i = 0; i < CYBOZU_NUM_OF_ARRAY(ngTbl); i++) {
+        CYBOZU_TEST_EXCEPTION(cybozu::disable_warning_unused_variable(static_cast<uint64_t>(cybozu::atoi(ngTbl[i]))), cybozu::Exception);
+    }
+    // size is an upper bound of the length
+    CYBOZU_TEST_EQUAL(static_cast<int>(cybozu::atoi("123", 100)), 123);
+    CYBOZU_TEST_EQUAL(static_cast<int>(cybozu::atoi("123456789", 5)), 12345);
+    // compare with strtoull for all lengths
+    char buf[32];
+    uint64_t v = 0;
+    for (int i = 0; i < 20; i++) {
+        v = v * 10 + (i * 7 + 3) % 10;
+        snprintf(buf, sizeof(buf), "%llu", (unsigned long long)v);
+        const size_t len = strlen(buf);
+        for (size_t j = 1; j <= len; j++) {
+            const uint64_t x = cybozu::atoi(buf, j);
+            const std::string t(buf, j);
+            CYBOZU_TEST_EQUAL(x, strtoull(t.c_str(), 0, 10));
+        }
+    }
+}
+
+template<class T>
+std::string atoiResult(const std::string& s)
+{
+    bool b;
+    const T x = cybozu::atoi(&b, s.c_str(), s.size());
+    std::ostringstream os;
+    os << b << ':' << x;
+    return os.str();
+}
+
+CYBOZU_TEST_AUTO(digits_simd)
+{
+    // 16 chars are parsed at a time with SSSE3 if they are available
+    using namespace cybozu::atoi_local;
+    unsigned int r = 12345;
+    for (size_t len = 0; len <= 24; len++) {
+        for (int i = 0; i < 50; i++) {
+            std::string s;
+            for (size_t j = 0; j < len; j++) {
+                r = r * 1103515245 + 12345;
+                s += char('0' + (r >> 16) % 10);
+            }
+            r = r * 1103515245 + 12345;
+            const char tailTbl[] = { '0', '9', '/', ':', 'x', ' ', char(0x80) };
+            if (i & 1) s += tailTbl[(r >> 16) % CYBOZU_NUM_OF_ARRAY(tailTbl)];
+            while (s.size() < 24) s += '0';
+            for (size_t n = len; n <= s.size(); n += 8) {
+                const std::string t = s.substr(0, n);
+                limitAtoiFeature(0);
+                const std::string u64 = atoiResult<uint64_t>(t);
+                const std::string i64 = atoiResult<int64_t>(t);
+                const std::string i32 = atoiResult<int>(t);
+                limitAtoiFeature(atoiSsse3);
+                CYBOZU_TEST_EQUAL(atoiResult<uint64_t>(t), u64);
+                CYBOZU_TEST_EQUAL(atoiResult<int64_t>(t), i64);
+                CYBOZU_TEST_EQUAL(atoiResult<int>(t), i32);
+            }
+        }
+    }
+    limitAtoiFeature(atoiSsse3);
+}
+
+CYBOZU_TEST_AUTO(parseInts)
+{
+    const std::string s = "12,-3,0,123456789012,-987654321,2147483647";
+    int x[6];
+    CYBOZU_TEST_EXCEPTION(cybozu::parseInts(s.data(), s.data() + s.size(), ',', x), cybozu::Exception);
+    long long y[6];
+    CYBOZU_TEST_EQUAL(cybozu::parseInts(s.data(), s.data() + s.size(), ',', y), 6u);
+    const long long yTbl[] = { 12, -3, 0, 123456789012LL, -987654321, 2147483647 };
+    for (size_t i = 0; i < 6; i++) {
+        CYBOZU_TEST_EQUAL(y[i], yTbl[i]);
+    }
+    const std::string t = "1 22 333";
+    CYBOZU_TEST_EQUAL(cybozu::parseInts(t.data(), t.data() + t.size(), ' ', x), 3u);
+    CYBOZU_TEST_EQUAL(x[0], 1);
+    CYBOZU_TEST_EQUAL(x[1], 22);
+    CYBOZU_TEST_EQUAL(x[2], 333);
+    CYBOZU_TEST_EQUAL(cybozu::parseInts(t.data(), t.data(), ' ', x), 0u);
+    const char *ngTbl[] = { "1,,2", "1,", ",1", "1,x", "1,2 " };
+    for (size_t i = 0; i < CYBOZU_NUM_OF_ARRAY(ngTbl); i++) {
+        const char *p = ngTbl[i];
+        CYBOZU_TEST_EXCEPTION(cybozu::parseInts(p, p + strlen(p), ',', x), cybozu::Exception);
+    }
+}
@@ -111,3 +111,69 @@ CYBOZU_TEST_AUTO(ignoreAllEqual)
 		CYBOZU_TEST_EQUAL(str, tbl[i].in);
 	}
 }
+
+CYBOZU_TEST_AUTO(buffer)
+{
+	std::string data;
+	uint32_t x = 123456789;
+	for (int i = 0; i < 1000; i++) {
+		x ^= x << 13;
+		x ^= x >> 17;
+		x ^= x << 5;
+		data += char(x);
+	}
+	const size_t lineTbl[] = { 0, 4, 8, 76, 128 };
+	const int modeTbl[] = { cybozu::base64::useLF, cybozu::base64::useCRLF, cybozu::base64::noEndLine };
+	for (size_t n = 0; n < data.size(); n += (n < 100 ? 1 : 97)) {
+		const std::string in = data.substr(0, n);
+		for (size_t i = 0; i < CYBOZU_NUM_OF_ARRAY(lineTbl); i++) {
+			for (size_t j = 0; j < CYBOZU_NUM_OF_ARRAY(modeTbl); j++) {
+				std::string expected;
+				{
+					cybozu::StringInputStream is(in);
+					cybozu::StringOutputStream os(expected);
+					cybozu::EncodeToBase64(os, is, lineTbl[i], modeTbl[j]);
+				}
+				const size_t encSize = cybozu::base64::getEncodedSize(n, lineTbl[i], modeTbl[j]);
+				CYBOZU_TEST_EQUAL(encSize, expected.size());
+				std::string enc(encSize, '\0');
+				CYBOZU_TEST_EQUAL(cybozu::base64::encode(&enc[0], enc.size(), in.data(), n, lineTbl[i], modeTbl[j]), encSize);
+				CYBOZU_TEST_EQUAL(enc, expected);
+				if (n > 0) {
+					CYBOZU_TEST_EXCEPTION(cybozu::base64::encode(&enc[0], encSize - 1, in.data(), n, lineTbl[i], modeTbl[j]), cybozu::Exception);
+				}
+				std::string dec(cybozu::base64::getDecodedMaxSize(encSize), '\0');
+				dec.resize(cybozu::base64::decode(&dec[0], dec.size(), enc.data(), enc.size()));
+				CYBOZU_TEST_EQUAL(dec, in);
+			}
+		}
+	}
+	CYBOZU_TEST_EXCEPTION(cybozu::base64::encode(0, 0, "", 0, 6), cybozu::Exception);
+}
+
+CYBOZU_TEST_AUTO(decodeBuffer)
+{
+	std::string str;
+	for (int i = 0; i < 100; i++) {
+		str += "MTIzNDU2Nzg5MDEy";
+		if (i % 7 == 0) str += "\r\n";
+		if (i % 11 == 0) str += "$";
+	}
+	std::string expected;
+	for (int i = 0; i < 100; i++) expected += "123456789012";
+	std::string dec(cybozu::base64::getDecodedMaxSize(str.size()), '\0');
+	dec.resize(cybozu::base64::decode(&dec[0], dec.size(), str.data(), str.size()));
+	CYBOZU_TEST_EQUAL(dec, expected);
+	CYBOZU_TEST_EXCEPTION(cybozu::base64::decode(&dec[0], 2, "MTIz", 4), cybozu::Exception);
+
+	// streaming decoder split at every position
+	for (size_t i = 0; i < 40; i++) {
+		std::string out;
+		cybozu::StringOutputStream os(out);
+		cybozu::Base64Decoder<cybozu::StringOutputStream> d(os);
+		d.write(str.data(), i);
+		d.write(str.data() + i, str.size() - i);
+		d.flush();
+		CYBOZU_TEST_EQUAL(out, expected);
+	}
+}
@@ -193,6 +193,32 @@ CYBOZU_TEST_AUTO(hmac)
 		cybozu::crypto::Hmac hmac(tbl[i].name);
 		CYBOZU_TEST_EQUAL(hmac.getSize(), strlen(tbl[i].mac) / 2);
 		CYBOZU_TEST_EQUAL(toHexStr(hmac.eval(tbl[i].key, tbl[i].msg)), tbl[i].mac);
+		// precomputed key
+		const std::string msg = tbl[i].msg;
+		hmac.setKey(tbl[i].key);
+		std::string out(hmac.getSize(), 0);
+		hmac.eval(&out[0], msg.c_str(), msg.size());
+		CYBOZU_TEST_EQUAL(toHexStr(out), tbl[i].mac);
+		CYBOZU_TEST_ASSERT(hmac.verify(out.c_str(), msg.c_str(), msg.size()));
+		out[0] ^= 1;
+		CYBOZU_TEST_ASSERT(!hmac.verify(out.c_str(), msg.c_str(), msg.size()));
+		const void *bufs[] = { msg.c_str(), msg.c_str() };
+		const size_t sizes[] = { msg.size(), 0 };
+		std::string outs(hmac.getSize() * 2, 0);
+		hmac.evalBatch(&outs[0], bufs, sizes, 2);
+		CYBOZU_TEST_EQUAL(toHexStr(outs.substr(0, hmac.getSize())), tbl[i].mac);
+		CYBOZU_TEST_EQUAL(outs.substr(hmac.getSize()), hmac.eval(tbl[i].key, ""));
+		// a copy keeps the key
+		const cybozu::crypto::Hmac copied(hmac);
+		copied.eval(&out[0], msg.c_str(), msg.size());
+		CYBOZU_TEST_EQUAL(toHexStr(out), tbl[i].mac);
+		// the key is empty before setKey
+		const cybozu::crypto::Hmac noKey(tbl[i].name);
+		noKey.eval(&out[0], msg.c_str(), msg.size());
+		CYBOZU_TEST_EQUAL(out, hmac.eval("", msg));
+		CYBOZU_TEST_ASSERT(noKey.verify(out.c_str(), msg.c_str(), msg.size()));
+		noKey.evalBatch(&outs[0], bufs, sizes, 2);
+		CYBOZU_TEST_EQUAL(outs.substr(0, hmac.getSize()), out);
 	}
 }
 
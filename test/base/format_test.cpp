@@ -1,5 +1,7 @@
 #include <cybozu/format.hpp>
 #include <cybozu/test.hpp>
+#include <limits>
+#include <string.h>
 
 CYBOZU_TEST_AUTO(format)
 {
@@ -10,3 +12,86 @@ CYBOZU_TEST_AUTO(format)
 	a = cybozu::format("%s%c%d%s", "abcdefg", 0, 123, "xxx");
 	CYBOZU_TEST_EQUAL(a, std::string("abcdefg" "\x00" "123xxx", 14));
 }
+
+#if CYBOZU_CPP_VERSION >= CYBOZU_CPP_VERSION_CPP11
+#include <cybozu/log.hpp>
+
+struct Point {
+	int x, y;
+};
+
+std::ostream& operator<<(std::ostream& os, const Point& p)
+{
+	return os << '(' << p.x << ',' << p.y << ')';
+}
+
+CYBOZU_TEST_AUTO(formatTo)
+{
+	std::string s;
+	cybozu::formatTo(s, "x={}, y={}, z={}", 123, -4.5, "abc");
+	CYBOZU_TEST_EQUAL(s, "x=123, y=-4.5, z=abc");
+	cybozu::formatTo(s, "{}{}{}{}{}", 'a', true, false, std::string("str"), (unsigned char)200);
+	CYBOZU_TEST_EQUAL(s, "atruefalsestr200");
+	const long long llMin = (std::numeric_limits<long long>::min)();
+	const unsigned long long ullMax = (std::numeric_limits<unsigned long long>::max)();
+	cybozu::formatTo(s, "{} {} {} {}", llMin, ullMax, short(-3), 0.1f);
+	CYBOZU_TEST_EQUAL(s, "-9223372036854775808 18446744073709551615 -3 0.10000000149011612");
+	char str[] = "xyz";
+	const Point pt = { 1, -2 };
+	const char *nul = 0;
+	cybozu::formatTo(s, "{{{}}} {} {} }}", str, pt, nul);
+	CYBOZU_TEST_EQUAL(s, "{xyz} (1,-2) (null) }");
+	cybozu::formatTo(s, "no arg");
+	CYBOZU_TEST_EQUAL(s, "no arg");
+
+	char buf[8];
+	size_t n = cybozu::formatTo(buf, sizeof(buf), "{}-{}", 12, 34);
+	CYBOZU_TEST_EQUAL(n, 5u);
+	CYBOZU_TEST_EQUAL(std::string(buf, n), "12-34");
+	n = cybozu::formatTo(buf, sizeof(buf), "{}-{}", 12345, 67890);
+	CYBOZU_TEST_EQUAL(n, 11u);
+	CYBOZU_TEST_EQUAL(std::string(buf, sizeof(buf)), "12345-67");
+
+	CYBOZU_TEST_EXCEPTION(cybozu::formatTo(s, "{}", 1, 2), cybozu::Exception);
+	CYBOZU_TEST_EXCEPTION(cybozu::formatTo(s, "{} {}", 1), cybozu::Exception);
+	CYBOZU_TEST_EXCEPTION(cybozu::formatTo(s, "{x}", 1), cybozu::Exception);
+	CYBOZU_TEST_EXCEPTION(cybozu::formatTo(s, "}", 1), cybozu::Exception);
+}
+
+CYBOZU_TEST_AUTO(formatCheck)
+{
+	static_assert(cybozu::format_local::countArg("") == 0, "");
+	static_assert(cybozu::format_local::countArg("{}{{}}{}") == 2, "");
+	static_assert(cybozu::format_local::countArg("{") == size_t(-1), "");
+	static_assert(cybozu::format_local::countArg("{a}") == size_t(-1), "");
+	static_assert(cybozu::format_local::countArg("}") == size_t(-1), "");
+	std::string s;
+	const int x = 5;
+	CYBOZU_FORMAT_TO(s, "x={}, {}", x, "y");
+	CYBOZU_TEST_EQUAL(s, "x=5, y");
+	CYBOZU_FORMAT_TO(s, "abc");
+	CYBOZU_TEST_EQUAL(s, "abc");
+	char buf[16];
+	const size_t n = CYBOZU_FORMAT_TO_BUF(buf, sizeof(buf), "[{}]", x);
+	CYBOZU_TEST_EQUAL(std::string(buf, n), "[5]");
+}
+
+CYBOZU_TEST_AUTO(putLog)
+{
+	FILE *fp = tmpfile();
+	CYBOZU_TEST_ASSERT(fp != 0);
+	cybozu::SetLogFILE(fp);
+	CYBOZU_PUT_LOG(cybozu::LogInfo, "a={} b={}", 1, "xyz");
+	CYBOZU_PUT_LOG(cybozu::LogDebug, "not shown {}", 2);
+	cybozu::PutLogFormat(cybozu::LogError, "{}", std::string(2000, 'x'));
+	rewind(fp);
+	char line[4096];
+	CYBOZU_TEST_ASSERT(fgets(line, sizeof(line), fp) != 0);
+	CYBOZU_TEST_ASSERT(strstr(line, " a=1 b=xyz\n") != 0);
+	CYBOZU_TEST_ASSERT(fgets(line, sizeof(line), fp) != 0);
+	CYBOZU_TEST_ASSERT(strstr(line, std::string(2000, 'x').c_str()) != 0);
+	CYBOZU_TEST_ASSERT(fgets(line, sizeof(line), fp) == 0);
+	cybozu::SetLogFILE(stderr);
+	fclose(fp);
+}
+#endif
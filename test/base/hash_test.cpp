@@ -0,0 +1,52 @@
+#include <cybozu/hash.hpp>
+#include <cybozu/string.hpp>
+#include <cybozu/test.hpp>
+#include <vector>
+#include <set>
+
+CYBOZU_TEST_AUTO(fastHash64)
+{
+	std::vector<char> data(300);
+	for (size_t i = 0; i < data.size(); i++) {
+		data[i] = char(i * 7 + 1);
+	}
+	std::set<uint64_t> s;
+	for (size_t n = 0; n <= data.size(); n++) {
+		// exact size buffer to check out of range access
+		const std::vector<char> v(data.begin(), data.begin() + n);
+		const char *p = n ? &v[0] : "";
+		const uint64_t h = cybozu::fastHash64(p, n);
+		CYBOZU_TEST_ASSERT(s.insert(h).second);
+		CYBOZU_TEST_EQUAL(h, cybozu::fastHash64(&data[0], n));
+		CYBOZU_TEST_ASSERT(h != cybozu::fastHash64(p, n, 1));
+		// every byte changes the value
+		std::vector<char> w(v);
+		for (size_t i = 0; i < n; i++) {
+			w[i] ^= 1;
+			CYBOZU_TEST_ASSERT(cybozu::fastHash64(&w[0], n) != h);
+			w[i] ^= 1;
+		}
+	}
+	// short keys of the same length
+	s.clear();
+	for (uint32_t i = 0; i < 100000; i++) {
+		CYBOZU_TEST_ASSERT(s.insert(cybozu::fastHash64(&i, sizeof(i))).second);
+	}
+}
+
+CYBOZU_TEST_AUTO(fnv)
+{
+	// FNV-1a
+	const char *str = "abc";
+	CYBOZU_TEST_EQUAL(cybozu::hash32(str, 3), 0x1a47e90bu);
+	CYBOZU_TEST_EQUAL(cybozu::hash32(str, 0), 2166136261u);
+}
+
+CYBOZU_TEST_AUTO(stringHash)
+{
+	const cybozu::String a("abcdefghijklmnopqrstuvwxyz"), b("abcdefghijklmnopqrstuvwxyz"), c("abcdefghijklmnopqrstuvwxyZ");
+	CYBOZU_NAMESPACE_STD::hash<cybozu::String> h;
+	CYBOZU_TEST_EQUAL(h(a), h(b));
+	CYBOZU_TEST_ASSERT(h(a) != h(c));
+	CYBOZU_TEST_ASSERT(h(cybozu::String()) != h(cybozu::String("a")));
+}
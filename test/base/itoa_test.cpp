@@ -1,6 +1,9 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <sstream>
 #include <iostream>
+#include <limits>
 #include <cybozu/itoa.hpp>
 #include <cybozu/test.hpp>
 
@@ -520,3 +523,104 @@ CYBOZU_TEST_AUTO(itohexWithoutZero)
 		CYBOZU_TEST_EQUAL(a, b);
 	}
 }
+
+CYBOZU_TEST_AUTO(dtoa)
+{
+	const struct {
+		double x;
+		const char *s;
+	} tbl[] = {
+		{ 0, "0" },
+		{ -0.0, "0" },
+		{ 1, "1" },
+		{ -2.5, "-2.5" },
+		{ 0.1, "0.1" },
+		{ 0.3, "0.3" },
+		{ 3.14, "3.14" },
+		{ 100, "100" },
+		{ 1e20, "100000000000000000000" },
+		{ 1e21, "1e+21" },
+		{ 1e22, "1e+22" },
+		{ 123456789012345680000.0, "123456789012345680000" },
+		{ 1e-6, "0.000001" },
+		{ 0.000001234, "0.000001234" },
+		{ 1.5e-7, "1.5e-7" },
+		{ 9007199254740993.0, "9007199254740992" },
+		{ 5e-324, "5e-324" },
+		{ 2.2250738585072014e-308, "2.2250738585072014e-308" },
+		{ 1.7976931348623157e308, "1.7976931348623157e+308" },
+		{ 5.966672584960166e-154, "5.966672584960166e-154" }, // 2^-509
+	};
+	for (size_t i = 0; i < CYBOZU_NUM_OF_ARRAY(tbl); i++) {
+		CYBOZU_TEST_EQUAL(cybozu::dtoa(tbl[i].x), tbl[i].s);
+	}
+	const double inf = std::numeric_limits<double>::infinity();
+	CYBOZU_TEST_EQUAL(cybozu::dtoa(inf), "Infinity");
+	CYBOZU_TEST_EQUAL(cybozu::dtoa(-inf), "-Infinity");
+	CYBOZU_TEST_EQUAL(cybozu::dtoa(std::numeric_limits<double>::quiet_NaN()), "NaN");
+	char buf[4];
+	CYBOZU_TEST_EQUAL(cybozu::dtoa(buf, sizeof(buf), 0.25), 4u);
+	CYBOZU_TEST_EQUAL(cybozu::dtoa(buf, sizeof(buf), 0.125), 0u);
+}
+
+CYBOZU_TEST_AUTO(dtoaRoundTrip)
+{
+	uint64_t x = 88172645463325252ull;
+	for (int i = 0; i < 100000; i++) {
+		// xorshift64
+		x ^= x << 13;
+		x ^= x >> 7;
+		x ^= x << 17;
+		if (((x >> 52) & 0x7ff) == 0x7ff) continue; // NaN or infinity
+		double d;
+		memcpy(&d, &x, sizeof(d));
+		const std::string s = cybozu::dtoa(d);
+		const double y = strtod(s.c_str(), 0);
+		CYBOZU_TEST_ASSERT(memcmp(&d, &y, sizeof(d)) == 0);
+	}
+}
+
+CYBOZU_TEST_AUTO(itoaBuf)
+{
+	char buf[32];
+	char expected[32];
+	for (int i = 0; i < 64; i++) {
+		const uint64_t tbl[] = { uint64_t(1) << i, (uint64_t(1) << i) - 1, (uint64_t(1) << i) + 1 };
+		for (size_t j = 0; j < CYBOZU_NUM_OF_ARRAY(tbl); j++) {
+			const uint64_t x = tbl[j];
+			snprintf(expected, sizeof(expected), "%llu", (unsigned long long)x);
+			size_t n = cybozu::itoa(buf, sizeof(buf), (unsigned long long)x);
+			CYBOZU_TEST_EQUAL(n, strlen(expected));
+			CYBOZU_TEST_EQUAL_ARRAY(buf, expected, n);
+			CYBOZU_TEST_EQUAL(cybozu::itoa(buf, n - 1, (unsigned long long)x), 0u);
+			snprintf(expected, sizeof(expected), "%lld", (long long)x);
+			n = cybozu::itoa(buf, sizeof(buf), (long long)x);
+			CYBOZU_TEST_EQUAL(n, strlen(expected));
+			CYBOZU_TEST_EQUAL_ARRAY(buf, expected, n);
+			CYBOZU_TEST_EQUAL(cybozu::itoa(buf, n - 1, (long long)x), 0u);
+			snprintf(expected, sizeof(expected), "%llx", (unsigned long long)x);
+			n = cybozu::itoa_local::uintToHex(buf, sizeof(buf), x, false);
+			CYBOZU_TEST_EQUAL(n, strlen(expected));
+			CYBOZU_TEST_EQUAL_ARRAY(buf + sizeof(buf) - n, expected, n);
+			CYBOZU_TEST_EQUAL(cybozu::itoa_local::uintToHex(buf, n - 1, x, false), 0u);
+		}
+	}
+	// powers of 10
+	uint64_t x = 1;
+	for (int i = 0; i < 20; i++) {
+		CYBOZU_TEST_EQUAL(cybozu::itoa(buf, sizeof(buf), (unsigned long long)x), size_t(i + 1));
+		CYBOZU_TEST_EQUAL(cybozu::itoa(buf, sizeof(buf), (unsigned long long)(x - 1)), size_t(i == 0 ? 1 : i));
+		x *= 10;
+	}
+	CYBOZU_TEST_EQUAL(cybozu::itoa(buf, sizeof(buf), 0), 1u);
+	CYBOZU_TEST_EQUAL(buf[0], '0');
+	CYBOZU_TEST_EQUAL(cybozu::itoa(buf, sizeof(buf), -1234), 5u);
+	CYBOZU_TEST_EQUAL_ARRAY(buf, "-1234", 5);
+	const int intMin = (std::numeric_limits<int>::min)();
+	CYBOZU_TEST_EQUAL(cybozu::itoa(buf, sizeof(buf), intMin), 11u);
+	CYBOZU_TEST_EQUAL_ARRAY(buf, "-2147483648", 11);
+	const long long llMin = (std::numeric_limits<long long>::min)();
+	CYBOZU_TEST_EQUAL(cybozu::itoa(buf, sizeof(buf), llMin), 20u);
+	CYBOZU_TEST_EQUAL_ARRAY(buf, "-9223372036854775808", 20);
+	CYBOZU_TEST_EQUAL(cybozu::itoa(buf, 0, 1), 0u);
+}
@@ -0,0 +1,412 @@
+#include <cybozu/test.hpp>
+#include <cybozu/json.hpp>
+#include <cybozu/stream.hpp>
+#include "test_util.hpp"
+#include <sstream>
+#include <limits>
+
+/*
+	record each event as a token
+*/
+struct Recorder {
+	std::string s;
+	void startObject() { s += "{"; }
+	void endObject() { s += "}"; }
+	void startArray() { s += "["; }
+	void endArray() { s += "]"; }
+	void key(const std::string& str) { s += "k:" + str + ";"; }
+	void string(const std::string& str) { s += "s:" + str + ";"; }
+	void number(double x)
+	{
+		char buf[64];
+		CYBOZU_SNPRINTF(buf, sizeof(buf), "n:%g;", x);
+		s += buf;
+	}
+	void boolean(bool b) { s += b ? "t;" : "f;"; }
+	void null() { s += "z;"; }
+};
+
+CYBOZU_TEST_AUTO(reader)
+{
+	const struct {
+		const char *in;
+		const char *out;
+	} tbl[] = {
+		{ "123", "n:123;" },
+		{ " -0.5e+2 ", "n:-50;" },
+		{ "0", "n:0;" },
+		{ "true", "t;" },
+		{ "false", "f;" },
+		{ "null", "z;" },
+		{ "\"abc\"", "s:abc;" },
+		{ "\"a\\\"\\\\\\/\\n\"", "s:a\"\\/\n;" },
+		{ "\"\\u3042\\u00e9\\ud83d\\ude00\"", "s:\xe3\x81\x82\xc3\xa9\xf0\x9f\x98\x80;" },
+		{ "[]", "[]" },
+		{ "{}", "{}" },
+		{ "[1, [2, []], {}]", "[n:1;[n:2;[]]{}]" },
+		{ "{\"a\":1,\"b\":[true,null],\"c\":{\"d\":\"e\"}}", "{k:a;n:1;k:b;[t;z;]k:c;{k:d;s:e;}}" },
+	};
+	for (size_t i = 0; i < CYBOZU_NUM_OF_ARRAY(tbl); i++) {
+		const std::string in = tbl[i].in;
+		{
+			cybozu::StringInputStream is(in);
+			cybozu::JsonReaderT<cybozu::StringInputStream> reader(is);
+			Recorder rec;
+			CYBOZU_TEST_ASSERT(reader.parse(rec));
+			CYBOZU_TEST_EQUAL(rec.s, tbl[i].out);
+			CYBOZU_TEST_ASSERT(!reader.parse(rec));
+		}
+		{
+			SlowInputStream is(in);
+			cybozu::JsonReaderT<SlowInputStream> reader(is);
+			Recorder rec;
+			CYBOZU_TEST_ASSERT(reader.parse(rec));
+			CYBOZU_TEST_EQUAL(rec.s, tbl[i].out);
+		}
+	}
+}
+
+CYBOZU_TEST_AUTO(readerLines)
+{
+	std::istringstream is("{\"x\":1}\n{\"x\":2}\n[3]\n");
+	cybozu::JsonReaderT<std::istringstream> reader(is);
+	Recorder rec;
+	int n = 0;
+	while (reader.parse(rec)) {
+		n++;
+	}
+	CYBOZU_TEST_EQUAL(n, 3);
+	CYBOZU_TEST_EQUAL(rec.s, "{k:x;n:1;}{k:x;n:2;}[n:3;]");
+}
+
+CYBOZU_TEST_AUTO(readerDeep)
+{
+	const size_t n = 100000;
+	const std::string in = std::string(n, '[') + std::string(n, ']');
+	cybozu::StringInputStream is(in);
+	cybozu::JsonReaderT<cybozu::StringInputStream> reader(is);
+	Recorder rec;
+	CYBOZU_TEST_ASSERT(reader.parse(rec));
+	CYBOZU_TEST_EQUAL(rec.s, in);
+}
+
+CYBOZU_TEST_AUTO(readerErr)
+{
+	const char *tbl[] = {
+		"[", "{", "]", "[1,]", "{\"a\"}", "{\"a\":}", "{1:2}", "[1 2]",
+		"01", "-", "1.", "1e", "tru", "nul", "\"abc", "\"\\x\"", "\"\\u12g4\"",
+		"\"\\ud800\"", "\"\\udc00\"", "\"a\x01\"",
+	};
+	for (size_t i = 0; i < CYBOZU_NUM_OF_ARRAY(tbl); i++) {
+		const std::string in = tbl[i];
+		cybozu::StringInputStream is(in);
+		cybozu::JsonReaderT<cybozu::StringInputStream> reader(is);
+		Recorder rec;
+		bool ok = false;
+		try {
+			/* "01" is parsed as 0 and 1 */
+			ok = reader.parse(rec) && !reader.parse(rec);
+		} catch (std::exception&) {
+		}
+		CYBOZU_TEST_ASSERT(!ok);
+	}
+}
+
+CYBOZU_TEST_AUTO(document)
+{
+	const std::string in = " {\"b\":[1, -2.5e1, true, false, null], \"a\":\"xyz\", \"esc\":\"a\\nb\\u3042\", \"obj\":{\"z\":{}, \"y\":[]}} ";
+	cybozu::JsonDocument doc;
+	doc.parse(in);
+	typedef cybozu::JsonDocument::Node Node;
+	const Node& root = doc.get();
+	CYBOZU_TEST_ASSERT(root.isObject());
+	CYBOZU_TEST_EQUAL(root.size(), 4u);
+	CYBOZU_TEST_EQUAL(root.memberBegin()[0].getKey(), "a");
+	CYBOZU_TEST_EQUAL(root.memberBegin()[1].getKey(), "b");
+	CYBOZU_TEST_EQUAL(root.memberBegin()[2].getKey(), "esc");
+	CYBOZU_TEST_EQUAL(root.memberBegin()[3].getKey(), "obj");
+	CYBOZU_TEST_ASSERT(root.find("c") == 0);
+	const Node& a = root["a"];
+	CYBOZU_TEST_EQUAL(a.getString(), "xyz");
+	// string without escape refers to the input
+	CYBOZU_TEST_ASSERT(in.c_str() <= a.getStr() && a.getStr() < in.c_str() + in.size());
+	CYBOZU_TEST_EQUAL(root["esc"].getString(), "a\nb\xe3\x81\x82");
+	const Node& b = root["b"];
+	CYBOZU_TEST_ASSERT(b.isArray());
+	CYBOZU_TEST_EQUAL(b.size(), 5u);
+	CYBOZU_TEST_EQUAL(int(b[0].getNumber()), 1);
+	CYBOZU_TEST_EQUAL(int(b[1].getNumber()), -25);
+	CYBOZU_TEST_ASSERT(b[2].getBool());
+	CYBOZU_TEST_ASSERT(!b[3].getBool());
+	CYBOZU_TEST_ASSERT(b[4].isNull());
+	const Node& obj = root["obj"];
+	CYBOZU_TEST_EQUAL(obj.memberBegin()->getKey(), "y");
+	CYBOZU_TEST_ASSERT(obj["y"].isArray());
+	CYBOZU_TEST_EQUAL(obj["y"].size(), 0u);
+	CYBOZU_TEST_ASSERT(obj["z"].isObject());
+	CYBOZU_TEST_EQUAL(obj["z"].size(), 0u);
+	CYBOZU_TEST_EXCEPTION(root["c"], cybozu::Exception);
+
+	const std::string in2 = "[[1, [2]], 3]";
+	doc.parse(in2);
+	CYBOZU_TEST_EQUAL(doc.get().size(), 2u);
+	CYBOZU_TEST_EQUAL(int(doc.get()[0][1][0].getNumber()), 2);
+	CYBOZU_TEST_EQUAL(int(doc.get()[1].getNumber()), 3);
+}
+
+CYBOZU_TEST_AUTO(documentLarge)
+{
+	std::string in = "[";
+	const int n = 10000;
+	for (int i = 0; i < n; i++) {
+		char buf[64];
+		CYBOZU_SNPRINTF(buf, sizeof(buf), "%s{\"id\":%d,\"name\":\"n%d\"}", i == 0 ? "" : ",", i, i);
+		in += buf;
+	}
+	in += "]";
+	cybozu::JsonDocument doc;
+	doc.parse(in);
+	const cybozu::JsonDocument::Node& root = doc.get();
+	CYBOZU_TEST_EQUAL(root.size(), size_t(n));
+	for (int i = 0; i < n; i++) {
+		CYBOZU_TEST_EQUAL(int(root[i]["id"].getNumber()), i);
+	}
+	CYBOZU_TEST_EQUAL(root[1234]["name"].getString(), "n1234");
+}
+
+CYBOZU_TEST_AUTO(documentErr)
+{
+	const char *tbl[] = {
+		"", "[", "{", "]", "[1,]", "{\"a\"}", "{\"a\":}", "{1:2}", "[1 2]",
+		"01", "-", "1.", "1e", "tru", "nul", "\"abc", "\"\\x\"", "\"\\u12g4\"",
+		"\"\\ud800\"", "\"\\udc00\"", "\"a\x01\"", "[1] 2",
+	};
+	for (size_t i = 0; i < CYBOZU_NUM_OF_ARRAY(tbl); i++) {
+		cybozu::JsonDocument doc;
+		CYBOZU_TEST_EXCEPTION(doc.parse(tbl[i]), cybozu::Exception);
+	}
+	// the previous DOM is not available after an error
+	cybozu::JsonDocument doc;
+	const std::string in = "[1,2,3]";
+	doc.parse(in);
+	CYBOZU_TEST_EQUAL(doc.get().size(), 3u);
+	CYBOZU_TEST_EXCEPTION(doc.parse("[1,2,"), cybozu::Exception);
+	CYBOZU_TEST_ASSERT(doc.get().isNull());
+	doc.parse(in);
+	CYBOZU_TEST_EXCEPTION(doc.parse("[4] 5"), cybozu::Exception);
+	CYBOZU_TEST_ASSERT(doc.get().isNull());
+}
+
+CYBOZU_TEST_AUTO(documentDuplicatedKey)
+{
+	cybozu::JsonDocument doc;
+	const std::string in = "{\"b\":0, \"a\":1, \"b\":2, \"a\":3, \"b\":4, \"a\":5, \"c\":6, \"a\":7}";
+	doc.parse(in);
+	const cybozu::JsonDocument::Node& root = doc.get();
+	CYBOZU_TEST_EQUAL(root.size(), 8u);
+	// the order of the input is kept and find returns the first one
+	const int tbl[] = { 1, 3, 5, 7, 0, 2, 4, 6 };
+	for (size_t i = 0; i < CYBOZU_NUM_OF_ARRAY(tbl); i++) {
+		CYBOZU_TEST_EQUAL(int(root.memberBegin()[i].val.getNumber()), tbl[i]);
+	}
+	CYBOZU_TEST_EQUAL(int(root["a"].getNumber()), 1);
+	CYBOZU_TEST_EQUAL(int(root["b"].getNumber()), 0);
+	CYBOZU_TEST_EQUAL(int(root["c"].getNumber()), 6);
+}
+
+CYBOZU_TEST_AUTO(number)
+{
+	const char *tbl[] = {
+		"0", "-0", "1", "-1", "123456789", "9007199254740992", "9007199254740993",
+		"9223372036854775807", "-9223372036854775808", "9223372036854775808",
+		"12345678901234567890123", "0.1", "-0.5", "3.14159265358979", "1e22", "1e23",
+		"1.5e-10", "123e-22", "123e-25", "2.2250738585072014e-308", "1.7976931348623157e308",
+		"4.9e-324", "1e400", "-1e-400", "0.000000000000000000000000012345", "1E+2",
+	};
+	for (size_t i = 0; i < CYBOZU_NUM_OF_ARRAY(tbl); i++) {
+		const char *s = tbl[i];
+		const size_t n = strlen(s);
+		CYBOZU_TEST_EQUAL(cybozu::json_local::scanNumber(s, s + n), s + n);
+		const double x = cybozu::json_local::toDouble(s, n);
+		const double y = strtod(s, 0);
+		CYBOZU_TEST_ASSERT(memcmp(&x, &y, sizeof(x)) == 0);
+	}
+	const struct {
+		const char *s;
+		bool isInt;
+		int64_t v;
+	} intTbl[] = {
+		{ "0", true, 0 },
+		{ "-0", false, 0 },
+		{ "123", true, 123 },
+		{ "-9223372036854775808", true, CYBOZU_LLONG_MIN },
+		{ "9223372036854775807", true, 9223372036854775807ll },
+		{ "9223372036854775808", false, 0 },
+		{ "1.0", false, 0 },
+		{ "1e2", false, 0 },
+	};
+	for (size_t i = 0; i < CYBOZU_NUM_OF_ARRAY(intTbl); i++) {
+		const char *s = intTbl[i].s;
+		int64_t v;
+		double d;
+		CYBOZU_TEST_EQUAL(cybozu::json_local::toNumber(&v, &d, s, strlen(s)), intTbl[i].isInt);
+		if (intTbl[i].isInt) CYBOZU_TEST_EQUAL(v, intTbl[i].v);
+	}
+	const std::string in = "[-12, 3.5, 9223372036854775807]";
+	cybozu::JsonDocument doc;
+	doc.parse(in);
+	CYBOZU_TEST_ASSERT(doc.get()[0].isInt());
+	CYBOZU_TEST_EQUAL(doc.get()[0].getInt(), -12);
+	CYBOZU_TEST_ASSERT(!doc.get()[1].isInt());
+	CYBOZU_TEST_EQUAL(int(doc.get()[1].getNumber() * 2), 7);
+	CYBOZU_TEST_EQUAL(doc.get()[2].getInt(), 9223372036854775807ll);
+}
+
+CYBOZU_TEST_AUTO(numberRandom)
+{
+	uint32_t x = 123456789;
+	for (int i = 0; i < 10000; i++) {
+		char buf[64];
+		x = x * 1103515245 + 12345;
+		const int digit = x % 17 + 1;
+		x = x * 1103515245 + 12345;
+		const int e = int(x % 70) - 35;
+		x = x * 1103515245 + 12345;
+		CYBOZU_SNPRINTF(buf, sizeof(buf), "%.*fe%d", digit, (x % 100000) / 99.0, e);
+		const size_t n = strlen(buf);
+		const double a = cybozu::json_local::toDouble(buf, n);
+		const double b = strtod(buf, 0);
+		CYBOZU_TEST_ASSERT(memcmp(&a, &b, sizeof(a)) == 0);
+	}
+}
+
+CYBOZU_TEST_AUTO(longString)
+{
+	for (size_t len = 60; len < 200; len++) {
+		for (size_t esc = 0; esc < len; esc += 7) {
+			std::string str(len, 'a');
+			str[esc] = '\n';
+			std::string in = std::string(len, ' ') + "[\"";
+			for (size_t i = 0; i < len; i++) {
+				if (str[i] == '\n') {
+					in += "\\n";
+				} else {
+					in += str[i];
+				}
+			}
+			in += "\"" + std::string(len, '\n') + "]";
+			cybozu::JsonDocument doc;
+			doc.parse(in);
+			CYBOZU_TEST_EQUAL(doc.get()[0].getString(), str);
+			cybozu::StringInputStream is(in);
+			cybozu::JsonReaderT<cybozu::StringInputStream> reader(is);
+			Recorder rec;
+			CYBOZU_TEST_ASSERT(reader.parse(rec));
+			CYBOZU_TEST_EQUAL(rec.s, "[s:" + str + ";]");
+		}
+	}
+}
+
+CYBOZU_TEST_AUTO(writer)
+{
+	std::string out;
+	{
+		cybozu::StringOutputStream os(out);
+		cybozu::JsonWriterT<cybozu::StringOutputStream> w(os);
+		w.startObject();
+		w.key("a");
+		w.integer(-123);
+		w.key("b\"");
+		w.startArray();
+		w.number(0.5);
+		w.boolean(true);
+		w.boolean(false);
+		w.null();
+		w.string("x\n\x01y\xe3\x81\x82");
+		w.startObject();
+		w.endObject();
+		w.startArray();
+		w.endArray();
+		w.endArray();
+		w.key("c");
+		w.number(1e21);
+		w.endObject();
+		CYBOZU_TEST_EXCEPTION(w.number(std::numeric_limits<double>::infinity()), cybozu::Exception);
+	}
+	CYBOZU_TEST_EQUAL(out, "{\"a\":-123,\"b\\\"\":[0.5,true,false,null,\"x\\n\\u0001y\xe3\x81\x82\",{},[]],\"c\":1e+21}");
+}
+
+CYBOZU_TEST_AUTO(writerNotFinite)
+{
+	const double tbl[] = {
+		std::numeric_limits<double>::infinity(),
+		-std::numeric_limits<double>::infinity(),
+		std::numeric_limits<double>::quiet_NaN(),
+	};
+	std::string out;
+	{
+		cybozu::StringOutputStream os(out);
+		cybozu::JsonWriterT<cybozu::StringOutputStream> w(os);
+		w.startArray();
+		w.number(1);
+		// nothing is written by an error
+		for (size_t i = 0; i < CYBOZU_NUM_OF_ARRAY(tbl); i++) {
+			CYBOZU_TEST_EXCEPTION(w.number(tbl[i]), cybozu::Exception);
+		}
+		w.number(2);
+		w.endArray();
+	}
+	CYBOZU_TEST_EQUAL(out, "[1,2]");
+}
+
+CYBOZU_TEST_AUTO(writerRoundTrip)
+{
+	std::string in = "[";
+	for (int i = 0; i < 1000; i++) {
+		char buf[128];
+		CYBOZU_SNPRINTF(buf, sizeof(buf), "%s{\"id\":%d,\"name\":\"name\\t%d\",\"v\":%d.25,\"ok\":%s,\"z\":null}", i == 0 ? "" : ",", i, i, i, i % 2 ? "true" : "false");
+		in += buf;
+	}
+	in += "]";
+	// reader -> writer
+	std::string out1;
+	{
+		cybozu::StringInputStream is(in);
+		cybozu::JsonReaderT<cybozu::StringInputStream> reader(is);
+		cybozu::StringOutputStream os(out1);
+		cybozu::JsonWriterT<cybozu::StringOutputStream, 64> writer(os);
+		CYBOZU_TEST_ASSERT(reader.parse(writer));
+	}
+	CYBOZU_TEST_EQUAL(out1, in);
+	// document -> writer
+	cybozu::JsonDocument doc;
+	doc.parse(in);
+	std::string out2;
+	{
+		cybozu::StringOutputStream os(out2);
+		cybozu::JsonWriterT<cybozu::StringOutputStream> writer(os);
+		writer.put(doc.get());
+		writer.flush();
+		CYBOZU_TEST_EQUAL(out2.size(), in.size());
+	}
+	// members are sorted
+	cybozu::JsonDocument doc2;
+	doc2.parse(out2);
+	CYBOZU_TEST_EQUAL(doc2.get()[999]["name"].getString(), "name\t999");
+	CYBOZU_TEST_EQUAL(doc2.get()[999].memberBegin()->getKey(), "id");
+	// Json::Value
+	cybozu::Json::Object obj;
+	obj["x"] = cybozu::Json::Value("abc");
+	obj["y"] = cybozu::Json::Value(1.5);
+	cybozu::Json::Array arr;
+	arr.push_back(cybozu::Json::Value(true));
+	arr.push_back(cybozu::Json::Value());
+	obj["z"] = cybozu::Json::Value(arr);
+	std::string out3;
+	{
+		cybozu::StringOutputStream os(out3);
+		cybozu::JsonWriterT<cybozu::StringOutputStream> writer(os);
+		writer.put(cybozu::Json::Value(obj));
+	}
+	CYBOZU_TEST_EQUAL(out3, "{\"x\":\"abc\",\"y\":1.5,\"z\":[true,null]}");
+}
@@ -4,6 +4,7 @@
 #include <cybozu/mmap.hpp>
 #include <cybozu/test.hpp>
 #include <cybozu/file.hpp>
+#include "test_util.hpp"
 #include <iostream>
 
 typedef cybozu::minixml::InputStream<std::string::const_iterator> InputStream;
@@ -73,6 +74,111 @@ CYBOZU_TEST_AUTO(escape)
 	CYBOZU_TEST_EQUAL(in, dec);
 }
 
+template<class Reader>
+std::string readAll(Reader& reader)
+{
+	std::string s;
+	for (;;) {
+		switch (reader.next()) {
+		case Reader::T_StartTag:
+			s += "<" + reader.getNameStr() + ">";
+			break;
+		case Reader::T_Attribute:
+			s += reader.getNameStr() + "=" + reader.getUnescapedValue() + ";";
+			break;
+		case Reader::T_Text:
+			s += "[" + reader.getValueStr() + "]";
+			break;
+		case Reader::T_EndTag:
+			s += "</" + reader.getNameStr() + ">";
+			break;
+		case Reader::T_End:
+			return s;
+		}
+	}
+}
+
+CYBOZU_TEST_AUTO(reader)
+{
+	const std::string in =
+		"<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+		"<!-- comment <a> -->\n"
+		"<root a=\"1\" b = 'x&amp;y'>\n"
+		"  <item id=\"2\"/>\n"
+		"  <item>text&lt;</item>\n"
+		"  <p:x><![CDATA[<raw>]]></p:x>\n"
+		"</root>\n";
+	const std::string expected = "<root>a=1;b=x&y;<item>id=2;</item><item>[text&lt;]</item><p:x>[<raw>]</p:x></root>";
+	{
+		cybozu::StringInputStream is(in);
+		cybozu::XmlReaderT<cybozu::StringInputStream> reader(is);
+		CYBOZU_TEST_EQUAL(readAll(reader), expected);
+	}
+	{
+		SlowInputStream is(in, 5);
+		cybozu::XmlReaderT<SlowInputStream> reader(is);
+		CYBOZU_TEST_EQUAL(readAll(reader), expected);
+	}
+	{
+		cybozu::StringInputStream is(xmlData);
+		cybozu::XmlReaderT<cybozu::StringInputStream> reader(is);
+		CYBOZU_TEST_EQUAL(reader.next(), reader.T_StartTag);
+		CYBOZU_TEST_EQUAL(reader.getNameStr(), "encryption");
+		CYBOZU_TEST_EQUAL(reader.getDepth(), 1u);
+		int n = 0;
+		for (;;) {
+			int type = reader.next();
+			if (type == reader.T_End) break;
+			if (type == reader.T_StartTag && reader.getNameStr() == "p:encryptedKey") {
+				CYBOZU_TEST_EQUAL(reader.getDepth(), 4u);
+				n++;
+			}
+		}
+		CYBOZU_TEST_EQUAL(n, 1);
+	}
+}
+
+CYBOZU_TEST_AUTO(readerLarge)
+{
+	/*
+		the buffer keeps only the current token
+	*/
+	std::string in = "<list>";
+	const int n = 100000;
+	for (int i = 0; i < n; i++) {
+		in += "<e v=\"123\">abc</e>";
+	}
+	in += "</list>";
+	cybozu::StringInputStream is(in);
+	cybozu::XmlReaderT<cybozu::StringInputStream> reader(is, 1024);
+	int count = 0;
+	for (;;) {
+		int type = reader.next();
+		if (type == reader.T_End) break;
+		if (type == reader.T_Text) count++;
+	}
+	CYBOZU_TEST_EQUAL(count, n);
+}
+
+CYBOZU_TEST_AUTO(readerErr)
+{
+	const char *tbl[] = {
+		"<a>", "<a></b>", "<a x></a>", "<a x=1></a>", "<a x=\"1></a>", "<a/ >", "</a>", "<!-- abc", "<>",
+	};
+	for (size_t i = 0; i < CYBOZU_NUM_OF_ARRAY(tbl); i++) {
+		const std::string in = tbl[i];
+		cybozu::StringInputStream is(in);
+		cybozu::XmlReaderT<cybozu::StringInputStream> reader(is);
+		CYBOZU_TEST_EXCEPTION(readAll(reader), cybozu::Exception);
+	}
+	{
+		const std::string in = "<a>" + std::string(2000, 'x') + "</a>";
+		cybozu::StringInputStream is(in);
+		cybozu::XmlReaderT<cybozu::StringInputStream> reader(is, 1024);
+		CYBOZU_TEST_EXCEPTION(readAll(reader), cybozu::Exception);
+	}
+}
+
 CYBOZU_TEST_AUTO(example)
 {
 	std::string file = cybozu::GetExePath();
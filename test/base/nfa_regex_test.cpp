@@ -0,0 +1,215 @@
+#include <cybozu/test.hpp>
+#include <cybozu/nfa_regex.hpp>
+#include <time.h>
+
+using cybozu::String;
+using cybozu::nfa_regex;
+
+CYBOZU_TEST_AUTO(search)
+{
+	const struct {
+		const char *re;
+		const char *text;
+		const char *match; // 0 if not matched
+	} tbl[] = {
+		{ "abc", "xxabcxx", "abc" },
+		{ "abc", "xxabxx", 0 },
+		{ "a.c", "a\nc abc", "abc" },
+		{ "a*", "bbb", "" },
+		{ "a+", "baaab", "aaa" },
+		{ "a+?", "baaab", "a" },
+		{ "a{2,3}", "aaaa", "aaa" },
+		{ "a{2,3}?", "aaaa", "aa" },
+		{ "a{2}", "a aa", "aa" },
+		{ "a{2,}", "aaaaa", "aaaaa" },
+		{ "x{", "x{", "x{" },
+		{ "ab|cd", "xcdab", "cd" },
+		{ "a|ab", "ab", "a" },
+		{ "(a|ab)(c|bcd)", "abcd", "abcd" },
+		{ "[a-c]+", "xxbcaz", "bca" },
+		{ "[^a-c]+", "abxyzc", "xyz" },
+		{ "[]", "abc", 0 },
+		{ "[^]+", "a\nb", "a\nb" },
+		{ "[\\d.]+", "ab12.5cd", "12.5" },
+		{ "\\d+", "abc123def", "123" },
+		{ "\\D+", "123abc456", "abc" },
+		{ "\\w+", "  foo_1 ", "foo_1" },
+		{ "\\W+", "ab  cd", "  " },
+		{ "\\s+", "ab \t\ncd", " \t\n" },
+		{ "\\S+", "  ab ", "ab" },
+		{ "\\bfoo\\b", "foobar foo", "foo" },
+		{ "\\Boo", "oo foo", "oo" },
+		{ "^abc", "xabc", 0 },
+		{ "^abc", "abcx", "abc" },
+		{ "abc$", "abcx abc", "abc" },
+		{ "\\x41\\u3042", "A\xe3\x81\x82", "A\xe3\x81\x82" },
+		{ "\\.\\*", "a.*b", ".*" },
+		{ "(?:ab)+", "abababx", "ababab" },
+		{ "\xe3\x81\x82+", "\xe3\x81\x84\xe3\x81\x82\xe3\x81\x82", "\xe3\x81\x82\xe3\x81\x82" },
+		{ "[\xe3\x81\x82-\xe3\x81\x86]+", "x\xe3\x81\x84\xe3\x81\x86\xe3\x81\x88", "\xe3\x81\x84\xe3\x81\x86" },
+		{ "(a*)*b", "aaab", "aaab" },
+		{ "", "abc", "" },
+		{ "a|", "b", "" },
+	};
+	for (size_t i = 0; i < CYBOZU_NUM_OF_ARRAY(tbl); i++) {
+		const nfa_regex re(tbl[i].re);
+		const String text(tbl[i].text);
+		cybozu::nfa_smatch m;
+		const bool b = cybozu::regex_search(text, m, re);
+		CYBOZU_TEST_EQUAL(b, tbl[i].match != 0);
+		CYBOZU_TEST_EQUAL(cybozu::regex_search(text, re), b);
+		if (b && tbl[i].match) {
+			CYBOZU_TEST_EQUAL(m.str(), tbl[i].match);
+		}
+	}
+}
+
+CYBOZU_TEST_AUTO(group)
+{
+	const nfa_regex re("(\\w+)@(\\w+)(\\.com)?");
+	CYBOZU_TEST_EQUAL(re.mark_count(), 3u);
+	const String s("mail: foo@example.org");
+	cybozu::nfa_smatch m;
+	CYBOZU_TEST_ASSERT(cybozu::regex_search(s, m, re));
+	CYBOZU_TEST_EQUAL(m.size(), 4u);
+	CYBOZU_TEST_EQUAL(m.str(), "foo@example");
+	CYBOZU_TEST_EQUAL(m.str(1), "foo");
+	CYBOZU_TEST_EQUAL(m.str(2), "example");
+	CYBOZU_TEST_ASSERT(!m.matched(3));
+	CYBOZU_TEST_EQUAL(m.str(3), "");
+	CYBOZU_TEST_EQUAL(m.position(), 6u);
+	CYBOZU_TEST_EQUAL(m.position(2), 10u);
+	CYBOZU_TEST_EQUAL(m.length(2), 7u);
+	CYBOZU_TEST_EQUAL(m.prefix(), "mail: ");
+	CYBOZU_TEST_EQUAL(m.suffix(), ".org");
+
+	// the last iteration is captured
+	const nfa_regex re2("(a|b)+");
+	const String s2("xabba");
+	CYBOZU_TEST_ASSERT(cybozu::regex_search(s2, m, re2));
+	CYBOZU_TEST_EQUAL(m.str(1), "a");
+	CYBOZU_TEST_EQUAL(m.position(1), 4u);
+
+	CYBOZU_TEST_ASSERT(cybozu::regex_search(s.begin() + 10, s.end(), m, nfa_regex("e(x)")));
+	CYBOZU_TEST_EQUAL(m.position(), 0u);
+	CYBOZU_TEST_EQUAL(m.str(1), "x");
+}
+
+CYBOZU_TEST_AUTO(match)
+{
+	const nfa_regex re("a+b*");
+	CYBOZU_TEST_ASSERT(cybozu::regex_match(String("aab"), re));
+	CYBOZU_TEST_ASSERT(cybozu::regex_match(String("a"), re));
+	CYBOZU_TEST_ASSERT(!cybozu::regex_match(String("aabc"), re));
+	CYBOZU_TEST_ASSERT(!cybozu::regex_match(String("baab"), re));
+	cybozu::nfa_smatch m;
+	const String abc("abc");
+	CYBOZU_TEST_ASSERT(cybozu::regex_match(abc, m, nfa_regex("(a|ab)(c|bcd)?")));
+	CYBOZU_TEST_EQUAL(m.str(1), "ab");
+	CYBOZU_TEST_EQUAL(m.str(2), "c");
+	CYBOZU_TEST_ASSERT(!cybozu::regex_match(String("abcx"), m, nfa_regex("(a|ab)(c|bcd)?")));
+	CYBOZU_TEST_ASSERT(m.empty());
+	const String s("xyz");
+	CYBOZU_TEST_ASSERT(cybozu::regex_match(s.begin() + 1, s.end(), nfa_regex("yz")));
+	CYBOZU_TEST_ASSERT(cybozu::regex_match(s.end(), s.end(), nfa_regex("y*")));
+}
+
+CYBOZU_TEST_AUTO(flags)
+{
+	CYBOZU_TEST_ASSERT(cybozu::regex_match(String("AbC"), nfa_regex("abc", nfa_regex::icase)));
+	CYBOZU_TEST_ASSERT(cybozu::regex_match(String("AbC"), nfa_regex("[a-c]+", nfa_regex::icase)));
+	CYBOZU_TEST_ASSERT(!cybozu::regex_match(String("AbC"), nfa_regex("abc")));
+	const String s("ab\ncd\n");
+	cybozu::nfa_smatch m;
+	CYBOZU_TEST_ASSERT(!cybozu::regex_search(s, nfa_regex("^cd$")));
+	CYBOZU_TEST_ASSERT(cybozu::regex_search(s, m, nfa_regex("^cd$", nfa_regex::multiline)));
+	CYBOZU_TEST_EQUAL(m.position(), 3u);
+}
+
+CYBOZU_TEST_AUTO(replace)
+{
+	const struct {
+		const char *re;
+		const char *text;
+		const char *fmt;
+		const char *out;
+	} tbl[] = {
+		{ "a", "banana", "o", "bonono" },
+		{ "(\\w+)@(\\w+)", "x foo@bar y", "$2 at $1", "x bar at foo y" },
+		{ "b", "abc", "[$`|$&|$']", "a[a|b|c]c" },
+		{ "b", "abc", "$$ $3 $", "a$ $3 $c" },
+		{ "x*", "abc", "-", "-a-b-c-" },
+		{ "^a", "aaa", "b", "baa" },
+		{ "\\b", "ab cd", "|", "|ab| |cd|" },
+	};
+	for (size_t i = 0; i < CYBOZU_NUM_OF_ARRAY(tbl); i++) {
+		const String out = cybozu::regex_replace(String(tbl[i].text), nfa_regex(tbl[i].re), String(tbl[i].fmt));
+		CYBOZU_TEST_EQUAL(out, tbl[i].out);
+	}
+}
+
+CYBOZU_TEST_AUTO(error)
+{
+	const char *tbl[] = {
+		"(", ")", "(a", "a)", "[a", "*a", "a**", "+", "\\1", "(?=a)", "(?!a)", "[z-a]", "a{3,2}", "\\x4", "a{1001}", "^*",
+		"((a{1000}){1000}){1000}",
+	};
+	for (size_t i = 0; i < CYBOZU_NUM_OF_ARRAY(tbl); i++) {
+		CYBOZU_TEST_EXCEPTION_MESSAGE(nfa_regex re(tbl[i]), cybozu::Exception, "nfa_regex");
+	}
+}
+
+CYBOZU_TEST_AUTO(linear)
+{
+	// (a*)*b and (a|aa)+$ take exponential time by backtracking
+	const String s(30, 'a');
+	const clock_t begin = clock();
+	CYBOZU_TEST_ASSERT(!cybozu::regex_search(s, nfa_regex("(a*)*b")));
+	CYBOZU_TEST_ASSERT(!cybozu::regex_match(s + String("c"), nfa_regex("(a|aa)+")));
+	CYBOZU_TEST_ASSERT(cybozu::regex_match(s, nfa_regex("(a|aa)+")));
+	String t;
+	for (int i = 0; i < 10000; i++) t += "ab";
+	CYBOZU_TEST_ASSERT(!cybozu::regex_search(t, nfa_regex("(a|b)*c")));
+	CYBOZU_TEST_ASSERT(clock() - begin < 10 * CLOCKS_PER_SEC);
+}
+
+CYBOZU_TEST_AUTO(manyGroups)
+{
+	// captures of each thread make the time O(pattern * groups * text)
+	String pattern;
+	for (int i = 0; i < 2000; i++) pattern += "(a)";
+	CYBOZU_TEST_EXCEPTION_MESSAGE(nfa_regex re(pattern), cybozu::Exception, "too many groups");
+	pattern.clear();
+	for (int i = 0; i < 300; i++) pattern += "(a)";
+	const nfa_regex re(pattern);
+	CYBOZU_TEST_EQUAL(re.mark_count(), 300u);
+	const String s(2000, 'a');
+	const clock_t begin = clock();
+	CYBOZU_TEST_ASSERT(cybozu::regex_search(s, re));
+	CYBOZU_TEST_ASSERT(!cybozu::regex_match(s, re));
+	cybozu::nfa_smatch m;
+	CYBOZU_TEST_ASSERT(cybozu::regex_search(s, m, re));
+	CYBOZU_TEST_EQUAL(m.size(), 301u);
+	CYBOZU_TEST_EQUAL(m.length(), 300u);
+	CYBOZU_TEST_EQUAL(m.position(300), 299u);
+	CYBOZU_TEST_EQUAL(cybozu::regex_replace(s, re, String("b")), String(6, 'b') + String(200, 'a'));
+	CYBOZU_TEST_ASSERT(clock() - begin < 10 * CLOCKS_PER_SEC);
+}
+
+CYBOZU_TEST_AUTO(work)
+{
+	const nfa_regex re("([a-z]+)([0-9]*)");
+	nfa_regex::Work w;
+	cybozu::nfa_smatch m;
+	const String s("12abc34 de f5");
+	CYBOZU_TEST_ASSERT(re.exec(w, &m, s.c_str(), s.size(), 0, false));
+	CYBOZU_TEST_EQUAL(m.str(1), String("abc"));
+	CYBOZU_TEST_EQUAL(m.str(2), String("34"));
+	CYBOZU_TEST_ASSERT(re.exec(w, &m, s.c_str(), s.size(), 7, false));
+	CYBOZU_TEST_EQUAL(m.str(), String("de"));
+	CYBOZU_TEST_ASSERT(re.exec(w, 0, s.c_str(), s.size(), 10, false));
+	CYBOZU_TEST_ASSERT(!re.exec(w, 0, s.c_str(), s.size(), 10, true));
+	CYBOZU_TEST_ASSERT(re.exec(w, &m, s.c_str(), s.size(), 11, false));
+	CYBOZU_TEST_EQUAL(m.str(), String("f5"));
+	CYBOZU_TEST_EQUAL(m.position(), 11u);
+}
@@ -0,0 +1,219 @@
+#include <cybozu/test.hpp>
+#include <cybozu/pipeline.hpp>
+#include <cybozu/crypto.hpp>
+#include <string>
+#include <vector>
+#include "test_util.hpp"
+
+typedef cybozu::crypto::Cipher Cipher;
+typedef cybozu::crypto::Hash Hash;
+typedef cybozu::StringOutputStream Out;
+
+const std::string key = "0123456789abcdef0123456789abcdef";
+const std::string iv = "fedcba9876543210";
+
+std::string encrypt(const std::string& in)
+{
+	Cipher cipher(Cipher::N_AES256_CTR);
+	cipher.setup(Cipher::Encoding, key, iv);
+	std::string out(in.size() + 16, 0);
+	const int n = cipher.update(&out[0], in.data(), int(in.size()));
+	CYBOZU_TEST_ASSERT(n >= 0);
+	out.resize(n);
+	return out;
+}
+
+/*
+	throw an exception after maxSize bytes
+*/
+struct LimitedOutputStream {
+	std::string str;
+	size_t maxSize;
+	explicit LimitedOutputStream(size_t maxSize) : maxSize(maxSize) {}
+	void write(const void *buf, size_t size)
+	{
+		if (str.size() + size > maxSize) throw cybozu::Exception("LimitedOutputStream:write") << maxSize;
+		str.append(static_cast<const char*>(buf), size);
+	}
+};
+
+CYBOZU_TEST_AUTO(cipherHash)
+{
+	typedef cybozu::HashOutputStreamT<Out, Hash> Sum;
+	typedef cybozu::CipherOutputStreamT<Sum, Cipher> Enc;
+	const std::string in = makeData(10000);
+	const std::string expected = encrypt(in);
+	const size_t chunkTbl[] = { 1, 15, 16, 100, 4096, 10000 };
+	for (size_t i = 0; i < CYBOZU_NUM_OF_ARRAY(chunkTbl); i++) {
+		std::string out;
+		Out os(out);
+		Hash hash(Hash::N_SHA256);
+		Cipher cipher(Cipher::N_AES256_CTR);
+		cipher.setup(Cipher::Encoding, key, iv);
+		Sum sum(os, hash);
+		Enc enc(sum, cipher, 1000);
+		for (size_t pos = 0; pos < in.size(); pos += chunkTbl[i]) {
+			enc.write(&in[pos], std::min(chunkTbl[i], in.size() - pos));
+		}
+		enc.flush();
+		CYBOZU_TEST_ASSERT(out == expected);
+		CYBOZU_TEST_EQUAL(hash.digest(), Hash::digest(Hash::N_SHA256, expected));
+	}
+	std::string out;
+	Out os(out);
+	Hash hash(Hash::N_SHA256);
+	Sum sum(os, hash);
+	Cipher cipher(Cipher::N_AES256_CTR);
+	CYBOZU_TEST_EXCEPTION(Enc(sum, cipher, 0), cybozu::Exception);
+}
+
+CYBOZU_TEST_AUTO(async)
+{
+	typedef cybozu::AsyncOutputStreamT<Out> Async;
+	const std::string in = makeData(100000);
+	const size_t bufSizeTbl[] = { 1, 7, 1000, 65536 };
+	const size_t queueSizeTbl[] = { 1, 2, 5 };
+	for (size_t i = 0; i < CYBOZU_NUM_OF_ARRAY(bufSizeTbl); i++) {
+		for (size_t j = 0; j < CYBOZU_NUM_OF_ARRAY(queueSizeTbl); j++) {
+			std::string out;
+			Out os(out);
+			Async async(os, bufSizeTbl[i], queueSizeTbl[j]);
+			size_t pos = 0;
+			for (size_t k = 1; pos < in.size(); k = k * 3 + 1) {
+				const size_t n = std::min(k % 5000, in.size() - pos);
+				async.write(&in[pos], n);
+				pos += n;
+				if (pos == in.size() / 2) {
+					async.flush();
+					CYBOZU_TEST_EQUAL(out.size(), pos);
+				}
+			}
+			async.flush();
+			CYBOZU_TEST_ASSERT(out == in);
+			// reuse after flush
+			async.write("abc", 3);
+			async.flush();
+			CYBOZU_TEST_ASSERT(out == in + "abc");
+		}
+	}
+	// the destructor writes the rest
+	std::string out;
+	{
+		Out os(out);
+		Async async(os, 1000);
+		async.write(&in[0], 1500);
+	}
+	CYBOZU_TEST_EQUAL(out, in.substr(0, 1500));
+	Out os(out);
+	CYBOZU_TEST_EXCEPTION(Async(os, 0), cybozu::Exception);
+	CYBOZU_TEST_EXCEPTION(Async(os, 100, 0), cybozu::Exception);
+}
+
+CYBOZU_TEST_AUTO(asyncError)
+{
+	typedef cybozu::AsyncOutputStreamT<LimitedOutputStream> Async;
+	const std::string in = makeData(10000);
+	{
+		LimitedOutputStream los(5000);
+		Async async(los, 100, 2);
+		CYBOZU_TEST_EXCEPTION(async.write(&in[0], in.size()), cybozu::Exception);
+		CYBOZU_TEST_EXCEPTION(async.flush(), cybozu::Exception);
+		CYBOZU_TEST_EQUAL(los.str, in.substr(0, 5000));
+	}
+	{
+		LimitedOutputStream los(5000);
+		Async async(los, 10000);
+		async.write(&in[0], 6000);
+		CYBOZU_TEST_EXCEPTION(async.flush(), cybozu::Exception);
+		CYBOZU_TEST_ASSERT(los.str.empty());
+	}
+}
+
+CYBOZU_TEST_AUTO(pipeline)
+{
+	// encrypt -> (thread) -> checksum -> (thread) -> string
+	typedef cybozu::AsyncOutputStreamT<Out> Async2;
+	typedef cybozu::HashOutputStreamT<Async2, Hash> Sum;
+	typedef cybozu::AsyncOutputStreamT<Sum> Async1;
+	typedef cybozu::CipherOutputStreamT<Async1, Cipher> Enc;
+	const std::string in = makeData(300000);
+	const std::string expected = encrypt(in);
+	std::string out;
+	Out os(out);
+	Hash hash(Hash::N_SHA256);
+	Cipher cipher(Cipher::N_AES256_CTR);
+	cipher.setup(Cipher::Encoding, key, iv);
+	Async2 async2(os, 4096, 3);
+	Sum sum(async2, hash);
+	Async1 async1(sum, 8192, 3);
+	Enc enc(async1, cipher, 1024);
+	for (size_t pos = 0; pos < in.size(); pos += 777) {
+		enc.write(&in[pos], std::min<size_t>(777, in.size() - pos));
+	}
+	// flush all stages and threads
+	enc.flush();
+	CYBOZU_TEST_ASSERT(out == expected);
+	CYBOZU_TEST_EQUAL(hash.digest(), Hash::digest(Hash::N_SHA256, expected));
+}
+
+struct FlushCountOutputStream {
+	std::string str;
+	int flushNum;
+	FlushCountOutputStream() : flushNum(0) {}
+	void write(const void *buf, size_t size)
+	{
+		str.append(static_cast<const char*>(buf), size);
+	}
+	void flush() { flushNum++; }
+};
+
+CYBOZU_TEST_AUTO(forwardFlush)
+{
+	typedef cybozu::AsyncOutputStreamT<FlushCountOutputStream> Async;
+	typedef cybozu::HashOutputStreamT<Async, Hash> Sum;
+	typedef cybozu::CipherOutputStreamT<Sum, Cipher> Enc;
+	const std::string in = makeData(5000);
+	FlushCountOutputStream os;
+	Hash hash(Hash::N_SHA256);
+	Cipher cipher(Cipher::N_AES256_CTR);
+	cipher.setup(Cipher::Encoding, key, iv);
+	Async async(os, 1000, 2);
+	Sum sum(async, hash);
+	Enc enc(sum, cipher, 100);
+	enc.write(in.data(), in.size());
+	enc.flush();
+	CYBOZU_TEST_EQUAL(os.flushNum, 1);
+	CYBOZU_TEST_ASSERT(os.str == encrypt(in));
+	sum.flush();
+	CYBOZU_TEST_EQUAL(os.flushNum, 2);
+}
+
+#ifdef CYBOZU_AES_GCM
+CYBOZU_TEST_AUTO(gcm)
+{
+	typedef cybozu::crypto::AesGcm AesGcm;
+	typedef cybozu::CipherOutputStreamT<Out, AesGcm> Enc;
+	const std::string in = makeData(5000);
+	const std::string gcmIv = iv.substr(0, 12);
+	std::string expected(in.size(), 0);
+	char expectedTag[AesGcm::tagSize];
+	{
+		AesGcm gcm;
+		gcm.setup(Cipher::Encoding, key, gcmIv);
+		CYBOZU_TEST_EQUAL(gcm.update(&expected[0], in.data(), int(in.size())), int(in.size()));
+		gcm.finalize(expectedTag);
+	}
+	std::string out;
+	Out os(out);
+	AesGcm gcm;
+	gcm.setup(Cipher::Encoding, key, gcmIv);
+	Enc enc(os, gcm, 333);
+	for (size_t pos = 0; pos < in.size(); pos += 100) {
+		enc.write(&in[pos], std::min<size_t>(100, in.size() - pos));
+	}
+	char tag[AesGcm::tagSize];
+	gcm.finalize(tag);
+	CYBOZU_TEST_ASSERT(out == expected);
+	CYBOZU_TEST_EQUAL_ARRAY(tag, expectedTag, AesGcm::tagSize);
+}
+#endif
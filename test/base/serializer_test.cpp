@@ -7,6 +7,7 @@
 #include <list>
 #include <vector>
 #include <cybozu/unordered_map.hpp>
+#include <cybozu/unordered_set.hpp>
 
 typedef std::vector<int> IntVec;
 typedef std::vector<std::string> StrVec;
@@ -481,3 +482,41 @@ void compressTest(X& x, Y& y, bool useCompression)
 }
 
 #endif
+
+CYBOZU_TEST_AUTO(flatHash)
+{
+	typedef cybozu::FlatHashMap<std::string, int> Map;
+	Map x, y;
+	x["asdfasd"] = 12;
+	x["this"] = 3141592;
+	x["is"] = 999;
+	x["a"] = -120;
+	x["pen"] = 0;
+	y["old"] = 1;
+	SaveAndLoad(y, x);
+	CYBOZU_TEST_EQUAL(y.size(), x.size());
+	for (Map::const_iterator i = x.begin(), ie = x.end(); i != ie; ++i) {
+		CYBOZU_TEST_EQUAL(y.at(i->first), i->second);
+	}
+
+	typedef cybozu::FlatHashSet<int> Set;
+	Set s, t;
+	for (int i = 0; i < 100; i++) {
+		s.insert(i * i);
+	}
+	t.insert(-1);
+	SaveAndLoad(t, s);
+	CYBOZU_TEST_EQUAL(t.size(), s.size());
+	for (Set::const_iterator i = s.begin(), ie = s.end(); i != ie; ++i) {
+		CYBOZU_TEST_EQUAL(t.count(*i), 1u);
+	}
+	// the same format as unordered_set
+	CYBOZU_NAMESPACE_STD::unordered_set<int> u;
+	std::stringstream ss;
+	cybozu::save(ss, s);
+	cybozu::load(u, ss);
+	CYBOZU_TEST_EQUAL(u.size(), s.size());
+	for (Set::const_iterator i = s.begin(), ie = s.end(); i != ie; ++i) {
+		CYBOZU_TEST_EQUAL(u.count(*i), 1u);
+	}
+}
@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <vector>
 #include <cybozu/sha1.hpp>
 #include <cybozu/test.hpp>
 #ifdef _MSC_VER
@@ -75,3 +76,103 @@ CYBOZU_TEST_AUTO(update2)
 		}
 	}
 }
+
+CYBOZU_TEST_AUTO(sha1Batch)
+{
+	std::vector<std::string> msgVec;
+	for (size_t i = 0; i < CYBOZU_NUM_OF_ARRAY(tbl); i++) {
+		msgVec.push_back(tbl[i].msg);
+	}
+	// various sizes around the block boundaries to shuffle the lanes
+	for (size_t i = 0; i < 200; i++) {
+		const size_t sizeTbl[] = { 0, 1, 55, 56, 63, 64, 65, 119, 120, 128, 1000 };
+		std::string s(sizeTbl[i % CYBOZU_NUM_OF_ARRAY(sizeTbl)] + (i * 7 % 3) * 64, 0);
+		for (size_t j = 0; j < s.size(); j++) {
+			s[j] = char(i * 31 + j * 3);
+		}
+		msgVec.push_back(s);
+	}
+	const size_t n = msgVec.size();
+	std::vector<const void*> bufs(n);
+	std::vector<size_t> sizes(n);
+	std::vector<std::string> expected(n);
+	for (size_t i = 0; i < n; i++) {
+		bufs[i] = msgVec[i].data();
+		sizes[i] = msgVec[i].size();
+		char md[20];
+		cybozu::Sha1().digest(md, sizeof(md), msgVec[i].data(), msgVec[i].size());
+		expected[i].assign(md, sizeof(md));
+	}
+	using namespace cybozu::sha2_local;
+	const int maskTbl[] = { 0, sha256ShaNi, sha256Avx2, sha256Avx512, sha256ShaNi | sha256Avx2 | sha256Avx512 };
+	for (size_t i = 0; i < CYBOZU_NUM_OF_ARRAY(maskTbl); i++) {
+		limitSha256Feature(maskTbl[i]);
+		for (size_t m = 0; m <= n; m += 37) {
+			std::vector<char> out(m * 20 + 1, 'x');
+			cybozu::sha1Batch(&bufs[0], &sizes[0], m, &out[0]);
+			for (size_t j = 0; j < m; j++) {
+				CYBOZU_TEST_EQUAL(std::string(&out[j * 20], 20), expected[j]);
+			}
+			CYBOZU_TEST_EQUAL(out[m * 20], 'x');
+		}
+		for (size_t j = 0; j < CYBOZU_NUM_OF_ARRAY(tbl); j++) {
+			CYBOZU_TEST_EQUAL(toHex(expected[j]), tbl[j].ret);
+		}
+	}
+	limitSha256Feature(sha256ShaNi | sha256Avx2 | sha256Avx512);
+}
+
+CYBOZU_TEST_AUTO(hmac1)
+{
+	// RFC 2202
+	const struct {
+		std::string key;
+		const char *msg;
+		const char *mac;
+	} hmacTbl[] = {
+		{ std::string(20, '\x0b'), "Hi There", "b617318655057264e28bc0b6fb378c8ef146be00" },
+		{ "Jefe", "what do ya want for nothing?", "effcdf6ae5eb2fa2d27416d5f184df9c259a7c79" },
+		{ std::string(80, '\xaa'), "Test Using Larger Than Block-Size Key - Hash Key First", "aa4ae5e15272d00e95705637ce8a3b55ed402112" },
+	};
+	for (size_t i = 0; i < CYBOZU_NUM_OF_ARRAY(hmacTbl); i++) {
+		const std::string& key = hmacTbl[i].key;
+		const std::string msg = hmacTbl[i].msg;
+		char mac[20];
+		cybozu::hmac1(mac, key.c_str(), key.size(), msg.c_str(), msg.size());
+		CYBOZU_TEST_EQUAL(toHex(std::string(mac, sizeof(mac))), hmacTbl[i].mac);
+		cybozu::Hmac1 hmac(key.c_str(), key.size());
+		for (size_t pos = 0; pos < msg.size(); pos += 5) {
+			hmac.update(&msg[pos], std::min<size_t>(5, msg.size() - pos));
+		}
+		CYBOZU_TEST_EQUAL(hmac.digest(mac, sizeof(mac)), sizeof(mac));
+		CYBOZU_TEST_EQUAL(toHex(std::string(mac, sizeof(mac))), hmacTbl[i].mac);
+		CYBOZU_TEST_ASSERT(hmac.verify(mac, msg.c_str(), msg.size()));
+		CYBOZU_TEST_ASSERT(!hmac.verify(mac, msg.c_str(), msg.size() - 1));
+	}
+	// batch
+	std::vector<std::string> msgVec;
+	for (size_t i = 0; i < 100; i++) {
+		msgVec.push_back(std::string(i * 13 % 150, char(i)));
+	}
+	const size_t n = msgVec.size();
+	std::vector<const void*> bufs(n);
+	std::vector<size_t> sizes(n);
+	for (size_t i = 0; i < n; i++) {
+		bufs[i] = msgVec[i].data();
+		sizes[i] = msgVec[i].size();
+	}
+	const cybozu::Hmac1 hmac("key", 3);
+	using namespace cybozu::sha2_local;
+	const int maskTbl[] = { 0, sha256ShaNi, sha256Avx2, sha256Avx512, sha256ShaNi | sha256Avx2 | sha256Avx512 };
+	for (size_t i = 0; i < CYBOZU_NUM_OF_ARRAY(maskTbl); i++) {
+		limitSha256Feature(maskTbl[i]);
+		std::vector<char> out(n * 20);
+		hmac.computeBatch(&out[0], &bufs[0], &sizes[0], n);
+		for (size_t j = 0; j < n; j++) {
+			char mac[20];
+			cybozu::hmac1(mac, "key", 3, msgVec[j].data(), msgVec[j].size());
+			CYBOZU_TEST_EQUAL(std::string(&out[j * 20], 20), std::string(mac, sizeof(mac)));
+		}
+	}
+	limitSha256Feature(sha256ShaNi | sha256Avx2 | sha256Avx512);
+}
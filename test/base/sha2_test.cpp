@@ -8,6 +8,7 @@
 #include <cybozu/itoa.hpp>
 #include <cybozu/atoi.hpp>
 #include <cybozu/benchmark.hpp>
+#include "test_util.hpp"
 
 const struct Tbl {
 	const char *out;
@@ -128,6 +129,51 @@ CYBOZU_TEST_AUTO(sha512)
 	}
 }
 
+CYBOZU_TEST_AUTO(sha256Batch)
+{
+	std::vector<std::string> msgVec;
+	for (size_t i = 0; i < CYBOZU_NUM_OF_ARRAY(sha256Tbl); i++) {
+		msgVec.push_back(sha256Tbl[i].in);
+	}
+	// various sizes around the block boundaries to shuffle the lanes
+	for (size_t i = 0; i < 200; i++) {
+		const size_t tbl[] = { 0, 1, 55, 56, 63, 64, 65, 119, 120, 128, 1000 };
+		std::string s(tbl[i % CYBOZU_NUM_OF_ARRAY(tbl)] + (i * 7 % 3) * 64, 0);
+		for (size_t j = 0; j < s.size(); j++) {
+			s[j] = char(i * 31 + j * 3);
+		}
+		msgVec.push_back(s);
+	}
+	const size_t n = msgVec.size();
+	std::vector<const void*> bufs(n);
+	std::vector<size_t> sizes(n);
+	std::vector<std::string> expected(n);
+	for (size_t i = 0; i < n; i++) {
+		bufs[i] = msgVec[i].data();
+		sizes[i] = msgVec[i].size();
+		char md[32];
+		cybozu::Sha256().digest(md, sizeof(md), msgVec[i].data(), msgVec[i].size());
+		expected[i].assign(md, sizeof(md));
+	}
+	using namespace cybozu::sha2_local;
+	const int maskTbl[] = { 0, sha256ShaNi, sha256Avx2, sha256Avx512, sha256ShaNi | sha256Avx2 | sha256Avx512 };
+	for (size_t i = 0; i < CYBOZU_NUM_OF_ARRAY(maskTbl); i++) {
+		limitSha256Feature(maskTbl[i]);
+		for (size_t m = 0; m <= n; m += 37) {
+			std::vector<char> out(m * 32 + 1, 'x');
+			cybozu::sha256Batch(&bufs[0], &sizes[0], m, &out[0]);
+			for (size_t j = 0; j < m; j++) {
+				CYBOZU_TEST_EQUAL(std::string(&out[j * 32], 32), expected[j]);
+			}
+			CYBOZU_TEST_EQUAL(out[m * 32], 'x');
+		}
+		for (size_t j = 0; j < CYBOZU_NUM_OF_ARRAY(sha256Tbl); j++) {
+			CYBOZU_TEST_EQUAL(toHex(expected[j]), sha256Tbl[j].out);
+		}
+	}
+	limitSha256Feature(sha256ShaNi | sha256Avx2 | sha256Avx512);
+}
+
 const struct HmacTbl {
 	const char *key;
 	const char *msg;
@@ -254,3 +300,123 @@ CYBOZU_TEST_AUTO(hmac512)
 	}
 }
 
+
+/*
+	HMAC by the hash class
+*/
+template<class Hash>
+std::string refHmac(size_t blockSize, std::string key, const std::string& msg)
+{
+	char md[64];
+	Hash hash;
+	if (key.size() > blockSize) {
+		key.assign(md, hash.digest(md, sizeof(md), key.data(), key.size()));
+		hash.clear();
+	}
+	key.resize(blockSize);
+	std::string ipad = key, opad = key;
+	for (size_t i = 0; i < blockSize; i++) {
+		ipad[i] ^= 0x36;
+		opad[i] ^= 0x5c;
+	}
+	const size_t mdSize = hash.digest(md, sizeof(md), (ipad + msg).data(), ipad.size() + msg.size());
+	hash.clear();
+	const std::string inner(md, mdSize);
+	hash.digest(md, sizeof(md), (opad + inner).data(), opad.size() + inner.size());
+	return std::string(md, mdSize);
+}
+
+typedef void (*HmacFunc)(void *hmac, const void *key, size_t keySize, const void *msg, size_t msgSize);
+
+template<class Hmac, class Hash>
+void testHmacContext(size_t blockSize, const HmacTbl *tbl, size_t tblNum, HmacFunc oneShot)
+{
+	const size_t macSize = Hmac::macSize;
+	for (size_t i = 0; i < tblNum; i++) {
+		Uint8Vec key = fromHex(tbl[i].key);
+		Uint8Vec msg = fromHex(tbl[i].msg);
+		Hmac hmac(key.data(), key.size());
+		char mac[64];
+		hmac.compute(mac, msg.data(), msg.size());
+		CYBOZU_TEST_EQUAL(toHex(std::string(mac, macSize)), tbl[i].mac);
+		CYBOZU_TEST_ASSERT(hmac.verify(mac, msg.data(), msg.size()));
+		mac[macSize - 1] ^= 1;
+		CYBOZU_TEST_ASSERT(!hmac.verify(mac, msg.data(), msg.size()));
+	}
+	const size_t keySizeTbl[] = { 0, 1, blockSize - 1, blockSize, blockSize + 1, 300 };
+	const size_t msgSizeTbl[] = { 0, 1, blockSize - 17, blockSize - 16, blockSize - 9, blockSize - 8, blockSize, blockSize + 1, 1000 };
+	for (size_t i = 0; i < CYBOZU_NUM_OF_ARRAY(keySizeTbl); i++) {
+		const std::string key = makeData(keySizeTbl[i], i);
+		Hmac hmac;
+		hmac.setKey(key.data(), key.size());
+		for (size_t j = 0; j < CYBOZU_NUM_OF_ARRAY(msgSizeTbl); j++) {
+			const std::string msg = makeData(msgSizeTbl[j], j + 100);
+			const std::string expected = refHmac<Hash>(blockSize, key, msg);
+			char mac[64];
+			hmac.compute(mac, msg.data(), msg.size());
+			CYBOZU_TEST_EQUAL(std::string(mac, macSize), expected);
+			// the one-shot function by the backend hash
+			oneShot(mac, key.empty() ? 0 : key.data(), key.size(), msg.data(), msg.size());
+			CYBOZU_TEST_EQUAL(std::string(mac, macSize), expected);
+			// split updates
+			const size_t chunkTbl[] = { 1, 7, blockSize, 100 };
+			for (size_t k = 0; k < CYBOZU_NUM_OF_ARRAY(chunkTbl); k++) {
+				for (size_t pos = 0; pos < msg.size(); pos += chunkTbl[k]) {
+					hmac.update(&msg[pos], std::min(chunkTbl[k], msg.size() - pos));
+				}
+				CYBOZU_TEST_EQUAL(hmac.digest(mac, sizeof(mac)), macSize);
+				CYBOZU_TEST_EQUAL(std::string(mac, macSize), expected);
+			}
+			CYBOZU_TEST_EQUAL(hmac.digest(mac, macSize - 1, msg.data(), msg.size()), 0u);
+		}
+	}
+}
+
+CYBOZU_TEST_AUTO(hmacContext)
+{
+	testHmacContext<cybozu::Hmac256, cybozu::Sha256>(64, hmac256Tbl, CYBOZU_NUM_OF_ARRAY(hmac256Tbl), cybozu::hmac256);
+	testHmacContext<cybozu::Hmac512, cybozu::Sha512>(128, hmac512Tbl, CYBOZU_NUM_OF_ARRAY(hmac512Tbl), cybozu::hmac512);
+}
+
+template<class Hmac>
+void testHmacBatch()
+{
+	const size_t macSize = Hmac::macSize;
+	const size_t n = 150;
+	std::vector<std::string> msgVec(n);
+	std::vector<const void*> bufs(n);
+	std::vector<size_t> sizes(n);
+	for (size_t i = 0; i < n; i++) {
+		const size_t tbl[] = { 0, 1, 31, 32, 55, 56, 64, 100, 1000 };
+		msgVec[i] = makeData(tbl[i % CYBOZU_NUM_OF_ARRAY(tbl)] + (i * 7 % 3) * 64, i);
+		bufs[i] = msgVec[i].data();
+		sizes[i] = msgVec[i].size();
+	}
+	const Hmac hmac("key", 3);
+	std::vector<std::string> expected(n);
+	for (size_t i = 0; i < n; i++) {
+		char mac[64];
+		hmac.compute(mac, bufs[i], sizes[i]);
+		expected[i].assign(mac, macSize);
+	}
+	using namespace cybozu::sha2_local;
+	const int maskTbl[] = { 0, sha256ShaNi, sha256Avx2, sha256Avx512, sha256ShaNi | sha256Avx2 | sha256Avx512 };
+	for (size_t i = 0; i < CYBOZU_NUM_OF_ARRAY(maskTbl); i++) {
+		limitSha256Feature(maskTbl[i]);
+		for (size_t m = 0; m <= n; m += 37) {
+			std::vector<char> out(m * macSize + 1, 'x');
+			hmac.computeBatch(&out[0], &bufs[0], &sizes[0], m);
+			for (size_t j = 0; j < m; j++) {
+				CYBOZU_TEST_EQUAL(std::string(&out[j * macSize], macSize), expected[j]);
+			}
+			CYBOZU_TEST_EQUAL(out[m * macSize], 'x');
+		}
+	}
+	limitSha256Feature(sha256ShaNi | sha256Avx2 | sha256Avx512);
+}
+
+CYBOZU_TEST_AUTO(hmacBatch)
+{
+	testHmacBatch<cybozu::Hmac256>();
+	testHmacBatch<cybozu::Hmac512>();
+}
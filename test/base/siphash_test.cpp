@@ -1,5 +1,6 @@
 #include <cybozu/test.hpp>
 #include <cybozu/siphash.hpp>
+#include <vector>
 
 const uint64_t vectors[64] = {
 	0x726fdb47dd0e0e31ULL, 0x74f839c593dc67fdULL, 0x0d6c8009d9a94f5aULL, 0x85676696d7fb7e2dULL,
@@ -31,3 +32,48 @@ CYBOZU_TEST_AUTO(siphash)
 		CYBOZU_TEST_EQUAL(cybozu::siphash24(plaintext, i), vectors[i]);
 	}
 }
+
+CYBOZU_TEST_AUTO(siphash24Batch)
+{
+	std::vector<char> data(10000);
+	for (size_t i = 0; i < data.size(); i++) {
+		data[i] = (char)(i * 13 + (i >> 5));
+	}
+	std::vector<const void*> bufs;
+	std::vector<size_t> sizes;
+	for (size_t i = 0; i < 100; i++) {
+		// similar sizes with a few long keys
+		const size_t size = (i % 37 == 5) ? 5000 + i : (i * 7) % 50;
+		bufs.push_back(&data[i * 3]);
+		sizes.push_back(size);
+	}
+	const uint64_t k0 = 0x123456789abcdef0ULL, k1 = 0xfedcba9876543210ULL;
+	using namespace cybozu::siphash_local;
+	const int maskTbl[] = { 0, simdAvx2, simdAvx2 | simdAvx512 };
+	for (size_t i = 0; i < CYBOZU_NUM_OF_ARRAY(maskTbl); i++) {
+		limitSimdFeature(maskTbl[i]);
+		for (size_t n = 0; n <= bufs.size(); n += 9) {
+			std::vector<uint64_t> out(n + 1, 12345);
+			cybozu::siphash24Batch(&out[0], &bufs[0], &sizes[0], n, k0, k1);
+			for (size_t j = 0; j < n; j++) {
+				CYBOZU_TEST_EQUAL(out[j], cybozu::siphash24(bufs[j], sizes[j], k0, k1));
+			}
+			CYBOZU_TEST_EQUAL(out[n], 12345u);
+		}
+		// test vectors
+		char plaintext[64];
+		const void *p[64];
+		size_t s[64];
+		for (int j = 0; j < 64; j++) {
+			plaintext[j] = (char)j;
+			p[j] = plaintext;
+			s[j] = j;
+		}
+		uint64_t out[64];
+		cybozu::siphash24Batch(out, p, s, 64);
+		for (int j = 0; j < 64; j++) {
+			CYBOZU_TEST_EQUAL(out[j], vectors[j]);
+		}
+	}
+	limitSimdFeature(simdAvx2 | simdAvx512);
+}
@@ -1,4 +1,5 @@
 #include <stdio.h>
+#include <algorithm>
 #include <vector>
 #include <sstream>
 #include <cybozu/test.hpp>
@@ -337,4 +338,161 @@ CYBOZU_TEST_AUTO(Strip)
 		cybozu::Strip(s2);
 		CYBOZU_TEST_EQUAL(s2, tbl[i].out);
 	}
-}
\ No newline at end of file
+}
+template<class String>
+void naiveFindAll(std::vector<typename cybozu::MultiPatternFinderT<typename String::value_type>::Match>& out, const std::vector<String>& patterns, const String& text)
+{
+	typedef typename cybozu::MultiPatternFinderT<typename String::value_type>::Match Match;
+	out.clear();
+	for (size_t id = 0; id < patterns.size(); id++) {
+		const String& pat = patterns[id];
+		size_t pos = 0;
+		for (;;) {
+			pos = text.find(pat, pos);
+			if (pos == String::npos) break;
+			out.push_back(Match(pos, pat.size(), id));
+			pos++;
+		}
+	}
+	std::sort(out.begin(), out.end());
+}
+
+CYBOZU_TEST_AUTO(multiPatternFinder)
+{
+	cybozu::MultiPatternFinder f;
+	const char *tbl[] = { "he", "she", "his", "hers", "she" };
+	for (size_t i = 0; i < CYBOZU_NUM_OF_ARRAY(tbl); i++) {
+		CYBOZU_TEST_EQUAL(f.add(tbl[i]), i);
+	}
+	CYBOZU_TEST_EXCEPTION(f.add(""), cybozu::Exception);
+	CYBOZU_TEST_EXCEPTION(f.contains("ushers"), cybozu::Exception);
+	f.compile();
+	CYBOZU_TEST_EXCEPTION(f.add("x"), cybozu::Exception);
+	std::vector<cybozu::MultiPatternFinder::Match> v;
+	f.findAll(v, "ushers");
+	typedef cybozu::MultiPatternFinder::Match Match;
+	const Match expected[] = { Match(1, 3, 4), Match(1, 3, 1), Match(2, 2, 0), Match(2, 4, 3) };
+	CYBOZU_TEST_EQUAL(v.size(), CYBOZU_NUM_OF_ARRAY(expected));
+	for (size_t i = 0; i < v.size(); i++) {
+		CYBOZU_TEST_ASSERT(v[i] == expected[i]);
+	}
+	CYBOZU_TEST_ASSERT(f.contains("this"));
+	CYBOZU_TEST_ASSERT(!f.contains("abc"));
+	CYBOZU_TEST_ASSERT(!f.contains(""));
+}
+
+template<class String>
+void testRandomMultiPattern(const std::vector<typename String::value_type>& alphabet, size_t patternNum, size_t maxDfaSize)
+{
+	typedef typename String::value_type CharT;
+	typedef cybozu::MultiPatternFinderT<CharT> Finder;
+	unsigned int r = 12345;
+	std::vector<String> patterns;
+	Finder f;
+	for (size_t i = 0; i < patternNum; i++) {
+		String pat;
+		r = r * 1103515245 + 12345;
+		const size_t len = (r >> 16) % 5 + 1;
+		for (size_t j = 0; j < len; j++) {
+			r = r * 1103515245 + 12345;
+			pat += alphabet[(r >> 16) % alphabet.size()];
+		}
+		patterns.push_back(pat);
+		f.add(pat);
+	}
+	f.compile(maxDfaSize);
+	for (size_t textLen = 0; textLen < 200; textLen += 7) {
+		String text;
+		for (size_t j = 0; j < textLen; j++) {
+			r = r * 1103515245 + 12345;
+			text += alphabet[(r >> 16) % alphabet.size()];
+		}
+		std::vector<typename Finder::Match> v1, v2;
+		f.findAll(v1, text);
+		std::sort(v1.begin(), v1.end());
+		naiveFindAll(v2, patterns, text);
+		CYBOZU_TEST_EQUAL(v1.size(), v2.size());
+		CYBOZU_TEST_ASSERT(v1 == v2);
+		CYBOZU_TEST_EQUAL(f.contains(text), !v2.empty());
+	}
+}
+
+template<class String>
+void testRandomMultiPattern(const std::vector<typename String::value_type>& alphabet, size_t patternNum)
+{
+	testRandomMultiPattern<String>(alphabet, patternNum, size_t(1) << 22);
+	testRandomMultiPattern<String>(alphabet, patternNum, 0);
+}
+
+CYBOZU_TEST_AUTO(multiPatternFinderRandom)
+{
+	std::vector<char> alphabet;
+	alphabet.push_back('a');
+	alphabet.push_back('b');
+	alphabet.push_back('c');
+	testRandomMultiPattern<std::string>(alphabet, 1);
+	testRandomMultiPattern<std::string>(alphabet, 3);
+	testRandomMultiPattern<std::string>(alphabet, 50);
+	alphabet.push_back('\x80');
+	alphabet.push_back('\xff');
+	for (char c = 'd'; c <= 'z'; c++) alphabet.push_back(c);
+	testRandomMultiPattern<std::string>(alphabet, 2);
+	testRandomMultiPattern<std::string>(alphabet, 1000);
+
+	std::vector<cybozu::Char> alphabetW;
+	alphabetW.push_back('a');
+	alphabetW.push_back(0xe9);
+	alphabetW.push_back(0x3042);
+	alphabetW.push_back(0x3043);
+	alphabetW.push_back(0x1f600);
+	testRandomMultiPattern<cybozu::String>(alphabetW, 1);
+	testRandomMultiPattern<cybozu::String>(alphabetW, 4);
+	testRandomMultiPattern<cybozu::String>(alphabetW, 300);
+}
+
+CYBOZU_TEST_AUTO(multiPatternFinderFirstBytes)
+{
+	// patterns starting with more than 4 bytes use the nibble table of the first bytes
+	using namespace cybozu::string_local;
+	const int maskTbl[] = { 0, stringSsse3, stringAvx2, stringSsse3 | stringAvx2 };
+	const char *firstTbl[] = { "ab", "#$%&", "\x01\x7f\x80\xff", "0123456789", "\x8f\x9e\xad\xbc\xcb\xda\xe9\xf8" };
+	unsigned int r = 12345;
+	size_t found = 0;
+	for (size_t i = 0; i < CYBOZU_NUM_OF_ARRAY(firstTbl); i++) {
+		const std::string first = firstTbl[i];
+		std::vector<std::string> patterns;
+		cybozu::MultiPatternFinder f;
+		for (size_t j = 0; j < first.size(); j++) {
+			patterns.push_back(first.substr(j, 1) + "x");
+			patterns.push_back(first.substr(j, 1) + "yz");
+			f.add(patterns[patterns.size() - 2]);
+			f.add(patterns.back());
+		}
+		f.compile();
+		for (size_t textLen = 0; textLen < 300; textLen += 13) {
+			// sparse candidates in bytes of all nibbles
+			std::string text;
+			for (size_t j = 0; j < textLen; j++) {
+				r = r * 1103515245 + 12345;
+				const uint32_t v = r >> 16;
+				if (v % 23 == 0) {
+					text += first[(v >> 5) % first.size()];
+					if (v & 32) text += (v & 64) ? "x" : "yz";
+				} else {
+					text += char(v >> 8);
+				}
+			}
+			std::vector<cybozu::MultiPatternFinder::Match> v1, v2;
+			naiveFindAll(v2, patterns, text);
+			found += v2.size();
+			for (size_t k = 0; k < CYBOZU_NUM_OF_ARRAY(maskTbl); k++) {
+				limitStringFeature(maskTbl[k]);
+				f.findAll(v1, text);
+				std::sort(v1.begin(), v1.end());
+				CYBOZU_TEST_ASSERT(v1 == v2);
+			}
+		}
+	}
+	CYBOZU_TEST_ASSERT(found > 100);
+	limitStringFeature(stringSsse3 | stringAvx2);
+}
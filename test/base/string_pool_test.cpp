@@ -0,0 +1,82 @@
+#include <cybozu/test.hpp>
+#include <cybozu/string_pool.hpp>
+#include <cybozu/stream.hpp>
+#include <cybozu/itoa.hpp>
+#include <map>
+
+CYBOZU_TEST_AUTO(intern)
+{
+	cybozu::StringPool pool;
+	CYBOZU_TEST_ASSERT(pool.empty());
+	CYBOZU_TEST_EQUAL(pool.intern("abc"), 0u);
+	CYBOZU_TEST_EQUAL(pool.intern(std::string("xyz")), 1u);
+	CYBOZU_TEST_EQUAL(pool.intern("abc", 3), 0u);
+	CYBOZU_TEST_EQUAL(pool.intern("ab"), 2u);
+	CYBOZU_TEST_EQUAL(pool.intern(""), 3u);
+	CYBOZU_TEST_EQUAL(pool.intern(std::string("a\0b", 3)), 4u);
+	CYBOZU_TEST_EQUAL(pool.intern("a"), 5u);
+	CYBOZU_TEST_EQUAL(pool.size(), 6u);
+	CYBOZU_TEST_EQUAL(pool.find("xyz"), 1u);
+	CYBOZU_TEST_EQUAL(pool.find(""), 3u);
+	CYBOZU_TEST_ASSERT(pool.find("abcd") == cybozu::StringPool::none);
+	CYBOZU_TEST_EQUAL(pool.find(std::string("a\0b", 3)), 4u);
+	CYBOZU_TEST_EQUAL(pool.c_str(2), std::string("ab"));
+	CYBOZU_TEST_EQUAL(pool.getSize(4), 3u);
+	CYBOZU_TEST_EQUAL(pool.getString(4), std::string("a\0b", 3));
+	CYBOZU_TEST_EXCEPTION(pool.c_str(6), cybozu::Exception);
+	pool.clear();
+	CYBOZU_TEST_EQUAL(pool.size(), 0u);
+	CYBOZU_TEST_ASSERT(pool.find("abc") == cybozu::StringPool::none);
+	CYBOZU_TEST_EQUAL(pool.intern("xyz"), 0u);
+}
+
+CYBOZU_TEST_AUTO(many)
+{
+	cybozu::StringPool pool(4096);
+	std::map<std::string, uint32_t> m;
+	const int N = 100000;
+	for (int i = 0; i < N; i++) {
+		const std::string s = cybozu::itoa((i * 7919) % (N / 2));
+		const uint32_t id = pool.intern(s);
+		std::pair<std::map<std::string, uint32_t>::iterator, bool> ret = m.insert(std::make_pair(s, uint32_t(m.size())));
+		CYBOZU_TEST_EQUAL(id, ret.first->second);
+	}
+	CYBOZU_TEST_EQUAL(pool.size(), m.size());
+	for (std::map<std::string, uint32_t>::const_iterator i = m.begin(); i != m.end(); ++i) {
+		CYBOZU_TEST_EQUAL(pool.find(i->first), i->second);
+		CYBOZU_TEST_EQUAL(pool.c_str(i->second), i->first);
+	}
+	CYBOZU_TEST_ASSERT(pool.find("x") == cybozu::StringPool::none);
+
+	std::string buf;
+	{
+		cybozu::StringOutputStream os(buf);
+		pool.save(os);
+	}
+	cybozu::StringPool pool2;
+	pool2.intern("dummy");
+	{
+		cybozu::StringInputStream is(buf);
+		pool2.load(is);
+	}
+	CYBOZU_TEST_EQUAL(pool2.size(), pool.size());
+	for (uint32_t i = 0; i < pool.size(); i++) {
+		CYBOZU_TEST_EQUAL(pool2.getString(i), pool.getString(i));
+	}
+	CYBOZU_TEST_ASSERT(pool2.find("dummy") == cybozu::StringPool::none);
+
+	// a broken count does not allocate memory for it
+	const uint32_t countTbl[] = { cybozu::StringPool::none - 1, cybozu::StringPool::none };
+	for (size_t i = 0; i < CYBOZU_NUM_OF_ARRAY(countTbl); i++) {
+		std::string bad;
+		{
+			cybozu::StringOutputStream os(bad);
+			cybozu::save(os, countTbl[i]);
+			cybozu::save(os, std::string("abc"));
+		}
+		cybozu::StringInputStream is(bad);
+		cybozu::StringPool pool3;
+		CYBOZU_TEST_EXCEPTION(pool3.load(is), cybozu::Exception);
+		CYBOZU_TEST_ASSERT(pool3.getAllocatedSize() < 100 * 1024 * 1024);
+	}
+}
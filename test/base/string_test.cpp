@@ -8,6 +8,8 @@
 #include <iterator>
 #include <stdexcept>
 #include <cybozu/string.hpp>
+#include <cybozu/arena.hpp>
+#include <cybozu/xorshift.hpp>
 #include <cybozu/test.hpp>
 
 using namespace cybozu;
@@ -1558,6 +1560,187 @@ CYBOZU_TEST_AUTO(utf16)
 	}
 }
 
+CYBOZU_TEST_AUTO(utf_bulk)
+{
+	// ASCII runs longer than 16 bytes mixed with 2, 3 and 4 byte characters
+	const cybozu::Char tbl[] = {
+		0x41, 0x7f, 0x80, 0x7ff, 0x800, 0x3042, 0xd7ff, 0xe000, 0xfffd, 0xffff, 0x10000, 0x1f600, 0x10ffff,
+	};
+	std::string utf8;
+	cybozu::String16 utf16;
+	cybozu::String::BasicString utf32;
+	for (int i = 0; i < 200; i++) {
+		const cybozu::Char c = (i % 7 == 0) ? tbl[(i / 7) % CYBOZU_NUM_OF_ARRAY(tbl)] : cybozu::Char('a' + i % 26);
+		cybozu::string::AppendUtf8(utf8, c);
+		cybozu::string::AppendUtf16(utf16, c);
+		utf32 += c;
+		const String s(utf8);
+		CYBOZU_TEST_ASSERT(s.get() == utf32);
+		CYBOZU_TEST_ASSERT(cybozu::string::IsValidUtf8(utf8.data(), utf8.size()));
+		CYBOZU_TEST_EQUAL(s.toUtf8(), utf8);
+		CYBOZU_TEST_ASSERT(s.toUtf16() == utf16);
+		cybozu::String16 t16;
+		CYBOZU_TEST_ASSERT(cybozu::ConvertUtf8ToUtf16(&t16, utf8));
+		CYBOZU_TEST_ASSERT(t16 == utf16);
+		std::string t8;
+		CYBOZU_TEST_ASSERT(cybozu::ConvertUtf16ToUtf8(&t8, utf16));
+		CYBOZU_TEST_EQUAL(t8, utf8);
+	}
+}
+
+CYBOZU_TEST_AUTO(utf_bulk_bad)
+{
+	const char *badTbl[] = {
+		"\x80", "\xbf", "\xc0\xaf", "\xc1\xbf", "\xc2", "\xc2\x41", "\xe0\x80\xaf", "\xe0\x9f\xbf",
+		"\xe3\x81", "\xed\xa0\x80", "\xed\xbf\xbf", "\xf0\x8f\xbf\xbf", "\xf4\x90\x80\x80", "\xf5\x80\x80\x80", "\xff",
+	};
+	const std::string ascii(40, 'x');
+	for (size_t i = 0; i < CYBOZU_NUM_OF_ARRAY(badTbl); i++) {
+		for (size_t pos = 0; pos < ascii.size(); pos += 13) {
+			std::string s = ascii;
+			s.insert(pos, badTbl[i]);
+			CYBOZU_TEST_ASSERT(!cybozu::string::IsValidUtf8(s.data(), s.size()));
+			String str("abc");
+			CYBOZU_TEST_EXCEPTION(str.append(s), cybozu::Exception);
+			CYBOZU_TEST_EQUAL(str, "abc");
+			cybozu::String16 t16;
+			CYBOZU_TEST_ASSERT(!cybozu::ConvertUtf8ToUtf16(&t16, s));
+		}
+	}
+	// lone surrogates in UTF-16
+	const cybozu::Char16 bad16Tbl[][2] = {
+		{ 0xd800, 0x41 }, { 0xdc00, 0xd800 }, { 0x41, 0xd83d },
+	};
+	for (size_t i = 0; i < CYBOZU_NUM_OF_ARRAY(bad16Tbl); i++) {
+		cybozu::String16 s(20, 0x41);
+		s.append(bad16Tbl[i], 2);
+		std::string t;
+		CYBOZU_TEST_ASSERT(!cybozu::ConvertUtf16ToUtf8(&t, s));
+	}
+	// invalid code points in UTF-32
+	const cybozu::Char bad32Tbl[] = { 0xd800, 0xdfff, 0x110000 };
+	for (size_t i = 0; i < CYBOZU_NUM_OF_ARRAY(bad32Tbl); i++) {
+		String s(20, 'a');
+		s += bad32Tbl[i];
+		CYBOZU_TEST_EXCEPTION(s.toUtf8(), cybozu::Exception);
+	}
+}
+
+namespace {
+
+/*
+	convert utf8 by each function and return the results as a string
+*/
+std::string convertUtf8All(const std::string& utf8)
+{
+	std::ostringstream os;
+	os << cybozu::string::IsValidUtf8(utf8.data(), utf8.size());
+	std::vector<cybozu::Char> u32(utf8.size() + 1);
+	const size_t n32 = cybozu::string::Utf8ToUtf32(&u32[0], utf8.data(), utf8.size());
+	os << ':' << n32;
+	if (n32 != size_t(-1)) {
+		for (size_t i = 0; i < n32; i++) os << ' ' << uint32_t(u32[i]);
+	}
+	std::vector<cybozu::Char16> u16(utf8.size() + 1);
+	const size_t n16 = cybozu::string::Utf8ToUtf16(&u16[0], utf8.data(), utf8.size());
+	os << ':' << n16;
+	if (n16 != size_t(-1)) {
+		for (size_t i = 0; i < n16; i++) os << ' ' << uint32_t(u16[i]);
+	}
+	return os.str();
+}
+
+} // namespace
+
+CYBOZU_TEST_AUTO(utf_simd)
+{
+	using namespace cybozu::string_local;
+	const int maskTbl[] = { 0, stringSsse3, stringAvx2, stringSsse3 | stringAvx2 };
+	// the first and the last code points of characters of 1, 2, 3 and 4 bytes
+	const uint32_t rangeTbl[][2] = {
+		{ 0x20, 0x7f }, { 0x80, 0x7ff }, { 0x800, 0xd7ff }, { 0xe000, 0xffff }, { 0x10000, 0x10ffff },
+	};
+	cybozu::XorShift rg;
+	for (int i = 0; i < 300; i++) {
+		// runs of characters of the same length exercise the block kernels
+		std::string utf8;
+		cybozu::String16 utf16;
+		cybozu::String::BasicString utf32;
+		const int runNum = rg() % 8 + 1;
+		for (int j = 0; j < runNum; j++) {
+			const uint32_t *range = rangeTbl[rg() % CYBOZU_NUM_OF_ARRAY(rangeTbl)];
+			const int len = rg() % 40 + 1;
+			for (int k = 0; k < len; k++) {
+				const cybozu::Char c = cybozu::Char(range[0] + rg() % (range[1] - range[0] + 1));
+				cybozu::string::AppendUtf8(utf8, c);
+				cybozu::string::AppendUtf16(utf16, c);
+				utf32 += c;
+			}
+		}
+		std::vector<std::string> inTbl;
+		inTbl.push_back(utf8);
+		// break a byte, cut the tail, insert a stray byte
+		for (int j = 0; j < 4; j++) {
+			std::string s = utf8;
+			s[rg() % s.size()] = char(rg());
+			inTbl.push_back(s);
+			inTbl.push_back(utf8.substr(0, rg() % utf8.size()));
+			s = utf8;
+			const char badTbl[] = { char(0x80), char(0xbf), char(0xc1), char(0xe0), char(0xed), char(0xf4), char(0xf5), char(0xff) };
+			s.insert(rg() % s.size(), 1, badTbl[rg() % CYBOZU_NUM_OF_ARRAY(badTbl)]);
+			inTbl.push_back(s);
+		}
+		for (size_t j = 0; j < inTbl.size(); j++) {
+			limitStringFeature(0);
+			const std::string expected = convertUtf8All(inTbl[j]);
+			for (size_t k = 1; k < CYBOZU_NUM_OF_ARRAY(maskTbl); k++) {
+				limitStringFeature(maskTbl[k]);
+				CYBOZU_TEST_EQUAL(convertUtf8All(inTbl[j]), expected);
+			}
+		}
+		for (size_t k = 0; k < CYBOZU_NUM_OF_ARRAY(maskTbl); k++) {
+			limitStringFeature(maskTbl[k]);
+			CYBOZU_TEST_ASSERT(cybozu::string::IsValidUtf8(utf8.data(), utf8.size()));
+			CYBOZU_TEST_ASSERT(String(utf8).get() == utf32);
+			cybozu::String16 t16;
+			CYBOZU_TEST_ASSERT(cybozu::ConvertUtf8ToUtf16(&t16, utf8));
+			CYBOZU_TEST_ASSERT(t16 == utf16);
+		}
+	}
+	limitStringFeature(stringSsse3 | stringAvx2);
+}
+
+CYBOZU_TEST_AUTO(arena_allocator)
+{
+	typedef cybozu::StringT<cybozu::Char, std::char_traits<cybozu::Char>, cybozu::ArenaAllocator<cybozu::Char> > ArenaString;
+	cybozu::Arena arena;
+	const std::string utf8 = "abc\xe3\x81\x82\xe3\x81\x84\xe3\x81\x86" "defghijklmnopqrstuvwxyz";
+	{
+		ArenaString s(utf8, arena);
+		CYBOZU_TEST_ASSERT(s.get_allocator().getArena() == &arena);
+		CYBOZU_TEST_ASSERT(arena.getAllocatedSize() > 0);
+		CYBOZU_TEST_EQUAL(s.size(), 29u);
+		CYBOZU_TEST_EQUAL(s.toUtf8(), utf8);
+		CYBOZU_TEST_EQUAL(s, utf8);
+		CYBOZU_TEST_EQUAL(s.find(cybozu::Char(0x3044)), 4u);
+		const ArenaString t = s.substr(3, 3);
+		CYBOZU_TEST_ASSERT(t.get_allocator().getArena() == &arena);
+		CYBOZU_TEST_EQUAL(t, "\xe3\x81\x82\xe3\x81\x84\xe3\x81\x86");
+		ArenaString u(t, arena);
+		u += s;
+		CYBOZU_TEST_EQUAL(u.size(), 32u);
+		ArenaString v(arena);
+		v.append("xyz");
+		CYBOZU_TEST_EQUAL(v, "xyz");
+		CYBOZU_TEST_ASSERT(cybozu::String(utf8.c_str()).get() == ArenaString(utf8.c_str(), arena).get().c_str());
+	}
+	// default constructed allocator uses operator new
+	ArenaString w("abc");
+	CYBOZU_TEST_ASSERT(w.get_allocator().getArena() == 0);
+	w += w;
+	CYBOZU_TEST_EQUAL(w, "abcabc");
+}
+
 CYBOZU_TEST_AUTO(Utf8ref)
 {
 	const std::string utf8 = "\xe3\x81\x93\xe3\x82\x8c\xe3\x81\xaf" "UTF-8 1";
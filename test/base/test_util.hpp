@@ -0,0 +1,33 @@
+#pragma once
+/**
+	@file
+	@brief helpers shared by tests
+*/
+#include <cybozu/stream.hpp>
+#include <string>
+
+/*
+	return at most maxSize bytes per readSome to check the boundary of buffer
+*/
+struct SlowInputStream {
+	cybozu::StringInputStream is;
+	size_t maxSize;
+	explicit SlowInputStream(const std::string& str, size_t maxSize = 3) : is(str), maxSize(maxSize) {}
+	size_t readSome(void *buf, size_t size)
+	{
+		if (size > maxSize) size = maxSize;
+		return is.readSome(buf, size);
+	}
+};
+
+/*
+	n bytes of test data which depend on seed
+*/
+inline std::string makeData(size_t n, size_t seed = 0)
+{
+	std::string s(n, 0);
+	for (size_t i = 0; i < n; i++) {
+		s[i] = char(seed * 31 + i * 7 + (i >> 5));
+	}
+	return s;
+}
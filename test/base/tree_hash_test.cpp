@@ -0,0 +1,139 @@
+#include <cybozu/tree_hash.hpp>
+#include <cybozu/test.hpp>
+#include <stdio.h>
+#include <vector>
+#include "test_util.hpp"
+
+typedef cybozu::Sha256Tree Tree;
+
+static const std::string fileName = "tree_hash_test.tmp";
+
+std::string sha256(const std::string& s)
+{
+	char md[32];
+	cybozu::Sha256().digest(md, sizeof(md), s.c_str(), s.size());
+	return std::string(md, sizeof(md));
+}
+
+/*
+	combine nodes of each level by pairs, the last odd node is promoted
+*/
+std::string refRoot(const char *p, size_t size, size_t leafSize)
+{
+	if (size == 0) return sha256("");
+	std::vector<std::string> v;
+	for (size_t pos = 0; pos < size; pos += leafSize) {
+		v.push_back(sha256(std::string(1, '\x00') + std::string(p + pos, std::min(leafSize, size - pos))));
+	}
+	while (v.size() > 1) {
+		std::vector<std::string> w;
+		for (size_t i = 0; i + 1 < v.size(); i += 2) {
+			w.push_back(sha256("\x01" + v[i] + v[i + 1]));
+		}
+		if (v.size() & 1) w.push_back(v.back());
+		v.swap(w);
+	}
+	return v[0];
+}
+
+std::string getRoot(Tree& tree)
+{
+	char md[32];
+	CYBOZU_TEST_EQUAL(tree.digest(md, sizeof(md)), sizeof(md));
+	return std::string(md, sizeof(md));
+}
+
+CYBOZU_TEST_AUTO(root)
+{
+	const std::string data = makeData(5000);
+	const size_t leafSizeTbl[] = { 1, 64, 100, 1024 };
+	const size_t sizeTbl[] = { 0, 1, 63, 64, 100, 101, 299, 300, 1024, 3000, 5000 };
+	for (size_t i = 0; i < CYBOZU_NUM_OF_ARRAY(leafSizeTbl); i++) {
+		const size_t leafSize = leafSizeTbl[i];
+		for (size_t j = 0; j < CYBOZU_NUM_OF_ARRAY(sizeTbl); j++) {
+			const size_t size = sizeTbl[j];
+			const std::string expected = refRoot(&data[0], size, leafSize);
+			for (size_t threadNum = 1; threadNum <= 4; threadNum += 3) {
+				Tree tree(leafSize, threadNum);
+				tree.update(&data[0], size);
+				CYBOZU_TEST_EQUAL(getRoot(tree), expected);
+				CYBOZU_TEST_EQUAL(tree.getTotalSize(), size);
+				CYBOZU_TEST_EQUAL(tree.getLeaves().size(), (size + leafSize - 1) / leafSize);
+				// split updates
+				const size_t chunkTbl[] = { 1, 7, 150 };
+				for (size_t k = 0; k < CYBOZU_NUM_OF_ARRAY(chunkTbl); k++) {
+					tree.clear();
+					for (size_t pos = 0; pos < size; pos += chunkTbl[k]) {
+						tree.update(&data[pos], std::min(chunkTbl[k], size - pos));
+					}
+					CYBOZU_TEST_EQUAL(getRoot(tree), expected);
+				}
+			}
+		}
+	}
+	CYBOZU_TEST_EXCEPTION(Tree(0), cybozu::Exception);
+	CYBOZU_TEST_EXCEPTION(Tree(64, 0), cybozu::Exception);
+}
+
+CYBOZU_TEST_AUTO(file)
+{
+	const std::string data = makeData(100000);
+	{
+		cybozu::File f;
+		f.open(fileName, std::ios::out | std::ios::trunc);
+		f.write(&data[0], data.size());
+	}
+	const size_t bufSizeTbl[] = { 0, 1000, 4096 };
+	for (size_t i = 0; i < CYBOZU_NUM_OF_ARRAY(bufSizeTbl); i++) {
+		Tree tree(1024, 3);
+		cybozu::File f;
+		f.open(fileName, std::ios::in);
+		tree.update(f, bufSizeTbl[i]);
+		CYBOZU_TEST_EQUAL(getRoot(tree), refRoot(&data[0], data.size(), 1024));
+	}
+	::remove(fileName.c_str());
+}
+
+CYBOZU_TEST_AUTO(proof)
+{
+	const size_t leafSize = 100;
+	const std::string data = makeData(1234);
+	const uint64_t totalSize = data.size();
+	Tree tree(leafSize, 2);
+	tree.update(&data[0], data.size());
+	const std::string root = getRoot(tree);
+	const size_t leafNum = tree.getLeaves().size();
+	Tree::DigestVec proof;
+	for (size_t begin = 0; begin < leafNum; begin++) {
+		for (size_t end = begin + 1; end <= leafNum; end++) {
+			const size_t offset = begin * leafSize;
+			const size_t size = std::min(end * leafSize, data.size()) - offset;
+			tree.getProof(proof, offset, size);
+			// verifier only knows root, leafSize and totalSize
+			Tree verifier(leafSize);
+			CYBOZU_TEST_ASSERT(verifier.verify(root.data(), totalSize, offset, &data[offset], size, proof));
+			std::vector<char> forged(data.begin() + offset, data.begin() + offset + size);
+			forged[size / 2] ^= 1;
+			CYBOZU_TEST_ASSERT(!verifier.verify(root.data(), totalSize, offset, &forged[0], size, proof));
+			if (!proof.empty()) {
+				Tree::DigestVec badProof = proof;
+				badProof[0].buf[0] ^= 1;
+				CYBOZU_TEST_ASSERT(!verifier.verify(root.data(), totalSize, offset, &data[offset], size, badProof));
+				badProof.pop_back();
+				CYBOZU_TEST_ASSERT(!verifier.verify(root.data(), totalSize, offset, &data[offset], size, badProof));
+			}
+			Tree::DigestVec longProof = proof;
+			longProof.push_back(Tree::Digest());
+			CYBOZU_TEST_ASSERT(!verifier.verify(root.data(), totalSize, offset, &data[offset], size, longProof));
+		}
+	}
+	// the whole data needs no proof
+	tree.getProof(proof, 0, totalSize);
+	CYBOZU_TEST_ASSERT(proof.empty());
+	// bad ranges
+	CYBOZU_TEST_EXCEPTION(tree.getProof(proof, 50, 100), cybozu::Exception);
+	CYBOZU_TEST_EXCEPTION(tree.getProof(proof, 100, 150), cybozu::Exception);
+	CYBOZU_TEST_EXCEPTION(tree.getProof(proof, 1200, 100), cybozu::Exception);
+	CYBOZU_TEST_EXCEPTION(tree.getProof(proof, 0, 0), cybozu::Exception);
+	CYBOZU_TEST_EXCEPTION(Tree(leafSize).verify(root.data(), totalSize, 1300, &data[0], 100, proof), cybozu::Exception);
+}
@@ -0,0 +1,251 @@
+#include <cybozu/unordered_map.hpp>
+#include <cybozu/unordered_set.hpp>
+#include <cybozu/test.hpp>
+#include <cybozu/xorshift.hpp>
+#include <string>
+#include <map>
+#include <set>
+
+typedef cybozu::FlatHashMap<int, int> IntMap;
+typedef std::map<int, int> RefMap;
+
+void verifyMap(const IntMap& m, const RefMap& ref)
+{
+	CYBOZU_TEST_EQUAL(m.size(), ref.size());
+	CYBOZU_TEST_EQUAL(m.empty(), ref.empty());
+	size_t n = 0;
+	for (IntMap::const_iterator i = m.begin(), ie = m.end(); i != ie; ++i) {
+		RefMap::const_iterator j = ref.find(i->first);
+		CYBOZU_TEST_ASSERT(j != ref.end());
+		CYBOZU_TEST_EQUAL(i->second, j->second);
+		n++;
+	}
+	CYBOZU_TEST_EQUAL(n, ref.size());
+	CYBOZU_TEST_ASSERT(m.load_factor() <= m.max_load_factor());
+}
+
+CYBOZU_TEST_AUTO(map)
+{
+	IntMap m;
+	CYBOZU_TEST_ASSERT(m.empty());
+	CYBOZU_TEST_ASSERT(m.begin() == m.end());
+	CYBOZU_TEST_ASSERT(m.find(3) == m.end());
+	CYBOZU_TEST_EQUAL(m.count(3), 0u);
+	CYBOZU_TEST_EQUAL(m.erase(3), 0u);
+	CYBOZU_TEST_EQUAL(m.bucket_count(), 0u);
+	CYBOZU_TEST_EXCEPTION(m.at(3), cybozu::Exception);
+
+	std::pair<IntMap::iterator, bool> r = m.insert(std::make_pair(3, 10));
+	CYBOZU_TEST_ASSERT(r.second);
+	CYBOZU_TEST_EQUAL(r.first->first, 3);
+	CYBOZU_TEST_EQUAL(r.first->second, 10);
+	r = m.insert(std::make_pair(3, 20));
+	CYBOZU_TEST_ASSERT(!r.second);
+	CYBOZU_TEST_EQUAL(r.first->second, 10);
+	m[5] = 7;
+	m[3]++;
+	CYBOZU_TEST_EQUAL(m.size(), 2u);
+	CYBOZU_TEST_EQUAL(m.at(3), 11);
+	CYBOZU_TEST_EQUAL(m[5], 7);
+	CYBOZU_TEST_EQUAL(m[6], 0);
+	CYBOZU_TEST_EQUAL(m.size(), 3u);
+	IntMap::iterator it = m.find(5);
+	CYBOZU_TEST_ASSERT(it != m.end());
+	it->second = 8;
+	CYBOZU_TEST_EQUAL(m.at(5), 8);
+	m.erase(it);
+	CYBOZU_TEST_EQUAL(m.count(5), 0u);
+	CYBOZU_TEST_EQUAL(m.size(), 2u);
+	m.clear();
+	CYBOZU_TEST_ASSERT(m.empty());
+	CYBOZU_TEST_ASSERT(m.begin() == m.end());
+	CYBOZU_TEST_ASSERT(m.find(3) == m.end());
+}
+
+CYBOZU_TEST_AUTO(random)
+{
+	cybozu::XorShift rg;
+	IntMap m;
+	RefMap ref;
+	for (int i = 0; i < 200000; i++) {
+		const int k = int(rg() % 3000);
+		switch (rg() % 4) {
+		case 0:
+		case 1:
+			m[k] = i;
+			ref[k] = i;
+			break;
+		case 2:
+			CYBOZU_TEST_EQUAL(m.erase(k), ref.erase(k));
+			break;
+		case 3:
+			{
+				IntMap::const_iterator p = m.find(k);
+				RefMap::const_iterator q = ref.find(k);
+				CYBOZU_TEST_EQUAL(p == m.end(), q == ref.end());
+				if (q != ref.end()) CYBOZU_TEST_EQUAL(p->second, q->second);
+			}
+			break;
+		}
+		CYBOZU_TEST_EQUAL(m.size(), ref.size());
+	}
+	verifyMap(m, ref);
+	// erase while iterating
+	for (IntMap::iterator i = m.begin(); i != m.end();) {
+		if (i->first & 1) {
+			ref.erase(i->first);
+			i = m.erase(i);
+		} else {
+			++i;
+		}
+	}
+	verifyMap(m, ref);
+	// many erases leave deleted slots, which are reused
+	const size_t capacity = m.bucket_count();
+	for (int i = 0; i < 100000; i++) {
+		const int k = 10000 + i;
+		m[k] = i;
+		m.erase(k);
+	}
+	CYBOZU_TEST_EQUAL(m.bucket_count(), capacity);
+	verifyMap(m, ref);
+}
+
+CYBOZU_TEST_AUTO(copy)
+{
+	IntMap a;
+	RefMap ref;
+	for (int i = 0; i < 1000; i++) {
+		a[i * 7] = i;
+		ref[i * 7] = i;
+	}
+	IntMap b(a);
+	verifyMap(b, ref);
+	IntMap c;
+	c[1] = 2;
+	c = a;
+	verifyMap(c, ref);
+	c[1] = 2;
+	CYBOZU_TEST_EQUAL(c.size(), a.size() + 1);
+	IntMap d;
+	d.swap(c);
+	CYBOZU_TEST_ASSERT(c.empty());
+	CYBOZU_TEST_EQUAL(d.at(1), 2);
+	IntMap e(ref.begin(), ref.end());
+	verifyMap(e, ref);
+#if CYBOZU_CPP_VERSION >= CYBOZU_CPP_VERSION_CPP11
+	IntMap f(std::move(e));
+	verifyMap(f, ref);
+	CYBOZU_TEST_ASSERT(e.empty());
+#endif
+}
+
+CYBOZU_TEST_AUTO(reserve)
+{
+	IntMap m(1000);
+	const size_t capacity = m.bucket_count();
+	CYBOZU_TEST_ASSERT(capacity >= 1000);
+	for (int i = 0; i < 1000; i++) m[i] = i;
+	CYBOZU_TEST_EQUAL(m.bucket_count(), capacity);
+	for (int i = 0; i < 990; i++) m.erase(i);
+	m.rehash(0);
+	CYBOZU_TEST_ASSERT(m.bucket_count() < capacity);
+	CYBOZU_TEST_EQUAL(m.size(), 10u);
+	for (int i = 990; i < 1000; i++) CYBOZU_TEST_EQUAL(m.at(i), i);
+}
+
+CYBOZU_TEST_AUTO(stringKey)
+{
+	cybozu::FlatHashMap<std::string, std::string> m;
+	std::map<std::string, std::string> ref;
+	for (int i = 0; i < 5000; i++) {
+		const std::string k = "key" + std::string(i % 30, 'x') + char('a' + i % 26) + char('0' + i % 10) + char('A' + i / 26 % 26);
+		m[k] += "v";
+		ref[k] += "v";
+	}
+	CYBOZU_TEST_EQUAL(m.size(), ref.size());
+	for (std::map<std::string, std::string>::const_iterator i = ref.begin(); i != ref.end(); ++i) {
+		CYBOZU_TEST_EQUAL(m.at(i->first), i->second);
+	}
+	CYBOZU_TEST_ASSERT(m.find("none") == m.end());
+}
+
+CYBOZU_TEST_AUTO(set)
+{
+	typedef cybozu::FlatHashSet<std::string> Set;
+	Set s;
+	std::set<std::string> ref;
+	CYBOZU_TEST_ASSERT(s.insert("abc").second);
+	CYBOZU_TEST_ASSERT(!s.insert("abc").second);
+	CYBOZU_TEST_EQUAL(*s.find("abc"), "abc");
+	ref.insert("abc");
+	for (int i = 0; i < 1000; i++) {
+		const std::string k(1 + i % 20, char('a' + i % 7));
+		s.insert(k);
+		ref.insert(k);
+	}
+	CYBOZU_TEST_EQUAL(s.size(), ref.size());
+	for (Set::const_iterator i = s.begin(); i != s.end(); ++i) {
+		CYBOZU_TEST_EQUAL(ref.count(*i), 1u);
+	}
+	CYBOZU_TEST_EQUAL(s.erase("abc"), 1u);
+	CYBOZU_TEST_EQUAL(s.count("abc"), 0u);
+	const Set t(ref.begin(), ref.end());
+	CYBOZU_TEST_EQUAL(t.size(), ref.size());
+	CYBOZU_TEST_EQUAL(t.count("abc"), 1u);
+}
+
+/*
+	count copies and live objects, and throw on the copy after copyLimit copies
+*/
+struct Counted {
+	int v;
+	static int copyNum;
+	static int copyLimit;
+	static int liveNum;
+	explicit Counted(int v = 0) : v(v) { liveNum++; }
+	Counted(const Counted& rhs) : v(rhs.v)
+	{
+		if (copyNum == copyLimit) throw cybozu::Exception("Counted:copy");
+		copyNum++;
+		liveNum++;
+	}
+#if CYBOZU_CPP_VERSION >= CYBOZU_CPP_VERSION_CPP11
+	Counted(Counted&& rhs) noexcept : v(rhs.v) { liveNum++; }
+#endif
+	~Counted() { liveNum--; }
+	bool operator==(const Counted& rhs) const { return v == rhs.v; }
+};
+int Counted::copyNum = 0;
+int Counted::copyLimit = -1;
+int Counted::liveNum = 0;
+
+struct CountedHash {
+	size_t operator()(const Counted& x) const { return size_t(x.v); }
+};
+
+CYBOZU_TEST_AUTO(elementCopy)
+{
+	typedef cybozu::FlatHashSet<Counted, CountedHash> Set;
+	{
+		Set s;
+		for (int i = 0; i < 1000; i++) s.insert(Counted(i));
+		Counted::copyNum = 0;
+		s.rehash(5000);
+		CYBOZU_TEST_EQUAL(s.size(), 1000u);
+#if CYBOZU_CPP_VERSION >= CYBOZU_CPP_VERSION_CPP11
+		// elements are moved
+		CYBOZU_TEST_EQUAL(Counted::copyNum, 0);
+#else
+		CYBOZU_TEST_EQUAL(Counted::copyNum, 1000);
+#endif
+		const int liveNum = Counted::liveNum;
+		Counted::copyNum = 0;
+		Counted::copyLimit = 500;
+		CYBOZU_TEST_EXCEPTION(Set t(s), cybozu::Exception);
+		Counted::copyLimit = -1;
+		// the elements copied before the exception are destroyed
+		CYBOZU_TEST_EQUAL(Counted::liveNum, liveNum);
+	}
+	CYBOZU_TEST_EQUAL(Counted::liveNum, 0);
+}
@@ -0,0 +1,123 @@
+#include <cybozu/utf8_string.hpp>
+#include <cybozu/test.hpp>
+#include <sstream>
+
+typedef cybozu::Utf8String Str;
+const size_t npos = size_t(-1);
+
+CYBOZU_TEST_AUTO(construct)
+{
+	// a-i-u-e-o
+	const char *aiueo = "\xe3\x81\x82\xe3\x81\x84\xe3\x81\x86\xe3\x81\x88\xe3\x81\x8a";
+	Str s(aiueo);
+	CYBOZU_TEST_EQUAL(s.size(), 5u);
+	CYBOZU_TEST_EQUAL(s.byteSize(), 15u);
+	CYBOZU_TEST_ASSERT(s[0] == 0x3042);
+	CYBOZU_TEST_ASSERT(s[4] == 0x304a);
+	CYBOZU_TEST_EQUAL(s.toString(), cybozu::String(aiueo));
+	CYBOZU_TEST_EQUAL(Str(cybozu::String(aiueo)), s);
+	CYBOZU_TEST_EQUAL(s, aiueo);
+	CYBOZU_TEST_EQUAL(s, std::string(aiueo));
+	CYBOZU_TEST_ASSERT(s.toUtf16() == cybozu::ToUtf16(aiueo));
+
+	Str t;
+	CYBOZU_TEST_ASSERT(t.empty());
+	CYBOZU_TEST_EQUAL(t.size(), 0u);
+	t += "abc";
+	t += cybozu::Char(0x1f600);
+	t += s;
+	CYBOZU_TEST_EQUAL(t.size(), 9u);
+	CYBOZU_TEST_EQUAL(t.byteSize(), 22u);
+	CYBOZU_TEST_ASSERT(t[3] == 0x1f600);
+	CYBOZU_TEST_ASSERT(t.at(8) == 0x304a);
+	CYBOZU_TEST_EXCEPTION(t.at(9), cybozu::Exception);
+	CYBOZU_TEST_EQUAL(t.substr(3, 2), "\xf0\x9f\x98\x80\xe3\x81\x82");
+	CYBOZU_TEST_EQUAL(t.substr(8), "\xe3\x81\x8a");
+	CYBOZU_TEST_EQUAL(t.substr(9), "");
+	CYBOZU_TEST_EXCEPTION(t.substr(10), cybozu::Exception);
+	std::ostringstream os;
+	os << t;
+	CYBOZU_TEST_EQUAL(os.str(), t.get());
+
+	CYBOZU_TEST_EXCEPTION(Str("\xe3\x81"), cybozu::Exception);
+	CYBOZU_TEST_EXCEPTION(t.append("\xc0\xaf"), cybozu::Exception);
+	CYBOZU_TEST_EXCEPTION(t.append(cybozu::Char(0xd800)), cybozu::Exception);
+	CYBOZU_TEST_EQUAL(t.size(), 9u);
+}
+
+CYBOZU_TEST_AUTO(iterator)
+{
+	const cybozu::String s("abc\xe3\x81\x82\xc3\xa9\xf0\x9f\x98\x80z");
+	const Str t(s);
+	cybozu::String u(t.begin(), t.end());
+	CYBOZU_TEST_EQUAL(u, s);
+	size_t i = s.size();
+	Str::const_iterator it = t.end();
+	while (it != t.begin()) {
+		--it;
+		i--;
+		CYBOZU_TEST_ASSERT(*it == s[i]);
+	}
+	CYBOZU_TEST_EQUAL(i, 0u);
+}
+
+CYBOZU_TEST_AUTO(index)
+{
+	// long strings use the sparse index
+	cybozu::String s;
+	for (int i = 0; i < 1000; i++) {
+		const cybozu::Char tbl[] = { 'a', 0xe9, 0x3042, 0x1f600 };
+		s += tbl[(i * 7 + i / 3) % 4];
+	}
+	const Str t(s);
+	CYBOZU_TEST_EQUAL(t.size(), s.size());
+	for (size_t i = 0; i < s.size(); i++) {
+		CYBOZU_TEST_ASSERT(t[i] == s[i]);
+		CYBOZU_TEST_EQUAL(t.getPos(t.getByteOffset(i)), i);
+	}
+	for (size_t i = s.size(); i > 0; i--) {
+		CYBOZU_TEST_ASSERT(t[i - 1] == s[i - 1]);
+	}
+	CYBOZU_TEST_EQUAL(t.getByteOffset(s.size()), t.byteSize());
+	CYBOZU_TEST_EQUAL(t.substr(100, 200).toString(), s.substr(100, 200));
+	// copy does not share the index
+	Str u = t;
+	u += "x";
+	CYBOZU_TEST_ASSERT(u[s.size()] == 'x');
+	CYBOZU_TEST_ASSERT(u[500] == s[500]);
+}
+
+CYBOZU_TEST_AUTO(find)
+{
+	const cybozu::String s("\xe3\x81\x82" "abc\xe3\x81\x84" "abc\xe3\x81\x82");
+	const Str t(s);
+	const char *tbl[] = { "abc", "\xe3\x81\x82", "\xe3\x81\x84" "a", "c\xe3\x81\x82", "", "xyz" };
+	for (size_t i = 0; i < CYBOZU_NUM_OF_ARRAY(tbl); i++) {
+		const cybozu::String key(tbl[i]);
+		for (size_t pos = 0; pos <= s.size(); pos++) {
+			CYBOZU_TEST_EQUAL(t.find(tbl[i], pos), s.find(key, pos));
+			CYBOZU_TEST_EQUAL(t.rfind(tbl[i], pos), s.rfind(key, pos));
+		}
+		CYBOZU_TEST_EQUAL(t.rfind(tbl[i]), s.rfind(key));
+	}
+	CYBOZU_TEST_EQUAL(t.find(cybozu::Char(0x3044)), 4u);
+	CYBOZU_TEST_EQUAL(t.rfind(cybozu::Char(0x3042)), 8u);
+	CYBOZU_TEST_EQUAL(t.find(cybozu::Char('x')), npos);
+	CYBOZU_TEST_EQUAL(t.find("abc", 100), npos);
+}
+
+CYBOZU_TEST_AUTO(compare)
+{
+	const char *tbl[] = {
+		"", "a", "ab", "b", "\x7f", "\xc2\x80", "\xdf\xbf", "\xe0\xa0\x80", "\xef\xbf\xbf", "\xf0\x90\x80\x80",
+	};
+	for (size_t i = 0; i < CYBOZU_NUM_OF_ARRAY(tbl); i++) {
+		for (size_t j = 0; j < CYBOZU_NUM_OF_ARRAY(tbl); j++) {
+			const Str a(tbl[i]), b(tbl[j]);
+			const cybozu::String sa(tbl[i]), sb(tbl[j]);
+			CYBOZU_TEST_EQUAL(a < b, sa < sb);
+			CYBOZU_TEST_EQUAL(a == b, sa == sb);
+			CYBOZU_TEST_EQUAL(a >= b, sa >= sb);
+		}
+	}
+}
@@ -0,0 +1,61 @@
+#include <cybozu/test.hpp>
+#include <cybozu/nlp/tfidf.hpp>
+#include <fstream>
+#include <stdio.h>
+
+void appendDoc(cybozu::nlp::Df& df, const char *words[], size_t n)
+{
+	for (size_t i = 0; i < n; i++) {
+		df.append(words[i]);
+	}
+	df.endDoc();
+}
+
+int getDf(const cybozu::nlp::Df& df, const char *word)
+{
+	const uint32_t id = df.word2id_.find(word);
+	return id == cybozu::StringPool::none ? 0 : df.df_[id];
+}
+
+CYBOZU_TEST_AUTO(df)
+{
+	cybozu::nlp::Df df;
+	const char *doc1[] = { "The", "cat", "the", "THE", "cat" };
+	const char *doc2[] = { "the", "dog" };
+	appendDoc(df, doc1, CYBOZU_NUM_OF_ARRAY(doc1));
+	appendDoc(df, doc2, CYBOZU_NUM_OF_ARRAY(doc2));
+	CYBOZU_TEST_EQUAL(df.docNum_, 2);
+	CYBOZU_TEST_EQUAL(df.word2id_.size(), 3u);
+	// counted once in a doc regardless of case
+	CYBOZU_TEST_EQUAL(getDf(df, "the"), 2);
+	CYBOZU_TEST_EQUAL(getDf(df, "cat"), 1);
+	CYBOZU_TEST_EQUAL(getDf(df, "dog"), 1);
+	CYBOZU_TEST_EQUAL(getDf(df, "The"), 0);
+}
+
+CYBOZU_TEST_AUTO(tfIdf)
+{
+	const char *keyFile = "tfidf_test_key.txt";
+	{
+		std::ofstream ofs(keyFile, std::ios::binary);
+		ofs << "cat\t3\ndog\t2\ncat\t1\n";
+	}
+	cybozu::nlp::TfIdf tfIdf;
+	CYBOZU_TEST_ASSERT(tfIdf.loadKeywordFile(keyFile));
+	remove(keyFile);
+	CYBOZU_TEST_EQUAL(tfIdf.word2id_.size(), 2u);
+	const char *doc1[] = { "Cat", "cat", "bird" };
+	const char *doc2[] = { "dog", "cat" };
+	for (size_t i = 0; i < CYBOZU_NUM_OF_ARRAY(doc1); i++) tfIdf.append(doc1[i]);
+	tfIdf.endDoc();
+	for (size_t i = 0; i < CYBOZU_NUM_OF_ARRAY(doc2); i++) tfIdf.append(doc2[i]);
+	tfIdf.endDoc();
+	const uint32_t cat = tfIdf.word2id_.find("cat");
+	const uint32_t dog = tfIdf.word2id_.find("dog");
+	CYBOZU_TEST_EQUAL(tfIdf.tf_.size(), 2u);
+	CYBOZU_TEST_EQUAL(tfIdf.tf_[0].find(cat)->second, 2);
+	CYBOZU_TEST_ASSERT(tfIdf.tf_[0].find(dog) == tfIdf.tf_[0].end());
+	CYBOZU_TEST_EQUAL(tfIdf.tf_[1].find(dog)->second, 1);
+	CYBOZU_TEST_EQUAL(tfIdf.df_[cat], 2);
+	CYBOZU_TEST_EQUAL(tfIdf.df_[dog], 1);
+}